@@ -2,8 +2,10 @@
 // TreeBillboardsApp.cpp by Frank Luna (C) 2015 All Rights Reserved.
 //***************************************************************************************
 
+#include "../../Common/DDSFile.h"
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/MathHelper.h"
+#include "../../Common/MipGenerator.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/d3dApp.h"
 #include "FrameResource.h"
@@ -561,11 +563,77 @@ void TreeBillboardsApp::LoadTextures() {
       md3dDevice.Get(), mCommandList.Get(), fenceTex->Filename.c_str(),
       fenceTex->Resource, fenceTex->UploadHeap));
 
+  // treeArray2.dds has no mips, so distant trees shimmer.  Build the chain
+  // here, scaling alpha so each level passes TreeSprite.hlsl's alpha test
+  // (clip below 0.1) over as much of the sprite as the full size image does.
   auto treeArrayTex = std::make_unique<Texture>();
   treeArrayTex->Name = "treeArrayTex";
   treeArrayTex->Filename = L"../../Textures/treeArray2.dds";
-  ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(
-      md3dDevice.Get(), mCommandList.Get(), treeArrayTex->Filename.c_str(),
+
+  DDSFile treeFile;
+  if (treeFile.Open(treeArrayTex->Filename) != DDSFile::Status::Ok ||
+      treeFile.Decompress() != DDSFile::Status::Ok)
+    ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
+
+  DDSFile::Description treeDesc = treeFile.GetDescription();
+
+  MipGenerator::Options mipOptions;
+  mipOptions.Kernel = MipGenerator::Filter::Kaiser;
+  mipOptions.PreserveAlphaCoverage = true;
+  mipOptions.AlphaReference = 0.1f;
+
+  std::vector<std::vector<MipGenerator::Level>> slices(treeDesc.ArraySize);
+  for (UINT slice = 0; slice < treeDesc.ArraySize; ++slice) {
+    const DDSFile::Subresource &top =
+        treeFile.GetSubresources()[slice * treeDesc.MipLevels];
+    if (!MipGenerator::Generate(treeDesc.Format, treeFile.SubresourceData(top),
+                                top.Width, top.Height, top.RowPitch,
+                                mipOptions, slices[slice]))
+      ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED));
+
+#if defined(DEBUG) | defined(_DEBUG)
+    // Levels with enough texels to measure keep the coverage of level 0, with
+    // the box kernel as well as the Kaiser one.
+    MipGenerator::Options boxOptions = mipOptions;
+    boxOptions.Kernel = MipGenerator::Filter::Box;
+    std::vector<MipGenerator::Level> boxLevels;
+    bool generated = MipGenerator::Generate(
+        treeDesc.Format, treeFile.SubresourceData(top), top.Width, top.Height,
+        top.RowPitch, boxOptions, boxLevels);
+    assert(generated);
+    assert(boxLevels.size() == slices[slice].size());
+
+    float coverage = MipGenerator::AlphaCoverage(
+        treeDesc.Format, slices[slice][0], mipOptions.AlphaReference);
+    for (size_t i = 0; i < boxLevels.size(); ++i) {
+      const MipGenerator::Level &level = slices[slice][i];
+      if (level.Width * level.Height < 64)
+        continue;
+
+      assert(fabsf(MipGenerator::AlphaCoverage(treeDesc.Format, level,
+                                               mipOptions.AlphaReference) -
+                   coverage) <= 0.02f);
+      assert(fabsf(MipGenerator::AlphaCoverage(treeDesc.Format, boxLevels[i],
+                                               mipOptions.AlphaReference) -
+                   coverage) <= 0.02f);
+    }
+#endif
+  }
+
+  treeDesc.MipLevels = (UINT)slices[0].size();
+
+  std::vector<const uint8_t *> subresources;
+  for (const auto &levels : slices) {
+    for (const MipGenerator::Level &level : levels)
+      subresources.push_back(level.Pixels.data());
+  }
+
+  std::vector<uint8_t> treeDds;
+  if (!DDSFile::Serialize(treeDesc, subresources, treeDds))
+    ThrowIfFailed(E_FAIL);
+
+  ThrowIfFailed(DirectX::CreateDDSTextureFromMemory12(
+      md3dDevice.Get(), mCommandList.Get(), treeDds.data(), treeDds.size(),
       treeArrayTex->Resource, treeArrayTex->UploadHeap));
 
   mTextures[grassTex->Name] = std::move(grassTex);
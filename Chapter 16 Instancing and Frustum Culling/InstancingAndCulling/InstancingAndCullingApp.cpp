@@ -7,7 +7,14 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/Camera.h"
+#include "../../Common/MeshOptimizer.h"
+#include "../../Common/FrustumCuller.h"
+#include "../../Common/SceneBVH.h"
+#include "../../Common/OcclusionCuller.h"
+#include "../../Common/MeshSimplifier.h"
 #include "FrameResource.h"
+#include <numeric>
+#include <ppl.h>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -18,6 +25,13 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Visible instances written to the instance buffer per parallel work item.
+const UINT gInstanceWriteChunkSize = 16384;
+
+// The nearest instances in the frustum are drawn into the software depth
+// buffer to hide the instances behind them.
+const UINT gOccluderCount = 8;
+
 // Lightweight structure stores parameters to draw a shape.  This will
 // vary from app-to-app.
 struct RenderItem
@@ -50,6 +64,13 @@ struct RenderItem
 	BoundingBox Bounds;
 	std::vector<InstanceData> Instances;
 
+	// World-space bounds of the instances, both flat and as a hierarchy, and
+	// room for the indices of the visible ones.
+	FrustumCuller InstanceCuller;
+	SceneBVH InstanceBVH;
+	std::vector<BoundingBox> InstanceBounds;
+	std::vector<std::uint32_t> VisibleInstances;
+
     // DrawIndexedInstanced parameters.
     UINT IndexCount = 0;
 	UINT InstanceCount = 0;
@@ -79,6 +100,7 @@ private:
     void OnKeyboardInput(const GameTimer& gt);
 	void AnimateMaterials(const GameTimer& gt);
 	void UpdateInstanceData(const GameTimer& gt);
+	UINT CullOccludedInstances(RenderItem* ritem, UINT visibleInstanceCount);
 	void UpdateMaterialBuffer(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 
@@ -125,7 +147,16 @@ private:
 
 	bool mFrustumCullingEnabled = true;
 
-	BoundingFrustum mCamFrustum;
+	// Walk InstanceBVH, or test every box with InstanceCuller.
+	bool mHierarchicalCullingEnabled = true;
+
+	// A coarse LOD of the skull drawn into the software depth buffer for the
+	// nearest instances; the instances left by frustum culling are then tested
+	// against its hierarchical-Z pyramid.
+	bool mOcclusionCullingEnabled = true;
+	OcclusionCuller mOcclusionCuller;
+	std::vector<XMFLOAT3> mOccluderPositions;
+	std::vector<std::uint32_t> mOccluderIndices;
 
     PassConstants mMainPassCB;
 
@@ -209,7 +240,9 @@ void InstancingAndCullingApp::OnResize()
 
 	mCamera.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 
-	BoundingFrustum::CreateFromMatrix(mCamFrustum, mCamera.GetProj());
+	// Keep the aspect of the software depth buffer that of the camera.
+	const UINT occlusionHeight = (UINT)(OcclusionCuller::DefaultWidth / AspectRatio());
+	mOcclusionCuller.Resize(OcclusionCuller::DefaultWidth, std::max(occlusionHeight, 1u));
 }
 
 void InstancingAndCullingApp::Update(const GameTimer& gt)
@@ -355,6 +388,18 @@ void InstancingAndCullingApp::OnKeyboardInput(const GameTimer& gt)
 	if(GetAsyncKeyState('2') & 0x8000)
 		mFrustumCullingEnabled = false;
 
+	if(GetAsyncKeyState('3') & 0x8000)
+		mHierarchicalCullingEnabled = true;
+
+	if(GetAsyncKeyState('4') & 0x8000)
+		mHierarchicalCullingEnabled = false;
+
+	if(GetAsyncKeyState('5') & 0x8000)
+		mOcclusionCullingEnabled = true;
+
+	if(GetAsyncKeyState('6') & 0x8000)
+		mOcclusionCullingEnabled = false;
+
 	mCamera.UpdateViewMatrix();
 }
  
@@ -366,41 +411,81 @@ void InstancingAndCullingApp::AnimateMaterials(const GameTimer& gt)
 void InstancingAndCullingApp::UpdateInstanceData(const GameTimer& gt)
 {
 	XMMATRIX view = mCamera.GetView();
-	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+	XMMATRIX proj = mCamera.GetProj();
+
+	// The frustum planes in world space, once per frame, instead of bringing the
+	// frustum into the local space of every instance.
+	XMFLOAT4 planes[6];
+	FrustumCuller::ExtractPlanes(XMMatrixMultiply(view, proj), planes);
 
 	auto currInstanceBuffer = mCurrFrameResource->InstanceBuffer.get();
 	for(auto& e : mAllRitems)
 	{
 		const auto& instanceData = e->Instances;
 
-		int visibleInstanceCount = 0;
-
-		for(UINT i = 0; i < (UINT)instanceData.size(); ++i)
+		// Writes the visible instances indices[0..count) to the structured
+		// buffer, starting at element first.  Called from several threads at
+		// once, each with its own range of the buffer.
+		auto writeInstances = [&](std::uint32_t first, const std::uint32_t* indices, std::uint32_t count)
 		{
-			XMMATRIX world = XMLoadFloat4x4(&instanceData[i].World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&instanceData[i].TexTransform);
-
-			XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(world), world);
+			for(std::uint32_t i = 0; i < count; ++i)
+			{
+				const auto& instance = instanceData[indices[i]];
 
-			// View space to the object's local space.
-			XMMATRIX viewToLocal = XMMatrixMultiply(invView, invWorld);
- 
-			// Transform the camera frustum from view space to the object's local space.
-			BoundingFrustum localSpaceFrustum;
-			mCamFrustum.Transform(localSpaceFrustum, viewToLocal);
+				XMMATRIX world = XMLoadFloat4x4(&instance.World);
+				XMMATRIX texTransform = XMLoadFloat4x4(&instance.TexTransform);
 
-			// Perform the box/frustum intersection test in local space.
-			if((localSpaceFrustum.Contains(e->Bounds) != DirectX::DISJOINT) || (mFrustumCullingEnabled==false))
-			{
 				InstanceData data;
 				XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
 				XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(texTransform));
-				data.MaterialIndex = instanceData[i].MaterialIndex;
+				data.MaterialIndex = instance.MaterialIndex;
 
-				// Write the instance data to structured buffer for the visible objects.
-				currInstanceBuffer->CopyData(visibleInstanceCount++, data);
+				currInstanceBuffer->CopyData(first + i, data);
+			}
+		};
+
+		const bool occlusionCulling = mFrustumCullingEnabled && mOcclusionCullingEnabled;
+
+		UINT visibleInstanceCount = (UINT)instanceData.size();
+		if(mFrustumCullingEnabled && !mHierarchicalCullingEnabled)
+		{
+			// Test every world-space box against the planes.  Without occlusion
+			// culling each chunk of visible instances is written as soon as its
+			// place in the buffer is known.  Instances come out in index order.
+			if(occlusionCulling)
+			{
+				visibleInstanceCount = e->InstanceCuller.CullParallel(planes, e->VisibleInstances.data());
+				visibleInstanceCount = CullOccludedInstances(e.get(), visibleInstanceCount);
+			}
+			else
+			{
+				visibleInstanceCount = e->InstanceCuller.CullParallel(planes, e->VisibleInstances.data(), writeInstances);
 			}
 		}
+		else
+		{
+			// Walk the hierarchy of instance bounds against the planes.  Groups
+			// of instances entirely inside the frustum are taken without testing
+			// each.  Instances come out in tree order.
+			if(mFrustumCullingEnabled)
+				visibleInstanceCount = e->InstanceBVH.Cull(planes, e->VisibleInstances.data());
+			else
+				std::iota(e->VisibleInstances.begin(), e->VisibleInstances.end(), 0u);
+
+			if(occlusionCulling)
+				visibleInstanceCount = CullOccludedInstances(e.get(), visibleInstanceCount);
+		}
+
+		if(!mFrustumCullingEnabled || mHierarchicalCullingEnabled || occlusionCulling)
+		{
+			const UINT chunkCount = (visibleInstanceCount + gInstanceWriteChunkSize - 1) / gInstanceWriteChunkSize;
+			concurrency::parallel_for(0u, chunkCount, [&](UINT chunk)
+			{
+				const UINT first = chunk*gInstanceWriteChunkSize;
+				const UINT count = std::min(gInstanceWriteChunkSize, visibleInstanceCount - first);
+				writeInstances(first, e->VisibleInstances.data() + first, count);
+			});
+		}
 
 		e->InstanceCount = visibleInstanceCount;
 
@@ -408,11 +493,43 @@ void InstancingAndCullingApp::UpdateInstanceData(const GameTimer& gt)
 		outs.precision(6);
 		outs << L"Instancing and Culling Demo" <<
 			L"    " << e->InstanceCount <<
-			L" objects visible out of " << e->Instances.size();
+			L" objects visible out of " << e->Instances.size() <<
+			(mHierarchicalCullingEnabled ? L" (hierarchy" : L" (flat") <<
+			(mOcclusionCullingEnabled ? L", occlusion)" : L")");
 		mMainWndCaption = outs.str();
 	}
 }
 
+UINT InstancingAndCullingApp::CullOccludedInstances(RenderItem* ritem, UINT visibleInstanceCount)
+{
+	XMVECTOR eyePos = mCamera.GetPosition();
+
+	// Take the nearest instances in the frustum as occluders; they hide the
+	// most of the screen.
+	std::vector<std::pair<float, std::uint32_t>> nearest(visibleInstanceCount);
+	for(UINT i = 0; i < visibleInstanceCount; ++i)
+	{
+		const std::uint32_t index = ritem->VisibleInstances[i];
+		XMVECTOR center = XMLoadFloat3(&ritem->InstanceBounds[index].Center);
+		nearest[i] = std::make_pair(XMVectorGetX(XMVector3LengthSq(center - eyePos)), index);
+	}
+
+	const UINT occluderCount = std::min(gOccluderCount, visibleInstanceCount);
+	std::partial_sort(nearest.begin(), nearest.begin() + occluderCount, nearest.end());
+
+	mOcclusionCuller.Begin(XMMatrixMultiply(mCamera.GetView(), mCamera.GetProj()));
+	for(UINT i = 0; i < occluderCount; ++i)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&ritem->Instances[nearest[i].second].World);
+		mOcclusionCuller.AddOccluder(mOccluderPositions.data(), sizeof(XMFLOAT3), mOccluderPositions.size(),
+			mOccluderIndices.data(), mOccluderIndices.size(), world);
+	}
+	mOcclusionCuller.End();
+
+	// Keeps the survivors in the order the frustum culler left them.
+	return mOcclusionCuller.Cull(ritem->InstanceBounds.data(), ritem->VisibleInstances.data(), visibleInstanceCount);
+}
+
 void InstancingAndCullingApp::UpdateMaterialBuffer(const GameTimer& gt)
 {
 	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
@@ -739,6 +856,28 @@ void InstancingAndCullingApp::BuildSkullGeometry()
 
 	fin.close();
 
+	// The skull is drawn once per visible instance, so reorder it for the
+	// post-transform cache and vertex fetch.
+	MeshOptimizer::Optimize(vertices, indices);
+
+	// The occluder drawn into the software depth buffer only needs the shape.
+	// Its vertices stay within 2% of the skull's size of the original surface,
+	// less than a texel of the depth buffer for skulls more than about 30 units
+	// away, which leaves some 2600 triangles.
+	MeshSimplifier::Options occluderOptions;
+	occluderOptions.NormalWeight = 0.0f;
+	occluderOptions.TexCWeight = 0.0f;
+	occluderOptions.OptimizeVertexCache = false;
+	MeshSimplifier::Lod occluder = MeshSimplifier::Simplify(
+		MeshSimplifier::Attributes(vertices, &Vertex::Pos),
+		reinterpret_cast<const std::uint32_t*>(indices.data()), indices.size(),
+		1000, 0.02f, occluderOptions);
+
+	mOccluderPositions.resize(vertices.size());
+	for(size_t i = 0; i < vertices.size(); ++i)
+		mOccluderPositions[i] = vertices[i].Pos;
+	mOccluderIndices = std::move(occluder.Indices);
+
 	//
 	// Pack the indices of all the meshes into one index buffer.
 	//
@@ -938,6 +1077,20 @@ void InstancingAndCullingApp::BuildRenderItems()
 		}
 	}
 
+	// The instances do not move, so their world-space bounds and the hierarchy
+	// over them are built once.
+	std::vector<BoundingBox>& instanceBounds = skullRitem->InstanceBounds;
+	instanceBounds.resize(mInstanceCount);
+	skullRitem->InstanceCuller.Resize(mInstanceCount);
+	for(UINT i = 0; i < mInstanceCount; ++i)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&skullRitem->Instances[i].World);
+		skullRitem->Bounds.Transform(instanceBounds[i], world);
+		skullRitem->InstanceCuller.SetBounds(i, instanceBounds[i]);
+	}
+	skullRitem->InstanceBVH.Build(instanceBounds.data(), mInstanceCount);
+	skullRitem->VisibleInstances.resize(mInstanceCount);
+
 
 	mAllRitems.push_back(std::move(skullRitem));
 	
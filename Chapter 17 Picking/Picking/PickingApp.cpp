@@ -6,7 +6,10 @@
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/MeshCleanup.h"
 #include "../../Common/Camera.h"
+#include "../../Common/TriangleBVH.h"
+#include "../../Common/RayQuery.h"
 #include "FrameResource.h"
 
 using Microsoft::WRL::ComPtr;
@@ -48,6 +51,10 @@ struct RenderItem
 	Material* Mat = nullptr;
 	MeshGeometry* Geo = nullptr;
 
+	// Hierarchy over the triangles of the submesh for picking, or null to
+	// test every triangle.
+	const TriangleBVH* Triangles = nullptr;
+
     // Primitive topology.
     D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
@@ -121,6 +128,9 @@ private:
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
 
+	// Triangle hierarchies for picking, by submesh name.
+	std::unordered_map<std::string, std::unique_ptr<TriangleBVH>> mTriangleBVHs;
+
     std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
  
 	// List of all the render items.
@@ -610,7 +620,7 @@ void PickingApp::BuildCarGeometry()
 	fin >> ignore;
 	fin >> ignore;
 
-	std::vector<std::int32_t> indices(3 * tcount);
+	std::vector<std::uint32_t> indices(3 * tcount);
 	for(UINT i = 0; i < tcount; ++i)
 	{
 		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
@@ -618,13 +628,17 @@ void PickingApp::BuildCarGeometry()
 
 	fin.close();
 
+	// The model stores some positions more than once; weld them and drop any
+	// triangles that collapse.
+	MeshCleanup::Clean(vertices, indices, &Vertex::Pos, &Vertex::Normal);
+
 	//
 	// Pack the indices of all the meshes into one index buffer.
 	//
 
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
+	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint32_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "carGeo";
@@ -654,6 +668,12 @@ void PickingApp::BuildCarGeometry()
 
 	geo->DrawArgs["car"] = submesh;
 
+	// Build the picking hierarchy once from the CPU copy of the geometry.
+	auto carBVH = std::make_unique<TriangleBVH>();
+	carBVH->Build(&((Vertex*)geo->VertexBufferCPU->GetBufferPointer())->Pos, sizeof(Vertex), vertices.size(),
+		(std::uint32_t*)geo->IndexBufferCPU->GetBufferPointer(), submesh.IndexCount);
+	mTriangleBVHs["car"] = std::move(carBVH);
+
 	mGeometries[geo->Name] = std::move(geo);
 }
 
@@ -763,6 +783,7 @@ void PickingApp::BuildRenderItems()
 	carRitem->IndexCount = carRitem->Geo->DrawArgs["car"].IndexCount;
 	carRitem->StartIndexLocation = carRitem->Geo->DrawArgs["car"].StartIndexLocation;
 	carRitem->BaseVertexLocation = carRitem->Geo->DrawArgs["car"].BaseVertexLocation;
+	carRitem->Triangles = mTriangleBVHs["car"].get();
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(carRitem.get());
 
 	auto pickedRitem = std::make_unique<RenderItem>();
@@ -919,49 +940,87 @@ void PickingApp::Pick(int sx, int sy)
 		float tmin = 0.0f;
 		if(ri->Bounds.Intersects(rayOrigin, rayDir, tmin))
 		{
-			// NOTE: For the demo, we know what to cast the vertex/index data to.  If we were mixing
-			// formats, some metadata would be needed to figure out what to cast it to.
-			auto vertices = (Vertex*)geo->VertexBufferCPU->GetBufferPointer();
-			auto indices = (std::uint32_t*)geo->IndexBufferCPU->GetBufferPointer();
-			UINT triCount = ri->IndexCount / 3;
-
-			// Find the nearest ray/triangle intersection.
-			tmin = MathHelper::Infinity;
-			for(UINT i = 0; i < triCount; ++i)
+			UINT pickedTriangle = 0;
+			bool picked = false;
+
+			if(ri->Triangles != nullptr)
 			{
-				// Indices for this triangle.
-				UINT i0 = indices[i * 3 + 0];
-				UINT i1 = indices[i * 3 + 1];
-				UINT i2 = indices[i * 3 + 2];
-
-				// Vertices for this triangle.
-				XMVECTOR v0 = XMLoadFloat3(&vertices[i0].Pos);
-				XMVECTOR v1 = XMLoadFloat3(&vertices[i1].Pos);
-				XMVECTOR v2 = XMLoadFloat3(&vertices[i2].Pos);
-
-				// We have to iterate over all the triangles in order to find the nearest intersection.
-				float t = 0.0f;
-				if(TriangleTests::Intersects(rayOrigin, rayDir, v0, v1, v2, t))
-				{
-					if(t < tmin)
-					{
-						// This is the new nearest picked triangle.
-						tmin = t;
-						UINT pickedTriangle = i;
+				// The hierarchy only tests the triangles near the ray, and finds
+				// the same nearest triangle as the loop below.
+				RayQuery::Ray ray;
+				XMStoreFloat3(&ray.Origin, rayOrigin);
+				XMStoreFloat3(&ray.Direction, rayDir);
 
-						mPickedRitem->Visible = true;
-						mPickedRitem->IndexCount = 3;
-						mPickedRitem->BaseVertexLocation = 0;
+				RayQuery::Hit hit;
+				RayQuery::Intersect(*ri->Triangles, &ray, 1, &hit);
 
-						// Picked render item needs same world matrix as object picked.
-						mPickedRitem->World = ri->World;
-						mPickedRitem->NumFramesDirty = gNumFrameResources;
+#if defined(DEBUG) | defined(_DEBUG)
+				// The query must find the triangle a single ray through the tree
+				// finds, at the same distance up to rounding.
+				UINT triangle = RayQuery::NoHit;
+				float dist = 0.0f;
+				bool treeHit = ri->Triangles->Intersects(rayOrigin, rayDir, triangle, dist);
+				assert(treeHit == (hit.Triangle != RayQuery::NoHit));
+				assert(!treeHit || (triangle == hit.Triangle && fabsf(dist - hit.Distance) <= 1e-5f*dist));
+#endif
 
-						// Offset to the picked triangle in the mesh index buffer.
-						mPickedRitem->StartIndexLocation = 3 * pickedTriangle;
+				if(hit.Triangle != RayQuery::NoHit)
+				{
+					picked = true;
+					pickedTriangle = hit.Triangle;
+					tmin = hit.Distance;
+				}
+			}
+			else
+			{
+				// NOTE: For the demo, we know what to cast the vertex/index data to.  If we were mixing
+				// formats, some metadata would be needed to figure out what to cast it to.
+				auto vertices = (Vertex*)geo->VertexBufferCPU->GetBufferPointer();
+				auto indices = (std::uint32_t*)geo->IndexBufferCPU->GetBufferPointer();
+				UINT triCount = ri->IndexCount / 3;
+
+				// Find the nearest ray/triangle intersection.
+				tmin = MathHelper::Infinity;
+				for(UINT i = 0; i < triCount; ++i)
+				{
+					// Indices for this triangle.
+					UINT i0 = indices[i * 3 + 0];
+					UINT i1 = indices[i * 3 + 1];
+					UINT i2 = indices[i * 3 + 2];
+
+					// Vertices for this triangle.
+					XMVECTOR v0 = XMLoadFloat3(&vertices[i0].Pos);
+					XMVECTOR v1 = XMLoadFloat3(&vertices[i1].Pos);
+					XMVECTOR v2 = XMLoadFloat3(&vertices[i2].Pos);
+
+					// We have to iterate over all the triangles in order to find the nearest intersection.
+					float t = 0.0f;
+					if(TriangleTests::Intersects(rayOrigin, rayDir, v0, v1, v2, t))
+					{
+						if(t < tmin)
+						{
+							// This is the new nearest picked triangle.
+							tmin = t;
+							pickedTriangle = i;
+							picked = true;
+						}
 					}
 				}
 			}
+
+			if(picked)
+			{
+				mPickedRitem->Visible = true;
+				mPickedRitem->IndexCount = 3;
+				mPickedRitem->BaseVertexLocation = 0;
+
+				// Picked render item needs same world matrix as object picked.
+				mPickedRitem->World = ri->World;
+				mPickedRitem->NumFramesDirty = gNumFrameResources;
+
+				// Offset to the picked triangle in the mesh index buffer.
+				mPickedRitem->StartIndexLocation = 3 * pickedTriangle;
+			}
 		}
 	}
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/Camera.h"
+#include "../../Common/MeshletBuilder.h"
 #include "FrameResource.h"
 
 using Microsoft::WRL::ComPtr;
@@ -51,6 +52,11 @@ struct RenderItem
     UINT IndexCount = 0;
     UINT StartIndexLocation = 0;
     int BaseVertexLocation = 0;
+
+	// If set, the meshlets are culled each frame and only the index ranges of
+	// the survivors are drawn instead of IndexCount indices.
+	const MeshletBuilder::MeshletData* Meshlets = nullptr;
+	std::vector<MeshletBuilder::IndexRange> VisibleRanges;
 };
 
 enum class RenderLayer : int
@@ -84,6 +90,7 @@ private:
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMaterialBuffer(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
+	void CullMeshlets(const GameTimer& gt);
 
 	void LoadTextures();
     void BuildRootSignature();
@@ -127,9 +134,13 @@ private:
 
 	UINT mSkyTexHeapIndex = 0;
 
+	// The skull's triangles in clusters small enough to cull one by one.
+	MeshletBuilder::MeshletData mSkullMeshlets;
+
     PassConstants mMainPassCB;
 
 	Camera mCamera;
+	BoundingFrustum mCamFrustum;
 
     POINT mLastMousePos;
 };
@@ -207,6 +218,8 @@ void CubeMapApp::OnResize()
     D3DApp::OnResize();
 
 	mCamera.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
+
+	BoundingFrustum::CreateFromMatrix(mCamFrustum, mCamera.GetProj());
 }
 
 void CubeMapApp::Update(const GameTimer& gt)
@@ -231,6 +244,7 @@ void CubeMapApp::Update(const GameTimer& gt)
 	UpdateObjectCBs(gt);
 	UpdateMaterialBuffer(gt);
 	UpdateMainPassCB(gt);
+	CullMeshlets(gt);
 }
 
 void CubeMapApp::Draw(const GameTimer& gt)
@@ -455,6 +469,22 @@ void CubeMapApp::UpdateMainPassCB(const GameTimer& gt)
 	currPassCB->CopyData(0, mMainPassCB);
 }
 
+void CubeMapApp::CullMeshlets(const GameTimer& gt)
+{
+	XMMATRIX view = mCamera.GetView();
+
+	for(auto& e : mAllRitems)
+	{
+		if(e->Meshlets == nullptr)
+			continue;
+
+		// Drop the meshlets outside the frustum or facing away from the camera.
+		XMMATRIX world = XMLoadFloat4x4(&e->World);
+		e->VisibleRanges.clear();
+		MeshletBuilder::Cull(*e->Meshlets, mCamFrustum, world, view, e->VisibleRanges);
+	}
+}
+
 void CubeMapApp::LoadTextures()
 {
     std::vector<std::string> texNames =
@@ -473,14 +503,19 @@ void CubeMapApp::LoadTextures()
         L"../../Textures/grasscube1024.dds"
     };
 
+    // All the textures share one upload buffer and are copied in one go.
+    std::vector<ComPtr<ID3D12Resource>> texResources;
+    ComPtr<ID3D12Resource> uploadArena;
+    ThrowIfFailed(DirectX::CreateDDSTexturesFromFiles12(md3dDevice.Get(),
+        mCommandList.Get(), texFilenames, texResources, uploadArena));
+
     for (int i = 0; i < (int)texNames.size(); ++i)
     {
         auto texMap = std::make_unique<Texture>();
         texMap->Name = texNames[i];
         texMap->Filename = texFilenames[i];
-        ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-            mCommandList.Get(), texMap->Filename.c_str(),
-            texMap->Resource, texMap->UploadHeap));
+        texMap->Resource = texResources[i];
+        texMap->UploadHeap = uploadArena;
 
         mTextures[texMap->Name] = std::move(texMap);
     }
@@ -788,13 +823,34 @@ void CubeMapApp::BuildSkullGeometry()
 
     fin.close();
 
+    // Draw the triangles in meshlet order, so the surviving meshlets of each
+    // frame are runs of the index buffer.
+    mSkullMeshlets = MeshletBuilder::Build(vertices, &Vertex::Pos, indices);
+
+#if defined(DEBUG) | defined(_DEBUG)
+    // Every meshlet keeps to the limits, and together they cover each triangle
+    // exactly once, in order.
+    UINT meshletTriangles = 0;
+    for(const MeshletBuilder::Meshlet& meshlet : mSkullMeshlets.Meshlets)
+    {
+        assert(meshlet.VertexCount <= MeshletBuilder::MaxVertices);
+        assert(meshlet.TriangleCount > 0 && meshlet.TriangleCount <= MeshletBuilder::MaxTriangles);
+        assert(meshlet.TriangleOffset == meshletTriangles);
+        meshletTriangles += meshlet.TriangleCount;
+    }
+    assert(meshletTriangles == tcount);
+    assert(mSkullMeshlets.Indices.size() == indices.size());
+#endif
+
+    const std::vector<std::uint32_t>& meshletIndices = mSkullMeshlets.Indices;
+
     //
     // Pack the indices of all the meshes into one index buffer.
     //
 
     const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 
-    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
+    const UINT ibByteSize = (UINT)meshletIndices.size() * sizeof(std::uint32_t);
 
     auto geo = std::make_unique<MeshGeometry>();
     geo->Name = "skullGeo";
@@ -803,13 +859,13 @@ void CubeMapApp::BuildSkullGeometry()
     CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
 
     ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-    CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+    CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), meshletIndices.data(), ibByteSize);
 
     geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
         mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
     geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+        mCommandList.Get(), meshletIndices.data(), ibByteSize, geo->IndexBufferUploader);
 
     geo->VertexByteStride = sizeof(Vertex);
     geo->VertexBufferByteSize = vbByteSize;
@@ -817,7 +873,7 @@ void CubeMapApp::BuildSkullGeometry()
     geo->IndexBufferByteSize = ibByteSize;
 
     SubmeshGeometry submesh;
-    submesh.IndexCount = (UINT)indices.size();
+    submesh.IndexCount = (UINT)meshletIndices.size();
     submesh.StartIndexLocation = 0;
     submesh.BaseVertexLocation = 0;
     submesh.Bounds = bounds;
@@ -984,6 +1040,7 @@ void CubeMapApp::BuildRenderItems()
     skullRitem->IndexCount = skullRitem->Geo->DrawArgs["skull"].IndexCount;
     skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["skull"].StartIndexLocation;
     skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["skull"].BaseVertexLocation;
+    skullRitem->Meshlets = &mSkullMeshlets;
 
     mRitemLayer[(int)RenderLayer::Opaque].push_back(skullRitem.get());
     mAllRitems.push_back(std::move(skullRitem));
@@ -1088,7 +1145,15 @@ void CubeMapApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::
 
 		cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
 
-        cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		if(ri->Meshlets != nullptr)
+		{
+			for(const MeshletBuilder::IndexRange& range : ri->VisibleRanges)
+				cmdList->DrawIndexedInstanced(range.IndexCount, 1, range.StartIndexLocation, ri->BaseVertexLocation, 0);
+		}
+		else
+		{
+			cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		}
     }
 }
 
@@ -493,15 +493,20 @@ void NormalMapApp::LoadTextures()
             L"../../Textures/waves1.dds"
 	};
 	
+	// All the textures share one upload buffer and are copied in one go.
+	std::vector<ComPtr<ID3D12Resource>> texResources;
+	ComPtr<ID3D12Resource> uploadArena;
+	ThrowIfFailed(DirectX::CreateDDSTexturesFromFiles12(md3dDevice.Get(),
+		mCommandList.Get(), texFilenames, texResources, uploadArena));
+
 	for(int i = 0; i < (int)texNames.size(); ++i)
 	{
 		auto texMap = std::make_unique<Texture>();
 		texMap->Name = texNames[i];
 		texMap->Filename = texFilenames[i];
-		ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-			mCommandList.Get(), texMap->Filename.c_str(),
-			texMap->Resource, texMap->UploadHeap));
-			
+		texMap->Resource = texResources[i];
+		texMap->UploadHeap = uploadArena;
+
 		mTextures[texMap->Name] = std::move(texMap);
 	}		
 }
@@ -7,6 +7,7 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/Camera.h"
+#include "../../Common/MeshOptimizer.h"
 #include "FrameResource.h"
 #include "ShadowMap.h"
 #include "Ssao.h"
@@ -1283,6 +1284,8 @@ void SkinnedMeshApp::LoadSkinnedModel()
 	m3dLoader.LoadM3d(mSkinnedModelFilename, vertices, indices, 
         mSkinnedSubsets, mSkinnedMats, mSkinnedInfo);
 
+    MeshOptimizer::Optimize(vertices, indices, mSkinnedSubsets);
+
     mSkinnedModelInst = std::make_unique<SkinnedModelInstance>();
     mSkinnedModelInst->SkinnedInfo = &mSkinnedInfo;
     mSkinnedModelInst->FinalTransforms.resize(mSkinnedInfo.BoneCount());
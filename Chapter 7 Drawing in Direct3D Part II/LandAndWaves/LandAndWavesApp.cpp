@@ -8,6 +8,7 @@
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/GeometryCache.h"
 #include "FrameResource.h"
 #include "Waves.h"
 
@@ -496,54 +497,76 @@ void LandAndWavesApp::BuildShadersAndInputLayout()
 
 void LandAndWavesApp::BuildLandGeometry()
 {
-	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 160.0f, 50, 50);
+	const float width = 160.0f;
+	const float depth = 160.0f;
+	const std::uint32_t m = 50;
+	const std::uint32_t n = 50;
+
+	// The land depends only on the grid and on GetHillsHeight, so it is built once
+	// and then loaded from the cache.  Bump the version when changing the height
+	// function or the coloring below.
+	GeometryCache cache;
+	GeometryCache::Key gridKey = GeometryCache::Key("CreateGrid", GeometryGenerator::Version)
+		.Add(width).Add(depth).Add(m).Add(n);
+	GeometryCache::Key landKey = GeometryCache::Key("LandAndWaves.Land", 1).Add(gridKey);
+
+	std::vector<Vertex> vertices;
+	std::vector<std::uint32_t> indices32;
+	cache.GetOrCreate(landKey, vertices, indices32,
+		[this, width, depth, m, n](std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices)
+	{
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData grid = geoGen.CreateGrid(width, depth, m, n);
 
-	//
-	// Extract the vertex elements we are interested and apply the height function to
-	// each vertex.  In addition, color the vertices based on their height so we have
-	// sandy looking beaches, grassy low hills, and snow mountain peaks.
-	//
+		//
+		// Extract the vertex elements we are interested and apply the height function to
+		// each vertex.  In addition, color the vertices based on their height so we have
+		// sandy looking beaches, grassy low hills, and snow mountain peaks.
+		//
 
-	std::vector<Vertex> vertices(grid.Vertices.size());
-	for(size_t i = 0; i < grid.Vertices.size(); ++i)
-	{
-		auto& p = grid.Vertices[i].Position;
-		vertices[i].Pos = p;
-		vertices[i].Pos.y = GetHillsHeight(p.x, p.z);
-
-        // Color the vertex based on its height.
-        if(vertices[i].Pos.y < -10.0f)
-        {
-            // Sandy beach color.
-            vertices[i].Color = XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
-        }
-        else if(vertices[i].Pos.y < 5.0f)
-        {
-            // Light yellow-green.
-            vertices[i].Color = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
-        }
-        else if(vertices[i].Pos.y < 12.0f)
-        {
-            // Dark yellow-green.
-            vertices[i].Color = XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
-        }
-        else if(vertices[i].Pos.y < 20.0f)
-        {
-            // Dark brown.
-            vertices[i].Color = XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
-        }
-        else
-        {
-            // White snow.
-            vertices[i].Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-        }
-	}
+		vertices.resize(grid.Vertices.size());
+		for(size_t i = 0; i < grid.Vertices.size(); ++i)
+		{
+			auto& p = grid.Vertices[i].Position;
+			vertices[i].Pos = p;
+			vertices[i].Pos.y = GetHillsHeight(p.x, p.z);
+
+			// Color the vertex based on its height.
+			if(vertices[i].Pos.y < -10.0f)
+			{
+				// Sandy beach color.
+				vertices[i].Color = XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
+			}
+			else if(vertices[i].Pos.y < 5.0f)
+			{
+				// Light yellow-green.
+				vertices[i].Color = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
+			}
+			else if(vertices[i].Pos.y < 12.0f)
+			{
+				// Dark yellow-green.
+				vertices[i].Color = XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
+			}
+			else if(vertices[i].Pos.y < 20.0f)
+			{
+				// Dark brown.
+				vertices[i].Color = XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
+			}
+			else
+			{
+				// White snow.
+				vertices[i].Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+			}
+		}
+
+		indices = std::move(grid.Indices32);
+	});
     
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 
-	std::vector<std::uint16_t> indices = grid.GetIndices16();
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+	// Narrowed to 16 bits in place, without a second copy.
+	CompactIndices indices(std::move(indices32));
+	const UINT ibByteSize = (UINT)indices.ByteSize();
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "landGeo";
@@ -552,21 +575,21 @@ void LandAndWavesApp::BuildLandGeometry()
 	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
 
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.Data(), ibByteSize);
 
 	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+		mCommandList.Get(), indices.Data(), ibByteSize, geo->IndexBufferUploader);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+	geo->IndexFormat = indices.Format();
 	geo->IndexBufferByteSize = ibByteSize;
 
 	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
+	submesh.IndexCount = (UINT)indices.Count();
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 
@@ -6,6 +6,7 @@
 
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/MathHelper.h"
+#include "../../Common/MeshBatchBuilder.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/d3dApp.h"
 #include "FrameResource.h"
@@ -530,125 +531,60 @@ void ShapesApp::BuildShadersAndInputLayout() {
 }
 
 void ShapesApp::BuildShapeGeometry() {
-  GeometryGenerator geoGen;
-  GeometryGenerator::MeshData box = geoGen.CreateBox(1.5f, 0.5f, 1.5f, 3);
-  GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, 60, 40);
-  GeometryGenerator::MeshData sphere = geoGen.CreateGeosphere(0.5f, 3);
-  GeometryGenerator::MeshData cylinder =
-      geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
-
-  //
-  // We are concatenating all the geometry into one big vertex/index buffer.  So
-  // define the regions in the buffer each submesh covers.
-  //
-
-  // Cache the vertex offsets to each object in the concatenated vertex buffer.
-  UINT boxVertexOffset = 0;
-  UINT gridVertexOffset = (UINT)box.Vertices.size();
-  UINT sphereVertexOffset = gridVertexOffset + (UINT)grid.Vertices.size();
-  UINT cylinderVertexOffset = sphereVertexOffset + (UINT)sphere.Vertices.size();
-
-  // Cache the starting index for each object in the concatenated index buffer.
-  UINT boxIndexOffset = 0;
-  UINT gridIndexOffset = (UINT)box.Indices32.size();
-  UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.Indices32.size();
-  UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
-
-  // Define the SubmeshGeometry that cover different
-  // regions of the vertex/index buffers.
-
-  SubmeshGeometry boxSubmesh;
-  boxSubmesh.IndexCount = (UINT)box.Indices32.size();
-  boxSubmesh.StartIndexLocation = boxIndexOffset;
-  boxSubmesh.BaseVertexLocation = boxVertexOffset;
-
-  SubmeshGeometry gridSubmesh;
-  gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
-  gridSubmesh.StartIndexLocation = gridIndexOffset;
-  gridSubmesh.BaseVertexLocation = gridVertexOffset;
-
-  SubmeshGeometry sphereSubmesh;
-  sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
-  sphereSubmesh.StartIndexLocation = sphereIndexOffset;
-  sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
-
-  SubmeshGeometry cylinderSubmesh;
-  cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
-  cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
-  cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
-
   //
-  // Extract the vertex elements we are interested in and pack the
-  // vertices of all the meshes into one vertex buffer.
+  // We are concatenating all the geometry into one big vertex/index buffer.  The
+  // generator writes the positions and normals straight into our vertex format
+  // and the batch builder keeps track of the region each submesh covers.
   //
 
-  auto totalVertexCount = box.Vertices.size() + grid.Vertices.size() +
-                          sphere.Vertices.size() + cylinder.Vertices.size();
-
-  std::vector<Vertex> vertices(totalVertexCount);
+  using ShapeVertexTraits =
+      GeometryGenerator::VertexTraits<Vertex, &Vertex::Pos, &Vertex::Normal>;
 
-  UINT k = 0;
-  for (size_t i = 0; i < box.Vertices.size(); ++i, ++k) {
-    vertices[k].Pos = box.Vertices[i].Position;
-    vertices[k].Normal = box.Vertices[i].Normal;
-  }
-
-  for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k) {
-    vertices[k].Pos = grid.Vertices[i].Position;
-    vertices[k].Normal = grid.Vertices[i].Normal;
-  }
-
-  for (size_t i = 0; i < sphere.Vertices.size(); ++i, ++k) {
-    vertices[k].Pos = sphere.Vertices[i].Position;
-    vertices[k].Normal = sphere.Vertices[i].Normal;
-  }
-
-  for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k) {
-    vertices[k].Pos = cylinder.Vertices[i].Position;
-    vertices[k].Normal = cylinder.Vertices[i].Normal;
-  }
-
-  std::vector<std::uint16_t> indices;
-  indices.insert(indices.end(), std::begin(box.GetIndices16()),
-                 std::end(box.GetIndices16()));
-  indices.insert(indices.end(), std::begin(grid.GetIndices16()),
-                 std::end(grid.GetIndices16()));
-  indices.insert(indices.end(), std::begin(sphere.GetIndices16()),
-                 std::end(sphere.GetIndices16()));
-  indices.insert(indices.end(), std::begin(cylinder.GetIndices16()),
-                 std::end(cylinder.GetIndices16()));
-
-  const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-  const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+  GeometryGenerator geoGen;
+  MeshBatchBuilder<Vertex> builder(&Vertex::Pos);
+
+  builder.AddGenerated("box", [&](auto &vertices, auto &indices) {
+    geoGen.CreateBox<ShapeVertexTraits>(1.5f, 0.5f, 1.5f, 3, vertices, indices);
+  });
+  builder.AddGenerated("grid", [&](auto &vertices, auto &indices) {
+    geoGen.CreateGrid<ShapeVertexTraits>(20.0f, 30.0f, 60, 40, vertices,
+                                         indices);
+  });
+  builder.AddGenerated("sphere", [&](auto &vertices, auto &indices) {
+    geoGen.CreateGeosphere<ShapeVertexTraits>(0.5f, 3, vertices, indices);
+  });
+  builder.AddGenerated("cylinder", [&](auto &vertices, auto &indices) {
+    geoGen.CreateCylinder<ShapeVertexTraits>(0.5f, 0.3f, 3.0f, 20, 20, vertices,
+                                             indices);
+  });
+
+  MeshBatchBuilder<Vertex>::Batch batch = builder.Build();
 
   auto geo = std::make_unique<MeshGeometry>();
   geo->Name = "shapeGeo";
 
-  ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-  CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(),
-             vbByteSize);
+  ThrowIfFailed(D3DCreateBlob(batch.VertexBufferByteSize, &geo->VertexBufferCPU));
+  CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), batch.VertexData(),
+             batch.VertexBufferByteSize);
 
-  ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-  CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(),
-             ibByteSize);
+  ThrowIfFailed(D3DCreateBlob(batch.IndexBufferByteSize, &geo->IndexBufferCPU));
+  CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), batch.IndexData(),
+             batch.IndexBufferByteSize);
 
   geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(
-      md3dDevice.Get(), mCommandList.Get(), vertices.data(), vbByteSize,
-      geo->VertexBufferUploader);
+      md3dDevice.Get(), mCommandList.Get(), batch.VertexData(),
+      batch.VertexBufferByteSize, geo->VertexBufferUploader);
 
   geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(
-      md3dDevice.Get(), mCommandList.Get(), indices.data(), ibByteSize,
-      geo->IndexBufferUploader);
-
-  geo->VertexByteStride = sizeof(Vertex);
-  geo->VertexBufferByteSize = vbByteSize;
-  geo->IndexFormat = DXGI_FORMAT_R16_UINT;
-  geo->IndexBufferByteSize = ibByteSize;
-
-  geo->DrawArgs["box"] = boxSubmesh;
-  geo->DrawArgs["grid"] = gridSubmesh;
-  geo->DrawArgs["sphere"] = sphereSubmesh;
-  geo->DrawArgs["cylinder"] = cylinderSubmesh;
+      md3dDevice.Get(), mCommandList.Get(), batch.IndexData(),
+      batch.IndexBufferByteSize, geo->IndexBufferUploader);
+
+  geo->VertexByteStride = batch.VertexByteStride;
+  geo->VertexBufferByteSize = batch.VertexBufferByteSize;
+  geo->IndexFormat = batch.IndexFormat;
+  geo->IndexBufferByteSize = batch.IndexBufferByteSize;
+
+  batch.FillDrawArgs(geo->DrawArgs);
 
   mGeometries[geo->Name] = std::move(geo);
 }
@@ -6,6 +6,8 @@
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/MeshCleanup.h"
+#include "../../Common/MeshSimplifier.h"
 #include "FrameResource.h"
 
 using Microsoft::WRL::ComPtr;
@@ -17,6 +19,10 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// The skull is drawn with the coarsest level of detail whose error covers no
+// more than this many pixels.
+const float gSkullLodPixelError = 1.0f;
+
 // Lightweight structure stores parameters to draw a shape.  This will
 // vary from app-to-app.
 struct RenderItem
@@ -72,6 +78,7 @@ private:
 
     void OnKeyboardInput(const GameTimer& gt);
 	void UpdateCamera(const GameTimer& gt);
+	void UpdateSkullLod(const GameTimer& gt);
 	void AnimateMaterials(const GameTimer& gt);
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMaterialCBs(const GameTimer& gt);
@@ -114,6 +121,11 @@ private:
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mOpaqueRitems;
 
+	// The skull's levels of detail (DrawArgs "skull0", "skull1", ...) and the
+	// error of each in model space.
+	RenderItem* mSkullRitem = nullptr;
+	std::vector<float> mSkullLodErrors;
+
     PassConstants mMainPassCB;
 
 	XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
@@ -206,6 +218,7 @@ void LitColumnsApp::Update(const GameTimer& gt)
 {
     OnKeyboardInput(gt);
 	UpdateCamera(gt);
+	UpdateSkullLod(gt);
 
     // Cycle through the circular frame resource array.
     mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
@@ -349,6 +362,29 @@ void LitColumnsApp::UpdateCamera(const GameTimer& gt)
 	XMStoreFloat4x4(&mView, view);
 }
 
+void LitColumnsApp::UpdateSkullLod(const GameTimer& gt)
+{
+	// An error of e model units at distance d covers e/(d*tan(fovY/2)) half
+	// screen heights.
+	XMMATRIX world = XMLoadFloat4x4(&mSkullRitem->World);
+	XMVECTOR center = XMVector3TransformCoord(XMVectorZero(), world);
+	float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&mEyePos) - center));
+	float worldScale = XMVectorGetX(XMVector3Length(world.r[0]));
+	float pixelsPerUnit = 0.5f*mClientHeight / (std::max(distance, 1.0f)*tanf(0.125f*MathHelper::Pi));
+
+	size_t lod = 0;
+	while(lod + 1 < mSkullLodErrors.size() &&
+		  mSkullLodErrors[lod + 1]*worldScale*pixelsPerUnit <= gSkullLodPixelError)
+	{
+		++lod;
+	}
+
+	const SubmeshGeometry& submesh = mSkullRitem->Geo->DrawArgs["skull" + std::to_string(lod)];
+	mSkullRitem->IndexCount = submesh.IndexCount;
+	mSkullRitem->StartIndexLocation = submesh.StartIndexLocation;
+	mSkullRitem->BaseVertexLocation = submesh.BaseVertexLocation;
+}
+
 void LitColumnsApp::AnimateMaterials(const GameTimer& gt)
 {
 	
@@ -639,7 +675,7 @@ void LitColumnsApp::BuildSkullGeometry()
 	fin >> ignore;
 	fin >> ignore;
 
-	std::vector<std::int32_t> indices(3 * tcount);
+	std::vector<std::uint32_t> indices(3 * tcount);
 	for(UINT i = 0; i < tcount; ++i)
 	{
 		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
@@ -647,13 +683,43 @@ void LitColumnsApp::BuildSkullGeometry()
 
 	fin.close();
 
+	// The model stores some positions more than once; weld them and drop any
+	// triangles that collapse.
+	MeshCleanup::Clean(vertices, indices, &Vertex::Pos, &Vertex::Normal);
+
+	// Halve the triangle count down to about a thousand triangles.  All levels
+	// index the same vertices, so they share the vertex buffer.
+	std::vector<MeshSimplifier::LodTarget> lodTargets;
+	for(UINT t = (UINT)indices.size() / 6; t >= 1000; t /= 2)
+	{
+		MeshSimplifier::LodTarget target;
+		target.TriangleCount = t;
+		lodTargets.push_back(target);
+	}
+
+	std::vector<MeshSimplifier::Lod> lods = MeshSimplifier::BuildLodChain(
+		MeshSimplifier::Attributes(vertices, &Vertex::Pos, &Vertex::Normal),
+		indices.data(), indices.size(), lodTargets);
+
+	// Each level is coarser than the one before and its error never shrinks,
+	// so UpdateSkullLod can stop at the first level that is too coarse.
+	for(size_t i = 1; i < lods.size(); ++i)
+	{
+		assert(lods[i].TriangleCount <= lods[i-1].TriangleCount);
+		assert(lods[i].Error >= lods[i-1].Error);
+	}
+
+	std::vector<SubmeshGeometry> lodSubmeshes;
+	indices.clear();
+	MeshSimplifier::PackLods(lods, indices, lodSubmeshes);
+
 	//
 	// Pack the indices of all the meshes into one index buffer.
 	//
 
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
+	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint32_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "skullGeo";
@@ -675,12 +741,12 @@ void LitColumnsApp::BuildSkullGeometry()
 	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
-
-	geo->DrawArgs["skull"] = submesh;
+	mSkullLodErrors.clear();
+	for(size_t i = 0; i < lods.size(); ++i)
+	{
+		geo->DrawArgs["skull" + std::to_string(i)] = lodSubmeshes[i];
+		mSkullLodErrors.push_back(lods[i].Error);
+	}
 
 	mGeometries[geo->Name] = std::move(geo);
 }
@@ -800,9 +866,10 @@ void LitColumnsApp::BuildRenderItems()
 	skullRitem->Mat = mMaterials["skullMat"].get();
 	skullRitem->Geo = mGeometries["skullGeo"].get();
 	skullRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	skullRitem->IndexCount = skullRitem->Geo->DrawArgs["skull"].IndexCount;
-	skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["skull"].StartIndexLocation;
-	skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["skull"].BaseVertexLocation;
+	skullRitem->IndexCount = skullRitem->Geo->DrawArgs["skull0"].IndexCount;
+	skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["skull0"].StartIndexLocation;
+	skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["skull0"].BaseVertexLocation;
+	mSkullRitem = skullRitem.get();
 	mAllRitems.push_back(std::move(skullRitem));
 
 	XMMATRIX brickTexTransform = XMMatrixScaling(1.0f, 1.0f, 1.0f);
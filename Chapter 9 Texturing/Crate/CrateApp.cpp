@@ -5,6 +5,7 @@
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
+#include "../../Common/VertexCompressor.h"
 #include "../../Common/d3dApp.h"
 #include "FrameResource.h"
 
@@ -51,6 +52,9 @@ struct RenderItem {
   UINT IndexCount = 0;
   UINT StartIndexLocation = 0;
   int BaseVertexLocation = 0;
+
+  // How the vertex shader decodes the packed vertices of Geo.
+  const VertexCompressor::PackedVertices *Packing = nullptr;
 };
 
 class CrateApp : public D3DApp {
@@ -108,7 +112,9 @@ private:
   std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
   std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 
+  // Built from the packed box vertices, whose layout VertexCompressor picks.
   std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
+  VertexCompressor::PackedVertices mBoxVertices;
 
   ComPtr<ID3D12PipelineState> mOpaquePSO = nullptr;
 
@@ -384,6 +390,18 @@ void CrateApp::UpdateObjectCBs(const GameTimer &gt) {
       XMStoreFloat4x4(&objConstants.TexTransform,
                       XMMatrixTranspose(texTransform));
 
+      if (e->Packing != nullptr) {
+        const auto *pos = e->Packing->Find("POSITION");
+        const auto *normal = e->Packing->Find("NORMAL");
+        const auto *texC = e->Packing->Find("TEXCOORD");
+        objConstants.PosScale = pos->Scale;
+        objConstants.PosBias = pos->Bias;
+        objConstants.NormalScale = normal->Scale;
+        objConstants.NormalBias = normal->Bias;
+        objConstants.TexCScale = texC->Scale;
+        objConstants.TexCBias = texC->Bias;
+      }
+
       currObjectCB->CopyData(e->ObjCBIndex, objConstants);
 
       // Next FrameResource need to be updated too.
@@ -556,14 +574,8 @@ void CrateApp::BuildShadersAndInputLayout() {
   mShaders["opaquePS"] =
       d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "PS", "ps_5_0");
 
-  mInputLayout = {
-      {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,
-       D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-      {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12,
-       D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-      {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24,
-       D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-  };
+  // The input layout is filled in by BuildShapeGeometry from the packed
+  // vertex format.
 }
 
 void CrateApp::BuildShapeGeometry() {
@@ -585,14 +597,36 @@ void CrateApp::BuildShapeGeometry() {
 
   std::vector<std::uint16_t> indices = box.GetIndices16();
 
-  const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+  // Pack the 32 byte vertices into 16 bytes: unorm16 positions, octahedral
+  // normals and half texture coordinates.
+  VertexCompressor::Report report;
+  mBoxVertices = VertexCompressor::Compress(
+      VertexCompressor::Attributes(vertices, &Vertex::Pos, &Vertex::Normal,
+                                   &Vertex::TexC),
+      VertexCompressor::Encoding(), &report);
+
+  // Decoding every vertex again must give back the box: positions to a
+  // fraction of a unorm16 step of its unit size, normals to under a degree and
+  // texture coordinates to the precision of a half.
+  assert(report.MaxPositionError <= 1e-4f);
+  assert(report.MaxNormalError <= 1.0f);
+  assert(report.MaxTexCError <= 1e-3f);
+
+  mInputLayout.clear();
+  for (const auto &attribute : mBoxVertices.Attributes) {
+    mInputLayout.push_back({attribute.SemanticName, attribute.SemanticIndex,
+                            attribute.Format, 0, attribute.AlignedByteOffset,
+                            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0});
+  }
+
+  const UINT vbByteSize = (UINT)mBoxVertices.Data.size();
   const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
   auto geo = std::make_unique<MeshGeometry>();
   geo->Name = "boxGeo";
 
   ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-  CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(),
+  CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), mBoxVertices.Data.data(),
              vbByteSize);
 
   ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
@@ -600,14 +634,14 @@ void CrateApp::BuildShapeGeometry() {
              ibByteSize);
 
   geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(
-      md3dDevice.Get(), mCommandList.Get(), vertices.data(), vbByteSize,
-      geo->VertexBufferUploader);
+      md3dDevice.Get(), mCommandList.Get(), mBoxVertices.Data.data(),
+      vbByteSize, geo->VertexBufferUploader);
 
   geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(
       md3dDevice.Get(), mCommandList.Get(), indices.data(), ibByteSize,
       geo->IndexBufferUploader);
 
-  geo->VertexByteStride = sizeof(Vertex);
+  geo->VertexByteStride = mBoxVertices.Stride;
   geo->VertexBufferByteSize = vbByteSize;
   geo->IndexFormat = DXGI_FORMAT_R16_UINT;
   geo->IndexBufferByteSize = ibByteSize;
@@ -678,6 +712,7 @@ void CrateApp::BuildRenderItems() {
       boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
   boxRitem->BaseVertexLocation =
       boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
+  boxRitem->Packing = &mBoxVertices;
   mAllRitems.push_back(std::move(boxRitem));
 
   // All the render items are opaque.
@@ -8,6 +8,15 @@ struct ObjectConstants
 {
     DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
 	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+
+    // Scale and bias that turn the packed vertex attributes back into their
+    // values (VertexCompressor::AttributeDesc).
+    DirectX::XMFLOAT4 PosScale = { 1.0f, 1.0f, 1.0f, 1.0f };
+    DirectX::XMFLOAT4 PosBias = { 0.0f, 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT4 NormalScale = { 1.0f, 1.0f, 1.0f, 1.0f };
+    DirectX::XMFLOAT4 NormalBias = { 0.0f, 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT4 TexCScale = { 1.0f, 1.0f, 1.0f, 1.0f };
+    DirectX::XMFLOAT4 TexCBias = { 0.0f, 0.0f, 0.0f, 0.0f };
 };
 
 struct PassConstants
@@ -36,6 +36,14 @@ cbuffer cbPerObject : register(b0)
 {
     float4x4 gWorld;
     float4x4 gTexTransform;
+
+    // Undo the quantization of the packed vertex attributes.
+    float4 gPosScale;
+    float4 gPosBias;
+    float4 gNormalScale;
+    float4 gNormalBias;
+    float4 gTexCScale;
+    float4 gTexCBias;
 };
 
 // Constant data that varies per material.
@@ -72,10 +80,12 @@ cbuffer cbMaterial : register(b2)
     float4x4 gMatTransform;
 };
 
+// Packed by VertexCompressor: unorm16 positions against the bounding box,
+// octahedral snorm8 normals and half texture coordinates.
 struct VertexIn
 {
-	float3 PosL    : POSITION;
-    float3 NormalL : NORMAL;
+	float4 PosL    : POSITION;
+    float2 NormalL : NORMAL;
 	float2 TexC    : TEXCOORD;
 };
 
@@ -87,22 +97,36 @@ struct VertexOut
 	float2 TexC    : TEXCOORD;
 };
 
+// Maps a point of the octahedral square [-1, 1]^2 back to a unit vector
+// (VertexCompressor::OctDecode).
+float3 OctDecode(float2 e)
+{
+    float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
 VertexOut VS(VertexIn vin)
 {
 	VertexOut vout = (VertexOut)0.0f;
+
+    float3 posL = vin.PosL.xyz*gPosScale.xyz + gPosBias.xyz;
+    float3 normalL = OctDecode(vin.NormalL*gNormalScale.xy + gNormalBias.xy);
+    float2 texC0 = vin.TexC*gTexCScale.xy + gTexCBias.xy;
 	
     // Transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(posL, 1.0f), gWorld);
     vout.PosW = posW.xyz;
 
     // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-    vout.NormalW = mul(vin.NormalL, (float3x3)gWorld);
+    vout.NormalW = mul(normalL, (float3x3)gWorld);
 
     // Transform to homogeneous clip space.
     vout.PosH = mul(posW, gViewProj);
 	
 	// Output vertex attributes for interpolation across triangle.
-    float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
+    float4 texC = mul(float4(texC0, 0.0f, 1.0f), gTexTransform);
     vout.TexC = mul(texC, gMatTransform).xy;
 
     return vout;
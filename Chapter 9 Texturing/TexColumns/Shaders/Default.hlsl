@@ -18,7 +18,9 @@
 // Include structures and functions for lighting.
 #include "LightingUtil.hlsl"
 
-Texture2D    gDiffuseMap : register(t0);
+// bricks, stone and tile are packed into the slices of one array; the material
+// transform outputs the slice in z.
+Texture2DArray gDiffuseMap : register(t0);
 
 
 SamplerState gsamPointWrap        : register(s0);
@@ -81,7 +83,7 @@ struct VertexOut
 	float4 PosH    : SV_POSITION;
     float3 PosW    : POSITION;
     float3 NormalW : NORMAL;
-	float2 TexC    : TEXCOORD;
+	float3 TexC    : TEXCOORD;
 };
 
 VertexOut VS(VertexIn vin)
@@ -100,7 +102,7 @@ VertexOut VS(VertexIn vin)
 	
 	// Output vertex attributes for interpolation across triangle.
 	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
-	vout.TexC = mul(texC, gMatTransform).xy;
+	vout.TexC = mul(texC, gMatTransform).xyz;
 	
     return vout;
 }
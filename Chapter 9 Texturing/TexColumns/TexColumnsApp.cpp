@@ -6,6 +6,11 @@
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/BlockCompression.h"
+#include "../../Common/DDSFile.h"
+#include "../../Common/MipGenerator.h"
+#include "../../Common/TextureIndex.h"
+#include "../../Common/TexturePacker.h"
 #include "FrameResource.h"
 
 using Microsoft::WRL::ComPtr;
@@ -78,6 +83,8 @@ private:
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 
+	bool BuildMipChain(const DDSFile& file, std::vector<std::uint8_t>& dds);
+
 	void LoadTextures();
     void BuildRootSignature();
 	void BuildDescriptorHeaps();
@@ -106,6 +113,10 @@ private:
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
 	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
+
+	// The textures are packed into pages "page0", "page1", ..., one SRV each.
+	UINT mTexturePageCount = 0;
+	std::unordered_map<std::string, TexturePacker::Placement> mTexturePlacements;
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
 
@@ -447,32 +458,144 @@ void TexColumnsApp::UpdateMainPassCB(const GameTimer& gt)
 	currPassCB->CopyData(0, mMainPassCB);
 }
 
+bool TexColumnsApp::BuildMipChain(const DDSFile& file, std::vector<std::uint8_t>& dds)
+{
+	// Decode level 0 to RGBA8, filter the chain and compress every level back
+	// to the format of the file.
+	const DDSFile::Description& desc = file.GetDescription();
+
+	std::vector<std::uint8_t> rgba;
+	if(!BlockCompression::CanEncode(desc.Format) || !BlockCompression::Decode(file, 0, 0, rgba))
+		return false;
+
+	MipGenerator::Options mipOptions;
+	mipOptions.Kernel = MipGenerator::Filter::Kaiser;
+
+	std::vector<MipGenerator::Level> levels;
+	if(!MipGenerator::Generate(DXGI_FORMAT_R8G8B8A8_UNORM, rgba.data(), desc.Width, desc.Height,
+		4*desc.Width, mipOptions, levels))
+		return false;
+
+	const size_t blockBytes = BlockCompression::BlockBytes(desc.Format);
+
+	std::vector<std::vector<std::uint8_t>> blocks(levels.size());
+	std::vector<const std::uint8_t*> subresources;
+	for(size_t i = 0; i < levels.size(); ++i)
+	{
+		const MipGenerator::Level& level = levels[i];
+		const size_t blockRowPitch = blockBytes*((level.Width + 3)/4);
+
+		blocks[i].resize(blockRowPitch*((level.Height + 3)/4));
+		if(!BlockCompression::Encode(desc.Format, level.Pixels.data(), level.Width, level.Height,
+			level.RowPitch, blocks[i].data(), blockRowPitch))
+			return false;
+
+		subresources.push_back(blocks[i].data());
+
+#if defined(DEBUG) | defined(_DEBUG)
+		// Decode the blocks again.  Level 0 was block compressed already, so it
+		// must come back almost exactly; the filtered levels within the usual
+		// BC error.
+		std::vector<std::uint8_t> decoded(level.Pixels.size());
+		bool decodedOk = BlockCompression::Decode(desc.Format, blocks[i].data(), blockRowPitch,
+			level.Width, level.Height, decoded.data(), level.RowPitch);
+		assert(decodedOk);
+
+		double squaredError = 0.0;
+		for(size_t j = 0; j < decoded.size(); ++j)
+		{
+			if(j % 4 != 3)
+			{
+				double e = (double)decoded[j] - (double)level.Pixels[j];
+				squaredError += e*e;
+			}
+		}
+		double meanSquaredError = squaredError / (3*level.Width*level.Height);
+		assert(meanSquaredError <= (i == 0 ? 1.0 : 64.0));
+#endif
+	}
+
+	DDSFile::Description chainDesc = desc;
+	chainDesc.MipLevels = (std::uint32_t)levels.size();
+
+	return DDSFile::Serialize(chainDesc, subresources, dds);
+}
+
 void TexColumnsApp::LoadTextures()
 {
-	auto bricksTex = std::make_unique<Texture>();
-	bricksTex->Name = "bricksTex";
-	bricksTex->Filename = L"../../Textures/bricks.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), bricksTex->Filename.c_str(),
-		bricksTex->Resource, bricksTex->UploadHeap));
-
-	auto stoneTex = std::make_unique<Texture>();
-	stoneTex->Name = "stoneTex";
-	stoneTex->Filename = L"../../Textures/stone.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), stoneTex->Filename.c_str(),
-		stoneTex->Resource, stoneTex->UploadHeap));
-
-	auto tileTex = std::make_unique<Texture>();
-	tileTex->Name = "tileTex";
-	tileTex->Filename = L"../../Textures/tile.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), tileTex->Filename.c_str(),
-		tileTex->Resource, tileTex->UploadHeap));
-
-	mTextures[bricksTex->Name] = std::move(bricksTex);
-	mTextures[stoneTex->Name] = std::move(stoneTex);
-	mTextures[tileTex->Name] = std::move(tileTex);
+	// The index tells which files lack mips before any of them is opened.  It is
+	// cached in the working directory, so later runs only reread changed files.
+	TextureIndex textureIndex;
+	textureIndex.Update(L"../../Textures", L"TextureIndex.bin");
+
+	const std::string names[] = { "bricksTex", "stoneTex", "tileTex" };
+	const std::wstring files[] = { L"bricks.dds", L"stone.dds", L"tile.dds" };
+
+	// The packer reads the sources in place, so they (and the chains built for
+	// them) must stay alive until the pages are serialized.
+	DDSFile sources[3];
+	std::vector<std::uint8_t> chains[3];
+	std::uint32_t inputs[3];
+
+	TexturePacker packer;
+
+	for(int i = 0; i < 3; ++i)
+	{
+		const TextureIndex::Entry* entry = textureIndex.Find(files[i]);
+		if(entry == nullptr || entry->Status != DDSFile::Status::Ok)
+			ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND));
+
+		DDSFile& source = sources[i];
+		if(source.Open(L"../../Textures/" + files[i]) != DDSFile::Status::Ok ||
+			source.Decompress() != DDSFile::Status::Ok)
+			ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
+
+		// The header-only index entry must describe the file as the loader does.
+		assert(entry->Desc.Format == source.GetDescription().Format);
+		assert(entry->Desc.Width == source.GetDescription().Width);
+		assert(entry->Desc.Height == source.GetDescription().Height);
+		assert(entry->Desc.MipLevels == source.GetDescription().MipLevels);
+
+		if(entry->Desc.MipLevels == 1)
+		{
+			// Build the chain the file does not have and pack that instead.
+			if(!BuildMipChain(source, chains[i]))
+				ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED));
+
+			if(source.Parse(chains[i].data(), chains[i].size()) != DDSFile::Status::Ok)
+				ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
+		}
+
+		// The grid tiles its texture, so nothing may go into an atlas.
+		inputs[i] = packer.AddTexture(source, false);
+		if(inputs[i] == TexturePacker::InvalidIndex)
+			ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED));
+	}
+
+	packer.Pack();
+
+	// bricks, stone and tile have the same format, size and mip count, so they
+	// become the three slices of a single array page.
+	assert(packer.PageCount() == 1 && packer.GetPage(0).Desc.ArraySize == 3);
+
+	mTexturePageCount = (UINT)packer.PageCount();
+	for(UINT page = 0; page < mTexturePageCount; ++page)
+	{
+		std::vector<std::uint8_t> dds;
+		if(!packer.Serialize(page, dds))
+			ThrowIfFailed(E_FAIL);
+
+		auto tex = std::make_unique<Texture>();
+		tex->Name = "page" + std::to_string(page);
+		ThrowIfFailed(DirectX::CreateDDSTextureFromMemory12(md3dDevice.Get(),
+			mCommandList.Get(), dds.data(), dds.size(),
+			tex->Resource, tex->UploadHeap));
+
+		mTextures[tex->Name] = std::move(tex);
+	}
+
+	for(int i = 0; i < 3; ++i)
+		mTexturePlacements[names[i]] = packer.GetPlacement(inputs[i]);
 }
 
 void TexColumnsApp::BuildRootSignature()
@@ -524,42 +647,36 @@ void TexColumnsApp::BuildDescriptorHeaps()
 	// Create the SRV heap.
 	//
 	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 3;
+	srvHeapDesc.NumDescriptors = mTexturePageCount;
 	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
 
 	//
-	// Fill out the heap with actual descriptors.
+	// Fill out the heap with actual descriptors, one per page.  Every page is
+	// viewed as an array, even one with a single slice, to match the shader.
 	//
 	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
 
-	auto bricksTex = mTextures["bricksTex"]->Resource;
-	auto stoneTex = mTextures["stoneTex"]->Resource;
-	auto tileTex = mTextures["tileTex"]->Resource;
-
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = bricksTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = bricksTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-	md3dDevice->CreateShaderResourceView(bricksTex.Get(), &srvDesc, hDescriptor);
-
-	// next descriptor
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	srvDesc.Format = stoneTex->GetDesc().Format;
-	srvDesc.Texture2D.MipLevels = stoneTex->GetDesc().MipLevels;
-	md3dDevice->CreateShaderResourceView(stoneTex.Get(), &srvDesc, hDescriptor);
-
-	// next descriptor
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	srvDesc.Format = tileTex->GetDesc().Format;
-	srvDesc.Texture2D.MipLevels = tileTex->GetDesc().MipLevels;
-	md3dDevice->CreateShaderResourceView(tileTex.Get(), &srvDesc, hDescriptor);
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MostDetailedMip = 0;
+	srvDesc.Texture2DArray.FirstArraySlice = 0;
+	srvDesc.Texture2DArray.ResourceMinLODClamp = 0.0f;
+
+	for(UINT page = 0; page < mTexturePageCount; ++page)
+	{
+		auto pageTex = mTextures["page" + std::to_string(page)]->Resource;
+
+		srvDesc.Format = pageTex->GetDesc().Format;
+		srvDesc.Texture2DArray.MipLevels = pageTex->GetDesc().MipLevels;
+		srvDesc.Texture2DArray.ArraySize = pageTex->GetDesc().DepthOrArraySize;
+		md3dDevice->CreateShaderResourceView(pageTex.Get(), &srvDesc, hDescriptor);
+
+		// next descriptor
+		hDescriptor.Offset(1, mCbvSrvDescriptorSize);
+	}
 }
 
 void TexColumnsApp::BuildShadersAndInputLayout()
@@ -749,10 +866,20 @@ void TexColumnsApp::BuildFrameResources()
 
 void TexColumnsApp::BuildMaterials()
 {
+	// Point a material at the page its texture was packed into.  The shader
+	// reads the array slice from the z the material transform outputs.
+	auto placeTexture = [this](Material* mat, const std::string& texName)
+	{
+		const TexturePacker::Placement& placement = mTexturePlacements[texName];
+		mat->DiffuseSrvHeapIndex = (int)placement.Page;
+		mat->MatTransform = TexturePacker::RemapTransform(mat->MatTransform, placement);
+		mat->MatTransform._43 = (float)placement.Slice;
+	};
+
 	auto bricks0 = std::make_unique<Material>();
 	bricks0->Name = "bricks0";
 	bricks0->MatCBIndex = 0;
-	bricks0->DiffuseSrvHeapIndex = 0;
+	placeTexture(bricks0.get(), "bricksTex");
 	bricks0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     bricks0->FresnelR0 = XMFLOAT3(0.02f, 0.02f, 0.02f);
     bricks0->Roughness = 0.1f;
@@ -760,7 +887,7 @@ void TexColumnsApp::BuildMaterials()
 	auto stone0 = std::make_unique<Material>();
 	stone0->Name = "stone0";
 	stone0->MatCBIndex = 1;
-	stone0->DiffuseSrvHeapIndex = 1;
+	placeTexture(stone0.get(), "stoneTex");
 	stone0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     stone0->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
     stone0->Roughness = 0.3f;
@@ -768,7 +895,7 @@ void TexColumnsApp::BuildMaterials()
 	auto tile0 = std::make_unique<Material>();
 	tile0->Name = "tile0";
 	tile0->MatCBIndex = 2;
-	tile0->DiffuseSrvHeapIndex = 2;
+	placeTexture(tile0.get(), "tileTex");
 	tile0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     tile0->FresnelR0 = XMFLOAT3(0.02f, 0.02f, 0.02f);
     tile0->Roughness = 0.3f;
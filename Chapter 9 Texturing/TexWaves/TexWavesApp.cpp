@@ -6,6 +6,8 @@
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/DDSFile.h"
+#include "../../Common/TextureStreamer.h"
 #include "FrameResource.h"
 #include "Waves.h"
 
@@ -18,6 +20,11 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Heap slot of the crate texture's SRV, and of the first of its per frame resource
+// copies that UpdateTextureStreaming rewrites as mips stream in.
+const int gCrateSrvHeapIndex = 2;
+const int gStreamedSrvHeapIndex = 3;
+
 // Lightweight structure stores parameters to draw a shape.  This will
 // vary from app-to-app.
 struct RenderItem
@@ -84,6 +91,8 @@ private:
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt); 
+	void UpdateTextureStreaming(const GameTimer& gt);
+	void RecordTextureLoads(ID3D12GraphicsCommandList* cmdList);
 
 	void LoadTextures();
     void BuildRootSignature();
@@ -135,6 +144,22 @@ private:
 
     PassConstants mMainPassCB;
 
+	// The crate texture starts with its mip tail only; the finer levels are
+	// streamed from mCrateFile as the camera gets close enough to need them.
+	struct PendingLoad
+	{
+		TextureStreamer::Request Load;
+		UINT64 Fence = 0;
+		ComPtr<ID3D12Resource> UploadHeap = nullptr;
+	};
+
+	DDSFile mCrateFile;
+	TextureStreamer mStreamer;
+	UINT mCrateTexture = 0;
+	std::vector<TextureStreamer::Request> mStreamLoads;
+	std::vector<TextureStreamer::Request> mStreamEvictions;
+	std::vector<PendingLoad> mPendingLoads;
+
 	XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
 	XMFLOAT4X4 mView = MathHelper::Identity4x4();
 	XMFLOAT4X4 mProj = MathHelper::Identity4x4();
@@ -250,6 +275,7 @@ void TexWavesApp::Update(const GameTimer& gt)
 	UpdateMaterialCBs(gt);
 	UpdateMainPassCB(gt);
     UpdateWaves(gt);
+	UpdateTextureStreaming(gt);
 }
 
 void TexWavesApp::Draw(const GameTimer& gt)
@@ -264,6 +290,8 @@ void TexWavesApp::Draw(const GameTimer& gt)
     // Reusing the command list reuses memory.
     ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
 
+	RecordTextureLoads(mCommandList.Get());
+
     mCommandList->RSSetViewports(1, &mScreenViewport);
     mCommandList->RSSetScissorRects(1, &mScissorRect);
 
@@ -526,6 +554,94 @@ void TexWavesApp::UpdateWaves(const GameTimer& gt)
 	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
 }
 
+void TexWavesApp::UpdateTextureStreaming(const GameTimer& gt)
+{
+	// Loads whose copies the GPU has finished are resident from now on.
+	UINT64 completedFence = mFence->GetCompletedValue();
+	for(size_t i = 0; i < mPendingLoads.size(); )
+	{
+		if(mPendingLoads[i].Fence <= completedFence)
+		{
+			mStreamer.OnLoaded(mPendingLoads[i].Load);
+			mPendingLoads[i] = std::move(mPendingLoads.back());
+			mPendingLoads.pop_back();
+		}
+		else
+			++i;
+	}
+
+	// The box is 8 units wide and each face maps the whole texture once, so a
+	// face covers about this many pixels at the box's distance.
+	XMVECTOR boxCenter = XMVectorSet(3.0f, 2.0f, -9.0f, 1.0f);
+	float dist = XMVectorGetX(XMVector3Length(boxCenter - XMLoadFloat3(&mEyePos)));
+	float pixels = 8.0f*mClientHeight / (2.0f*std::max(dist, 1.0f)*tanf(0.125f*MathHelper::Pi));
+
+	const DDSFile::Description& desc = mCrateFile.GetDescription();
+	mStreamer.SetDemand(mCrateTexture, TextureStreamer::DesiredMip(desc.Width, desc.Height, pixels, pixels));
+
+	// The texture keeps all its levels allocated, so an eviction only moves the
+	// clamp below; there is nothing to release.  Loads are recorded in Draw.
+	mStreamer.Update(mStreamLoads, mStreamEvictions);
+
+	// The GPU is done with this frame resource, so its descriptor can be rewritten
+	// to clamp sampling to the levels that are resident now.
+	auto crateTex = mTextures["fenceTex"]->Resource;
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = crateTex->GetDesc().Format;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = -1;
+	srvDesc.Texture2D.ResourceMinLODClamp = (float)mStreamer.ResidentMip(mCrateTexture);
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+	hDescriptor.Offset(gStreamedSrvHeapIndex + mCurrFrameResourceIndex, mCbvSrvDescriptorSize);
+	md3dDevice->CreateShaderResourceView(crateTex.Get(), &srvDesc, hDescriptor);
+}
+
+void TexWavesApp::RecordTextureLoads(ID3D12GraphicsCommandList* cmdList)
+{
+	if(mStreamLoads.empty())
+		return;
+
+	auto crateTex = mTextures["fenceTex"]->Resource;
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(crateTex.Get(),
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST));
+
+	for(const TextureStreamer::Request& load : mStreamLoads)
+	{
+		const DDSFile::Subresource& sub = mCrateFile.GetSubresources()[load.Mip];
+
+		D3D12_SUBRESOURCE_DATA data = {};
+		data.pData = mCrateFile.SubresourceData(sub);
+		data.RowPitch = sub.RowPitch;
+		data.SlicePitch = sub.SlicePitch;
+
+		PendingLoad pending;
+		pending.Load = load;
+		pending.Fence = mCurrentFence + 1; // the value Draw signals for this frame
+
+		ThrowIfFailed(md3dDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(GetRequiredIntermediateSize(crateTex.Get(), load.Mip, 1)),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(pending.UploadHeap.GetAddressOf())));
+
+		UpdateSubresources(cmdList, crateTex.Get(), pending.UploadHeap.Get(), 0, load.Mip, 1, &data);
+
+		mPendingLoads.push_back(std::move(pending));
+	}
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(crateTex.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+	mStreamLoads.clear();
+}
+
 void TexWavesApp::LoadTextures()
 {
 	auto grassTex = std::make_unique<Texture>();
@@ -542,12 +658,53 @@ void TexWavesApp::LoadTextures()
 		mCommandList.Get(), waterTex->Filename.c_str(),
 		waterTex->Resource, waterTex->UploadHeap));
 
+	// The crate texture is created with its full mip chain but only the tail is
+	// uploaded here; UpdateTextureStreaming brings in the rest on demand.
 	auto fenceTex = std::make_unique<Texture>();
 	fenceTex->Name = "fenceTex";
 	fenceTex->Filename = L"../../Textures/WoodCrate01.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), fenceTex->Filename.c_str(),
-		fenceTex->Resource, fenceTex->UploadHeap));
+	if(mCrateFile.Open(fenceTex->Filename) != DDSFile::Status::Ok ||
+		mCrateFile.Decompress() != DDSFile::Status::Ok)
+		ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
+
+	const DDSFile::Description& crateDesc = mCrateFile.GetDescription();
+	mCrateTexture = mStreamer.AddTexture(mCrateFile);
+	UINT tailMip = mStreamer.TailMip(mCrateTexture);
+	UINT mipLevels = mStreamer.MipLevels(mCrateTexture);
+
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Tex2D(crateDesc.Format, crateDesc.Width, crateDesc.Height, 1, (UINT16)mipLevels),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(fenceTex->Resource.GetAddressOf())));
+
+	std::vector<D3D12_SUBRESOURCE_DATA> tailData;
+	for(UINT mip = tailMip; mip < mipLevels; ++mip)
+	{
+		const DDSFile::Subresource& sub = mCrateFile.GetSubresources()[mip];
+
+		D3D12_SUBRESOURCE_DATA data = {};
+		data.pData = mCrateFile.SubresourceData(sub);
+		data.RowPitch = sub.RowPitch;
+		data.SlicePitch = sub.SlicePitch;
+		tailData.push_back(data);
+	}
+
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(GetRequiredIntermediateSize(fenceTex->Resource.Get(), tailMip, mipLevels - tailMip)),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(fenceTex->UploadHeap.GetAddressOf())));
+
+	UpdateSubresources(mCommandList.Get(), fenceTex->Resource.Get(), fenceTex->UploadHeap.Get(),
+		0, tailMip, mipLevels - tailMip, tailData.data());
+
+	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(fenceTex->Resource.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
 
 	mTextures[grassTex->Name] = std::move(grassTex);
 	mTextures[waterTex->Name] = std::move(waterTex);
@@ -600,7 +757,7 @@ void TexWavesApp::BuildDescriptorHeaps()
 	// Create the SRV heap.
 	//
 	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 3;
+	srvHeapDesc.NumDescriptors = gStreamedSrvHeapIndex + gNumFrameResources;
 	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
@@ -632,7 +789,15 @@ void TexWavesApp::BuildDescriptorHeaps()
 	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
 
 	srvDesc.Format = fenceTex->GetDesc().Format;
+	srvDesc.Texture2D.ResourceMinLODClamp = (float)mStreamer.ResidentMip(mCrateTexture);
 	md3dDevice->CreateShaderResourceView(fenceTex.Get(), &srvDesc, hDescriptor);
+
+	// One streamed crate SRV per frame resource, starting out as the tail only.
+	for(int i = 0; i < gNumFrameResources; ++i)
+	{
+		hDescriptor.Offset(1, mCbvSrvDescriptorSize);
+		md3dDevice->CreateShaderResourceView(fenceTex.Get(), &srvDesc, hDescriptor);
+	}
 }
 
 void TexWavesApp::BuildShadersAndInputLayout()
@@ -948,8 +1113,13 @@ void TexWavesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std:
         cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
         cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
+		// The crate uses this frame resource's streamed SRV.
+		int srvHeapIndex = ri->Mat->DiffuseSrvHeapIndex;
+		if(srvHeapIndex == gCrateSrvHeapIndex)
+			srvHeapIndex = gStreamedSrvHeapIndex + mCurrFrameResourceIndex;
+
 		CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-		tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+		tex.Offset(srvHeapIndex, mCbvSrvDescriptorSize);
 
         D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex*objCBByteSize;
 		D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex*matCBByteSize;
@@ -0,0 +1,110 @@
+//***************************************************************************************
+// BinnedSAH.cpp
+//***************************************************************************************
+
+#include "BinnedSAH.h"
+
+using namespace DirectX;
+
+namespace
+{
+    float Component(const XMFLOAT3& v, int axis)
+    {
+        return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+    }
+}
+
+BinnedSAH::Split BinnedSAH::SplitItems(uint32* items, uint32 count, const Range* bounds,
+    const XMFLOAT3* centers, float extent)
+{
+    Range centerRange;
+    for(uint32 i = 0; i < count; ++i)
+        centerRange.Grow(centers[items[i]]);
+
+    int axis = 0;
+    float spread = centerRange.Max.x - centerRange.Min.x;
+    if(centerRange.Max.y - centerRange.Min.y > spread)
+    {
+        axis = 1;
+        spread = centerRange.Max.y - centerRange.Min.y;
+    }
+    if(centerRange.Max.z - centerRange.Min.z > spread)
+    {
+        axis = 2;
+        spread = centerRange.Max.z - centerRange.Min.z;
+    }
+
+    Split split;
+
+    // Spreads that are tiny next to the whole set would give a huge or infinite
+    // bin scale; treat those centers as coincident.  Any split is as good as
+    // another then.
+    if(!(spread > 1e-6f*extent))
+    {
+        Range all;
+        for(uint32 i = 0; i < count; ++i)
+            all.Grow(bounds[items[i]]);
+
+        split.LeftCount = count/2;
+        split.Cost = FLT_MAX;
+        split.HalfArea = all.HalfArea();
+        return split;
+    }
+
+    const float axisMin = Component(centerRange.Min, axis);
+    const float scale = BinCount/spread;
+    auto binOf = [&](uint32 item)
+    {
+        // Clamped as a float, so the conversion is defined whatever the product.
+        const float bin = (Component(centers[item], axis) - axisMin)*scale;
+        return (uint32)std::min(std::max(0.0f, bin), (float)(BinCount - 1));
+    };
+
+    Range binBounds[BinCount];
+    uint32 binCounts[BinCount] = {};
+    for(uint32 i = 0; i < count; ++i)
+    {
+        const uint32 bin = binOf(items[i]);
+        binBounds[bin].Grow(bounds[items[i]]);
+        binCounts[bin]++;
+    }
+
+    float rightCosts[BinCount];
+    Range right;
+    uint32 rightCount = 0;
+    for(uint32 bin = BinCount - 1; bin > 0; --bin)
+    {
+        right.Grow(binBounds[bin]);
+        rightCount += binCounts[bin];
+        rightCosts[bin] = right.HalfArea()*rightCount;
+    }
+
+    // The bins of the lowest and highest centers are never empty, so every
+    // split has items on both sides.
+    Range left;
+    uint32 leftCount = 0;
+    uint32 bestSplit = 1;
+    split.Cost = FLT_MAX;
+    for(uint32 s = 1; s < BinCount; ++s)
+    {
+        left.Grow(binBounds[s - 1]);
+        leftCount += binCounts[s - 1];
+
+        const float cost = left.HalfArea()*leftCount + rightCosts[s];
+        if(cost < split.Cost)
+        {
+            split.Cost = cost;
+            bestSplit = s;
+        }
+    }
+
+    left.Grow(right);
+    split.HalfArea = left.HalfArea();
+
+    split.LeftCount = (uint32)(std::partition(items, items + count, [&](uint32 item)
+    {
+        return binOf(item) < bestSplit;
+    }) - items);
+
+    return split;
+}
@@ -0,0 +1,88 @@
+//***************************************************************************************
+// BinnedSAH.h
+//
+// The node split shared by the bounding volume hierarchy builders (SceneBVH,
+// TriangleBVH).  The items of a node are sorted into bins along the axis where
+// their centers spread the most, the bins are swept from both ends to get the
+// cost of every split between two bins, and the node is split at the boundary
+// with the lowest surface area heuristic cost.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+
+class BinnedSAH
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+    // Bins per split.
+    static const uint32 BinCount = 16;
+
+    // An axis aligned box by its corners; empty until grown.
+    struct Range
+    {
+        DirectX::XMFLOAT3 Min = DirectX::XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+        DirectX::XMFLOAT3 Max = DirectX::XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+        void Grow(const DirectX::XMFLOAT3& p)
+        {
+            Grow(p, p);
+        }
+
+        void Grow(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max)
+        {
+            Min.x = std::min(Min.x, min.x);
+            Min.y = std::min(Min.y, min.y);
+            Min.z = std::min(Min.z, min.z);
+            Max.x = std::max(Max.x, max.x);
+            Max.y = std::max(Max.y, max.y);
+            Max.z = std::max(Max.z, max.z);
+        }
+
+        void Grow(const Range& r)
+        {
+            Grow(r.Min, r.Max);
+        }
+
+        // Half the surface area, which is all the heuristic needs.
+        float HalfArea()const
+        {
+            if(Min.x > Max.x)
+                return 0.0f;
+
+            const float dx = Max.x - Min.x;
+            const float dy = Max.y - Min.y;
+            const float dz = Max.z - Min.z;
+            return dx*dy + dy*dz + dz*dx;
+        }
+    };
+
+    struct Split
+    {
+        // The first LeftCount items go to the first child, the rest to the
+        // second.
+        uint32 LeftCount;
+
+        // Half area of the two children times their item counts, or FLT_MAX
+        // when the centers are all at one point and the items are just halved.
+        float Cost;
+
+        // Half area of the box around all the items.
+        float HalfArea;
+    };
+
+    ///<summary>
+    /// Splits the count >= 2 items of a node, reordering items so those of the
+    /// first child come first.  bounds and centers are indexed by the values in
+    /// items.  Centers that spread less than a millionth of extent, the size of
+    /// the whole set, count as one point.
+    ///</summary>
+    static Split SplitItems(uint32* items, uint32 count, const Range* bounds,
+        const DirectX::XMFLOAT3* centers, float extent);
+};
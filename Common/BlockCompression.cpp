@@ -0,0 +1,953 @@
+//***************************************************************************************
+// BlockCompression.cpp
+//***************************************************************************************
+
+#include "BlockCompression.h"
+#include "DDSFile.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ppl.h>
+
+namespace
+{
+    using uint8 = BlockCompression::uint8;
+    using uint16 = std::uint16_t;
+    using uint32 = BlockCompression::uint32;
+    using uint64 = std::uint64_t;
+    using Quality = BlockCompression::Quality;
+
+    template<typename Body>
+    void ParallelFor(uint32 count, uint32 itemsPerRow, const Body& body)
+    {
+        // Below this many blocks the thread hand-off costs more than it saves.
+        const uint32 parallelThreshold = 1024;
+
+        if(count*itemsPerRow < parallelThreshold)
+        {
+            for(uint32 i = 0; i < count; ++i)
+                body(i);
+        }
+        else
+        {
+            concurrency::parallel_for(0u, count, body);
+        }
+    }
+
+    //
+    // Endpoints and palettes.  The interpolation matches what the decoder below
+    // produces, rounded to the nearest integer.
+    //
+
+    uint16 Pack565(int r, int g, int b)
+    {
+        r = (std::min(std::max(r, 0), 255)*31 + 127) / 255;
+        g = (std::min(std::max(g, 0), 255)*63 + 127) / 255;
+        b = (std::min(std::max(b, 0), 255)*31 + 127) / 255;
+
+        return (uint16)((r << 11) | (g << 5) | b);
+    }
+
+    void Unpack565(uint16 c, int rgb[3])
+    {
+        const int r = (c >> 11) & 31;
+        const int g = (c >> 5) & 63;
+        const int b = c & 31;
+
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    void ColorPalette(uint16 c0, uint16 c1, bool fourColors, int palette[4][3])
+    {
+        Unpack565(c0, palette[0]);
+        Unpack565(c1, palette[1]);
+
+        for(int k = 0; k < 3; ++k)
+        {
+            if(fourColors)
+            {
+                palette[2][k] = (2*palette[0][k] + palette[1][k] + 1) / 3;
+                palette[3][k] = (palette[0][k] + 2*palette[1][k] + 1) / 3;
+            }
+            else
+            {
+                palette[2][k] = (palette[0][k] + palette[1][k] + 1) / 2;
+                palette[3][k] = 0;
+            }
+        }
+    }
+
+    void AlphaPalette(int a0, int a1, int palette[8])
+    {
+        palette[0] = a0;
+        palette[1] = a1;
+
+        if(a0 > a1)
+        {
+            for(int i = 2; i < 8; ++i)
+                palette[i] = ((8 - i)*a0 + (i - 1)*a1 + 3) / 7;
+        }
+        else
+        {
+            for(int i = 2; i < 6; ++i)
+                palette[i] = ((6 - i)*a0 + (i - 1)*a1 + 2) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    void WriteColorBlock(uint16 c0, uint16 c1, uint32 indices, uint8* block)
+    {
+        std::memcpy(block + 0, &c0, 2);
+        std::memcpy(block + 2, &c1, 2);
+        std::memcpy(block + 4, &indices, 4);
+    }
+
+    void WriteAlphaBlock(int a0, int a1, const uint8 indices[16], uint8* block)
+    {
+        block[0] = (uint8)a0;
+        block[1] = (uint8)a1;
+
+        uint64 bits = 0;
+        for(int i = 0; i < 16; ++i)
+            bits |= (uint64)indices[i] << (3*i);
+
+        for(int i = 0; i < 6; ++i)
+            block[2 + i] = (uint8)(bits >> (8*i));
+    }
+
+    //
+    // BC1 color blocks.  pixels is 16 RGBA8 pixels, row major.
+    //
+
+    int ColorError(const uint8* p, const int c[3])
+    {
+        const int dr = p[0] - c[0];
+        const int dg = p[1] - c[1];
+        const int db = p[2] - c[2];
+        return dr*dr + dg*dg + db*db;
+    }
+
+    // Picks the palette entry with the smallest error for every pixel in mask and
+    // returns the total error.  Pixels outside mask get index 3 (transparent).
+    int FitIndices(const uint8* pixels, uint32 mask, const int palette[4][3], int paletteSize, uint32& indices)
+    {
+        int total = 0;
+        indices = 0;
+
+        for(int i = 0; i < 16; ++i)
+        {
+            uint32 best = 3;
+            if(mask & (1u << i))
+            {
+                int bestError = ColorError(pixels + 4*i, palette[0]);
+                best = 0;
+                for(int k = 1; k < paletteSize; ++k)
+                {
+                    const int error = ColorError(pixels + 4*i, palette[k]);
+                    if(error < bestError)
+                    {
+                        bestError = error;
+                        best = k;
+                    }
+                }
+                total += bestError;
+            }
+
+            indices |= best << (2*i);
+        }
+
+        return total;
+    }
+
+    // Four color mode only: the index of each pixel comes from its position along
+    // the endpoint axis, rounded to the nearest of the four palette points.
+    uint32 ProjectIndices(const uint8* pixels, const int c0[3], const int c1[3])
+    {
+        const int dr = c0[0] - c1[0];
+        const int dg = c0[1] - c1[1];
+        const int db = c0[2] - c1[2];
+        const int total = dr*dr + dg*dg + db*db;
+
+        // Position 0 is c1 (index 1), 1 and 2 the interpolated colors (indices 3
+        // and 2) and 3 is c0 (index 0).
+        static const uint32 indexAt[4] = { 1, 3, 2, 0 };
+
+        int steps[16];
+
+#if defined(_XM_SSE_INTRINSICS_)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i axis = _mm_setr_epi16((short)dr, (short)dg, (short)db, 0, (short)dr, (short)dg, (short)db, 0);
+        const __m128i origin = _mm_setr_epi16((short)c1[0], (short)c1[1], (short)c1[2], 0,
+                                              (short)c1[0], (short)c1[1], (short)c1[2], 0);
+        const __m128i threshold1 = _mm_set1_epi32(total - 1);
+        const __m128i threshold3 = _mm_set1_epi32(3*total - 1);
+        const __m128i threshold5 = _mm_set1_epi32(5*total - 1);
+
+        for(int row = 0; row < 4; ++row)
+        {
+            const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 16*row));
+
+            // Two pixels per register as 16-bit (r, g, b, a); madd leaves
+            // (r*dr + g*dg, b*db) for each.
+            const __m128i lo = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(p, zero), origin), axis);
+            const __m128i hi = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(p, zero), origin), axis);
+
+            const __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+            const __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+            const __m128i dot = _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+
+            // 6*dot compared with total, 3*total and 5*total.
+            const __m128i dot6 = _mm_add_epi32(_mm_slli_epi32(dot, 2), _mm_slli_epi32(dot, 1));
+            __m128i step = _mm_sub_epi32(zero, _mm_cmpgt_epi32(dot6, threshold1));
+            step = _mm_sub_epi32(step, _mm_cmpgt_epi32(dot6, threshold3));
+            step = _mm_sub_epi32(step, _mm_cmpgt_epi32(dot6, threshold5));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(steps + 4*row), step);
+        }
+#else
+        for(int i = 0; i < 16; ++i)
+        {
+            const uint8* p = pixels + 4*i;
+            const int dot6 = 6*((p[0] - c1[0])*dr + (p[1] - c1[1])*dg + (p[2] - c1[2])*db);
+            steps[i] = (dot6 >= total) + (dot6 >= 3*total) + (dot6 >= 5*total);
+        }
+#endif
+
+        uint32 indices = 0;
+        for(int i = 0; i < 16; ++i)
+            indices |= indexAt[steps[i]] << (2*i);
+
+        return indices;
+    }
+
+    // Least squares endpoints for the given indices.  Returns false if the indices
+    // do not pin the endpoints down (all pixels on one palette entry).
+    bool RefineEndpoints(const uint8* pixels, uint32 mask, uint32 indices, bool fourColors,
+        float c0[3], float c1[3])
+    {
+        static const float fourWeights[4] = { 1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f };
+        static const float threeWeights[4] = { 1.0f, 0.0f, 0.5f, 0.0f };
+        const float* weights = fourColors ? fourWeights : threeWeights;
+
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[3] = { 0.0f, 0.0f, 0.0f };
+        float bx[3] = { 0.0f, 0.0f, 0.0f };
+
+        for(int i = 0; i < 16; ++i)
+        {
+            const uint32 index = (indices >> (2*i)) & 3;
+            if(!(mask & (1u << i)) || (!fourColors && index == 3))
+                continue;
+
+            const float a = weights[index];
+            const float b = 1.0f - a;
+            aa += a*a;
+            ab += a*b;
+            bb += b*b;
+
+            for(int k = 0; k < 3; ++k)
+            {
+                ax[k] += a*pixels[4*i + k];
+                bx[k] += b*pixels[4*i + k];
+            }
+        }
+
+        const float det = aa*bb - ab*ab;
+        if(std::fabs(det) < 1e-6f)
+            return false;
+
+        const float invDet = 1.0f / det;
+        for(int k = 0; k < 3; ++k)
+        {
+            c0[k] = (bb*ax[k] - ab*bx[k]) * invDet;
+            c1[k] = (aa*bx[k] - ab*ax[k]) * invDet;
+        }
+
+        return true;
+    }
+
+    // Principal axis of the pixels in mask, by power iteration on the covariance.
+    void PrincipalEndpoints(const uint8* pixels, uint32 mask, float c0[3], float c1[3])
+    {
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        float lo[3] = { 255.0f, 255.0f, 255.0f };
+        float hi[3] = { 0.0f, 0.0f, 0.0f };
+        int count = 0;
+
+        for(int i = 0; i < 16; ++i)
+        {
+            if(!(mask & (1u << i)))
+                continue;
+
+            for(int k = 0; k < 3; ++k)
+            {
+                const float v = pixels[4*i + k];
+                mean[k] += v;
+                lo[k] = std::min(lo[k], v);
+                hi[k] = std::max(hi[k], v);
+            }
+            count++;
+        }
+
+        for(int k = 0; k < 3; ++k)
+            mean[k] /= (float)count;
+
+        float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+        for(int i = 0; i < 16; ++i)
+        {
+            if(!(mask & (1u << i)))
+                continue;
+
+            const float r = pixels[4*i + 0] - mean[0];
+            const float g = pixels[4*i + 1] - mean[1];
+            const float b = pixels[4*i + 2] - mean[2];
+            cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+            cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+        }
+
+        float axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+        for(int iteration = 0; iteration < 8; ++iteration)
+        {
+            const float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+            const float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+            const float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+
+            const float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+            if(length < 1e-6f)
+                break;
+
+            axis[0] = x / length;
+            axis[1] = y / length;
+            axis[2] = z / length;
+        }
+
+        float tMin = 1e30f;
+        float tMax = -1e30f;
+        for(int i = 0; i < 16; ++i)
+        {
+            if(!(mask & (1u << i)))
+                continue;
+
+            const float t = (pixels[4*i + 0] - mean[0])*axis[0] +
+                            (pixels[4*i + 1] - mean[1])*axis[1] +
+                            (pixels[4*i + 2] - mean[2])*axis[2];
+            tMin = std::min(tMin, t);
+            tMax = std::max(tMax, t);
+        }
+
+        const float lengthSq = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+        const float scale = lengthSq > 0.0f ? 1.0f / lengthSq : 0.0f;
+        for(int k = 0; k < 3; ++k)
+        {
+            c0[k] = mean[k] + axis[k]*tMax*scale;
+            c1[k] = mean[k] + axis[k]*tMin*scale;
+        }
+    }
+
+    struct ColorFit
+    {
+        uint16 C0 = 0;
+        uint16 C1 = 0;
+        uint32 Indices = 0;
+        int Error = 0x7fffffff;
+    };
+
+    // Tries a pair of endpoints in the required mode and keeps it if it is better.
+    void TryEndpoints(const uint8* pixels, uint32 mask, bool fourColors, uint16 a, uint16 b, ColorFit& best)
+    {
+        // Four color mode needs c0 > c1 and three color mode c0 <= c1.  Equal
+        // endpoints in four color mode fall back to a single color.
+        uint16 c0 = fourColors ? std::max(a, b) : std::min(a, b);
+        uint16 c1 = fourColors ? std::min(a, b) : std::max(a, b);
+
+        int palette[4][3];
+        ColorPalette(c0, c1, fourColors && c0 != c1, palette);
+
+        uint32 indices = 0;
+        int error = 0;
+        if(fourColors && c0 == c1)
+            error = FitIndices(pixels, mask, palette, 1, indices);
+        else
+            error = FitIndices(pixels, mask, palette, fourColors ? 4 : 3, indices);
+
+        if(error < best.Error)
+        {
+            best.C0 = c0;
+            best.C1 = c1;
+            best.Indices = indices;
+            best.Error = error;
+        }
+    }
+
+    uint16 Pack565(const float c[3])
+    {
+        return Pack565((int)std::lround(c[0]), (int)std::lround(c[1]), (int)std::lround(c[2]));
+    }
+
+    void EncodeColorBlock(const uint8* pixels, uint8* block, Quality quality, bool punchThrough)
+    {
+        uint32 mask = 0xffff;
+        if(punchThrough)
+        {
+            mask = 0;
+            for(int i = 0; i < 16; ++i)
+            {
+                if(pixels[4*i + 3] >= 128)
+                    mask |= 1u << i;
+            }
+
+            if(mask == 0)
+            {
+                WriteColorBlock(0, 0, 0xffffffff, block);
+                return;
+            }
+        }
+
+        const bool fourColors = (mask == 0xffff);
+
+        // Bounding box, inset by 1/16 of its size so the endpoints land on the
+        // palette points the pixels actually use.
+        int lo[3] = { 255, 255, 255 };
+        int hi[3] = { 0, 0, 0 };
+        for(int i = 0; i < 16; ++i)
+        {
+            if(!(mask & (1u << i)))
+                continue;
+
+            for(int k = 0; k < 3; ++k)
+            {
+                lo[k] = std::min(lo[k], (int)pixels[4*i + k]);
+                hi[k] = std::max(hi[k], (int)pixels[4*i + k]);
+            }
+        }
+
+        for(int k = 0; k < 3; ++k)
+        {
+            const int inset = (hi[k] - lo[k]) >> 4;
+            lo[k] += inset;
+            hi[k] -= inset;
+        }
+
+        const uint16 boxHi = Pack565(hi[0], hi[1], hi[2]);
+        const uint16 boxLo = Pack565(lo[0], lo[1], lo[2]);
+
+        if(quality == Quality::Fast && fourColors)
+        {
+            uint16 c0 = std::max(boxHi, boxLo);
+            uint16 c1 = std::min(boxHi, boxLo);
+
+            uint32 indices = 0;
+            if(c0 != c1)
+            {
+                int p0[3], p1[3];
+                Unpack565(c0, p0);
+                Unpack565(c1, p1);
+                indices = ProjectIndices(pixels, p0, p1);
+            }
+
+            WriteColorBlock(c0, c1, indices, block);
+            return;
+        }
+
+        ColorFit best;
+        TryEndpoints(pixels, mask, fourColors, boxHi, boxLo, best);
+
+        if(quality == Quality::High)
+        {
+            float c0[3], c1[3];
+            PrincipalEndpoints(pixels, mask, c0, c1);
+            TryEndpoints(pixels, mask, fourColors, Pack565(c0), Pack565(c1), best);
+
+            for(int iteration = 0; iteration < 2; ++iteration)
+            {
+                const bool bestFour = best.C0 > best.C1;
+                if(!RefineEndpoints(pixels, mask, best.Indices, bestFour, c0, c1))
+                    break;
+
+                const int before = best.Error;
+                TryEndpoints(pixels, mask, fourColors, Pack565(c0), Pack565(c1), best);
+                if(best.Error >= before)
+                    break;
+            }
+        }
+
+        WriteColorBlock(best.C0, best.C1, best.Indices, block);
+    }
+
+    //
+    // BC4 channel blocks, also the alpha of BC3 and both halves of BC5.
+    //
+
+    // Returns the total error, or stops early once it reaches limit.
+    int FitAlphaIndices(const uint8 values[16], const int palette[8], uint8 indices[16], int limit = 0x7fffffff)
+    {
+        int total = 0;
+        for(int i = 0; i < 16 && total < limit; ++i)
+        {
+            int bestError = 0x7fffffff;
+            for(int k = 0; k < 8; ++k)
+            {
+                const int d = values[i] - palette[k];
+                if(d*d < bestError)
+                {
+                    bestError = d*d;
+                    indices[i] = (uint8)k;
+                }
+            }
+            total += bestError;
+        }
+
+        return total;
+    }
+
+    // Same as FitAlphaIndices for the eight value mode (a0 > a1), where the palette
+    // is evenly spaced: only the step nearest the value's position and its two
+    // neighbours (the palette is rounded) need checking.
+    int FitAlphaIndices8(const uint8 values[16], int a0, int a1, const int palette[8], uint8 indices[16],
+        int limit = 0x7fffffff)
+    {
+        static const uint8 indexAt[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+
+        const float stepsPerValue = 7.0f / (float)(a0 - a1);
+        int total = 0;
+        for(int i = 0; i < 16 && total < limit; ++i)
+        {
+            const int step = std::min(std::max((int)((values[i] - a1)*stepsPerValue + 0.5f), 0), 7);
+
+            int bestError = 0x7fffffff;
+            for(int s = std::max(step - 1, 0); s <= std::min(step + 1, 7); ++s)
+            {
+                const int d = values[i] - palette[indexAt[s]];
+                if(d*d < bestError)
+                {
+                    bestError = d*d;
+                    indices[i] = indexAt[s];
+                }
+            }
+            total += bestError;
+        }
+
+        return total;
+    }
+
+    // Eight value mode with a0 = hi > a1 = lo: each index comes from the value's
+    // position between the endpoints, rounded to the nearest of the eight steps.
+    void ProjectAlphaIndices(const uint8 values[16], int hi, int lo, uint8 indices[16])
+    {
+        const int range = hi - lo;
+        std::int16_t steps[16];
+
+#if defined(_XM_SSE_INTRINSICS_)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i origin = _mm_set1_epi16((short)lo);
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+
+        // 14*(v - lo) fits in 16 bits; step k starts at (2k - 1)*range.
+        __m128i scaledLo = _mm_sub_epi16(_mm_unpacklo_epi8(v, zero), origin);
+        __m128i scaledHi = _mm_sub_epi16(_mm_unpackhi_epi8(v, zero), origin);
+        scaledLo = _mm_mullo_epi16(scaledLo, _mm_set1_epi16(14));
+        scaledHi = _mm_mullo_epi16(scaledHi, _mm_set1_epi16(14));
+
+        __m128i stepLo = zero;
+        __m128i stepHi = zero;
+        for(int k = 1; k < 8; ++k)
+        {
+            const __m128i threshold = _mm_set1_epi16((short)((2*k - 1)*range - 1));
+            stepLo = _mm_sub_epi16(stepLo, _mm_cmpgt_epi16(scaledLo, threshold));
+            stepHi = _mm_sub_epi16(stepHi, _mm_cmpgt_epi16(scaledHi, threshold));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(steps + 0), stepLo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(steps + 8), stepHi);
+#else
+        for(int i = 0; i < 16; ++i)
+        {
+            const int scaled = 14*(values[i] - lo);
+            int step = 0;
+            for(int k = 1; k < 8; ++k)
+                step += scaled >= (2*k - 1)*range;
+            steps[i] = (std::int16_t)step;
+        }
+#endif
+
+        // Step 0 is a1 (index 1), step 7 is a0 (index 0) and step s in between is
+        // index 8 - s.
+        for(int i = 0; i < 16; ++i)
+        {
+            const int s = steps[i];
+            indices[i] = (uint8)(((8 - s) & 7) ^ ((s == 0 || s == 7) ? 1 : 0));
+        }
+    }
+
+    void EncodeAlphaBlock(const uint8* source, size_t stride, uint8* block, Quality quality)
+    {
+        uint8 values[16];
+        int lo = 255;
+        int hi = 0;
+        for(int i = 0; i < 16; ++i)
+        {
+            values[i] = source[i*stride];
+            lo = std::min(lo, (int)values[i]);
+            hi = std::max(hi, (int)values[i]);
+        }
+
+        uint8 indices[16] = {};
+        if(hi == lo)
+        {
+            WriteAlphaBlock(hi, lo, indices, block);
+            return;
+        }
+
+        if(quality == Quality::Fast)
+        {
+            ProjectAlphaIndices(values, hi, lo, indices);
+            WriteAlphaBlock(hi, lo, indices, block);
+            return;
+        }
+
+        int palette[8];
+        uint8 trial[16];
+
+        // Eight value mode around the bounding endpoints.
+        int bestA0 = hi, bestA1 = lo;
+        AlphaPalette(hi, lo, palette);
+        int bestError = FitAlphaIndices(values, palette, indices);
+
+        const int radius = 2;
+        for(int a0 = std::max(hi - radius, 1); a0 <= std::min(hi + radius, 255); ++a0)
+        {
+            for(int a1 = std::max(lo - radius, 0); a1 <= std::min(lo + radius, 254) && a1 < a0; ++a1)
+            {
+                AlphaPalette(a0, a1, palette);
+                const int error = FitAlphaIndices8(values, a0, a1, palette, trial, bestError);
+                if(error < bestError)
+                {
+                    bestError = error;
+                    bestA0 = a0;
+                    bestA1 = a1;
+                    std::memcpy(indices, trial, 16);
+                }
+            }
+        }
+
+        // Six value mode, with 0 and 255 exact, spanning the values in between.
+        int innerLo = 255, innerHi = 0;
+        for(int i = 0; i < 16; ++i)
+        {
+            if(values[i] != 0 && values[i] != 255)
+            {
+                innerLo = std::min(innerLo, (int)values[i]);
+                innerHi = std::max(innerHi, (int)values[i]);
+            }
+        }
+
+        if(innerLo > innerHi)
+            innerLo = innerHi = 0;
+
+        AlphaPalette(innerLo, innerHi, palette);
+        const int error = FitAlphaIndices(values, palette, trial, bestError);
+        if(error < bestError)
+        {
+            bestA0 = innerLo;
+            bestA1 = innerHi;
+            std::memcpy(indices, trial, 16);
+        }
+
+        WriteAlphaBlock(bestA0, bestA1, indices, block);
+    }
+
+    //
+    // Decoding.
+    //
+
+    void DecodeColorBlock(const uint8* block, uint8* pixels, bool alwaysFourColors)
+    {
+        uint16 c0, c1;
+        uint32 indices;
+        std::memcpy(&c0, block + 0, 2);
+        std::memcpy(&c1, block + 2, 2);
+        std::memcpy(&indices, block + 4, 4);
+
+        const bool fourColors = alwaysFourColors || c0 > c1;
+
+        int palette[4][3];
+        ColorPalette(c0, c1, fourColors, palette);
+
+        for(int i = 0; i < 16; ++i)
+        {
+            const uint32 index = (indices >> (2*i)) & 3;
+            pixels[4*i + 0] = (uint8)palette[index][0];
+            pixels[4*i + 1] = (uint8)palette[index][1];
+            pixels[4*i + 2] = (uint8)palette[index][2];
+            pixels[4*i + 3] = (!fourColors && index == 3) ? 0 : 255;
+        }
+    }
+
+    void DecodeAlphaBlock(const uint8* block, uint8* destination, size_t stride)
+    {
+        int palette[8];
+        AlphaPalette(block[0], block[1], palette);
+
+        uint64 bits = 0;
+        for(int i = 0; i < 6; ++i)
+            bits |= (uint64)block[2 + i] << (8*i);
+
+        for(int i = 0; i < 16; ++i)
+            destination[i*stride] = (uint8)palette[(bits >> (3*i)) & 7];
+    }
+
+    void DecodeExplicitAlphaBlock(const uint8* block, uint8* destination, size_t stride)
+    {
+        for(int i = 0; i < 16; ++i)
+        {
+            const int a = (block[i / 2] >> (4*(i & 1))) & 15;
+            destination[i*stride] = (uint8)(a*17);
+        }
+    }
+
+    enum class BlockFormat
+    {
+        None,
+        BC1,
+        BC2,
+        BC3,
+        BC4,
+        BC5
+    };
+
+    BlockFormat GetBlockFormat(DXGI_FORMAT format)
+    {
+        switch(format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+            return BlockFormat::BC1;
+
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+            return BlockFormat::BC2;
+
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            return BlockFormat::BC3;
+
+        case DXGI_FORMAT_BC4_UNORM:
+            return BlockFormat::BC4;
+
+        case DXGI_FORMAT_BC5_UNORM:
+            return BlockFormat::BC5;
+
+        default:
+            return BlockFormat::None;
+        }
+    }
+}
+
+bool BlockCompression::CanEncode(DXGI_FORMAT format)
+{
+    const BlockFormat blockFormat = GetBlockFormat(format);
+    return blockFormat != BlockFormat::None && blockFormat != BlockFormat::BC2;
+}
+
+bool BlockCompression::CanDecode(DXGI_FORMAT format)
+{
+    return GetBlockFormat(format) != BlockFormat::None;
+}
+
+size_t BlockCompression::BlockBytes(DXGI_FORMAT format)
+{
+    switch(GetBlockFormat(format))
+    {
+    case BlockFormat::BC1:
+    case BlockFormat::BC4:
+        return 8;
+    case BlockFormat::BC2:
+    case BlockFormat::BC3:
+    case BlockFormat::BC5:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+bool BlockCompression::Encode(DXGI_FORMAT format, const uint8* rgba, uint32 width, uint32 height, size_t rowPitch,
+    uint8* blocks, size_t blockRowPitch, Quality quality)
+{
+    const BlockFormat blockFormat = GetBlockFormat(format);
+    if(!CanEncode(format) || width == 0 || height == 0)
+        return false;
+
+    const uint32 blocksWide = (width + 3) / 4;
+    const uint32 blocksHigh = (height + 3) / 4;
+    const size_t blockBytes = BlockBytes(format);
+
+    ParallelFor(blocksHigh, blocksWide, [&](uint32 by)
+    {
+        uint8 pixels[64];
+        uint8* out = blocks + by*blockRowPitch;
+
+        for(uint32 bx = 0; bx < blocksWide; ++bx, out += blockBytes)
+        {
+            // Gather the block, repeating the last row and column at the edges.
+            for(uint32 y = 0; y < 4; ++y)
+            {
+                const uint32 sy = std::min(by*4 + y, height - 1);
+                for(uint32 x = 0; x < 4; ++x)
+                {
+                    const uint32 sx = std::min(bx*4 + x, width - 1);
+                    std::memcpy(pixels + 4*(4*y + x), rgba + sy*rowPitch + 4*sx, 4);
+                }
+            }
+
+            switch(blockFormat)
+            {
+            case BlockFormat::BC1:
+                EncodeColorBlock(pixels, out, quality, true);
+                break;
+            case BlockFormat::BC3:
+                EncodeAlphaBlock(pixels + 3, 4, out, quality);
+                EncodeColorBlock(pixels, out + 8, quality, false);
+                break;
+            case BlockFormat::BC4:
+                EncodeAlphaBlock(pixels + 0, 4, out, quality);
+                break;
+            case BlockFormat::BC5:
+                EncodeAlphaBlock(pixels + 0, 4, out, quality);
+                EncodeAlphaBlock(pixels + 1, 4, out + 8, quality);
+                break;
+            default:
+                break;
+            }
+        }
+    });
+
+    return true;
+}
+
+bool BlockCompression::Decode(DXGI_FORMAT format, const uint8* blocks, size_t blockRowPitch,
+    uint32 width, uint32 height, uint8* rgba, size_t rowPitch)
+{
+    const BlockFormat blockFormat = GetBlockFormat(format);
+    if(blockFormat == BlockFormat::None)
+        return false;
+
+    const uint32 blocksWide = (width + 3) / 4;
+    const uint32 blocksHigh = (height + 3) / 4;
+    const size_t blockBytes = BlockBytes(format);
+
+    ParallelFor(blocksHigh, blocksWide, [&](uint32 by)
+    {
+        uint8 pixels[64];
+        const uint8* in = blocks + by*blockRowPitch;
+
+        for(uint32 bx = 0; bx < blocksWide; ++bx, in += blockBytes)
+        {
+            switch(blockFormat)
+            {
+            case BlockFormat::BC1:
+                DecodeColorBlock(in, pixels, false);
+                break;
+            case BlockFormat::BC2:
+                DecodeColorBlock(in + 8, pixels, true);
+                DecodeExplicitAlphaBlock(in, pixels + 3, 4);
+                break;
+            case BlockFormat::BC3:
+                DecodeColorBlock(in + 8, pixels, true);
+                DecodeAlphaBlock(in, pixels + 3, 4);
+                break;
+            case BlockFormat::BC4:
+                DecodeAlphaBlock(in, pixels + 0, 4);
+                for(int i = 0; i < 16; ++i)
+                {
+                    pixels[4*i + 1] = pixels[4*i + 2] = 0;
+                    pixels[4*i + 3] = 255;
+                }
+                break;
+            case BlockFormat::BC5:
+                DecodeAlphaBlock(in, pixels + 0, 4);
+                DecodeAlphaBlock(in + 8, pixels + 1, 4);
+                for(int i = 0; i < 16; ++i)
+                {
+                    pixels[4*i + 2] = 0;
+                    pixels[4*i + 3] = 255;
+                }
+                break;
+            default:
+                break;
+            }
+
+            // Scatter the part of the block inside the image.
+            const uint32 w = std::min(4u, width - bx*4);
+            const uint32 h = std::min(4u, height - by*4);
+            for(uint32 y = 0; y < h; ++y)
+                std::memcpy(rgba + (by*4 + y)*rowPitch + 4*bx*4, pixels + 16*y, 4*w);
+        }
+    });
+
+    return true;
+}
+
+bool BlockCompression::Decode(const DDSFile& file, uint32 mip, uint32 arraySlice, std::vector<uint8>& rgba)
+{
+    const DDSFile::Description& desc = file.GetDescription();
+    if(mip >= desc.MipLevels || arraySlice >= desc.ArraySize || file.IsCompressed())
+        return false;
+
+    const DDSFile::Subresource& subresource = file.GetSubresource(mip, arraySlice);
+    const size_t slicePixels = (size_t)subresource.Width*subresource.Height;
+
+    rgba.resize(slicePixels*4*subresource.Depth);
+
+    for(uint32 z = 0; z < subresource.Depth; ++z)
+    {
+        const uint8* src = file.SubresourceData(subresource) + z*subresource.SlicePitch;
+        uint8* dst = rgba.data() + z*slicePixels*4;
+
+        if(CanDecode(desc.Format))
+        {
+            Decode(desc.Format, src, subresource.RowPitch, subresource.Width, subresource.Height,
+                dst, subresource.Width*4);
+            continue;
+        }
+
+        for(uint32 y = 0; y < subresource.Height; ++y)
+        {
+            const uint8* in = src + y*subresource.RowPitch;
+            uint8* out = dst + (size_t)y*subresource.Width*4;
+
+            switch(desc.Format)
+            {
+            case DXGI_FORMAT_R8G8B8A8_UNORM:
+            case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+                std::memcpy(out, in, subresource.Width*4);
+                break;
+
+            case DXGI_FORMAT_B8G8R8A8_UNORM:
+            case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+            case DXGI_FORMAT_B8G8R8X8_UNORM:
+            case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+            {
+                const bool opaque = desc.Format == DXGI_FORMAT_B8G8R8X8_UNORM ||
+                                    desc.Format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+                for(uint32 x = 0; x < subresource.Width; ++x)
+                {
+                    out[4*x + 0] = in[4*x + 2];
+                    out[4*x + 1] = in[4*x + 1];
+                    out[4*x + 2] = in[4*x + 0];
+                    out[4*x + 3] = opaque ? 255 : in[4*x + 3];
+                }
+            } break;
+
+            default:
+                rgba.clear();
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
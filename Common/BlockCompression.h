@@ -0,0 +1,68 @@
+//***************************************************************************************
+// BlockCompression.h
+//
+// CPU encoder and decoder for the BC1, BC3, BC4 and BC5 block compressed formats
+// (and a decoder for BC2), for tools and software paths that need the texels on
+// the CPU.
+//
+// Images are RGBA8, four bytes per pixel in R, G, B, A order.  BC4 stores the red
+// channel and BC5 the red and green channels; decoding them gives (r, 0, 0, 255)
+// and (r, g, 0, 255), as sampling the texture would.
+//
+// The Fast mode fits each block to its bounding box and picks the indices by
+// projecting onto the endpoint axis (with SSE2 where DirectXMath uses it).  The
+// High mode fits the principal axis of the colors, refines the endpoints by least
+// squares and picks each index by its actual error.  Both split the image into
+// rows of blocks across cores.
+//***************************************************************************************
+
+#pragma once
+
+#include <dxgiformat.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class DDSFile;
+
+class BlockCompression
+{
+public:
+
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+
+    enum class Quality
+    {
+        Fast,
+        High
+    };
+
+    // BC1, BC3, BC4 and BC5, UNORM and (for BC1 and BC3) UNORM_SRGB.
+    static bool CanEncode(DXGI_FORMAT format);
+
+    // Everything CanEncode accepts, plus BC2.
+    static bool CanDecode(DXGI_FORMAT format);
+
+    // 8 for BC1 and BC4, 16 for BC2, BC3 and BC5; 0 otherwise.
+    static size_t BlockBytes(DXGI_FORMAT format);
+
+    ///<summary>
+    /// Compresses a width by height RGBA8 image (rows rowPitch bytes apart) into
+    /// (width+3)/4 by (height+3)/4 blocks (rows blockRowPitch bytes apart).  Edge
+    /// blocks repeat the last row and column.  In BC1, pixels with alpha below 128
+    /// become transparent.
+    ///</summary>
+    static bool Encode(DXGI_FORMAT format, const uint8* rgba, uint32 width, uint32 height, size_t rowPitch,
+        uint8* blocks, size_t blockRowPitch, Quality quality = Quality::High);
+
+    static bool Decode(DXGI_FORMAT format, const uint8* blocks, size_t blockRowPitch,
+        uint32 width, uint32 height, uint8* rgba, size_t rowPitch);
+
+    ///<summary>
+    /// Decodes one subresource of a DDS file to tightly packed RGBA8 (all depth
+    /// slices, one after another).  Besides the block formats, 8-bit RGBA, BGRA and
+    /// BGRX files are converted.  Returns false for any other format.
+    ///</summary>
+    static bool Decode(const DDSFile& file, uint32 mip, uint32 arraySlice, std::vector<uint8>& rgba);
+};
@@ -0,0 +1,244 @@
+//***************************************************************************************
+// CompactIndices.cpp
+//***************************************************************************************
+
+#include "CompactIndices.h"
+#include "MeshUtil.h"
+#include <DirectXMath.h>
+#include <algorithm>
+
+namespace
+{
+    using uint32 = CompactIndices::uint32;
+
+    bool FitsIn16Bits(const uint32* indices, size_t count)
+    {
+        // Every index is below 65536 exactly when none of them has a high bit set,
+        // so OR them all together instead of searching for the maximum.
+        size_t i = 0;
+        uint32 bits = 0;
+
+#if defined(_XM_SSE_INTRINSICS_)
+        __m128i acc = _mm_setzero_si128();
+        for(; i + 4 <= count; i += 4)
+            acc = _mm_or_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i)));
+
+        acc = _mm_or_si128(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_or_si128(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        bits = (uint32)_mm_cvtsi128_si32(acc);
+#endif
+
+        for(; i < count; ++i)
+            bits |= indices[i];
+
+        return (bits & 0xffff0000) == 0;
+    }
+
+    bool StripFitsIn16Bits(const uint32* indices, size_t count)
+    {
+        // The restart value itself narrows to RestartIndex16, so no real index may
+        // use 0xffff.
+        for(size_t i = 0; i < count; ++i)
+        {
+            if(indices[i] != CompactIndices::RestartIndex32 && indices[i] >= CompactIndices::RestartIndex16)
+                return false;
+        }
+
+        return true;
+    }
+}
+
+CompactIndices::CompactIndices(std::vector<uint32>&& indices, Topology topology) :
+    mTopology(topology)
+{
+    bool fits = false;
+
+    if(topology == Topology::TriangleStrip)
+    {
+        mStorage = Stripify(indices.data(), indices.size(), RestartIndex32);
+        std::vector<uint32>().swap(indices);
+
+        fits = StripFitsIn16Bits(mStorage.data(), mStorage.size());
+    }
+    else
+    {
+        mStorage = std::move(indices);
+        indices.clear();
+
+        fits = FitsIn16Bits(mStorage.data(), mStorage.size());
+    }
+
+    mCount = mStorage.size();
+
+    if(fits)
+    {
+        Narrow(reinterpret_cast<uint16*>(mStorage.data()), mStorage.data(), mCount);
+        mIs16Bit = true;
+
+        // Give the upper half back.  shrink_to_fit reallocates, so for a moment
+        // the 16-bit data exists twice; afterwards the buffer is half its size.
+        mStorage.resize((mCount + 1) / 2);
+        mStorage.shrink_to_fit();
+    }
+}
+
+void CompactIndices::Narrow(uint16* dst, const uint32* src, size_t count)
+{
+    size_t i = 0;
+
+#if defined(_XM_SSE_INTRINSICS_)
+    // Sign extend the low 16 bits so the saturating pack keeps them unchanged.  A
+    // block of 8 reads 32 bytes at src + 4i and writes 16 bytes at dst + 2i, so
+    // in place narrowing never overwrites indices that have not been read yet.
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4));
+
+        a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(a, b));
+    }
+#endif
+
+    for(; i < count; ++i)
+        dst[i] = static_cast<uint16>(src[i]);
+}
+
+std::vector<CompactIndices::uint32> CompactIndices::Stripify(const uint32* indices, size_t indexCount,
+    uint32 restartIndex)
+{
+    const uint32 triangleCount = (uint32)(indexCount / 3);
+
+    std::vector<uint32> strips;
+    if(triangleCount == 0)
+        return strips;
+
+    uint32 vertexCount = 0;
+    for(size_t i = 0; i < indexCount; ++i)
+        vertexCount = std::max(vertexCount, indices[i] + 1);
+
+    const MeshUtil::VertexAdjacency adjacency(indices, triangleCount, vertexCount);
+
+    std::vector<bool> used(triangleCount, false);
+
+    // Finds an unused triangle with the directed edge a->b and returns its third
+    // vertex, or UINT32_MAX.
+    auto findTriangle = [&](uint32 a, uint32 b, uint32& triangle) -> uint32
+    {
+        for(uint32 k = adjacency.Offset[a]; k < adjacency.Offset[a+1]; ++k)
+        {
+            uint32 t = adjacency.Triangles[k];
+            if(used[t])
+                continue;
+
+            const uint32* tri = &indices[t*3];
+            for(uint32 e = 0; e < 3; ++e)
+            {
+                if(tri[e] == a && tri[(e+1)%3] == b)
+                {
+                    triangle = t;
+                    return tri[(e+2)%3];
+                }
+            }
+        }
+
+        return UINT32_MAX;
+    };
+
+    strips.reserve(indexCount);
+
+    // Start new strips in input order so the result keeps the input's locality.
+    for(uint32 start = 0; start < triangleCount; ++start)
+    {
+        if(used[start])
+            continue;
+
+        used[start] = true;
+
+        // Rotate the first triangle so that the strip can continue across its
+        // last edge if possible.  Strip triangle i is (v[i], v[i+1], v[i+2]) for
+        // even i and (v[i+1], v[i], v[i+2]) for odd i.
+        const uint32* tri = &indices[start*3];
+        uint32 rotation = 0;
+        for(uint32 r = 0; r < 3; ++r)
+        {
+            uint32 t;
+            if(findTriangle(tri[(r+2)%3], tri[(r+1)%3], t) != UINT32_MAX)
+            {
+                rotation = r;
+                break;
+            }
+        }
+
+        if(!strips.empty())
+            strips.push_back(restartIndex);
+
+        size_t stripStart = strips.size();
+        strips.push_back(tri[rotation]);
+        strips.push_back(tri[(rotation+1)%3]);
+        strips.push_back(tri[(rotation+2)%3]);
+
+        for(;;)
+        {
+            size_t n = strips.size() - stripStart;
+            uint32 p = strips[strips.size() - 2];
+            uint32 q = strips[strips.size() - 1];
+
+            // The next triangle is number n - 2 of the strip.
+            uint32 t = 0;
+            uint32 next = ((n - 2) % 2 == 0) ? findTriangle(p, q, t) : findTriangle(q, p, t);
+            if(next == UINT32_MAX)
+                break;
+
+            used[t] = true;
+            strips.push_back(next);
+        }
+    }
+
+    return strips;
+}
+
+std::vector<CompactIndices::uint32> CompactIndices::ToTriangleList()const
+{
+    std::vector<uint32> list;
+
+    if(mTopology == Topology::TriangleList)
+    {
+        list.resize(mCount);
+        for(size_t i = 0; i < mCount; ++i)
+            list[i] = (*this)[i];
+        return list;
+    }
+
+    const uint32 restart = mIs16Bit ? RestartIndex16 : RestartIndex32;
+
+    size_t stripStart = 0;
+    for(size_t i = 0; i < mCount; ++i)
+    {
+        if((*this)[i] == restart)
+        {
+            stripStart = i + 1;
+            continue;
+        }
+
+        size_t k = i - stripStart;
+        if(k < 2)
+            continue;
+
+        if(k % 2 == 0)
+        {
+            list.push_back((*this)[i-2]);
+            list.push_back((*this)[i-1]);
+        }
+        else
+        {
+            list.push_back((*this)[i-1]);
+            list.push_back((*this)[i-2]);
+        }
+        list.push_back((*this)[i]);
+    }
+
+    return list;
+}
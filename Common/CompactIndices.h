@@ -0,0 +1,89 @@
+//***************************************************************************************
+// CompactIndices.h
+//
+// An index buffer that stores its indices in the narrowest format that fits.
+//
+// The buffer takes over an existing std::vector<uint32> and, when every index fits
+// in 16 bits, narrows it in place, so there is never a second copy of the indices.
+// Optionally the triangle list is re-encoded as triangle strips separated by the
+// primitive restart (strip cut) value.
+//***************************************************************************************
+
+#pragma once
+
+#include <dxgiformat.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class CompactIndices
+{
+public:
+
+    using uint16 = std::uint16_t;
+    using uint32 = std::uint32_t;
+
+    enum class Topology
+    {
+        TriangleList,
+
+        // Strips separated by RestartIndex16/RestartIndex32.  Draw with
+        // D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP and a PSO whose IBStripCutValue
+        // matches Format().
+        TriangleStrip
+    };
+
+    static const uint16 RestartIndex16 = 0xffff;
+    static const uint32 RestartIndex32 = 0xffffffff;
+
+    CompactIndices() = default;
+
+    ///<summary>
+    /// Takes over a triangle list.  The indices are narrowed to 16 bits in place if
+    /// they fit; indices is left empty.
+    ///</summary>
+    explicit CompactIndices(std::vector<uint32>&& indices, Topology topology = Topology::TriangleList);
+
+    bool Is16Bit()const { return mIs16Bit; }
+    DXGI_FORMAT Format()const { return mIs16Bit ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT; }
+    Topology GetTopology()const { return mTopology; }
+
+    // Number of indices, including strip restarts.
+    size_t Count()const { return mCount; }
+    size_t ByteSize()const { return mCount * (mIs16Bit ? sizeof(uint16) : sizeof(uint32)); }
+
+    const void* Data()const { return mStorage.data(); }
+
+    // Null unless the buffer has the matching width.
+    const uint16* Data16()const { return mIs16Bit ? reinterpret_cast<const uint16*>(mStorage.data()) : nullptr; }
+    const uint32* Data32()const { return mIs16Bit ? nullptr : mStorage.data(); }
+
+    uint32 operator[](size_t i)const
+    {
+        return mIs16Bit ? reinterpret_cast<const uint16*>(mStorage.data())[i] : mStorage[i];
+    }
+
+    ///<summary>
+    /// Expands the buffer back to a 32-bit triangle list (strips are unrolled).
+    ///</summary>
+    std::vector<uint32> ToTriangleList()const;
+
+    ///<summary>
+    /// Narrows count 32-bit indices to 16 bits.  dst may alias src, as long as it
+    /// does not start after it.
+    ///</summary>
+    static void Narrow(uint16* dst, const uint32* src, size_t count);
+
+    ///<summary>
+    /// Re-encodes a triangle list as triangle strips joined by restartIndex.  The
+    /// winding of every triangle is preserved.
+    ///</summary>
+    static std::vector<uint32> Stripify(const uint32* indices, size_t indexCount, uint32 restartIndex);
+
+private:
+    // 16-bit data is packed two per element.
+    std::vector<uint32> mStorage;
+    size_t mCount = 0;
+    bool mIs16Bit = false;
+    Topology mTopology = Topology::TriangleList;
+};
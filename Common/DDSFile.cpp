@@ -0,0 +1,1214 @@
+//***************************************************************************************
+// DDSFile.cpp
+//
+// BitsPerPixel, GetSurfaceInfo, GetDXGIFormat and MakeSRGB were moved here from
+// DDSTextureLoader.cpp (Copyright (c) Microsoft Corporation) unchanged.
+//***************************************************************************************
+
+#include "DDSFile.h"
+#include "DDS.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <ppl.h>
+
+namespace
+{
+    using uint8 = DDSFile::uint8;
+    using uint32 = DDSFile::uint32;
+    using uint64 = DDSFile::uint64;
+
+    //
+    // The compressed variant: the magic number, the same DDS_HEADER and
+    // DDS_HEADER_DXT10, a CompressedHeader, ChunkCount ChunkRecords and then the
+    // chunk data.
+    //
+
+    const uint32 CompressedMagic = 0x5A534444; // "DDSZ"
+
+    struct CompressedHeader
+    {
+        uint32 ChunkCount;
+        uint32 Reserved;
+    };
+
+    struct ChunkRecord
+    {
+        uint32 Subresource;
+        uint32 FirstRow;
+        uint32 RowCount;
+        uint32 Size;
+        uint32 CompressedSize;
+        uint32 Reserved;
+        uint64 SourceOffset;
+    };
+
+    static_assert(sizeof(CompressedHeader) == 8, "The chunk table header is written as is.");
+    static_assert(sizeof(ChunkRecord) == 32, "Chunk records are written as is.");
+
+    DDSFile::AlphaMode GetAlphaMode(const DDS_HEADER& header, const DDS_HEADER_DXT10* d3d10ext)
+    {
+        if(header.ddspf.flags & DDS_FOURCC)
+        {
+            if(d3d10ext != nullptr)
+            {
+                uint32 mode = d3d10ext->miscFlags2 & DDS_MISC_FLAGS2_ALPHA_MODE_MASK;
+                if(mode >= (uint32)DDSFile::AlphaMode::Straight && mode <= (uint32)DDSFile::AlphaMode::Custom)
+                    return (DDSFile::AlphaMode)mode;
+            }
+            else if((MAKEFOURCC('D', 'X', 'T', '2') == header.ddspf.fourCC) ||
+                    (MAKEFOURCC('D', 'X', 'T', '4') == header.ddspf.fourCC))
+            {
+                return DDSFile::AlphaMode::Premultiplied;
+            }
+        }
+
+        return DDSFile::AlphaMode::Unknown;
+    }
+}
+
+static_assert(DDSFile::MaxHeaderSize == sizeof(std::uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10),
+    "MaxHeaderSize covers the magic number and both headers.");
+
+DDSFile::Status DDSFile::Open(const std::wstring& filename)
+{
+    mDesc = Description();
+    mSubresources.clear();
+    mChunks.clear();
+    mDecompressed.clear();
+    mData = nullptr;
+    mSize = 0;
+
+    if(!mFile.Open(filename))
+        return Status::FileNotFound;
+
+    return ParseData(mFile.Data(), mFile.Size());
+}
+
+DDSFile::Status DDSFile::Parse(const uint8* data, size_t size)
+{
+    mFile.Close();
+
+    return ParseData(data, size);
+}
+
+DDSFile::Status DDSFile::ParseData(const uint8* data, size_t size)
+{
+    mDesc = Description();
+    mSubresources.clear();
+    mChunks.clear();
+    mData = data;
+    mSize = size;
+
+    Description desc;
+    size_t dataOffset = 0;
+    bool compressed = false;
+    Status status = ReadHeader(data, size, desc, dataOffset, compressed);
+    if(status != Status::Ok)
+        return status;
+
+    if(compressed)
+    {
+        // Every subresource has at least one chunk, so the chunk count bounds
+        // the subresources before anything is allocated for them.
+        CompressedHeader header;
+        if(size - dataOffset < sizeof(CompressedHeader))
+            return Status::EndOfFile;
+        std::memcpy(&header, data + dataOffset, sizeof(CompressedHeader));
+        if((uint64)desc.MipLevels*desc.ArraySize > header.ChunkCount)
+            return Status::InvalidData;
+
+        uint64 dataBytes = 0;
+        status = Layout(desc, dataOffset, UINT64_MAX, &mSubresources, &dataBytes);
+        if(status == Status::Ok)
+            status = ReadChunks(dataOffset, dataBytes);
+    }
+    else
+    {
+        status = Layout(desc, dataOffset, size, &mSubresources, nullptr);
+    }
+
+    if(status != Status::Ok)
+    {
+        mSubresources.clear();
+        mChunks.clear();
+        return status;
+    }
+
+    mDesc = desc;
+
+    return Status::Ok;
+}
+
+DDSFile::Status DDSFile::ReadChunks(size_t dataOffset, uint64 dataBytes)
+{
+    CompressedHeader header;
+    std::memcpy(&header, mData + dataOffset, sizeof(CompressedHeader));
+
+    const uint64 tableEnd = dataOffset + sizeof(CompressedHeader) + (uint64)header.ChunkCount*sizeof(ChunkRecord);
+    if(tableEnd > mSize)
+        return Status::EndOfFile;
+
+    // The uncompressed file must fit in memory.
+    if(dataOffset + dataBytes > SIZE_MAX)
+        return Status::NotSupported;
+
+    //
+    // The chunks cover the rows of every subresource once, in order.
+    //
+
+    mChunks.resize(header.ChunkCount);
+
+    uint32 subresource = 0;
+    uint64 row = 0;
+    for(uint32 i = 0; i < header.ChunkCount; ++i)
+    {
+        ChunkRecord record;
+        std::memcpy(&record, mData + dataOffset + sizeof(CompressedHeader) + (size_t)i*sizeof(ChunkRecord),
+            sizeof(ChunkRecord));
+
+        if(subresource == mSubresources.size())
+            return Status::InvalidData;
+
+        const Subresource& s = mSubresources[subresource];
+        const uint64 rows = (uint64)s.NumRows*s.Depth;
+        if(record.Subresource != subresource || record.FirstRow != row ||
+           record.RowCount == 0 || record.RowCount > rows - row ||
+           record.Size != (uint64)record.RowCount*s.RowPitch)
+            return Status::InvalidData;
+
+        // LZBlock cannot expand a byte to more than 255, which also keeps a
+        // damaged table from asking for more memory than the file could fill.
+        if(record.CompressedSize == 0 || record.CompressedSize > record.Size ||
+           record.Size > (uint64)record.CompressedSize*255 + 16)
+            return Status::InvalidData;
+
+        if(record.SourceOffset < tableEnd || record.SourceOffset > mSize ||
+           record.CompressedSize > mSize - record.SourceOffset)
+            return Status::EndOfFile;
+
+        Chunk& chunk = mChunks[i];
+        chunk.Subresource = record.Subresource;
+        chunk.FirstRow = record.FirstRow;
+        chunk.RowCount = record.RowCount;
+        chunk.Size = record.Size;
+        chunk.CompressedSize = record.CompressedSize;
+        chunk.SourceOffset = (size_t)record.SourceOffset;
+        chunk.Offset = s.Offset + (size_t)record.FirstRow*s.RowPitch;
+
+        row += record.RowCount;
+        if(row == rows)
+        {
+            subresource++;
+            row = 0;
+        }
+    }
+
+    if(subresource != mSubresources.size())
+        return Status::InvalidData;
+
+    return Status::Ok;
+}
+
+bool DDSFile::DecompressChunk(const Chunk& chunk, uint8* dst)const
+{
+    const uint8* src = mData + chunk.SourceOffset;
+    if(chunk.CompressedSize == chunk.Size)
+    {
+        std::memcpy(dst, src, chunk.Size);
+        return true;
+    }
+
+    return LZBlock::Decompress(src, chunk.CompressedSize, dst, chunk.Size);
+}
+
+DDSFile::Status DDSFile::Decompress()
+{
+    if(mChunks.empty())
+        return Status::Ok;
+
+    const Subresource& last = mSubresources.back();
+    const size_t dataOffset = mSubresources.front().Offset;
+    const size_t size = last.Offset + last.SlicePitch*last.Depth;
+
+    std::vector<uint8> file(size);
+    std::memcpy(file.data(), mData, dataOffset);
+    std::memcpy(file.data(), &DDS_MAGIC, sizeof(uint32));
+
+    std::atomic<bool> ok(true);
+    concurrency::parallel_for(size_t(0), mChunks.size(), [&](size_t i)
+    {
+        if(!DecompressChunk(mChunks[i], file.data() + mChunks[i].Offset))
+            ok.store(false, std::memory_order_relaxed);
+    });
+
+    if(!ok)
+        return Status::InvalidData;
+
+    mDecompressed.swap(file);
+    mChunks.clear();
+    mFile.Close();
+    mData = mDecompressed.data();
+    mSize = mDecompressed.size();
+
+    return Status::Ok;
+}
+
+DDSFile::Status DDSFile::ParseHeader(const uint8* data, size_t size, std::uint64_t fileSize, Description& desc,
+    std::uint64_t* dataBytes)
+{
+    desc = Description();
+
+    Description parsed;
+    size_t dataOffset = 0;
+    bool compressed = false;
+    Status status = ReadHeader(data, size, parsed, dataOffset, compressed);
+    if(status != Status::Ok)
+        return status;
+
+    status = Layout(parsed, dataOffset, compressed ? UINT64_MAX : fileSize, nullptr, dataBytes);
+    if(status != Status::Ok)
+        return status;
+
+    desc = parsed;
+
+    return Status::Ok;
+}
+
+DDSFile::Status DDSFile::ReadHeader(const uint8* data, size_t size, Description& desc, size_t& dataOffset,
+    bool& compressed)
+{
+    // DDS files always start with the same magic number ("DDS "), or "DDSZ" for
+    // the compressed variant.
+    if(data == nullptr || size < sizeof(uint32) + sizeof(DDS_HEADER))
+        return Status::InvalidFile;
+
+    uint32 magic;
+    std::memcpy(&magic, data, sizeof(uint32));
+    if(magic != DDS_MAGIC && magic != CompressedMagic)
+        return Status::InvalidFile;
+
+    compressed = magic == CompressedMagic;
+
+    DDS_HEADER header;
+    std::memcpy(&header, data + sizeof(uint32), sizeof(DDS_HEADER));
+    if(header.size != sizeof(DDS_HEADER) || header.ddspf.size != sizeof(DDS_PIXELFORMAT))
+        return Status::InvalidFile;
+
+    DDS_HEADER_DXT10 d3d10ext;
+    const bool hasDXT10Header = (header.ddspf.flags & DDS_FOURCC) &&
+        (MAKEFOURCC('D', 'X', '1', '0') == header.ddspf.fourCC);
+
+    size_t offset = sizeof(uint32) + sizeof(DDS_HEADER);
+    if(hasDXT10Header)
+    {
+        if(size < offset + sizeof(DDS_HEADER_DXT10))
+            return Status::InvalidFile;
+
+        std::memcpy(&d3d10ext, data + offset, sizeof(DDS_HEADER_DXT10));
+        offset += sizeof(DDS_HEADER_DXT10);
+    }
+
+    //
+    // Same rules as the Direct3D loaders.
+    //
+
+    desc = Description();
+    desc.Width = header.width;
+    desc.Height = header.height;
+    desc.Depth = header.depth;
+    desc.MipLevels = header.mipMapCount == 0 ? 1 : header.mipMapCount;
+    desc.ArraySize = 1;
+
+    if(hasDXT10Header)
+    {
+        if(d3d10ext.arraySize == 0)
+            return Status::InvalidData;
+
+        switch(d3d10ext.dxgiFormat)
+        {
+        case DXGI_FORMAT_AI44:
+        case DXGI_FORMAT_IA44:
+        case DXGI_FORMAT_P8:
+        case DXGI_FORMAT_A8P8:
+            return Status::NotSupported;
+
+        default:
+            if(BitsPerPixel(d3d10ext.dxgiFormat) == 0)
+                return Status::NotSupported;
+        }
+
+        desc.Format = d3d10ext.dxgiFormat;
+        desc.ArraySize = d3d10ext.arraySize;
+
+        switch(d3d10ext.resourceDimension)
+        {
+        case DDS_DIMENSION_TEXTURE1D:
+            if((header.flags & DDS_HEIGHT) && desc.Height != 1)
+                return Status::InvalidData;
+            desc.Height = desc.Depth = 1;
+            desc.Dimension = TextureDimension::Texture1D;
+            break;
+
+        case DDS_DIMENSION_TEXTURE2D:
+            if(d3d10ext.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE)
+            {
+                if(desc.ArraySize > UINT32_MAX / 6)
+                    return Status::InvalidData;
+                desc.ArraySize *= 6;
+                desc.IsCubeMap = true;
+            }
+            desc.Depth = 1;
+            desc.Dimension = TextureDimension::Texture2D;
+            break;
+
+        case DDS_DIMENSION_TEXTURE3D:
+            if(!(header.flags & DDS_HEADER_FLAGS_VOLUME))
+                return Status::InvalidData;
+            if(desc.ArraySize > 1)
+                return Status::NotSupported;
+            desc.Dimension = TextureDimension::Texture3D;
+            break;
+
+        default:
+            return Status::NotSupported;
+        }
+    }
+    else
+    {
+        desc.Format = GetDXGIFormat(header.ddspf);
+        if(desc.Format == DXGI_FORMAT_UNKNOWN)
+            return Status::NotSupported;
+
+        if(header.flags & DDS_HEADER_FLAGS_VOLUME)
+        {
+            desc.Dimension = TextureDimension::Texture3D;
+        }
+        else
+        {
+            if(header.caps2 & DDS_CUBEMAP)
+            {
+                if((header.caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES)
+                    return Status::NotSupported;
+                desc.ArraySize = 6;
+                desc.IsCubeMap = true;
+            }
+
+            desc.Depth = 1;
+            desc.Dimension = TextureDimension::Texture2D;
+        }
+    }
+
+    if(desc.Width == 0 || desc.Height == 0 || desc.Depth == 0)
+        return Status::InvalidData;
+
+    // No texture has more mips than a 32-bit size has bits.
+    if(desc.MipLevels > 32)
+        return Status::NotSupported;
+
+    desc.Alpha = GetAlphaMode(header, hasDXT10Header ? &d3d10ext : nullptr);
+
+    dataOffset = offset;
+
+    return Status::Ok;
+}
+
+DDSFile::Status DDSFile::Layout(const Description& desc, size_t dataOffset, std::uint64_t fileSize,
+    std::vector<Subresource>* subresources, std::uint64_t* dataBytes)
+{
+    //
+    // Walk the subresources: all mips of slice 0, then all mips of slice 1, ...
+    //
+
+    if(fileSize < dataOffset)
+        return Status::EndOfFile;
+
+    // Every subresource takes at least one byte, so a header that claims more than
+    // that is rejected before anything is allocated for it.
+    const std::uint64_t subresourceCount = (std::uint64_t)desc.MipLevels*desc.ArraySize;
+    if(subresourceCount > fileSize - dataOffset)
+        return Status::EndOfFile;
+
+    if(subresources != nullptr)
+        subresources->reserve((size_t)subresourceCount);
+
+    std::uint64_t offset = dataOffset;
+    for(uint32 slice = 0; slice < desc.ArraySize; ++slice)
+    {
+        size_t w = desc.Width;
+        size_t h = desc.Height;
+        size_t d = desc.Depth;
+        for(uint32 mip = 0; mip < desc.MipLevels; ++mip)
+        {
+            Subresource subresource;
+            GetSurfaceInfo(w, h, desc.Format, &subresource.SlicePitch, &subresource.RowPitch, &subresource.NumRows);
+
+            subresource.Offset = (size_t)offset;
+            subresource.Width = (uint32)w;
+            subresource.Height = (uint32)h;
+            subresource.Depth = (uint32)d;
+
+            const std::uint64_t bytes = (std::uint64_t)subresource.SlicePitch * d;
+            if(bytes > fileSize - offset)
+            {
+                if(subresources != nullptr)
+                    subresources->clear();
+                return Status::EndOfFile;
+            }
+
+            if(subresources != nullptr)
+                subresources->push_back(subresource);
+            offset += bytes;
+
+            w = std::max<size_t>(w >> 1, 1);
+            h = std::max<size_t>(h >> 1, 1);
+            d = std::max<size_t>(d >> 1, 1);
+        }
+    }
+
+    if(dataBytes != nullptr)
+        *dataBytes = offset - dataOffset;
+
+    return Status::Ok;
+}
+
+bool DDSFile::Serialize(const Description& desc, const std::vector<const uint8*>& subresources,
+    std::vector<uint8>& file)
+{
+    const bool is3D = desc.Dimension == TextureDimension::Texture3D;
+    const uint32 arraySize = desc.IsCubeMap ? desc.ArraySize / 6 : desc.ArraySize;
+
+    if(desc.Dimension == TextureDimension::Unknown || desc.Format == DXGI_FORMAT_UNKNOWN ||
+       desc.Width == 0 || desc.Height == 0 || desc.MipLevels == 0 || arraySize == 0 ||
+       (desc.IsCubeMap && desc.ArraySize % 6 != 0) ||
+       subresources.size() != (size_t)desc.MipLevels*desc.ArraySize)
+    {
+        return false;
+    }
+
+    size_t topBytes = 0;
+    size_t topRowBytes = 0;
+    size_t topNumRows = 0;
+    GetSurfaceInfo(desc.Width, desc.Height, desc.Format, &topBytes, &topRowBytes, &topNumRows);
+    if(topBytes == 0)
+        return false;
+
+    // Block compressed formats store the size of the top level, others its pitch.
+    const bool compressed = topNumRows != desc.Height;
+
+    DDS_HEADER header = {};
+    header.size = sizeof(DDS_HEADER);
+    header.flags = DDS_HEADER_FLAGS_TEXTURE | (compressed ? DDS_HEADER_FLAGS_LINEARSIZE : DDS_HEADER_FLAGS_PITCH);
+    header.height = desc.Height;
+    header.width = desc.Width;
+    header.pitchOrLinearSize = (uint32)(compressed ? topBytes : topRowBytes);
+    header.mipMapCount = desc.MipLevels;
+    header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+    header.ddspf.flags = DDS_FOURCC;
+    header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+    header.caps = DDS_SURFACE_FLAGS_TEXTURE;
+
+    if(desc.MipLevels > 1)
+    {
+        header.flags |= DDS_HEADER_FLAGS_MIPMAP;
+        header.caps |= DDS_SURFACE_FLAGS_MIPMAP;
+    }
+
+    if(is3D)
+    {
+        header.flags |= DDS_HEADER_FLAGS_VOLUME;
+        header.depth = desc.Depth;
+    }
+
+    if(desc.IsCubeMap)
+    {
+        header.caps |= DDS_SURFACE_FLAGS_CUBEMAP;
+        header.caps2 = DDS_CUBEMAP_ALLFACES;
+    }
+
+    DDS_HEADER_DXT10 d3d10ext = {};
+    d3d10ext.dxgiFormat = desc.Format;
+    d3d10ext.resourceDimension = (uint32)desc.Dimension;
+    d3d10ext.miscFlag = desc.IsCubeMap ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+    d3d10ext.arraySize = is3D ? 1 : arraySize;
+    d3d10ext.miscFlags2 = (uint32)desc.Alpha;
+
+    size_t size = sizeof(uint32) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+    std::vector<size_t> bytes(subresources.size());
+    for(uint32 slice = 0; slice < desc.ArraySize; ++slice)
+    {
+        for(uint32 mip = 0; mip < desc.MipLevels; ++mip)
+        {
+            size_t surfaceBytes = 0;
+            GetSurfaceInfo(std::max(desc.Width >> mip, 1u), std::max(desc.Height >> mip, 1u), desc.Format,
+                &surfaceBytes, nullptr, nullptr);
+
+            const size_t depth = is3D ? std::max(desc.Depth >> mip, 1u) : 1;
+            bytes[mip + slice*desc.MipLevels] = surfaceBytes*depth;
+            size += surfaceBytes*depth;
+        }
+    }
+
+    file.resize(size);
+    uint8* out = file.data();
+
+    const uint32 magic = DDS_MAGIC;
+    std::memcpy(out, &magic, sizeof(magic));
+    out += sizeof(magic);
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    std::memcpy(out, &d3d10ext, sizeof(d3d10ext));
+    out += sizeof(d3d10ext);
+
+    for(size_t i = 0; i < subresources.size(); ++i)
+    {
+        if(subresources[i] == nullptr)
+            return false;
+
+        std::memcpy(out, subresources[i], bytes[i]);
+        out += bytes[i];
+    }
+
+    return true;
+}
+
+bool DDSFile::Save(const std::wstring& filename, const Description& desc,
+    const std::vector<const uint8*>& subresources)
+{
+    std::vector<uint8> file;
+    if(!Serialize(desc, subresources, file))
+        return false;
+
+    return MappedFile::WriteAtomic(filename, file.data(), file.size());
+}
+
+bool DDSFile::SerializeCompressed(const Description& desc, const std::vector<const uint8*>& subresources,
+    std::vector<uint8>& file, LZBlock::Level level)
+{
+    std::vector<uint8> plain;
+    if(!Serialize(desc, subresources, plain))
+        return false;
+
+    Description parsed;
+    size_t dataOffset = 0;
+    bool compressed = false;
+    std::vector<Subresource> layout;
+    if(ReadHeader(plain.data(), plain.size(), parsed, dataOffset, compressed) != Status::Ok ||
+       Layout(parsed, dataOffset, plain.size(), &layout, nullptr) != Status::Ok)
+        return false;
+
+    //
+    // Split every subresource into chunks of whole rows, about ChunkTargetSize
+    // bytes each, and compress them in parallel.
+    //
+
+    std::vector<Chunk> chunks;
+    for(uint32 i = 0; i < (uint32)layout.size(); ++i)
+    {
+        const Subresource& s = layout[i];
+        // A row that is a chunk on its own must still fit the 32-bit sizes.
+        if(s.RowPitch > UINT32_MAX)
+            return false;
+
+        const uint64 rows = (uint64)s.NumRows*s.Depth;
+        const uint64 rowsPerChunk = std::max<uint64>(ChunkTargetSize / s.RowPitch, 1);
+        for(uint64 row = 0; row < rows; row += rowsPerChunk)
+        {
+            Chunk chunk;
+            chunk.Subresource = i;
+            chunk.FirstRow = (uint32)row;
+            chunk.RowCount = (uint32)std::min(rowsPerChunk, rows - row);
+            chunk.Size = (uint32)(chunk.RowCount*s.RowPitch);
+            chunk.Offset = s.Offset + (size_t)row*s.RowPitch;
+            chunks.push_back(chunk);
+        }
+    }
+
+    std::vector<std::vector<uint8>> blocks(chunks.size());
+    concurrency::parallel_for(size_t(0), chunks.size(), [&](size_t i)
+    {
+        Chunk& chunk = chunks[i];
+        const uint8* src = plain.data() + chunk.Offset;
+
+        std::vector<uint8>& block = blocks[i];
+        block.resize(LZBlock::CompressBound(chunk.Size));
+        size_t size = LZBlock::Compress(src, chunk.Size, block.data(), block.size(), level);
+        if(size == 0 || size >= chunk.Size)
+        {
+            block.assign(src, src + chunk.Size);
+            size = chunk.Size;
+        }
+
+        block.resize(size);
+        chunk.CompressedSize = (uint32)size;
+    });
+
+    const size_t tableEnd = dataOffset + sizeof(CompressedHeader) + chunks.size()*sizeof(ChunkRecord);
+    size_t size = tableEnd;
+    for(const std::vector<uint8>& block : blocks)
+        size += block.size();
+
+    file.resize(size);
+    std::memcpy(file.data(), plain.data(), dataOffset);
+    std::memcpy(file.data(), &CompressedMagic, sizeof(uint32));
+
+    CompressedHeader header = {};
+    header.ChunkCount = (uint32)chunks.size();
+    std::memcpy(file.data() + dataOffset, &header, sizeof(header));
+
+    size_t sourceOffset = tableEnd;
+    for(size_t i = 0; i < chunks.size(); ++i)
+    {
+        ChunkRecord record = {};
+        record.Subresource = chunks[i].Subresource;
+        record.FirstRow = chunks[i].FirstRow;
+        record.RowCount = chunks[i].RowCount;
+        record.Size = chunks[i].Size;
+        record.CompressedSize = chunks[i].CompressedSize;
+        record.SourceOffset = sourceOffset;
+        std::memcpy(file.data() + dataOffset + sizeof(CompressedHeader) + i*sizeof(ChunkRecord), &record, sizeof(record));
+
+        std::memcpy(file.data() + sourceOffset, blocks[i].data(), blocks[i].size());
+        sourceOffset += blocks[i].size();
+    }
+
+    return true;
+}
+
+bool DDSFile::SaveCompressed(const std::wstring& filename, const Description& desc,
+    const std::vector<const uint8*>& subresources, LZBlock::Level level)
+{
+    std::vector<uint8> file;
+    if(!SerializeCompressed(desc, subresources, file, level))
+        return false;
+
+    return MappedFile::WriteAtomic(filename, file.data(), file.size());
+}
+
+
+//--------------------------------------------------------------------------------------
+// Return the BPP for a particular format
+//--------------------------------------------------------------------------------------
+size_t DDSFile::BitsPerPixel( DXGI_FORMAT fmt )
+{
+    switch( fmt )
+    {
+    case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+    case DXGI_FORMAT_R32G32B32A32_UINT:
+    case DXGI_FORMAT_R32G32B32A32_SINT:
+        return 128;
+
+    case DXGI_FORMAT_R32G32B32_TYPELESS:
+    case DXGI_FORMAT_R32G32B32_FLOAT:
+    case DXGI_FORMAT_R32G32B32_UINT:
+    case DXGI_FORMAT_R32G32B32_SINT:
+        return 96;
+
+    case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+    case DXGI_FORMAT_R16G16B16A16_UNORM:
+    case DXGI_FORMAT_R16G16B16A16_UINT:
+    case DXGI_FORMAT_R16G16B16A16_SNORM:
+    case DXGI_FORMAT_R16G16B16A16_SINT:
+    case DXGI_FORMAT_R32G32_TYPELESS:
+    case DXGI_FORMAT_R32G32_FLOAT:
+    case DXGI_FORMAT_R32G32_UINT:
+    case DXGI_FORMAT_R32G32_SINT:
+    case DXGI_FORMAT_R32G8X24_TYPELESS:
+    case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+    case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+    case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+    case DXGI_FORMAT_Y416:
+    case DXGI_FORMAT_Y210:
+    case DXGI_FORMAT_Y216:
+        return 64;
+
+    case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+    case DXGI_FORMAT_R10G10B10A2_UNORM:
+    case DXGI_FORMAT_R10G10B10A2_UINT:
+    case DXGI_FORMAT_R11G11B10_FLOAT:
+    case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_R8G8B8A8_UINT:
+    case DXGI_FORMAT_R8G8B8A8_SNORM:
+    case DXGI_FORMAT_R8G8B8A8_SINT:
+    case DXGI_FORMAT_R16G16_TYPELESS:
+    case DXGI_FORMAT_R16G16_FLOAT:
+    case DXGI_FORMAT_R16G16_UNORM:
+    case DXGI_FORMAT_R16G16_UINT:
+    case DXGI_FORMAT_R16G16_SNORM:
+    case DXGI_FORMAT_R16G16_SINT:
+    case DXGI_FORMAT_R32_TYPELESS:
+    case DXGI_FORMAT_D32_FLOAT:
+    case DXGI_FORMAT_R32_FLOAT:
+    case DXGI_FORMAT_R32_UINT:
+    case DXGI_FORMAT_R32_SINT:
+    case DXGI_FORMAT_R24G8_TYPELESS:
+    case DXGI_FORMAT_D24_UNORM_S8_UINT:
+    case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+    case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+    case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+    case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+    case DXGI_FORMAT_AYUV:
+    case DXGI_FORMAT_Y410:
+    case DXGI_FORMAT_YUY2:
+        return 32;
+
+    case DXGI_FORMAT_P010:
+    case DXGI_FORMAT_P016:
+        return 24;
+
+    case DXGI_FORMAT_R8G8_TYPELESS:
+    case DXGI_FORMAT_R8G8_UNORM:
+    case DXGI_FORMAT_R8G8_UINT:
+    case DXGI_FORMAT_R8G8_SNORM:
+    case DXGI_FORMAT_R8G8_SINT:
+    case DXGI_FORMAT_R16_TYPELESS:
+    case DXGI_FORMAT_R16_FLOAT:
+    case DXGI_FORMAT_D16_UNORM:
+    case DXGI_FORMAT_R16_UNORM:
+    case DXGI_FORMAT_R16_UINT:
+    case DXGI_FORMAT_R16_SNORM:
+    case DXGI_FORMAT_R16_SINT:
+    case DXGI_FORMAT_B5G6R5_UNORM:
+    case DXGI_FORMAT_B5G5R5A1_UNORM:
+    case DXGI_FORMAT_A8P8:
+    case DXGI_FORMAT_B4G4R4A4_UNORM:
+        return 16;
+
+    case DXGI_FORMAT_NV12:
+    case DXGI_FORMAT_420_OPAQUE:
+    case DXGI_FORMAT_NV11:
+        return 12;
+
+    case DXGI_FORMAT_R8_TYPELESS:
+    case DXGI_FORMAT_R8_UNORM:
+    case DXGI_FORMAT_R8_UINT:
+    case DXGI_FORMAT_R8_SNORM:
+    case DXGI_FORMAT_R8_SINT:
+    case DXGI_FORMAT_A8_UNORM:
+    case DXGI_FORMAT_AI44:
+    case DXGI_FORMAT_IA44:
+    case DXGI_FORMAT_P8:
+        return 8;
+
+    case DXGI_FORMAT_R1_UNORM:
+        return 1;
+
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        return 4;
+
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        return 8;
+
+    default:
+        return 0;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Get surface information for a particular format
+//--------------------------------------------------------------------------------------
+void DDSFile::GetSurfaceInfo( size_t width,
+                               size_t height,
+                               DXGI_FORMAT fmt,
+                               size_t* outNumBytes,
+                               size_t* outRowBytes,
+                               size_t* outNumRows )
+{
+    size_t numBytes = 0;
+    size_t rowBytes = 0;
+    size_t numRows = 0;
+
+    bool bc = false;
+    bool packed = false;
+    bool planar = false;
+    size_t bpe = 0;
+    switch (fmt)
+    {
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        bc=true;
+        bpe = 8;
+        break;
+
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        bc = true;
+        bpe = 16;
+        break;
+
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:
+    case DXGI_FORMAT_YUY2:
+        packed = true;
+        bpe = 4;
+        break;
+
+    case DXGI_FORMAT_Y210:
+    case DXGI_FORMAT_Y216:
+        packed = true;
+        bpe = 8;
+        break;
+
+    case DXGI_FORMAT_NV12:
+    case DXGI_FORMAT_420_OPAQUE:
+        planar = true;
+        bpe = 2;
+        break;
+
+    case DXGI_FORMAT_P010:
+    case DXGI_FORMAT_P016:
+        planar = true;
+        bpe = 4;
+        break;
+    }
+
+    if (bc)
+    {
+        size_t numBlocksWide = 0;
+        if (width > 0)
+        {
+            numBlocksWide = std::max<size_t>( 1, (width + 3) / 4 );
+        }
+        size_t numBlocksHigh = 0;
+        if (height > 0)
+        {
+            numBlocksHigh = std::max<size_t>( 1, (height + 3) / 4 );
+        }
+        rowBytes = numBlocksWide * bpe;
+        numRows = numBlocksHigh;
+        numBytes = rowBytes * numBlocksHigh;
+    }
+    else if (packed)
+    {
+        rowBytes = ( ( width + 1 ) >> 1 ) * bpe;
+        numRows = height;
+        numBytes = rowBytes * height;
+    }
+    else if ( fmt == DXGI_FORMAT_NV11 )
+    {
+        rowBytes = ( ( width + 3 ) >> 2 ) * 4;
+        numRows = height * 2; // Direct3D makes this simplifying assumption, although it is larger than the 4:1:1 data
+        numBytes = rowBytes * numRows;
+    }
+    else if (planar)
+    {
+        rowBytes = ( ( width + 1 ) >> 1 ) * bpe;
+        numBytes = ( rowBytes * height ) + ( ( rowBytes * height + 1 ) >> 1 );
+        numRows = height + ( ( height + 1 ) >> 1 );
+    }
+    else
+    {
+        size_t bpp = BitsPerPixel( fmt );
+        rowBytes = ( width * bpp + 7 ) / 8; // round up to nearest byte
+        numRows = height;
+        numBytes = rowBytes * height;
+    }
+
+    if (outNumBytes)
+    {
+        *outNumBytes = numBytes;
+    }
+    if (outRowBytes)
+    {
+        *outRowBytes = rowBytes;
+    }
+    if (outNumRows)
+    {
+        *outNumRows = numRows;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+#define ISBITMASK( r,g,b,a ) ( ddpf.RBitMask == r && ddpf.GBitMask == g && ddpf.BBitMask == b && ddpf.ABitMask == a )
+
+DXGI_FORMAT DDSFile::GetDXGIFormat( const DDS_PIXELFORMAT& ddpf )
+{
+    if (ddpf.flags & DDS_RGB)
+    {
+        // Note that sRGB formats are written using the "DX10" extended header
+
+        switch (ddpf.RGBBitCount)
+        {
+        case 32:
+            if (ISBITMASK(0x000000ff,0x0000ff00,0x00ff0000,0xff000000))
+            {
+                return DXGI_FORMAT_R8G8B8A8_UNORM;
+            }
+
+            if (ISBITMASK(0x00ff0000,0x0000ff00,0x000000ff,0xff000000))
+            {
+                return DXGI_FORMAT_B8G8R8A8_UNORM;
+            }
+
+            if (ISBITMASK(0x00ff0000,0x0000ff00,0x000000ff,0x00000000))
+            {
+                return DXGI_FORMAT_B8G8R8X8_UNORM;
+            }
+
+            // No DXGI format maps to ISBITMASK(0x000000ff,0x0000ff00,0x00ff0000,0x00000000) aka D3DFMT_X8B8G8R8
+
+            // Note that many common DDS reader/writers (including D3DX) swap the
+            // the RED/BLUE masks for 10:10:10:2 formats. We assume
+            // below that the 'backwards' header mask is being used since it is most
+            // likely written by D3DX. The more robust solution is to use the 'DX10'
+            // header extension and specify the DXGI_FORMAT_R10G10B10A2_UNORM format directly
+
+            // For 'correct' writers, this should be 0x000003ff,0x000ffc00,0x3ff00000 for RGB data
+            if (ISBITMASK(0x3ff00000,0x000ffc00,0x000003ff,0xc0000000))
+            {
+                return DXGI_FORMAT_R10G10B10A2_UNORM;
+            }
+
+            // No DXGI format maps to ISBITMASK(0x000003ff,0x000ffc00,0x3ff00000,0xc0000000) aka D3DFMT_A2R10G10B10
+
+            if (ISBITMASK(0x0000ffff,0xffff0000,0x00000000,0x00000000))
+            {
+                return DXGI_FORMAT_R16G16_UNORM;
+            }
+
+            if (ISBITMASK(0xffffffff,0x00000000,0x00000000,0x00000000))
+            {
+                // Only 32-bit color channel format in D3D9 was R32F
+                return DXGI_FORMAT_R32_FLOAT; // D3DX writes this out as a FourCC of 114
+            }
+            break;
+
+        case 24:
+            // No 24bpp DXGI formats aka D3DFMT_R8G8B8
+            break;
+
+        case 16:
+            if (ISBITMASK(0x7c00,0x03e0,0x001f,0x8000))
+            {
+                return DXGI_FORMAT_B5G5R5A1_UNORM;
+            }
+            if (ISBITMASK(0xf800,0x07e0,0x001f,0x0000))
+            {
+                return DXGI_FORMAT_B5G6R5_UNORM;
+            }
+
+            // No DXGI format maps to ISBITMASK(0x7c00,0x03e0,0x001f,0x0000) aka D3DFMT_X1R5G5B5
+
+            if (ISBITMASK(0x0f00,0x00f0,0x000f,0xf000))
+            {
+                return DXGI_FORMAT_B4G4R4A4_UNORM;
+            }
+
+            // No DXGI format maps to ISBITMASK(0x0f00,0x00f0,0x000f,0x0000) aka D3DFMT_X4R4G4B4
+
+            // No 3:3:2, 3:3:2:8, or paletted DXGI formats aka D3DFMT_A8R3G3B2, D3DFMT_R3G3B2, D3DFMT_P8, D3DFMT_A8P8, etc.
+            break;
+        }
+    }
+    else if (ddpf.flags & DDS_LUMINANCE)
+    {
+        if (8 == ddpf.RGBBitCount)
+        {
+            if (ISBITMASK(0x000000ff,0x00000000,0x00000000,0x00000000))
+            {
+                return DXGI_FORMAT_R8_UNORM; // D3DX10/11 writes this out as DX10 extension
+            }
+
+            // No DXGI format maps to ISBITMASK(0x0f,0x00,0x00,0xf0) aka D3DFMT_A4L4
+        }
+
+        if (16 == ddpf.RGBBitCount)
+        {
+            if (ISBITMASK(0x0000ffff,0x00000000,0x00000000,0x00000000))
+            {
+                return DXGI_FORMAT_R16_UNORM; // D3DX10/11 writes this out as DX10 extension
+            }
+            if (ISBITMASK(0x000000ff,0x00000000,0x00000000,0x0000ff00))
+            {
+                return DXGI_FORMAT_R8G8_UNORM; // D3DX10/11 writes this out as DX10 extension
+            }
+        }
+    }
+    else if (ddpf.flags & DDS_ALPHA)
+    {
+        if (8 == ddpf.RGBBitCount)
+        {
+            return DXGI_FORMAT_A8_UNORM;
+        }
+    }
+    else if (ddpf.flags & DDS_FOURCC)
+    {
+        if (MAKEFOURCC( 'D', 'X', 'T', '1' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC1_UNORM;
+        }
+        if (MAKEFOURCC( 'D', 'X', 'T', '3' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC2_UNORM;
+        }
+        if (MAKEFOURCC( 'D', 'X', 'T', '5' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC3_UNORM;
+        }
+
+        // While pre-multiplied alpha isn't directly supported by the DXGI formats,
+        // they are basically the same as these BC formats so they can be mapped
+        if (MAKEFOURCC( 'D', 'X', 'T', '2' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC2_UNORM;
+        }
+        if (MAKEFOURCC( 'D', 'X', 'T', '4' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC3_UNORM;
+        }
+
+        if (MAKEFOURCC( 'A', 'T', 'I', '1' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC4_UNORM;
+        }
+        if (MAKEFOURCC( 'B', 'C', '4', 'U' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC4_UNORM;
+        }
+        if (MAKEFOURCC( 'B', 'C', '4', 'S' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC4_SNORM;
+        }
+
+        if (MAKEFOURCC( 'A', 'T', 'I', '2' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC5_UNORM;
+        }
+        if (MAKEFOURCC( 'B', 'C', '5', 'U' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC5_UNORM;
+        }
+        if (MAKEFOURCC( 'B', 'C', '5', 'S' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC5_SNORM;
+        }
+
+        // BC6H and BC7 are written using the "DX10" extended header
+
+        if (MAKEFOURCC( 'R', 'G', 'B', 'G' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_R8G8_B8G8_UNORM;
+        }
+        if (MAKEFOURCC( 'G', 'R', 'G', 'B' ) == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_G8R8_G8B8_UNORM;
+        }
+
+        if (MAKEFOURCC('Y','U','Y','2') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_YUY2;
+        }
+
+        // Check for D3DFORMAT enums being set here
+        switch( ddpf.fourCC )
+        {
+        case 36: // D3DFMT_A16B16G16R16
+            return DXGI_FORMAT_R16G16B16A16_UNORM;
+
+        case 110: // D3DFMT_Q16W16V16U16
+            return DXGI_FORMAT_R16G16B16A16_SNORM;
+
+        case 111: // D3DFMT_R16F
+            return DXGI_FORMAT_R16_FLOAT;
+
+        case 112: // D3DFMT_G16R16F
+            return DXGI_FORMAT_R16G16_FLOAT;
+
+        case 113: // D3DFMT_A16B16G16R16F
+            return DXGI_FORMAT_R16G16B16A16_FLOAT;
+
+        case 114: // D3DFMT_R32F
+            return DXGI_FORMAT_R32_FLOAT;
+
+        case 115: // D3DFMT_G32R32F
+            return DXGI_FORMAT_R32G32_FLOAT;
+
+        case 116: // D3DFMT_A32B32G32R32F
+            return DXGI_FORMAT_R32G32B32A32_FLOAT;
+        }
+    }
+
+    return DXGI_FORMAT_UNKNOWN;
+}
+
+
+//--------------------------------------------------------------------------------------
+DXGI_FORMAT DDSFile::MakeSRGB( DXGI_FORMAT format )
+{
+    switch( format )
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+        return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+
+    case DXGI_FORMAT_BC1_UNORM:
+        return DXGI_FORMAT_BC1_UNORM_SRGB;
+
+    case DXGI_FORMAT_BC2_UNORM:
+        return DXGI_FORMAT_BC2_UNORM_SRGB;
+
+    case DXGI_FORMAT_BC3_UNORM:
+        return DXGI_FORMAT_BC3_UNORM_SRGB;
+
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+        return DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+        return DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+
+    case DXGI_FORMAT_BC7_UNORM:
+        return DXGI_FORMAT_BC7_UNORM_SRGB;
+
+    default:
+        return format;
+    }
+}
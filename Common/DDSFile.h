@@ -0,0 +1,238 @@
+//***************************************************************************************
+// DDSFile.h
+//
+// Parses a DDS file without any Direct3D device.  The file is memory mapped and
+// every subresource (mip level of an array slice or cube face) is described by its
+// offset, row pitch and slice pitch inside the mapping, so the texel data is never
+// copied until it goes into an upload buffer.
+//
+// DDSTextureLoader's CreateDDSTextureFromFile12/CreateDDSTextureFromMemory12 are
+// built on top of this.  It only needs <dxgiformat.h>, so it also builds (and can
+// be tested) off Windows.
+//
+// It also reads and writes a compressed variant, for storage where the load time
+// is bound by file size.  Such a file starts with "DDSZ" instead of "DDS " and has
+// the same headers, then a chunk table and the texel data in LZBlock blocks.
+// Every chunk holds whole rows of one subresource, so the chunks decompress in
+// parallel and each goes straight to its rows of an upload buffer (see
+// TextureBatch::CopyToArena).  The subresources of a compressed file describe the
+// data as an uncompressed DDS file would hold it, which is where Decompress puts
+// it.
+//***************************************************************************************
+
+#pragma once
+
+#include "LZBlock.h"
+#include "MappedFile.h"
+#include <dxgiformat.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct DDS_PIXELFORMAT;
+
+class DDSFile
+{
+public:
+
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    enum class Status
+    {
+        Ok,
+        FileNotFound,   // the file could not be opened or mapped
+        InvalidFile,    // not a DDS file
+        InvalidData,    // a DDS file with inconsistent metadata
+        NotSupported,   // a valid DDS file this parser cannot describe
+        EndOfFile       // the texel data is shorter than the header says
+    };
+
+    // The values match D3D12_RESOURCE_DIMENSION.
+    enum class TextureDimension
+    {
+        Unknown = 0,
+        Texture1D = 2,
+        Texture2D = 3,
+        Texture3D = 4
+    };
+
+    // The values match DirectX::DDS_ALPHA_MODE.
+    enum class AlphaMode
+    {
+        Unknown = 0,
+        Straight = 1,
+        Premultiplied = 2,
+        Opaque = 3,
+        Custom = 4
+    };
+
+    struct Description
+    {
+        TextureDimension Dimension = TextureDimension::Unknown;
+        DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+        uint32 Width = 0;
+        uint32 Height = 0;
+        uint32 Depth = 0;
+        uint32 MipLevels = 0;
+
+        // Number of 2D slices; 6 per cube for cube maps.
+        uint32 ArraySize = 0;
+
+        bool IsCubeMap = false;
+        AlphaMode Alpha = AlphaMode::Unknown;
+    };
+
+    // One mip level of one array slice.  For volume textures a subresource holds
+    // Depth slices of SlicePitch bytes each.
+    struct Subresource
+    {
+        size_t Offset = 0;      // from the start of the (uncompressed) file
+        size_t RowPitch = 0;
+        size_t SlicePitch = 0;
+        size_t NumRows = 0;     // rows of blocks for block compressed formats
+
+        uint32 Width = 0;
+        uint32 Height = 0;
+        uint32 Depth = 0;
+    };
+
+    // A block of a compressed file: rows FirstRow..FirstRow + RowCount - 1 of one
+    // subresource, counting the rows of all its depth slices in order.
+    struct Chunk
+    {
+        uint32 Subresource = 0;
+        uint32 FirstRow = 0;
+        uint32 RowCount = 0;
+
+        uint32 Size = 0;            // uncompressed
+        uint32 CompressedSize = 0;  // equal to Size for a chunk stored as is
+        size_t SourceOffset = 0;    // from the start of the file
+        size_t Offset = 0;          // in the uncompressed layout
+    };
+
+    // Uncompressed bytes per chunk that SerializeCompressed aims for.
+    static const uint32 ChunkTargetSize = 256*1024;
+
+    DDSFile() = default;
+    DDSFile(const DDSFile& rhs) = delete;
+    DDSFile& operator=(const DDSFile& rhs) = delete;
+
+    ///<summary>
+    /// Maps the file and parses it.  The mapping stays open until the DDSFile is
+    /// destroyed or another file is opened.
+    ///</summary>
+    Status Open(const std::wstring& filename);
+
+    ///<summary>
+    /// Parses a DDS file that is already in memory.  The memory must outlive the
+    /// DDSFile.
+    ///</summary>
+    Status Parse(const uint8* data, size_t size);
+
+    const Description& GetDescription()const { return mDesc; }
+
+    // Subresources in Direct3D order: mip + arraySlice*MipLevels.
+    const std::vector<Subresource>& GetSubresources()const { return mSubresources; }
+    const Subresource& GetSubresource(uint32 mip, uint32 arraySlice)const
+    {
+        return mSubresources[mip + arraySlice*mDesc.MipLevels];
+    }
+
+    const uint8* Data()const { return mData; }
+    size_t Size()const { return mSize; }
+
+    // Only valid for compressed files after Decompress.
+    const uint8* SubresourceData(const Subresource& subresource)const { return mData + subresource.Offset; }
+
+    // True until Decompress for a compressed file.
+    bool IsCompressed()const { return !mChunks.empty(); }
+    const std::vector<Chunk>& GetChunks()const { return mChunks; }
+
+    ///<summary>
+    /// Decompresses one chunk into dst (chunk.Size bytes).  Returns false if the
+    /// chunk is damaged.
+    ///</summary>
+    bool DecompressChunk(const Chunk& chunk, uint8* dst)const;
+
+    ///<summary>
+    /// Decompresses all chunks, in parallel, into memory the DDSFile owns, which
+    /// then holds the file as an uncompressed DDS file.  Does nothing for a file
+    /// that is not compressed.
+    ///</summary>
+    Status Decompress();
+
+    // Bytes ParseHeader needs: the magic number, DDS_HEADER and DDS_HEADER_DXT10.
+    static const size_t MaxHeaderSize = 148;
+
+    ///<summary>
+    /// Validates a DDS file from its first bytes alone (at most MaxHeaderSize;
+    /// fewer if the file is shorter) and its total size, with the same checks
+    /// and results as Parse, without reading any texel data.  dataBytes receives
+    /// the size of all subresources.  The chunk table of a compressed file is not
+    /// read, so only Parse finds a damaged or truncated one.
+    ///</summary>
+    static Status ParseHeader(const uint8* data, size_t size, uint64 fileSize, Description& desc,
+        uint64* dataBytes = nullptr);
+
+    ///<summary>
+    /// Writes a DDS file with a DX10 header.  subresources holds one pointer per
+    /// subresource, in the order GetSubresources uses, each with the tightly packed
+    /// pitches GetSurfaceInfo gives.  The file is replaced atomically.
+    ///</summary>
+    static bool Save(const std::wstring& filename, const Description& desc,
+        const std::vector<const uint8*>& subresources);
+
+    // Same, into memory.
+    static bool Serialize(const Description& desc, const std::vector<const uint8*>& subresources,
+        std::vector<uint8>& file);
+
+    ///<summary>
+    /// Same as Save and Serialize, for the compressed variant.  Chunks that do not
+    /// get smaller are stored as they are.
+    ///</summary>
+    static bool SaveCompressed(const std::wstring& filename, const Description& desc,
+        const std::vector<const uint8*>& subresources, LZBlock::Level level = LZBlock::Level::High);
+    static bool SerializeCompressed(const Description& desc, const std::vector<const uint8*>& subresources,
+        std::vector<uint8>& file, LZBlock::Level level = LZBlock::Level::High);
+
+    ///<summary>
+    /// Bytes of one 2D surface of the given size, bytes per row and number of rows
+    /// (of blocks, for block compressed formats).
+    ///</summary>
+    static void GetSurfaceInfo(size_t width, size_t height, DXGI_FORMAT fmt,
+        size_t* outNumBytes, size_t* outRowBytes, size_t* outNumRows);
+
+    static size_t BitsPerPixel(DXGI_FORMAT fmt);
+    static DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& ddpf);
+    static DXGI_FORMAT MakeSRGB(DXGI_FORMAT format);
+
+private:
+    Status ParseData(const uint8* data, size_t size);
+
+    // The header checks; dataOffset receives where the texel data starts (in the
+    // uncompressed layout, for compressed files).
+    static Status ReadHeader(const uint8* data, size_t size, Description& desc, size_t& dataOffset,
+        bool& compressed);
+
+    // Walks the subresources of a file of fileSize bytes and checks they fit.
+    static Status Layout(const Description& desc, size_t dataOffset, uint64 fileSize,
+        std::vector<Subresource>* subresources, uint64* dataBytes);
+
+    // Reads and checks the chunk table that follows the headers.
+    Status ReadChunks(size_t dataOffset, uint64 dataBytes);
+
+private:
+    MappedFile mFile;
+    const uint8* mData = nullptr;
+    size_t mSize = 0;
+
+    Description mDesc;
+    std::vector<Subresource> mSubresources;
+    std::vector<Chunk> mChunks;
+
+    // The uncompressed file, after Decompress.
+    std::vector<uint8> mDecompressed;
+};
@@ -25,6 +25,8 @@
 #include <wrl.h>
 #include <d3d11_1.h>
 #include "d3dx12.h"
+#include <string>
+#include <vector>
 
 #pragma warning(push)
 #pragma warning(disable : 4005)
@@ -92,6 +94,17 @@ namespace DirectX
 		                               _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
 		                               );
 
+	// Loads every file with one shared upload buffer.  The files are parsed and laid
+	// out in parallel, the texel data is copied into uploadArena, and the copies and
+	// the transitions to PIXEL_SHADER_RESOURCE are recorded together.  Keep
+	// uploadArena alive until the command list has executed.  2D textures only.
+	HRESULT CreateDDSTexturesFromFiles12(_In_ ID3D12Device* device,
+		                                 _In_ ID3D12GraphicsCommandList* cmdList,
+		                                 _In_ const std::vector<std::wstring>& fileNames,
+		                                 _Out_ std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>>& textures,
+		                                 _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& uploadArena
+		                                 );
+
     // Standard version with optional auto-gen mipmap support
     HRESULT CreateDDSTextureFromMemory( _In_ ID3D11Device* d3dDevice,
                                         _In_opt_ ID3D11DeviceContext* d3dContext,
@@ -0,0 +1,260 @@
+//***************************************************************************************
+// FrustumCuller.cpp
+//***************************************************************************************
+
+#include "FrustumCuller.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <ppl.h>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = FrustumCuller::uint32;
+
+    // Extents of the padding boxes: every plane sees them as entirely outside.
+    const float EmptyExtent = -FLT_MAX;
+
+    void AppendVisible(uint32 mask, uint32 first, uint32* visible, uint32& count)
+    {
+        for(uint32 lane = first; mask != 0; ++lane, mask >>= 1)
+        {
+            if(mask & 1)
+                visible[count++] = lane;
+        }
+    }
+}
+
+void FrustumCuller::ExtractPlanes(FXMMATRIX viewProj, XMFLOAT4 planes[6])
+{
+    // With row vectors, clip = p*M, so each clip coordinate is p dotted with a
+    // column of M.  A point is inside when -w <= x <= w, -w <= y <= w and
+    // 0 <= z <= w.
+    XMMATRIX m = XMMatrixTranspose(viewProj);
+
+    XMVECTOR p[6];
+    p[0] = XMVectorAdd(m.r[3], m.r[0]);
+    p[1] = XMVectorSubtract(m.r[3], m.r[0]);
+    p[2] = XMVectorAdd(m.r[3], m.r[1]);
+    p[3] = XMVectorSubtract(m.r[3], m.r[1]);
+    p[4] = m.r[2];
+    p[5] = XMVectorSubtract(m.r[3], m.r[2]);
+
+    for(int i = 0; i < 6; ++i)
+        XMStoreFloat4(&planes[i], XMPlaneNormalize(p[i]));
+}
+
+void FrustumCuller::Resize(uint32 count)
+{
+    const size_t padded = ((size_t)count + GroupSize - 1) / GroupSize * GroupSize;
+
+    // Boxes past the old count, and the padding, become empty.
+    for(size_t i = count; i < mCount && i < mExtentX.size(); ++i)
+        mExtentX[i] = mExtentY[i] = mExtentZ[i] = EmptyExtent;
+
+    mCenterX.resize(padded, 0.0f);
+    mCenterY.resize(padded, 0.0f);
+    mCenterZ.resize(padded, 0.0f);
+    mExtentX.resize(padded, EmptyExtent);
+    mExtentY.resize(padded, EmptyExtent);
+    mExtentZ.resize(padded, EmptyExtent);
+
+    mCount = count;
+}
+
+void FrustumCuller::SetBounds(uint32 index, const BoundingBox& worldBounds)
+{
+    mCenterX[index] = worldBounds.Center.x;
+    mCenterY[index] = worldBounds.Center.y;
+    mCenterZ[index] = worldBounds.Center.z;
+    mExtentX[index] = worldBounds.Extents.x;
+    mExtentY[index] = worldBounds.Extents.y;
+    mExtentZ[index] = worldBounds.Extents.z;
+}
+
+void FrustumCuller::SetBounds(uint32 index, const BoundingBox& localBounds, FXMMATRIX world)
+{
+    // The world extents along each axis are the sums of the local extents
+    // projected onto it.
+    const XMVECTOR center = XMVector3Transform(XMLoadFloat3(&localBounds.Center), world);
+
+    XMVECTOR extents = XMVectorMultiply(XMVectorAbs(world.r[0]), XMVectorReplicate(localBounds.Extents.x));
+    extents = XMVectorMultiplyAdd(XMVectorAbs(world.r[1]), XMVectorReplicate(localBounds.Extents.y), extents);
+    extents = XMVectorMultiplyAdd(XMVectorAbs(world.r[2]), XMVectorReplicate(localBounds.Extents.z), extents);
+
+    BoundingBox worldBounds;
+    XMStoreFloat3(&worldBounds.Center, center);
+    XMStoreFloat3(&worldBounds.Extents, extents);
+    SetBounds(index, worldBounds);
+}
+
+BoundingBox FrustumCuller::GetBounds(uint32 index)const
+{
+    return BoundingBox(
+        XMFLOAT3(mCenterX[index], mCenterY[index], mCenterZ[index]),
+        XMFLOAT3(mExtentX[index], mExtentY[index], mExtentZ[index]));
+}
+
+uint32 FrustumCuller::Cull(const XMFLOAT4 planes[6], uint32* visible)const
+{
+    return CullRange(planes, 0, (uint32)mCenterX.size(), visible);
+}
+
+uint32 FrustumCuller::CullParallel(const XMFLOAT4 planes[6], uint32* visible, const WriteFunction& write)
+{
+    const uint32 padded = (uint32)mCenterX.size();
+    const uint32 chunkCount = (padded + ChunkSize - 1) / ChunkSize;
+
+    if(chunkCount <= 1)
+    {
+        const uint32 count = Cull(planes, visible);
+        if(write && count > 0)
+            write(0, visible, count);
+        return count;
+    }
+
+    //
+    // Each chunk culls into its own range of the scratch indices and counts; a
+    // prefix sum of the counts then gives every chunk its place in the output,
+    // so the chunks copy and write in parallel, without locks, in the same
+    // order Cull gives.
+    //
+
+    mChunkVisible.resize(padded);
+    mChunkOffsets.resize(chunkCount + 1);
+    mChunkOffsets[0] = 0;
+
+    concurrency::parallel_for(0u, chunkCount, [&](uint32 chunk)
+    {
+        const uint32 first = chunk*ChunkSize;
+        const uint32 last = std::min(first + ChunkSize, padded);
+        mChunkOffsets[chunk + 1] = CullRange(planes, first, last, mChunkVisible.data() + first);
+    });
+
+    for(uint32 chunk = 0; chunk < chunkCount; ++chunk)
+        mChunkOffsets[chunk + 1] += mChunkOffsets[chunk];
+
+    concurrency::parallel_for(0u, chunkCount, [&](uint32 chunk)
+    {
+        const uint32 offset = mChunkOffsets[chunk];
+        const uint32 count = mChunkOffsets[chunk + 1] - offset;
+        if(count == 0)
+            return;
+
+        std::memcpy(visible + offset, mChunkVisible.data() + chunk*ChunkSize, count*sizeof(uint32));
+        if(write)
+            write(offset, visible + offset, count);
+    });
+
+    return mChunkOffsets[chunkCount];
+}
+
+uint32 FrustumCuller::CullRange(const XMFLOAT4 planes[6], uint32 first, uint32 last, uint32* visible)const
+{
+    //
+    // A box is outside a plane when its center is further behind the plane than
+    // its projected radius, |a|*ex + |b|*ey + |c|*ez.
+    //
+
+    uint32 count = 0;
+
+#if defined(_XM_AVX_INTRINSICS_)
+    __m256 a[6], b[6], c[6], d[6], absA[6], absB[6], absC[6];
+    for(int p = 0; p < 6; ++p)
+    {
+        a[p] = _mm256_set1_ps(planes[p].x);
+        b[p] = _mm256_set1_ps(planes[p].y);
+        c[p] = _mm256_set1_ps(planes[p].z);
+        d[p] = _mm256_set1_ps(planes[p].w);
+        absA[p] = _mm256_set1_ps(std::fabs(planes[p].x));
+        absB[p] = _mm256_set1_ps(std::fabs(planes[p].y));
+        absC[p] = _mm256_set1_ps(std::fabs(planes[p].z));
+    }
+
+    const __m256 zero = _mm256_setzero_ps();
+    for(uint32 i = first; i < last; i += 8)
+    {
+        const __m256 cx = _mm256_loadu_ps(&mCenterX[i]);
+        const __m256 cy = _mm256_loadu_ps(&mCenterY[i]);
+        const __m256 cz = _mm256_loadu_ps(&mCenterZ[i]);
+        const __m256 ex = _mm256_loadu_ps(&mExtentX[i]);
+        const __m256 ey = _mm256_loadu_ps(&mExtentY[i]);
+        const __m256 ez = _mm256_loadu_ps(&mExtentZ[i]);
+
+        __m256 outside = zero;
+        for(int p = 0; p < 6; ++p)
+        {
+            __m256 dist = _mm256_add_ps(_mm256_mul_ps(a[p], cx), d[p]);
+            dist = _mm256_add_ps(_mm256_mul_ps(b[p], cy), dist);
+            dist = _mm256_add_ps(_mm256_mul_ps(c[p], cz), dist);
+
+            __m256 radius = _mm256_mul_ps(absA[p], ex);
+            radius = _mm256_add_ps(_mm256_mul_ps(absB[p], ey), radius);
+            radius = _mm256_add_ps(_mm256_mul_ps(absC[p], ez), radius);
+
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(dist, radius), zero, _CMP_LT_OQ));
+        }
+
+        AppendVisible(~_mm256_movemask_ps(outside) & 0xff, i, visible, count);
+    }
+#elif defined(_XM_SSE_INTRINSICS_)
+    __m128 a[6], b[6], c[6], d[6], absA[6], absB[6], absC[6];
+    for(int p = 0; p < 6; ++p)
+    {
+        a[p] = _mm_set1_ps(planes[p].x);
+        b[p] = _mm_set1_ps(planes[p].y);
+        c[p] = _mm_set1_ps(planes[p].z);
+        d[p] = _mm_set1_ps(planes[p].w);
+        absA[p] = _mm_set1_ps(std::fabs(planes[p].x));
+        absB[p] = _mm_set1_ps(std::fabs(planes[p].y));
+        absC[p] = _mm_set1_ps(std::fabs(planes[p].z));
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    for(uint32 i = first; i < last; i += 4)
+    {
+        const __m128 cx = _mm_loadu_ps(&mCenterX[i]);
+        const __m128 cy = _mm_loadu_ps(&mCenterY[i]);
+        const __m128 cz = _mm_loadu_ps(&mCenterZ[i]);
+        const __m128 ex = _mm_loadu_ps(&mExtentX[i]);
+        const __m128 ey = _mm_loadu_ps(&mExtentY[i]);
+        const __m128 ez = _mm_loadu_ps(&mExtentZ[i]);
+
+        __m128 outside = zero;
+        for(int p = 0; p < 6; ++p)
+        {
+            __m128 dist = _mm_add_ps(_mm_mul_ps(a[p], cx), d[p]);
+            dist = _mm_add_ps(_mm_mul_ps(b[p], cy), dist);
+            dist = _mm_add_ps(_mm_mul_ps(c[p], cz), dist);
+
+            __m128 radius = _mm_mul_ps(absA[p], ex);
+            radius = _mm_add_ps(_mm_mul_ps(absB[p], ey), radius);
+            radius = _mm_add_ps(_mm_mul_ps(absC[p], ez), radius);
+
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), zero));
+        }
+
+        AppendVisible(~_mm_movemask_ps(outside) & 0xf, i, visible, count);
+    }
+#else
+    for(uint32 i = first; i < last; ++i)
+    {
+        bool outside = false;
+        for(int p = 0; p < 6 && !outside; ++p)
+        {
+            const float dist = planes[p].x*mCenterX[i] + planes[p].y*mCenterY[i] + planes[p].z*mCenterZ[i] + planes[p].w;
+            const float radius = std::fabs(planes[p].x)*mExtentX[i] + std::fabs(planes[p].y)*mExtentY[i] +
+                std::fabs(planes[p].z)*mExtentZ[i];
+            outside = dist + radius < 0.0f;
+        }
+
+        if(!outside)
+            visible[count++] = i;
+    }
+#endif
+
+    return count;
+}
@@ -0,0 +1,95 @@
+//***************************************************************************************
+// FrustumCuller.h
+//
+// Frustum culling of many instances against world-space planes.
+//
+// The classic way (Chapter 16) inverts every instance's world matrix and brings
+// the camera frustum into the instance's local space before each test.  Here the
+// world-space bounding box of every instance is computed once, when the instance
+// is placed, and the six frustum planes are extracted from the view-projection
+// matrix once per frame.  The boxes are kept as separate arrays of center and
+// extent components, so the test runs on 8 boxes per AVX instruction (4 with
+// SSE) with no per-instance matrix work at all.
+//
+// The world box of a rotated instance encloses its oriented box, so such an
+// instance can be kept where the local-space test would cull it; the test never
+// culls anything visible.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class FrustumCuller
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+    // Boxes are processed in groups of this many; the arrays are padded to it.
+    static const uint32 GroupSize = 8;
+
+    // Boxes per work item of CullParallel (a multiple of GroupSize).
+    static const uint32 ChunkSize = 16384;
+
+    // Receives the visible boxes indices[0..count) that go to positions
+    // first..first + count - 1 of the output.
+    using WriteFunction = std::function<void(uint32 first, const uint32* indices, uint32 count)>;
+
+    ///<summary>
+    /// The left, right, bottom, top, near and far planes (a, b, c, d with
+    /// ax + by + cz + d >= 0 inside, (a, b, c) normalized) of a view-projection
+    /// matrix.  Planes from a projection matrix alone are in view space.
+    ///</summary>
+    static void ExtractPlanes(DirectX::FXMMATRIX viewProj, DirectX::XMFLOAT4 planes[6]);
+
+    // Sets the number of boxes.  New boxes are empty and never visible.
+    void Resize(uint32 count);
+    uint32 Count()const { return mCount; }
+
+    void SetBounds(uint32 index, const DirectX::BoundingBox& worldBounds);
+
+    // The world box of localBounds transformed by world.
+    void SetBounds(uint32 index, const DirectX::BoundingBox& localBounds, DirectX::FXMMATRIX world);
+
+    DirectX::BoundingBox GetBounds(uint32 index)const;
+
+    ///<summary>
+    /// Writes the indices of the boxes that are not entirely outside one of the
+    /// planes, in increasing order, and returns how many there are.  visible must
+    /// have room for Count() indices.
+    ///</summary>
+    uint32 Cull(const DirectX::XMFLOAT4 planes[6], uint32* visible)const;
+
+    ///<summary>
+    /// Same as Cull, split across threads in chunks of ChunkSize boxes.  write,
+    /// if given, is called once per chunk with visible boxes, from several
+    /// threads at once, so each chunk can write its instances straight to their
+    /// place in an upload buffer.  Uses scratch memory of the culler, so only one
+    /// CullParallel per culler can run at a time.
+    ///</summary>
+    uint32 CullParallel(const DirectX::XMFLOAT4 planes[6], uint32* visible, const WriteFunction& write = nullptr);
+
+private:
+    // Culls boxes first..last - 1 (multiples of GroupSize, padding included).
+    uint32 CullRange(const DirectX::XMFLOAT4 planes[6], uint32 first, uint32 last, uint32* visible)const;
+
+private:
+    uint32 mCount = 0;
+
+    // Padded to a multiple of GroupSize with empty boxes.
+    std::vector<float> mCenterX;
+    std::vector<float> mCenterY;
+    std::vector<float> mCenterZ;
+    std::vector<float> mExtentX;
+    std::vector<float> mExtentY;
+    std::vector<float> mExtentZ;
+
+    // CullParallel's visible boxes per chunk, at the chunk's first box, and
+    // where each chunk's boxes start in the output.
+    std::vector<uint32> mChunkVisible;
+    std::vector<uint32> mChunkOffsets;
+};
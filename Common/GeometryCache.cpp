@@ -0,0 +1,148 @@
+//***************************************************************************************
+// GeometryCache.cpp
+//***************************************************************************************
+
+#include "GeometryCache.h"
+#include <cstring>
+
+namespace
+{
+    using uint32 = GeometryCache::uint32;
+    using uint64 = GeometryCache::uint64;
+
+    const uint32 FileMagic = 0x4f454743; // "CGEO"
+
+    // FNV-1a.
+    const uint64 HashOffset = 0xcbf29ce484222325ull;
+    const uint64 HashPrime = 0x100000001b3ull;
+
+    struct FileHeader
+    {
+        uint32 Magic;
+        uint32 FormatVersion;
+        uint64 KeyHash;
+        uint32 VertexStride;
+        uint32 VertexCount;
+        uint32 IndexCount;
+        uint32 Reserved;
+    };
+
+    static_assert(sizeof(FileHeader) == 32, "The header keeps the vertex data 16 byte aligned.");
+
+    uint64 IndexOffset(uint32 vertexStride, uint32 vertexCount)
+    {
+        uint64 offset = sizeof(FileHeader) + (uint64)vertexStride*vertexCount;
+        return (offset + 3) & ~3ull;
+    }
+}
+
+GeometryCache::Key::Key(const char* stage, uint32 version) :
+    mHash(HashOffset)
+{
+    Add(stage);
+    Add(version);
+}
+
+GeometryCache::Key& GeometryCache::Key::Add(const void* data, size_t size)
+{
+    const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+    for(size_t i = 0; i < size; ++i)
+    {
+        mHash ^= bytes[i];
+        mHash *= HashPrime;
+    }
+
+    return *this;
+}
+
+GeometryCache::Key& GeometryCache::Key::Add(const char* text)
+{
+    // Include the terminator so ("ab", "c") and ("a", "bc") differ.
+    return Add(text, std::strlen(text) + 1);
+}
+
+GeometryCache::GeometryCache(const std::wstring& directory) :
+    mDirectory(directory)
+{
+    mEnabled = MappedFile::MakeDirectory(mDirectory);
+}
+
+std::wstring GeometryCache::FileName(const Key& key)const
+{
+    static const wchar_t digits[] = L"0123456789abcdef";
+
+    std::wstring name = mDirectory + L"/";
+    for(int shift = 60; shift >= 0; shift -= 4)
+        name += digits[(key.Hash() >> shift) & 0xf];
+    name += L".geo";
+
+    return name;
+}
+
+bool GeometryCache::Open(const Key& key, uint32 vertexStride, Entry& entry)const
+{
+    entry.Close();
+
+    if(!mEnabled || !entry.mFile.Open(FileName(key)))
+        return false;
+
+    const MappedFile& file = entry.mFile;
+
+    FileHeader header;
+    if(file.Size() < sizeof(FileHeader))
+    {
+        entry.Close();
+        return false;
+    }
+    std::memcpy(&header, file.Data(), sizeof(FileHeader));
+
+    const uint64 indexOffset = IndexOffset(header.VertexStride, header.VertexCount);
+    const uint64 expectedSize = indexOffset + (uint64)header.IndexCount*sizeof(uint32);
+
+    if(header.Magic != FileMagic ||
+       header.FormatVersion != FormatVersion ||
+       header.KeyHash != key.Hash() ||
+       header.VertexStride != vertexStride ||
+       file.Size() != expectedSize)
+    {
+        entry.Close();
+        return false;
+    }
+
+    entry.mVertices = file.Data() + sizeof(FileHeader);
+    entry.mIndices = reinterpret_cast<const uint32*>(file.Data() + indexOffset);
+    entry.mVertexStride = header.VertexStride;
+    entry.mVertexCount = header.VertexCount;
+    entry.mIndexCount = header.IndexCount;
+
+    return true;
+}
+
+bool GeometryCache::Store(const Key& key, const void* vertices, uint32 vertexStride, uint32 vertexCount,
+    const uint32* indices, uint32 indexCount)const
+{
+    if(!mEnabled)
+        return false;
+
+    FileHeader header;
+    header.Magic = FileMagic;
+    header.FormatVersion = FormatVersion;
+    header.KeyHash = key.Hash();
+    header.VertexStride = vertexStride;
+    header.VertexCount = vertexCount;
+    header.IndexCount = indexCount;
+    header.Reserved = 0;
+
+    const uint64 indexOffset = IndexOffset(vertexStride, vertexCount);
+    const uint64 vertexBytes = (uint64)vertexStride*vertexCount;
+    const uint64 indexBytes = (uint64)indexCount*sizeof(uint32);
+
+    std::vector<std::uint8_t> data((size_t)(indexOffset + indexBytes), 0);
+    std::memcpy(data.data(), &header, sizeof(header));
+    if(vertexBytes > 0)
+        std::memcpy(data.data() + sizeof(header), vertices, (size_t)vertexBytes);
+    if(indexBytes > 0)
+        std::memcpy(data.data() + indexOffset, indices, (size_t)indexBytes);
+
+    return MappedFile::WriteAtomic(FileName(key), data.data(), data.size());
+}
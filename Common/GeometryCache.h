@@ -0,0 +1,128 @@
+//***************************************************************************************
+// GeometryCache.h
+//
+// An on-disk cache for meshes that are the same on every run: generator output
+// (CreateGrid, CreateGeosphere, ...), terrain built from a height function, and
+// anything derived from those (optimized, simplified or quantized versions).
+//
+// A mesh is stored under the hash of a Key, which covers the name and version of
+// the stage that produced it, its parameters and the key of its input mesh.
+// Bumping a stage's version (e.g., GeometryGenerator::Version) changes the key of
+// everything built from it, so stale entries are never found.  Files are replaced
+// atomically and checked (magic, format version, key, vertex stride and size)
+// before use; a file that fails the checks is rebuilt.
+//
+// Entries are memory mapped, so a warm start reads only the pages it touches.
+//***************************************************************************************
+
+#pragma once
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class GeometryCache
+{
+public:
+
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    // Bump when the file layout below changes.
+    static const uint32 FormatVersion = 1;
+
+    class Key
+    {
+    public:
+        Key(const char* stage, uint32 version);
+
+        Key& Add(const void* data, size_t size);
+        Key& Add(const char* text);
+        Key& Add(float value) { return Add(&value, sizeof(value)); }
+        Key& Add(uint32 value) { return Add(&value, sizeof(value)); }
+
+        // Chains a derived stage to the mesh it was computed from.
+        Key& Add(const Key& input) { return Add(&input.mHash, sizeof(input.mHash)); }
+
+        uint64 Hash()const { return mHash; }
+
+    private:
+        uint64 mHash;
+    };
+
+    // A cached mesh, read straight from the mapped file.
+    class Entry
+    {
+    public:
+        const void* Vertices()const { return mVertices; }
+        const uint32* Indices()const { return mIndices; }
+        uint32 VertexStride()const { return mVertexStride; }
+        uint32 VertexCount()const { return mVertexCount; }
+        uint32 IndexCount()const { return mIndexCount; }
+
+        bool IsValid()const { return mFile.IsOpen(); }
+        void Close() { mFile.Close(); }
+
+    private:
+        friend class GeometryCache;
+
+        MappedFile mFile;
+        const void* mVertices = nullptr;
+        const uint32* mIndices = nullptr;
+        uint32 mVertexStride = 0;
+        uint32 mVertexCount = 0;
+        uint32 mIndexCount = 0;
+    };
+
+    ///<summary>
+    /// The directory is created if needed.  If it cannot be created the cache is
+    /// disabled: nothing is found and nothing is stored.
+    ///</summary>
+    explicit GeometryCache(const std::wstring& directory = L"GeometryCache");
+
+    bool IsEnabled()const { return mEnabled; }
+
+    ///<summary>
+    /// Maps the entry for key.  Returns false if there is none, or if it does not
+    /// pass the checks.
+    ///</summary>
+    bool Open(const Key& key, uint32 vertexStride, Entry& entry)const;
+
+    bool Store(const Key& key, const void* vertices, uint32 vertexStride, uint32 vertexCount,
+        const uint32* indices, uint32 indexCount)const;
+
+    ///<summary>
+    /// Loads the mesh for key, or calls generate(vertices, indices) and stores what
+    /// it produces.  Returns true if the mesh came from the cache.  VertexT must be
+    /// trivially copyable.
+    ///</summary>
+    template<typename VertexT, typename Generator>
+    bool GetOrCreate(const Key& key, std::vector<VertexT>& vertices, std::vector<uint32>& indices,
+        Generator generate)const
+    {
+        Entry entry;
+        if(Open(key, sizeof(VertexT), entry))
+        {
+            const VertexT* v = static_cast<const VertexT*>(entry.Vertices());
+            vertices.assign(v, v + entry.VertexCount());
+            indices.assign(entry.Indices(), entry.Indices() + entry.IndexCount());
+            return true;
+        }
+
+        vertices.clear();
+        indices.clear();
+        generate(vertices, indices);
+
+        Store(key, vertices.data(), sizeof(VertexT), (uint32)vertices.size(),
+            indices.data(), (uint32)indices.size());
+
+        return false;
+    }
+
+    std::wstring FileName(const Key& key)const;
+
+private:
+    std::wstring mDirectory;
+    bool mEnabled = false;
+};
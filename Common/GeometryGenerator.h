@@ -14,6 +14,9 @@
 
 #pragma once
 
+#include "CompactIndices.h"
+#include "MeshUtil.h"
+#include <algorithm>
 #include <cstdint>
 #include <DirectXMath.h>
 #include <vector>
@@ -25,6 +28,10 @@ public:
     using uint16 = std::uint16_t;
     using uint32 = std::uint32_t;
 
+    // Bump whenever a generator starts producing different geometry, so meshes
+    // cached on disk (see GeometryCache) are rebuilt.
+    static const uint32 Version = 1;
+
 	struct Vertex
 	{
 		Vertex(){}
@@ -58,6 +65,8 @@ public:
 		std::vector<Vertex> Vertices;
         std::vector<uint32> Indices32;
 
+        // Keeps a 16-bit copy alongside Indices32 for the lifetime of the mesh.  Use
+        // ReleaseIndices() to end up with a single buffer instead.
         std::vector<uint16>& GetIndices16()
         {
 			if(mIndices16.empty())
@@ -70,10 +79,52 @@ public:
 			return mIndices16;
         }
 
+        ///<summary>
+        /// Moves Indices32 into a CompactIndices buffer that is narrowed to 16 bits
+        /// in place when the indices fit.  Indices32 is left empty.
+        ///</summary>
+        CompactIndices ReleaseIndices(CompactIndices::Topology topology = CompactIndices::Topology::TriangleList)
+        {
+            std::vector<uint16>().swap(mIndices16);
+            return CompactIndices(std::move(Indices32), topology);
+        }
+
 	private:
 		std::vector<uint16> mIndices16;
 	};
 
+    ///<summary>
+    /// Describes where the templated Create* functions write each attribute in an
+    /// application vertex.  Attributes whose member is null are never computed, so
+    /// an app that only needs positions and normals pays for nothing else, e.g.,
+    ///   using ShapeVertexTraits = GeometryGenerator::VertexTraits<Vertex, &Vertex::Pos, &Vertex::Normal>;
+    ///</summary>
+    template<typename VertexT,
+             DirectX::XMFLOAT3 VertexT::* PositionMember,
+             DirectX::XMFLOAT3 VertexT::* NormalMember = nullptr,
+             DirectX::XMFLOAT2 VertexT::* TexCMember = nullptr,
+             DirectX::XMFLOAT3 VertexT::* TangentUMember = nullptr>
+    struct VertexTraits
+    {
+        using VertexType = VertexT;
+
+        static const bool HasNormal = NormalMember != nullptr;
+        static const bool HasTexC = TexCMember != nullptr;
+        static const bool HasTangentU = TangentUMember != nullptr;
+
+        static const DirectX::XMFLOAT3& GetPosition(const VertexT& v) { return v.*PositionMember; }
+        static const DirectX::XMFLOAT3& GetNormal(const VertexT& v) { return v.*NormalMember; }
+        static const DirectX::XMFLOAT2& GetTexC(const VertexT& v) { return v.*TexCMember; }
+        static const DirectX::XMFLOAT3& GetTangentU(const VertexT& v) { return v.*TangentUMember; }
+
+        static void SetPosition(VertexT& v, const DirectX::XMFLOAT3& p) { v.*PositionMember = p; }
+        static void SetNormal(VertexT& v, const DirectX::XMFLOAT3& n) { v.*NormalMember = n; }
+        static void SetTexC(VertexT& v, const DirectX::XMFLOAT2& uv) { v.*TexCMember = uv; }
+        static void SetTangentU(VertexT& v, const DirectX::XMFLOAT3& t) { v.*TangentUMember = t; }
+    };
+
+    using MeshVertexTraits = VertexTraits<Vertex, &Vertex::Position, &Vertex::Normal, &Vertex::TexC, &Vertex::TangentU>;
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions, where each
     /// face has m rows and n columns of vertices.
@@ -110,10 +161,737 @@ public:
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
 
+    ///<summary>
+    /// The same shapes written straight into an application's vertex and index
+    /// arrays, skipping the intermediate MeshData.  The vertices and indices are
+    /// appended; the indices are relative to the first appended vertex, so the mesh
+    /// is drawn with BaseVertexLocation set to the vertex count before the call.
+    /// IndexT may be uint16 as long as the mesh has fewer than 65536 vertices.
+    ///</summary>
+    template<typename Traits, typename IndexT>
+    void CreateBox(float width, float height, float depth, uint32 numSubdivisions,
+        std::vector<typename Traits::VertexType>& vertices, std::vector<IndexT>& indices);
+
+    template<typename Traits, typename IndexT>
+    void CreateSphere(float radius, uint32 sliceCount, uint32 stackCount,
+        std::vector<typename Traits::VertexType>& vertices, std::vector<IndexT>& indices);
+
+    template<typename Traits, typename IndexT>
+    void CreateGeosphere(float radius, uint32 numSubdivisions,
+        std::vector<typename Traits::VertexType>& vertices, std::vector<IndexT>& indices);
+
+    template<typename Traits, typename IndexT>
+    void CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
+        std::vector<typename Traits::VertexType>& vertices, std::vector<IndexT>& indices);
+
+    template<typename Traits, typename IndexT>
+    void CreateGrid(float width, float depth, uint32 m, uint32 n,
+        std::vector<typename Traits::VertexType>& vertices, std::vector<IndexT>& indices);
+
+    template<typename Traits, typename IndexT>
+    void CreateQuad(float x, float y, float w, float h, float depth,
+        std::vector<typename Traits::VertexType>& vertices, std::vector<IndexT>& indices);
+
 private:
-	void Subdivide(MeshData& meshData);
-    Vertex MidPoint(const Vertex& v0, const Vertex& v1);
+    struct PositionVertex
+    {
+        DirectX::XMFLOAT3 Position;
+    };
+
+    using PositionTraits = VertexTraits<PositionVertex, &PositionVertex::Position>;
+
+    template<typename Traits>
+    static void SetVertex(typename Traits::VertexType& vertex,
+        float px, float py, float pz,
+        float nx, float ny, float nz,
+        float tx, float ty, float tz,
+        float u, float v);
+
+    template<typename Traits>
+    static void AddVertex(std::vector<typename Traits::VertexType>& vertices,
+        float px, float py, float pz,
+        float nx, float ny, float nz,
+        float tx, float ty, float tz,
+        float u, float v);
+
+    template<typename Traits, typename IndexT>
+    void Subdivide(std::vector<typename Traits::VertexType>& vertices, std::vector<IndexT>& indices,
+        size_t baseVertex, size_t baseIndex);
+
+    template<typename Traits>
+    typename Traits::VertexType MidPoint(const typename Traits::VertexType& v0, const typename Traits::VertexType& v1);
+
     void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
     void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
 };
 
+
+//
+// Template definitions.
+//
+
+template<typename Traits>
+void GeometryGenerator::SetVertex(typename Traits::VertexType& vertex,
+    float px, float py, float pz,
+    float nx, float ny, float nz,
+    float tx, float ty, float tz,
+    float u, float v)
+{
+    Traits::SetPosition(vertex, DirectX::XMFLOAT3(px, py, pz));
+    if(Traits::HasNormal)
+        Traits::SetNormal(vertex, DirectX::XMFLOAT3(nx, ny, nz));
+    if(Traits::HasTangentU)
+        Traits::SetTangentU(vertex, DirectX::XMFLOAT3(tx, ty, tz));
+    if(Traits::HasTexC)
+        Traits::SetTexC(vertex, DirectX::XMFLOAT2(u, v));
+}
+
+template<typename Traits>
+void GeometryGenerator::AddVertex(std::vector<typename Traits::VertexType>& vertices,
+    float px, float py, float pz,
+    float nx, float ny, float nz,
+    float tx, float ty, float tz,
+    float u, float v)
+{
+    typename Traits::VertexType vertex;
+    SetVertex<Traits>(vertex, px, py, pz, nx, ny, nz, tx, ty, tz, u, v);
+    vertices.push_back(vertex);
+}
+
+template<typename Traits, typename IndexT>
+void GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions,
+    std::vector<typename Traits::VertexType>& vertices, std::vector<IndexT>& indices)
+{
+    const size_t baseVertex = vertices.size();
+    const size_t baseIndex = indices.size();
+
+    //
+    // Create the vertices.
+    //
+
+    float w2 = 0.5f*width;
+    float h2 = 0.5f*height;
+    float d2 = 0.5f*depth;
+
+    // Fill in the front face vertex data.
+    AddVertex<Traits>(vertices, -w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    AddVertex<Traits>(vertices, -w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    AddVertex<Traits>(vertices, +w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+    AddVertex<Traits>(vertices, +w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+
+    // Fill in the back face vertex data.
+    AddVertex<Traits>(vertices, -w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+    AddVertex<Traits>(vertices, +w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    AddVertex<Traits>(vertices, +w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    AddVertex<Traits>(vertices, -w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+
+    // Fill in the top face vertex data.
+    AddVertex<Traits>(vertices, -w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    AddVertex<Traits>(vertices, -w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    AddVertex<Traits>(vertices, +w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+    AddVertex<Traits>(vertices, +w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+
+    // Fill in the bottom face vertex data.
+    AddVertex<Traits>(vertices, -w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+    AddVertex<Traits>(vertices, +w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    AddVertex<Traits>(vertices, +w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    AddVertex<Traits>(vertices, -w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+
+    // Fill in the left face vertex data.
+    AddVertex<Traits>(vertices, -w2, -h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f);
+    AddVertex<Traits>(vertices, -w2, +h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f);
+    AddVertex<Traits>(vertices, -w2, +h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f);
+    AddVertex<Traits>(vertices, -w2, -h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f);
+
+    // Fill in the right face vertex data.
+    AddVertex<Traits>(vertices, +w2, -h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f);
+    AddVertex<Traits>(vertices, +w2, +h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+    AddVertex<Traits>(vertices, +w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
+    AddVertex<Traits>(vertices, +w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
+
+    //
+    // Create the indices.  Every face is the quad (k, k+1, k+2, k+3).
+    //
+
+    for(uint32 k = 0; k < 24; k += 4)
+    {
+        indices.push_back(static_cast<IndexT>(k));
+        indices.push_back(static_cast<IndexT>(k+1));
+        indices.push_back(static_cast<IndexT>(k+2));
+
+        indices.push_back(static_cast<IndexT>(k));
+        indices.push_back(static_cast<IndexT>(k+2));
+        indices.push_back(static_cast<IndexT>(k+3));
+    }
+
+    // Put a cap on the number of subdivisions.
+    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+
+    for(uint32 i = 0; i < numSubdivisions; ++i)
+        Subdivide<Traits>(vertices, indices, baseVertex, baseIndex);
+}
+
+template<typename Traits, typename IndexT>
+void GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount,
+    std::vector<typename Traits::VertexType>& vertices, std::vector<IndexT>& indices)
+{
+    using namespace DirectX;
+
+    typedef typename Traits::VertexType VertexT;
+
+    uint32 ringVertexCount = sliceCount + 1;
+    uint32 ringCount = stackCount - 1;
+
+    const size_t baseVertex = vertices.size();
+    vertices.resize(baseVertex + 2 + ringCount*ringVertexCount);
+    VertexT* v = vertices.data() + baseVertex;
+
+    //
+    // Compute the vertices stating at the top pole and moving down the stacks.
+    //
+
+    // Poles: note that there will be texture coordinate distortion as there is
+    // not a unique point on the texture map to assign to the pole when mapping
+    // a rectangular texture onto a sphere.
+    SetVertex<Traits>(v[0], 0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    SetVertex<Traits>(v[1 + ringCount*ringVertexCount],
+        0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+
+    float phiStep   = XM_PI/stackCount;
+    float thetaStep = 2.0f*XM_PI/sliceCount;
+
+    // Every vertex of a column shares theta, so evaluate its sine and cosine once
+    // per column instead of once per vertex.
+    std::vector<float> sinTheta(ringVertexCount);
+    std::vector<float> cosTheta(ringVertexCount);
+    for(uint32 j = 0; j <= sliceCount; ++j)
+    {
+        sinTheta[j] = sinf(j*thetaStep);
+        cosTheta[j] = cosf(j*thetaStep);
+    }
+
+    // Compute vertices for each stack ring (do not count the poles as rings).
+    MeshUtil::ParallelFor(ringCount, ringVertexCount, [&](uint32 ring)
+    {
+        uint32 i = ring + 1;
+        float phi = i*phiStep;
+        float sinPhi = sinf(phi);
+        float cosPhi = cosf(phi);
+
+        // Vertices of ring.
+        VertexT* ringVertices = v + 1 + ring*ringVertexCount;
+        for(uint32 j = 0; j <= sliceCount; ++j)
+        {
+            float theta = j*thetaStep;
+
+            // spherical to cartesian
+            XMFLOAT3 position;
+            position.x = radius*sinPhi*cosTheta[j];
+            position.y = radius*cosPhi;
+            position.z = radius*sinPhi*sinTheta[j];
+            Traits::SetPosition(ringVertices[j], position);
+
+            if(Traits::HasTangentU)
+            {
+                // Partial derivative of P with respect to theta
+                XMFLOAT3 tangentU;
+                tangentU.x = -radius*sinPhi*sinTheta[j];
+                tangentU.y = 0.0f;
+                tangentU.z = +radius*sinPhi*cosTheta[j];
+
+                XMStoreFloat3(&tangentU, XMVector3Normalize(XMLoadFloat3(&tangentU)));
+                Traits::SetTangentU(ringVertices[j], tangentU);
+            }
+
+            if(Traits::HasNormal)
+            {
+                XMFLOAT3 normal;
+                XMStoreFloat3(&normal, XMVector3Normalize(XMLoadFloat3(&position)));
+                Traits::SetNormal(ringVertices[j], normal);
+            }
+
+            if(Traits::HasTexC)
+                Traits::SetTexC(ringVertices[j], XMFLOAT2(theta / XM_2PI, phi / XM_PI));
+        }
+    });
+
+    const size_t baseIndex = indices.size();
+    indices.resize(baseIndex + 6*sliceCount*ringCount);
+    IndexT* k = indices.data() + baseIndex;
+
+    //
+    // Compute indices for top stack.  The top stack was written first to the vertex buffer
+    // and connects the top pole to the first ring.
+    //
+
+    for(uint32 i = 1; i <= sliceCount; ++i)
+    {
+        *k++ = static_cast<IndexT>(0);
+        *k++ = static_cast<IndexT>(i+1);
+        *k++ = static_cast<IndexT>(i);
+    }
+
+    //
+    // Compute indices for inner stacks (not connected to poles).
+    //
+
+    // Offset the indices to the index of the first vertex in the first ring.
+    // This is just skipping the top pole vertex.
+    uint32 baseIndexValue = 1;
+    IndexT* innerIndices = k;
+    MeshUtil::ParallelFor(stackCount-2, 6*sliceCount, [&](uint32 i)
+    {
+        IndexT* q = innerIndices + 6*sliceCount*i;
+        for(uint32 j = 0; j < sliceCount; ++j)
+        {
+            *q++ = static_cast<IndexT>(baseIndexValue + i*ringVertexCount + j);
+            *q++ = static_cast<IndexT>(baseIndexValue + i*ringVertexCount + j+1);
+            *q++ = static_cast<IndexT>(baseIndexValue + (i+1)*ringVertexCount + j);
+
+            *q++ = static_cast<IndexT>(baseIndexValue + (i+1)*ringVertexCount + j);
+            *q++ = static_cast<IndexT>(baseIndexValue + i*ringVertexCount + j+1);
+            *q++ = static_cast<IndexT>(baseIndexValue + (i+1)*ringVertexCount + j+1);
+        }
+    });
+    k += 6*sliceCount*(stackCount-2);
+
+    //
+    // Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
+    // and connects the bottom pole to the bottom ring.
+    //
+
+    // South pole vertex was added last.
+    uint32 southPoleIndex = 1 + ringCount*ringVertexCount;
+
+    // Offset the indices to the index of the first vertex in the last ring.
+    baseIndexValue = southPoleIndex - ringVertexCount;
+
+    for(uint32 i = 0; i < sliceCount; ++i)
+    {
+        *k++ = static_cast<IndexT>(southPoleIndex);
+        *k++ = static_cast<IndexT>(baseIndexValue+i);
+        *k++ = static_cast<IndexT>(baseIndexValue+i+1);
+    }
+}
+
+template<typename Traits, typename IndexT>
+void GeometryGenerator::Subdivide(std::vector<typename Traits::VertexType>& vertices, std::vector<IndexT>& indices,
+    size_t baseVertex, size_t baseIndex)
+{
+    // Save a copy of the input geometry.
+    std::vector<typename Traits::VertexType> inputVertices(vertices.begin() + baseVertex, vertices.end());
+    std::vector<IndexT> inputIndices(indices.begin() + baseIndex, indices.end());
+
+    uint32 numTris = (uint32)inputIndices.size()/3;
+
+    vertices.resize(baseVertex);
+    indices.resize(baseIndex);
+    vertices.reserve(baseVertex + numTris*6);
+    indices.reserve(baseIndex + numTris*12);
+
+    // A block comment, since a // line ending in a backslash continues onto
+    // the next line.
+    /*
+           v1
+           *
+          / \
+         /   \
+      m0*-----*m1
+       / \   / \
+      /   \ /   \
+     *-----*-----*
+     v0    m2     v2
+    */
+
+    for(uint32 i = 0; i < numTris; ++i)
+    {
+        const typename Traits::VertexType& v0 = inputVertices[ inputIndices[i*3+0] ];
+        const typename Traits::VertexType& v1 = inputVertices[ inputIndices[i*3+1] ];
+        const typename Traits::VertexType& v2 = inputVertices[ inputIndices[i*3+2] ];
+
+        //
+        // Add new geometry.
+        //
+
+        vertices.push_back(v0); // 0
+        vertices.push_back(v1); // 1
+        vertices.push_back(v2); // 2
+        vertices.push_back(MidPoint<Traits>(v0, v1)); // 3
+        vertices.push_back(MidPoint<Traits>(v1, v2)); // 4
+        vertices.push_back(MidPoint<Traits>(v0, v2)); // 5
+
+        indices.push_back(static_cast<IndexT>(i*6+0));
+        indices.push_back(static_cast<IndexT>(i*6+3));
+        indices.push_back(static_cast<IndexT>(i*6+5));
+
+        indices.push_back(static_cast<IndexT>(i*6+3));
+        indices.push_back(static_cast<IndexT>(i*6+4));
+        indices.push_back(static_cast<IndexT>(i*6+5));
+
+        indices.push_back(static_cast<IndexT>(i*6+5));
+        indices.push_back(static_cast<IndexT>(i*6+4));
+        indices.push_back(static_cast<IndexT>(i*6+2));
+
+        indices.push_back(static_cast<IndexT>(i*6+3));
+        indices.push_back(static_cast<IndexT>(i*6+1));
+        indices.push_back(static_cast<IndexT>(i*6+4));
+    }
+}
+
+template<typename Traits>
+typename Traits::VertexType GeometryGenerator::MidPoint(const typename Traits::VertexType& v0,
+    const typename Traits::VertexType& v1)
+{
+    using namespace DirectX;
+
+    typename Traits::VertexType v;
+
+    // Compute the midpoints of all the attributes.  Vectors need to be normalized
+    // since linear interpolating can make them not unit length.
+    XMFLOAT3 pos;
+    XMStoreFloat3(&pos, 0.5f*(XMLoadFloat3(&Traits::GetPosition(v0)) + XMLoadFloat3(&Traits::GetPosition(v1))));
+    Traits::SetPosition(v, pos);
+
+    if(Traits::HasNormal)
+    {
+        XMFLOAT3 normal;
+        XMStoreFloat3(&normal, XMVector3Normalize(
+            0.5f*(XMLoadFloat3(&Traits::GetNormal(v0)) + XMLoadFloat3(&Traits::GetNormal(v1)))));
+        Traits::SetNormal(v, normal);
+    }
+
+    if(Traits::HasTangentU)
+    {
+        XMFLOAT3 tangent;
+        XMStoreFloat3(&tangent, XMVector3Normalize(
+            0.5f*(XMLoadFloat3(&Traits::GetTangentU(v0)) + XMLoadFloat3(&Traits::GetTangentU(v1)))));
+        Traits::SetTangentU(v, tangent);
+    }
+
+    if(Traits::HasTexC)
+    {
+        XMFLOAT2 tex;
+        XMStoreFloat2(&tex, 0.5f*(XMLoadFloat2(&Traits::GetTexC(v0)) + XMLoadFloat2(&Traits::GetTexC(v1))));
+        Traits::SetTexC(v, tex);
+    }
+
+    return v;
+}
+
+template<typename Traits, typename IndexT>
+void GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions,
+    std::vector<typename Traits::VertexType>& vertices, std::vector<IndexT>& indices)
+{
+    using namespace DirectX;
+
+    // Put a cap on the number of subdivisions.
+    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+
+    // Approximate a sphere by tessellating an icosahedron.
+
+    const float X = 0.525731f;
+    const float Z = 0.850651f;
+
+    PositionVertex pos[12] =
+    {
+        XMFLOAT3(-X, 0.0f, Z),  XMFLOAT3(X, 0.0f, Z),
+        XMFLOAT3(-X, 0.0f, -Z), XMFLOAT3(X, 0.0f, -Z),
+        XMFLOAT3(0.0f, Z, X),   XMFLOAT3(0.0f, Z, -X),
+        XMFLOAT3(0.0f, -Z, X),  XMFLOAT3(0.0f, -Z, -X),
+        XMFLOAT3(Z, X, 0.0f),   XMFLOAT3(-Z, X, 0.0f),
+        XMFLOAT3(Z, -X, 0.0f),  XMFLOAT3(-Z, -X, 0.0f)
+    };
+
+    uint32 k[60] =
+    {
+        1,4,0,  4,9,0,  4,5,9,  8,5,4,  1,8,4,
+        1,10,8, 10,3,8, 8,3,5,  3,2,5,  3,7,2,
+        3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0,
+        10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7
+    };
+
+    // Only the positions take part in the subdivision; every other attribute is
+    // derived from the projected position afterwards.
+    std::vector<PositionVertex> positions(&pos[0], &pos[12]);
+    std::vector<uint32> positionIndices(&k[0], &k[60]);
+
+    for(uint32 i = 0; i < numSubdivisions; ++i)
+        Subdivide<PositionTraits>(positions, positionIndices, 0, 0);
+
+    const size_t baseVertex = vertices.size();
+    vertices.resize(baseVertex + positions.size());
+    typename Traits::VertexType* out = vertices.data() + baseVertex;
+
+    // Project vertices onto sphere and scale.  Vertices are independent, so the
+    // work is split into blocks that run in parallel.
+    const uint32 blockSize = 1024;
+    const uint32 blockCount = ((uint32)positions.size() + blockSize - 1) / blockSize;
+
+    MeshUtil::ParallelFor(blockCount, blockSize, [&](uint32 block)
+    {
+        uint32 end = std::min<uint32>((block+1)*blockSize, (uint32)positions.size());
+        for(uint32 i = block*blockSize; i < end; ++i)
+        {
+            typename Traits::VertexType& v = out[i];
+
+            // Project onto unit sphere.
+            XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&positions[i].Position));
+
+            // Project onto sphere.
+            XMVECTOR p = radius*n;
+
+            XMFLOAT3 position;
+            XMStoreFloat3(&position, p);
+            Traits::SetPosition(v, position);
+
+            if(Traits::HasNormal)
+            {
+                XMFLOAT3 normal;
+                XMStoreFloat3(&normal, n);
+                Traits::SetNormal(v, normal);
+            }
+
+            if(Traits::HasTexC || Traits::HasTangentU)
+            {
+                // Derive texture coordinates from spherical coordinates.
+                float theta = atan2f(position.z, position.x);
+
+                // Put in [0, 2pi].
+                if(theta < 0.0f)
+                    theta += XM_2PI;
+
+                float phi = acosf(position.y / radius);
+
+                if(Traits::HasTexC)
+                    Traits::SetTexC(v, XMFLOAT2(theta/XM_2PI, phi/XM_PI));
+
+                if(Traits::HasTangentU)
+                {
+                    // Partial derivative of P with respect to theta
+                    XMFLOAT3 tangentU;
+                    tangentU.x = -radius*sinf(phi)*sinf(theta);
+                    tangentU.y = 0.0f;
+                    tangentU.z = +radius*sinf(phi)*cosf(theta);
+
+                    XMStoreFloat3(&tangentU, XMVector3Normalize(XMLoadFloat3(&tangentU)));
+                    Traits::SetTangentU(v, tangentU);
+                }
+            }
+        }
+    });
+
+    indices.reserve(indices.size() + positionIndices.size());
+    for(uint32 index : positionIndices)
+        indices.push_back(static_cast<IndexT>(index));
+}
+
+template<typename Traits, typename IndexT>
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
+    std::vector<typename Traits::VertexType>& vertices, std::vector<IndexT>& indices)
+{
+    using namespace DirectX;
+
+    typedef typename Traits::VertexType VertexT;
+
+    //
+    // Build Stacks.
+    //
+
+    float stackHeight = height / stackCount;
+
+    // Amount to increment radius as we move up each stack level from bottom to top.
+    float radiusStep = (topRadius - bottomRadius) / stackCount;
+
+    uint32 ringCount = stackCount+1;
+
+    // Add one because we duplicate the first and last vertex per ring
+    // since the texture coordinates are different.
+    uint32 ringVertexCount = sliceCount+1;
+
+    const size_t baseVertex = vertices.size();
+    vertices.resize(baseVertex + ringCount*ringVertexCount);
+    VertexT* v = vertices.data() + baseVertex;
+
+    // Every ring has the same angles, so evaluate them once.
+    float dTheta = 2.0f*XM_PI/sliceCount;
+    std::vector<float> sinTheta(ringVertexCount);
+    std::vector<float> cosTheta(ringVertexCount);
+    for(uint32 j = 0; j <= sliceCount; ++j)
+    {
+        sinTheta[j] = sinf(j*dTheta);
+        cosTheta[j] = cosf(j*dTheta);
+    }
+
+    // The normal only depends on the angle too.
+    std::vector<XMFLOAT3> normals;
+    if(Traits::HasNormal)
+    {
+        normals.resize(ringVertexCount);
+        for(uint32 j = 0; j <= sliceCount; ++j)
+        {
+            float c = cosTheta[j];
+            float s = sinTheta[j];
+
+            // Cylinder can be parameterized as follows, where we introduce v
+            // parameter that goes in the same direction as the v tex-coord
+            // so that the bitangent goes in the same direction as the v tex-coord.
+            //   Let r0 be the bottom radius and let r1 be the top radius.
+            //   y(v) = h - hv for v in [0,1].
+            //   r(v) = r1 + (r0-r1)v
+            //
+            //   x(t, v) = r(v)*cos(t)
+            //   y(t, v) = h - hv
+            //   z(t, v) = r(v)*sin(t)
+            //
+            //  dx/dt = -r(v)*sin(t)
+            //  dy/dt = 0
+            //  dz/dt = +r(v)*cos(t)
+            //
+            //  dx/dv = (r0-r1)*cos(t)
+            //  dy/dv = -h
+            //  dz/dv = (r0-r1)*sin(t)
+
+            // This is unit length.
+            XMFLOAT3 tangentU(-s, 0.0f, c);
+
+            float dr = bottomRadius-topRadius;
+            XMFLOAT3 bitangent(dr*c, -height, dr*s);
+
+            XMVECTOR T = XMLoadFloat3(&tangentU);
+            XMVECTOR B = XMLoadFloat3(&bitangent);
+            XMStoreFloat3(&normals[j], XMVector3Normalize(XMVector3Cross(T, B)));
+        }
+    }
+
+    // Compute vertices for each stack ring starting at the bottom and moving up.
+    MeshUtil::ParallelFor(ringCount, ringVertexCount, [&](uint32 i)
+    {
+        float y = -0.5f*height + i*stackHeight;
+        float r = bottomRadius + i*radiusStep;
+
+        // vertices of ring
+        VertexT* ringVertices = v + i*ringVertexCount;
+        for(uint32 j = 0; j <= sliceCount; ++j)
+        {
+            float c = cosTheta[j];
+            float s = sinTheta[j];
+
+            Traits::SetPosition(ringVertices[j], XMFLOAT3(r*c, y, r*s));
+
+            if(Traits::HasTexC)
+                Traits::SetTexC(ringVertices[j], XMFLOAT2((float)j/sliceCount, 1.0f - (float)i/stackCount));
+
+            if(Traits::HasTangentU)
+                Traits::SetTangentU(ringVertices[j], XMFLOAT3(-s, 0.0f, c));
+
+            if(Traits::HasNormal)
+                Traits::SetNormal(ringVertices[j], normals[j]);
+        }
+    });
+
+    // Compute indices for each stack.
+    const size_t baseIndex = indices.size();
+    indices.resize(baseIndex + 6*stackCount*sliceCount);
+    IndexT* k = indices.data() + baseIndex;
+
+    MeshUtil::ParallelFor(stackCount, 6*sliceCount, [&](uint32 i)
+    {
+        IndexT* q = k + 6*sliceCount*i;
+        for(uint32 j = 0; j < sliceCount; ++j)
+        {
+            *q++ = static_cast<IndexT>(i*ringVertexCount + j);
+            *q++ = static_cast<IndexT>((i+1)*ringVertexCount + j);
+            *q++ = static_cast<IndexT>((i+1)*ringVertexCount + j+1);
+
+            *q++ = static_cast<IndexT>(i*ringVertexCount + j);
+            *q++ = static_cast<IndexT>((i+1)*ringVertexCount + j+1);
+            *q++ = static_cast<IndexT>(i*ringVertexCount + j+1);
+        }
+    });
+}
+
+template<typename Traits, typename IndexT>
+void GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n,
+    std::vector<typename Traits::VertexType>& vertices, std::vector<IndexT>& indices)
+{
+    using namespace DirectX;
+
+    uint32 vertexCount = m*n;
+    uint32 faceCount   = (m-1)*(n-1)*2;
+
+    //
+    // Create the vertices.
+    //
+
+    float halfWidth = 0.5f*width;
+    float halfDepth = 0.5f*depth;
+
+    float dx = width / (n-1);
+    float dz = depth / (m-1);
+
+    float du = 1.0f / (n-1);
+    float dv = 1.0f / (m-1);
+
+    const size_t baseVertex = vertices.size();
+    vertices.resize(baseVertex + vertexCount);
+
+    typename Traits::VertexType* v = vertices.data() + baseVertex;
+    MeshUtil::ParallelFor(m, n, [&](uint32 i)
+    {
+        float z = halfDepth - i*dz;
+        for(uint32 j = 0; j < n; ++j)
+        {
+            float x = -halfWidth + j*dx;
+
+            Traits::SetPosition(v[i*n+j], XMFLOAT3(x, 0.0f, z));
+            if(Traits::HasNormal)
+                Traits::SetNormal(v[i*n+j], XMFLOAT3(0.0f, 1.0f, 0.0f));
+            if(Traits::HasTangentU)
+                Traits::SetTangentU(v[i*n+j], XMFLOAT3(1.0f, 0.0f, 0.0f));
+
+            // Stretch texture over grid.
+            if(Traits::HasTexC)
+                Traits::SetTexC(v[i*n+j], XMFLOAT2(j*du, i*dv));
+        }
+    });
+
+    //
+    // Create the indices.
+    //
+
+    const size_t baseIndex = indices.size();
+    indices.resize(baseIndex + faceCount*3); // 3 indices per face
+
+    // Iterate over each quad and compute indices.
+    IndexT* indexData = indices.data() + baseIndex;
+    MeshUtil::ParallelFor(m-1, 6*(n-1), [&](uint32 i)
+    {
+        IndexT* k = indexData + 6*(n-1)*i;
+        for(uint32 j = 0; j < n-1; ++j)
+        {
+            k[0] = static_cast<IndexT>(i*n+j);
+            k[1] = static_cast<IndexT>(i*n+j+1);
+            k[2] = static_cast<IndexT>((i+1)*n+j);
+
+            k[3] = static_cast<IndexT>((i+1)*n+j);
+            k[4] = static_cast<IndexT>(i*n+j+1);
+            k[5] = static_cast<IndexT>((i+1)*n+j+1);
+
+            k += 6; // next quad
+        }
+    });
+}
+
+template<typename Traits, typename IndexT>
+void GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth,
+    std::vector<typename Traits::VertexType>& vertices, std::vector<IndexT>& indices)
+{
+    // Position coordinates specified in NDC space.
+    AddVertex<Traits>(vertices, x, y - h, depth, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    AddVertex<Traits>(vertices, x, y, depth, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    AddVertex<Traits>(vertices, x+w, y, depth, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+    AddVertex<Traits>(vertices, x+w, y-h, depth, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+
+    const IndexT quad[6] = { 0, 1, 2, 0, 2, 3 };
+    indices.insert(indices.end(), &quad[0], &quad[6]);
+}
@@ -0,0 +1,406 @@
+//***************************************************************************************
+// LZBlock.cpp
+//***************************************************************************************
+
+#include "LZBlock.h"
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    using uint8 = LZBlock::uint8;
+    using uint32 = std::uint32_t;
+
+    //
+    // The LZ4 block format: each sequence is a token (literal count in the high
+    // nibble, match length - 4 in the low nibble; 15 means more bytes follow, each
+    // adding up to 255), the literals, a 2-byte little endian offset and the rest
+    // of the match length.  The last sequence has only literals.  The last 5 bytes
+    // are always literals and the last match starts at least 12 bytes before the
+    // end, which lets decoders copy in fixed size steps.
+    //
+
+    const size_t MinMatch = 4;
+    const size_t LastLiterals = 5;
+    const size_t MatchLimit = 12;
+    const size_t MaxOffset = 65535;
+
+    const uint32 FastHashBits = 14;
+    const uint32 HighHashBits = 16;
+    const uint32 HighMaxAttempts = 256;
+
+    uint32 Read32(const uint8* p)
+    {
+        uint32 value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint32 Hash(uint32 value, uint32 bits)
+    {
+        return (value*2654435761u) >> (32 - bits);
+    }
+
+    // Bytes that match at a and b, stopping at limit (a < limit).
+    size_t MatchLength(const uint8* a, const uint8* b, const uint8* limit)
+    {
+        const uint8* start = a;
+        while(a + sizeof(std::uint64_t) <= limit)
+        {
+            std::uint64_t x, y;
+            std::memcpy(&x, a, sizeof(x));
+            std::memcpy(&y, b, sizeof(y));
+            if(x != y)
+            {
+                std::uint64_t diff = x ^ y;
+                while((diff & 0xff) == 0)
+                {
+                    diff >>= 8;
+                    ++a;
+                }
+                return a - start;
+            }
+            a += sizeof(x);
+            b += sizeof(y);
+        }
+
+        while(a < limit && *a == *b)
+        {
+            ++a;
+            ++b;
+        }
+
+        return a - start;
+    }
+
+    class Writer
+    {
+    public:
+        Writer(uint8* dst, size_t capacity) :
+            mDst(dst),
+            mCapacity(capacity)
+        {
+        }
+
+        size_t Size()const { return mSize; }
+
+        // A sequence; matchLength 0 ends the block.
+        bool Sequence(const uint8* literals, size_t literalCount, size_t offset, size_t matchLength)
+        {
+            const size_t worst = 1 + literalCount/255 + 1 + literalCount + 2 + matchLength/255 + 1;
+            if(worst > mCapacity - mSize)
+                return false;
+
+            uint8* token = mDst + mSize++;
+            *token = (uint8)((literalCount < 15 ? literalCount : 15) << 4);
+            if(literalCount >= 15)
+                Extend(literalCount - 15);
+
+            if(literalCount > 0)
+                std::memcpy(mDst + mSize, literals, literalCount);
+            mSize += literalCount;
+
+            if(matchLength == 0)
+                return true;
+
+            mDst[mSize++] = (uint8)(offset & 0xff);
+            mDst[mSize++] = (uint8)(offset >> 8);
+
+            const size_t code = matchLength - MinMatch;
+            *token |= (uint8)(code < 15 ? code : 15);
+            if(code >= 15)
+                Extend(code - 15);
+
+            return true;
+        }
+
+    private:
+        void Extend(size_t value)
+        {
+            for(; value >= 255; value -= 255)
+                mDst[mSize++] = 255;
+            mDst[mSize++] = (uint8)value;
+        }
+
+    private:
+        uint8* mDst;
+        size_t mCapacity;
+        size_t mSize = 0;
+    };
+
+    size_t CompressFast(const uint8* src, size_t size, Writer& out)
+    {
+        size_t anchor = 0;
+
+        if(size > MatchLimit)
+        {
+            // Positions + 1, so 0 means empty.
+            std::vector<uint32> table((size_t)1 << FastHashBits, 0);
+
+            const size_t lastMatchStart = size - MatchLimit;
+            const uint8* matchEnd = src + size - LastLiterals;
+
+            size_t ip = 1;
+            table[Hash(Read32(src), FastHashBits)] = 1;
+
+            // After 64 misses in a row the step grows, so data that does not
+            // compress goes through quickly.
+            uint32 misses = 1 << 6;
+            while(ip <= lastMatchStart)
+            {
+                const uint32 h = Hash(Read32(src + ip), FastHashBits);
+                const size_t candidate = table[h];
+                table[h] = (uint32)(ip + 1);
+
+                size_t ref = candidate - 1;
+                if(candidate == 0 || ip - ref > MaxOffset || Read32(src + ref) != Read32(src + ip))
+                {
+                    ip += misses++ >> 6;
+                    continue;
+                }
+
+                while(ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1])
+                {
+                    --ip;
+                    --ref;
+                }
+
+                const size_t length = MinMatch + MatchLength(src + ip + MinMatch, src + ref + MinMatch, matchEnd);
+                if(!out.Sequence(src + anchor, ip - anchor, ip - ref, length))
+                    return 0;
+
+                ip += length;
+                anchor = ip;
+                misses = 1 << 6;
+
+                if(ip <= lastMatchStart)
+                    table[Hash(Read32(src + ip - 2), FastHashBits)] = (uint32)(ip - 2 + 1);
+            }
+        }
+
+        if(!out.Sequence(src + anchor, size - anchor, 0, 0))
+            return 0;
+
+        return out.Size();
+    }
+
+    class HashChain
+    {
+    public:
+        HashChain(const uint8* src, size_t size) :
+            mSrc(src),
+            mSize(size),
+            mHead((size_t)1 << HighHashBits, -1),
+            mPrevious(size, -1)
+        {
+        }
+
+        // The longest match for pos within the window, ending at or before limit.
+        size_t Find(size_t pos, const uint8* limit, size_t& ref)
+        {
+            Insert(pos);
+
+            size_t best = 0;
+            int candidate = mHead[Hash(Read32(mSrc + pos), HighHashBits)];
+            for(uint32 attempt = 0; attempt < HighMaxAttempts && candidate >= 0; ++attempt)
+            {
+                if(pos - (size_t)candidate > MaxOffset)
+                    break;
+
+                const uint8* a = mSrc + pos;
+                const uint8* b = mSrc + candidate;
+                if((best == 0 || (a + best < limit && a[best] == b[best])) && Read32(a) == Read32(b))
+                {
+                    const size_t length = MinMatch + MatchLength(a + MinMatch, b + MinMatch, limit);
+                    if(length > best)
+                    {
+                        best = length;
+                        ref = (size_t)candidate;
+                    }
+                }
+
+                candidate = mPrevious[candidate];
+            }
+
+            return best;
+        }
+
+    private:
+        // Adds every position before pos.
+        void Insert(size_t pos)
+        {
+            for(; mNext < pos && mNext + sizeof(uint32) <= mSize; ++mNext)
+            {
+                int& head = mHead[Hash(Read32(mSrc + mNext), HighHashBits)];
+                mPrevious[mNext] = head;
+                head = (int)mNext;
+            }
+        }
+
+    private:
+        const uint8* mSrc;
+        size_t mSize;
+        size_t mNext = 0;
+        std::vector<int> mHead;
+        std::vector<int> mPrevious;
+    };
+
+    size_t CompressHigh(const uint8* src, size_t size, Writer& out)
+    {
+        size_t anchor = 0;
+
+        if(size > MatchLimit)
+        {
+            HashChain chain(src, size);
+
+            const size_t lastMatchStart = size - MatchLimit;
+            const uint8* matchEnd = src + size - LastLiterals;
+
+            size_t ip = 0;
+            while(ip <= lastMatchStart)
+            {
+                size_t ref = 0;
+                size_t length = chain.Find(ip, matchEnd, ref);
+                if(length < MinMatch)
+                {
+                    ++ip;
+                    continue;
+                }
+
+                // Take a longer match one byte later if there is one; the byte
+                // becomes a literal.
+                while(ip + 1 <= lastMatchStart)
+                {
+                    size_t nextRef = 0;
+                    const size_t nextLength = chain.Find(ip + 1, matchEnd, nextRef);
+                    if(nextLength <= length)
+                        break;
+
+                    ++ip;
+                    length = nextLength;
+                    ref = nextRef;
+                }
+
+                if(!out.Sequence(src + anchor, ip - anchor, ip - ref, length))
+                    return 0;
+
+                ip += length;
+                anchor = ip;
+            }
+        }
+
+        if(!out.Sequence(src + anchor, size - anchor, 0, 0))
+            return 0;
+
+        return out.Size();
+    }
+}
+
+size_t LZBlock::CompressBound(size_t size)
+{
+    return size + size/255 + 16;
+}
+
+size_t LZBlock::Compress(const uint8* src, size_t size, uint8* dst, size_t capacity, Level level)
+{
+    // Positions are kept in 32 bits.
+    if(size > 0x7fffffff)
+        return 0;
+
+    Writer out(dst, capacity);
+    return level == Level::High ? CompressHigh(src, size, out) : CompressFast(src, size, out);
+}
+
+bool LZBlock::Decompress(const uint8* src, size_t srcSize, uint8* dst, size_t dstSize)
+{
+    //
+    // Copies go in 16-byte steps, past the end of what is needed, when both
+    // buffers have room for it; the bytes past the end are overwritten by the
+    // next sequence.  Near the ends of the buffers everything is copied exactly.
+    //
+
+    const size_t Step = 16;
+
+    size_t ip = 0;
+    size_t op = 0;
+    for(;;)
+    {
+        if(ip >= srcSize)
+            return false;
+
+        const uint32 token = src[ip++];
+
+        size_t literalCount = token >> 4;
+        if(literalCount == 15)
+        {
+            uint32 b;
+            do
+            {
+                if(ip >= srcSize || literalCount > dstSize)
+                    return false;
+                b = src[ip++];
+                literalCount += b;
+            } while(b == 255);
+        }
+
+        if(literalCount > srcSize - ip || literalCount > dstSize - op)
+            return false;
+
+        if(literalCount <= Step && srcSize - ip >= Step && dstSize - op >= Step)
+            std::memcpy(dst + op, src + ip, Step);
+        else if(literalCount > 0)
+            std::memcpy(dst + op, src + ip, literalCount);
+
+        ip += literalCount;
+        op += literalCount;
+
+        // Only the last sequence ends after its literals.
+        if(ip == srcSize)
+            return op == dstSize;
+
+        if(srcSize - ip < 2)
+            return false;
+
+        const size_t offset = src[ip] | ((size_t)src[ip + 1] << 8);
+        ip += 2;
+        if(offset == 0 || offset > op)
+            return false;
+
+        size_t length = (token & 15) + MinMatch;
+        if(length == 15 + MinMatch)
+        {
+            uint32 b;
+            do
+            {
+                if(ip >= srcSize || length > dstSize)
+                    return false;
+                b = src[ip++];
+                length += b;
+            } while(b == 255);
+        }
+
+        if(length > dstSize - op)
+            return false;
+
+        uint8* d = dst + op;
+        const uint8* s = d - offset;
+        if(offset >= Step && dstSize - op >= length + Step - 1)
+        {
+            // Each step reads only bytes written before it.
+            for(size_t i = 0; i < length; i += Step)
+                std::memcpy(d + i, s + i, Step);
+        }
+        else if(offset >= length)
+        {
+            std::memcpy(d, s, length);
+        }
+        else
+        {
+            // A repeating pattern shorter than the match.
+            for(size_t i = 0; i < length; ++i)
+                d[i] = s[i];
+        }
+
+        op += length;
+    }
+}
@@ -0,0 +1,49 @@
+//***************************************************************************************
+// LZBlock.h
+//
+// A small LZ77 compressor and decompressor in the LZ4 block format, for texel
+// payloads on disk (see the compressed DDS variant in DDSFile).
+//
+// A block is a sequence of (literals, match) pairs with a 64 KB window and no
+// entropy coding, so decompression is little more than memcpy.  The Fast level
+// keeps one candidate per hash; the High level searches hash chains and looks one
+// byte ahead before taking a match, which suits offline tools.  Blocks are
+// independent, so large payloads are split into blocks that decompress in
+// parallel.
+//
+// Decompress checks every length and offset against both buffers, so a damaged
+// file fails instead of writing out of bounds.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class LZBlock
+{
+public:
+
+    using uint8 = std::uint8_t;
+
+    enum class Level
+    {
+        Fast,
+        High
+    };
+
+    // The most bytes Compress can produce from size bytes of input.
+    static size_t CompressBound(size_t size);
+
+    ///<summary>
+    /// Compresses size bytes into dst (capacity bytes).  Returns the compressed
+    /// size, or 0 if it does not fit in capacity.
+    ///</summary>
+    static size_t Compress(const uint8* src, size_t size, uint8* dst, size_t capacity, Level level = Level::Fast);
+
+    ///<summary>
+    /// Decompresses a whole block, which must expand to exactly dstSize bytes.
+    /// Returns false if the block is damaged.
+    ///</summary>
+    static bool Decompress(const uint8* src, size_t srcSize, uint8* dst, size_t dstSize);
+};
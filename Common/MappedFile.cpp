@@ -0,0 +1,316 @@
+//***************************************************************************************
+// MappedFile.cpp
+//***************************************************************************************
+
+#include "MappedFile.h"
+#include <cstdio>
+#include <cwctype>
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <cerrno>
+    #include <cstdlib>
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace
+{
+    bool HasExtension(const std::wstring& name, const std::wstring& extension)
+    {
+        if(name.size() < extension.size())
+            return false;
+
+        const size_t start = name.size() - extension.size();
+        for(size_t i = 0; i < extension.size(); ++i)
+        {
+            if(std::towlower(name[start + i]) != std::towlower(extension[i]))
+                return false;
+        }
+
+        return true;
+    }
+
+#if !defined(_WIN32)
+    std::wstring WidePath(const std::string& path)
+    {
+        std::wstring wide(path.size() + 1, L'\0');
+        size_t length = std::mbstowcs(&wide[0], path.c_str(), wide.size());
+        wide.resize(length == (size_t)-1 ? 0 : length);
+        return wide;
+    }
+
+    std::string NarrowPath(const std::wstring& path)
+    {
+        std::string narrow(path.size()*MB_CUR_MAX + 1, '\0');
+        size_t length = std::wcstombs(&narrow[0], path.c_str(), narrow.size());
+        narrow.resize(length == (size_t)-1 ? 0 : length);
+        return narrow;
+    }
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& rhs) :
+    mData(rhs.mData),
+    mSize(rhs.mSize)
+{
+    rhs.mData = nullptr;
+    rhs.mSize = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs)
+{
+    if(this != &rhs)
+    {
+        Close();
+
+        mData = rhs.mData;
+        mSize = rhs.mSize;
+        rhs.mData = nullptr;
+        rhs.mSize = 0;
+    }
+
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const std::wstring& filename)
+{
+    Close();
+
+    HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    // The view keeps the mapping and the file alive; the handles can go.
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if(mapping == nullptr)
+        return false;
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if(view == nullptr)
+        return false;
+
+    mData = static_cast<const uint8*>(view);
+    mSize = (size_t)size.QuadPart;
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if(mData != nullptr)
+        UnmapViewOfFile(mData);
+
+    mData = nullptr;
+    mSize = 0;
+}
+
+bool MappedFile::WriteAtomic(const std::wstring& filename, const void* data, size_t size)
+{
+    const std::wstring tempName = filename + L".tmp";
+
+    FILE* file = nullptr;
+    if(_wfopen_s(&file, tempName.c_str(), L"wb") != 0 || file == nullptr)
+        return false;
+
+    bool ok = std::fwrite(data, 1, size, file) == size;
+    ok = (std::fclose(file) == 0) && ok;
+
+    if(ok)
+        ok = MoveFileExW(tempName.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+
+    if(!ok)
+        DeleteFileW(tempName.c_str());
+
+    return ok;
+}
+
+bool MappedFile::MakeDirectory(const std::wstring& path)
+{
+    return CreateDirectoryW(path.c_str(), nullptr) != 0 || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+bool MappedFile::ListDirectory(const std::wstring& path, const std::wstring& extension,
+    std::vector<DirectoryEntry>& entries)
+{
+    entries.clear();
+
+    // The find data already holds the size and write time, so no file is opened.
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileExW((path + L"\\*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch,
+        nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    if(find == INVALID_HANDLE_VALUE)
+        return false;
+
+    do
+    {
+        if(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+        if(!HasExtension(data.cFileName, extension))
+            continue;
+
+        DirectoryEntry entry;
+        entry.Name = data.cFileName;
+        entry.Size = ((uint64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        entry.ModifiedTime = ((uint64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+        entries.push_back(entry);
+    }
+    while(FindNextFileW(find, &data));
+
+    FindClose(find);
+
+    return true;
+}
+
+size_t MappedFile::ReadHead(const std::wstring& filename, void* buffer, size_t size)
+{
+    HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        return 0;
+
+    DWORD bytesRead = 0;
+    if(!ReadFile(file, buffer, (DWORD)size, &bytesRead, nullptr))
+        bytesRead = 0;
+
+    CloseHandle(file);
+
+    return bytesRead;
+}
+
+#else
+
+bool MappedFile::Open(const std::wstring& filename)
+{
+    Close();
+
+    int fd = open(NarrowPath(filename).c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(view == MAP_FAILED)
+        return false;
+
+    mData = static_cast<const uint8*>(view);
+    mSize = (size_t)info.st_size;
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if(mData != nullptr)
+        munmap(const_cast<uint8*>(mData), mSize);
+
+    mData = nullptr;
+    mSize = 0;
+}
+
+bool MappedFile::WriteAtomic(const std::wstring& filename, const void* data, size_t size)
+{
+    const std::string name = NarrowPath(filename);
+    const std::string tempName = name + ".tmp";
+
+    FILE* file = std::fopen(tempName.c_str(), "wb");
+    if(file == nullptr)
+        return false;
+
+    bool ok = std::fwrite(data, 1, size, file) == size;
+    ok = (std::fclose(file) == 0) && ok;
+
+    if(ok)
+        ok = std::rename(tempName.c_str(), name.c_str()) == 0;
+
+    if(!ok)
+        std::remove(tempName.c_str());
+
+    return ok;
+}
+
+bool MappedFile::MakeDirectory(const std::wstring& path)
+{
+    return mkdir(NarrowPath(path).c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool MappedFile::ListDirectory(const std::wstring& path, const std::wstring& extension,
+    std::vector<DirectoryEntry>& entries)
+{
+    entries.clear();
+
+    DIR* dir = opendir(NarrowPath(path).c_str());
+    if(dir == nullptr)
+        return false;
+
+    while(dirent* d = readdir(dir))
+    {
+        const std::wstring name = WidePath(d->d_name);
+        if(!HasExtension(name, extension))
+            continue;
+
+        struct stat info;
+        if(fstatat(dirfd(dir), d->d_name, &info, 0) != 0 || !S_ISREG(info.st_mode))
+            continue;
+
+        DirectoryEntry entry;
+        entry.Name = name;
+        entry.Size = (uint64)info.st_size;
+        entry.ModifiedTime = (uint64)info.st_mtim.tv_sec*1000000000ull + (uint64)info.st_mtim.tv_nsec;
+        entries.push_back(entry);
+    }
+
+    closedir(dir);
+
+    return true;
+}
+
+size_t MappedFile::ReadHead(const std::wstring& filename, void* buffer, size_t size)
+{
+    int fd = open(NarrowPath(filename).c_str(), O_RDONLY);
+    if(fd < 0)
+        return 0;
+
+    size_t total = 0;
+    while(total < size)
+    {
+        const ssize_t n = read(fd, static_cast<char*>(buffer) + total, size - total);
+        if(n <= 0)
+            break;
+        total += (size_t)n;
+    }
+
+    close(fd);
+
+    return total;
+}
+
+#endif
@@ -0,0 +1,80 @@
+//***************************************************************************************
+// MappedFile.h
+//
+// A read-only memory mapped file, plus the small amount of file system code the
+// caches need (atomic replacement of a file, directory creation and listing, and
+// reading the start of a file).
+//
+// Windows uses CreateFileMapping/MapViewOfFile; elsewhere mmap is used, so code
+// that only parses files can be built and tested off Windows too.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class MappedFile
+{
+public:
+
+    using uint8 = std::uint8_t;
+    using uint64 = std::uint64_t;
+
+    struct DirectoryEntry
+    {
+        std::wstring Name;
+        uint64 Size = 0;
+
+        // Last write time, in the platform's units (100 ns on Windows, 1 ns elsewhere).
+        uint64 ModifiedTime = 0;
+    };
+
+    MappedFile() = default;
+    MappedFile(const MappedFile& rhs) = delete;
+    MappedFile& operator=(const MappedFile& rhs) = delete;
+    MappedFile(MappedFile&& rhs);
+    MappedFile& operator=(MappedFile&& rhs);
+    ~MappedFile();
+
+    ///<summary>
+    /// Maps the whole file.  Returns false if the file does not exist, cannot be
+    /// mapped, or is empty.
+    ///</summary>
+    bool Open(const std::wstring& filename);
+    void Close();
+
+    bool IsOpen()const { return mData != nullptr; }
+    const uint8* Data()const { return mData; }
+    size_t Size()const { return mSize; }
+
+    ///<summary>
+    /// Writes the file to a temporary name and renames it over filename, so readers
+    /// never see a partially written file.
+    ///</summary>
+    static bool WriteAtomic(const std::wstring& filename, const void* data, size_t size);
+
+    ///<summary>
+    /// Creates a directory (one level).  Returns true if it exists afterwards.
+    ///</summary>
+    static bool MakeDirectory(const std::wstring& path);
+
+    ///<summary>
+    /// Lists the files in a directory (not in its subdirectories) whose names end
+    /// with extension, compared without case, with their sizes and write times.
+    ///</summary>
+    static bool ListDirectory(const std::wstring& path, const std::wstring& extension,
+        std::vector<DirectoryEntry>& entries);
+
+    ///<summary>
+    /// Reads up to size bytes from the start of a file without mapping it.
+    /// Returns the number of bytes read; 0 if the file cannot be opened.
+    ///</summary>
+    static size_t ReadHead(const std::wstring& filename, void* buffer, size_t size);
+
+private:
+    const uint8* mData = nullptr;
+    size_t mSize = 0;
+};
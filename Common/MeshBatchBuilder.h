@@ -0,0 +1,261 @@
+//***************************************************************************************
+// MeshBatchBuilder.h
+//
+// Packs several meshes into one vertex buffer and one index buffer, the way the
+// shape demos concatenate the box, grid, sphere and cylinder.
+//
+//   -Submeshes are appended one after another and the builder keeps track of
+//    their StartIndexLocation and BaseVertexLocation.
+//   -Indices are stored relative to the first vertex of their submesh, so the
+//    batch uses 16-bit indices whenever no single submesh has more than 65536
+//    vertices, however large the whole batch is.
+//   -Every submesh gets a bounding box, which FillDrawArgs copies to SubmeshGeometry.
+//   -Build() packs the vertices and the indices into a single allocation.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <DirectXCollision.h>
+#include <dxgiformat.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+template<typename VertexT>
+class MeshBatchBuilder
+{
+public:
+
+    using uint8 = std::uint8_t;
+    using uint16 = std::uint16_t;
+    using uint32 = std::uint32_t;
+
+    struct Submesh
+    {
+        std::string Name;
+
+        uint32 IndexCount = 0;
+        uint32 StartIndexLocation = 0;
+        int BaseVertexLocation = 0;
+        uint32 VertexCount = 0;
+
+        DirectX::BoundingBox Bounds;
+    };
+
+    struct Batch
+    {
+        std::vector<Submesh> Submeshes;
+
+        // The vertex buffer followed by the index buffer.
+        std::vector<uint8> Data;
+
+        uint32 VertexByteStride = 0;
+        uint32 VertexBufferByteSize = 0;
+        uint32 IndexBufferOffset = 0;
+        uint32 IndexBufferByteSize = 0;
+        DXGI_FORMAT IndexFormat = DXGI_FORMAT_R16_UINT;
+
+        const void* VertexData()const { return Data.data(); }
+        const void* IndexData()const { return Data.data() + IndexBufferOffset; }
+
+        ///<summary>
+        /// Adds a draw argument (e.g., SubmeshGeometry in MeshGeometry::DrawArgs) for
+        /// every submesh, keyed by the submesh name.
+        ///</summary>
+        template<typename DrawArgsMap>
+        void FillDrawArgs(DrawArgsMap& drawArgs)const
+        {
+            for(const Submesh& submesh : Submeshes)
+            {
+                auto& args = drawArgs[submesh.Name];
+                args.IndexCount = submesh.IndexCount;
+                args.StartIndexLocation = submesh.StartIndexLocation;
+                args.BaseVertexLocation = submesh.BaseVertexLocation;
+                args.Bounds = submesh.Bounds;
+            }
+        }
+    };
+
+    explicit MeshBatchBuilder(DirectX::XMFLOAT3 VertexT::* position) :
+        mPosition(position){}
+
+    void Reserve(size_t submeshCount, size_t vertexCount, size_t indexCount)
+    {
+        mSubmeshes.reserve(submeshCount);
+        mVertices.reserve(vertexCount);
+        mIndices.reserve(indexCount);
+    }
+
+    ///<summary>
+    /// Starts a submesh that is filled by appending to Vertices() and Indices().
+    /// Indices are relative to the first vertex of the submesh.  Returns the
+    /// submesh index.
+    ///</summary>
+    uint32 BeginSubmesh(const std::string& name)
+    {
+        Submesh submesh;
+        submesh.Name = name;
+        submesh.StartIndexLocation = (uint32)mIndices.size();
+        submesh.BaseVertexLocation = (int)mVertices.size();
+        mSubmeshes.push_back(submesh);
+
+        return (uint32)mSubmeshes.size() - 1;
+    }
+
+    std::vector<VertexT>& Vertices() { return mVertices; }
+    std::vector<uint32>& Indices() { return mIndices; }
+
+    void EndSubmesh()
+    {
+        Submesh& submesh = mSubmeshes.back();
+        submesh.IndexCount = (uint32)mIndices.size() - submesh.StartIndexLocation;
+        submesh.VertexCount = (uint32)mVertices.size() - (uint32)submesh.BaseVertexLocation;
+
+        ComputeBounds(submesh);
+    }
+
+    ///<summary>
+    /// Appends a mesh that is already in the batch's vertex format.
+    ///</summary>
+    template<typename IndexT>
+    uint32 Add(const std::string& name, const VertexT* vertices, size_t vertexCount,
+        const IndexT* indices, size_t indexCount)
+    {
+        uint32 id = BeginSubmesh(name);
+        mVertices.insert(mVertices.end(), vertices, vertices + vertexCount);
+        mIndices.insert(mIndices.end(), indices, indices + indexCount);
+        EndSubmesh();
+
+        return id;
+    }
+
+    ///<summary>
+    /// Appends a MeshData, copying the attributes named by Traits (see
+    /// GeometryGenerator::VertexTraits).
+    ///</summary>
+    template<typename Traits>
+    uint32 Add(const std::string& name, const GeometryGenerator::MeshData& meshData)
+    {
+        uint32 id = BeginSubmesh(name);
+
+        for(const GeometryGenerator::Vertex& src : meshData.Vertices)
+        {
+            VertexT v;
+            Traits::SetPosition(v, src.Position);
+            if(Traits::HasNormal)
+                Traits::SetNormal(v, src.Normal);
+            if(Traits::HasTexC)
+                Traits::SetTexC(v, src.TexC);
+            if(Traits::HasTangentU)
+                Traits::SetTangentU(v, src.TangentU);
+            mVertices.push_back(v);
+        }
+        mIndices.insert(mIndices.end(), meshData.Indices32.begin(), meshData.Indices32.end());
+
+        EndSubmesh();
+
+        return id;
+    }
+
+    ///<summary>
+    /// Appends whatever generate(vertices, indices) appends, e.g.,
+    /// AddGenerated("box", [&](auto& v, auto& i) { geoGen.CreateBox<Traits>(1.0f, 1.0f, 1.0f, 3, v, i); }).
+    ///</summary>
+    template<typename Generator>
+    uint32 AddGenerated(const std::string& name, Generator generate)
+    {
+        uint32 id = BeginSubmesh(name);
+        generate(mVertices, mIndices);
+        EndSubmesh();
+
+        return id;
+    }
+
+    ///<summary>
+    /// Packs everything added so far into one allocation and resets the builder.
+    ///</summary>
+    Batch Build()
+    {
+        Batch batch;
+
+        uint32 maxVertexCount = 0;
+        for(const Submesh& submesh : mSubmeshes)
+            maxVertexCount = std::max(maxVertexCount, submesh.VertexCount);
+
+        const bool use16 = maxVertexCount <= 65536;
+        const uint32 indexSize = use16 ? sizeof(uint16) : sizeof(uint32);
+
+        batch.VertexByteStride = sizeof(VertexT);
+        batch.VertexBufferByteSize = (uint32)(mVertices.size()*sizeof(VertexT));
+        batch.IndexBufferOffset = (batch.VertexBufferByteSize + 3) & ~3u;
+        batch.IndexBufferByteSize = (uint32)mIndices.size()*indexSize;
+        batch.IndexFormat = use16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+        batch.Data.resize(batch.IndexBufferOffset + batch.IndexBufferByteSize);
+        if(!mVertices.empty())
+            std::memcpy(batch.Data.data(), mVertices.data(), batch.VertexBufferByteSize);
+
+        uint8* indexData = batch.Data.data() + batch.IndexBufferOffset;
+        if(use16)
+        {
+            uint16* dst = reinterpret_cast<uint16*>(indexData);
+            for(size_t i = 0; i < mIndices.size(); ++i)
+                dst[i] = static_cast<uint16>(mIndices[i]);
+        }
+        else if(!mIndices.empty())
+        {
+            std::memcpy(indexData, mIndices.data(), batch.IndexBufferByteSize);
+        }
+
+        batch.Submeshes = std::move(mSubmeshes);
+
+        mSubmeshes.clear();
+        mVertices.clear();
+        mIndices.clear();
+
+        return batch;
+    }
+
+private:
+    void ComputeBounds(Submesh& submesh)const
+    {
+        using namespace DirectX;
+
+        if(submesh.VertexCount == 0)
+        {
+            submesh.Bounds = BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+            return;
+        }
+
+        const VertexT* first = mVertices.data() + submesh.BaseVertexLocation;
+        const VertexT* last = first + submesh.VertexCount;
+
+        XMFLOAT3 vMinf3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+        XMFLOAT3 vMaxf3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+        XMVECTOR vMin = XMLoadFloat3(&vMinf3);
+        XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
+
+        for(const VertexT* v = first; v != last; ++v)
+        {
+            XMVECTOR P = XMLoadFloat3(&(v->*mPosition));
+
+            vMin = XMVectorMin(vMin, P);
+            vMax = XMVectorMax(vMax, P);
+        }
+
+        XMStoreFloat3(&submesh.Bounds.Center, 0.5f*(vMin + vMax));
+        XMStoreFloat3(&submesh.Bounds.Extents, 0.5f*(vMax - vMin));
+    }
+
+private:
+    DirectX::XMFLOAT3 VertexT::* mPosition;
+
+    std::vector<Submesh> mSubmeshes;
+    std::vector<VertexT> mVertices;
+    std::vector<uint32> mIndices;
+};
@@ -0,0 +1,346 @@
+//***************************************************************************************
+// MeshCleanup.cpp
+//***************************************************************************************
+
+#include "MeshCleanup.h"
+#include "MeshUtil.h"
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = MeshCleanup::uint32;
+
+    const XMFLOAT3& At(const XMFLOAT3* base, size_t stride, size_t i)
+    {
+        return *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const char*>(base) + i*stride);
+    }
+
+    XMFLOAT3& At(XMFLOAT3* base, size_t stride, size_t i)
+    {
+        return *reinterpret_cast<XMFLOAT3*>(reinterpret_cast<char*>(base) + i*stride);
+    }
+
+    // Open addressing hash table from a grid cell to the first welded vertex in
+    // it.  The other vertices of the cell are chained through Next.
+    class CellTable
+    {
+    public:
+        explicit CellTable(uint32 maxCells)
+        {
+            uint32 size = 16;
+            while(size < 2*maxCells)
+                size *= 2;
+
+            mMask = size - 1;
+            mCells.resize(size);
+        }
+
+        // Returns the head of the cell's chain, or UINT32_MAX.
+        uint32 Find(std::int64_t x, std::int64_t y, std::int64_t z)const
+        {
+            for(uint32 slot = Hash(x, y, z) & mMask; ; slot = (slot + 1) & mMask)
+            {
+                const Cell& cell = mCells[slot];
+                if(cell.Head == UINT32_MAX)
+                    return UINT32_MAX;
+                if(cell.X == x && cell.Y == y && cell.Z == z)
+                    return cell.Head;
+            }
+        }
+
+        // Makes vertex the head of the cell's chain and returns the old head.
+        uint32 Insert(std::int64_t x, std::int64_t y, std::int64_t z, uint32 vertex)
+        {
+            for(uint32 slot = Hash(x, y, z) & mMask; ; slot = (slot + 1) & mMask)
+            {
+                Cell& cell = mCells[slot];
+                if(cell.Head == UINT32_MAX)
+                {
+                    cell.X = x;
+                    cell.Y = y;
+                    cell.Z = z;
+                    cell.Head = vertex;
+                    return UINT32_MAX;
+                }
+                if(cell.X == x && cell.Y == y && cell.Z == z)
+                {
+                    uint32 oldHead = cell.Head;
+                    cell.Head = vertex;
+                    return oldHead;
+                }
+            }
+        }
+
+    private:
+        static uint32 Hash(std::int64_t x, std::int64_t y, std::int64_t z)
+        {
+            std::uint64_t h = (std::uint64_t)x*0x9E3779B97F4A7C15ull ^
+                              (std::uint64_t)y*0xC2B2AE3D27D4EB4Full ^
+                              (std::uint64_t)z*0x165667B19E3779F9ull;
+            return (uint32)(h ^ (h >> 32));
+        }
+
+        struct Cell
+        {
+            std::int64_t X = 0;
+            std::int64_t Y = 0;
+            std::int64_t Z = 0;
+            uint32 Head = UINT32_MAX;
+        };
+
+        uint32 mMask = 0;
+        std::vector<Cell> mCells;
+    };
+}
+
+uint32 MeshCleanup::Weld(const XMFLOAT3* positions, size_t positionStride,
+    const XMFLOAT3* normals, size_t normalStride, uint32 vertexCount,
+    float epsilon, float normalCosine, std::vector<uint32>& remap)
+{
+    remap.resize(vertexCount);
+
+    // With cells as wide as epsilon, every vertex within epsilon of a point is in
+    // the point's cell or one of its 26 neighbors.
+    const double invCellSize = 1.0 / (double)epsilon;
+    const float epsilonSq = epsilon*epsilon;
+
+    CellTable table(vertexCount);
+    std::vector<uint32> next(vertexCount, UINT32_MAX);
+
+    uint32 uniqueCount = 0;
+    for(uint32 i = 0; i < vertexCount; ++i)
+    {
+        const XMFLOAT3& p = At(positions, positionStride, i);
+        XMVECTOR P = XMLoadFloat3(&p);
+
+        const std::int64_t cx = (std::int64_t)std::floor(p.x*invCellSize);
+        const std::int64_t cy = (std::int64_t)std::floor(p.y*invCellSize);
+        const std::int64_t cz = (std::int64_t)std::floor(p.z*invCellSize);
+
+        // Weld to the nearest earlier vertex that qualifies.
+        uint32 best = UINT32_MAX;
+        float bestDistSq = epsilonSq;
+
+        for(std::int64_t z = cz - 1; z <= cz + 1; ++z)
+        {
+            for(std::int64_t y = cy - 1; y <= cy + 1; ++y)
+            {
+                for(std::int64_t x = cx - 1; x <= cx + 1; ++x)
+                {
+                    for(uint32 r = table.Find(x, y, z); r != UINT32_MAX; r = next[r])
+                    {
+                        XMVECTOR Q = XMLoadFloat3(&At(positions, positionStride, r));
+                        float distSq = XMVectorGetX(XMVector3LengthSq(P - Q));
+                        if(distSq > bestDistSq || (distSq == bestDistSq && best < r))
+                            continue;
+
+                        if(normals != nullptr)
+                        {
+                            XMVECTOR N0 = XMLoadFloat3(&At(normals, normalStride, i));
+                            XMVECTOR N1 = XMLoadFloat3(&At(normals, normalStride, r));
+                            if(XMVectorGetX(XMVector3Dot(N0, N1)) < normalCosine)
+                                continue;
+                        }
+
+                        best = r;
+                        bestDistSq = distSq;
+                    }
+                }
+            }
+        }
+
+        if(best != UINT32_MAX)
+        {
+            remap[i] = best;
+        }
+        else
+        {
+            remap[i] = i;
+            next[i] = table.Insert(cx, cy, cz, i);
+            ++uniqueCount;
+        }
+    }
+
+    return uniqueCount;
+}
+
+size_t MeshCleanup::RemoveDegenerateTriangles(const XMFLOAT3* positions, size_t positionStride,
+    uint32* indices, size_t indexCount)
+{
+    size_t kept = 0;
+    for(size_t t = 0; t + 3 <= indexCount; t += 3)
+    {
+        uint32 i0 = indices[t+0];
+        uint32 i1 = indices[t+1];
+        uint32 i2 = indices[t+2];
+
+        if(i0 == i1 || i1 == i2 || i2 == i0)
+            continue;
+
+        XMVECTOR p0 = XMLoadFloat3(&At(positions, positionStride, i0));
+        XMVECTOR p1 = XMLoadFloat3(&At(positions, positionStride, i1));
+        XMVECTOR p2 = XMLoadFloat3(&At(positions, positionStride, i2));
+
+        XMVECTOR e0 = p1 - p0;
+        XMVECTOR e1 = p2 - p0;
+
+        // |e0 x e1|^2 = |e0|^2 |e1|^2 sin^2(angle).  Treat the triangle as flat when
+        // the angle is below float precision; this also catches zero length edges.
+        float crossSq = XMVectorGetX(XMVector3LengthSq(XMVector3Cross(e0, e1)));
+        float edgeSq = XMVectorGetX(XMVector3LengthSq(e0)) * XMVectorGetX(XMVector3LengthSq(e1));
+        if(crossSq <= 1.0e-12f*edgeSq)
+            continue;
+
+        indices[kept+0] = i0;
+        indices[kept+1] = i1;
+        indices[kept+2] = i2;
+        kept += 3;
+    }
+
+    return kept;
+}
+
+void MeshCleanup::ComputeNormals(const XMFLOAT3* positions, size_t positionStride, uint32 vertexCount,
+    const uint32* indices, size_t indexCount, XMFLOAT3* normals, size_t normalStride)
+{
+    const uint32 triangleCount = (uint32)(indexCount / 3);
+
+    // The cross product's length is twice the triangle's area, so summing
+    // unnormalized face normals weights them by area.
+    std::vector<XMFLOAT3> faceNormals(triangleCount);
+    MeshUtil::ParallelFor(triangleCount, 3, [&](uint32 t)
+    {
+        XMVECTOR p0 = XMLoadFloat3(&At(positions, positionStride, indices[t*3+0]));
+        XMVECTOR p1 = XMLoadFloat3(&At(positions, positionStride, indices[t*3+1]));
+        XMVECTOR p2 = XMLoadFloat3(&At(positions, positionStride, indices[t*3+2]));
+
+        XMStoreFloat3(&faceNormals[t], XMVector3Cross(p1 - p0, p2 - p0));
+    });
+
+    const MeshUtil::VertexAdjacency adjacency(indices, triangleCount, vertexCount);
+
+    MeshUtil::ParallelFor(vertexCount, 6, [&](uint32 v)
+    {
+        XMVECTOR sum = XMVectorZero();
+        for(uint32 k = adjacency.Offset[v]; k < adjacency.Offset[v+1]; ++k)
+            sum += XMLoadFloat3(&faceNormals[adjacency.Triangles[k]]);
+
+        if(XMVectorGetX(XMVector3LengthSq(sum)) > 0.0f)
+            sum = XMVector3Normalize(sum);
+
+        XMStoreFloat3(&At(normals, normalStride, v), sum);
+    });
+}
+
+void MeshCleanup::ComputeTangents(const XMFLOAT3* positions, size_t positionStride,
+    const XMFLOAT3* normals, size_t normalStride,
+    const XMFLOAT2* texCs, size_t texCStride, uint32 vertexCount,
+    const uint32* indices, size_t indexCount,
+    float* tangents, size_t tangentStride, bool writeHandedness)
+{
+    const uint32 triangleCount = (uint32)(indexCount / 3);
+
+    auto texCAt = [&](uint32 i) -> const XMFLOAT2&
+    {
+        return *reinterpret_cast<const XMFLOAT2*>(reinterpret_cast<const char*>(texCs) + i*texCStride);
+    };
+
+    //
+    // Solve e1 = du1*T + dv1*B, e2 = du2*T + dv2*B for every triangle.  The
+    // triangles are independent, so they are split across threads; the results
+    // are gathered per vertex below, in triangle order.
+    //
+
+    std::vector<XMFLOAT3> faceTangents(triangleCount);
+    std::vector<XMFLOAT3> faceBitangents(triangleCount);
+
+    MeshUtil::ParallelFor(triangleCount, 3, [&](uint32 t)
+    {
+        const uint32 i0 = indices[t*3+0];
+        const uint32 i1 = indices[t*3+1];
+        const uint32 i2 = indices[t*3+2];
+
+        XMVECTOR p0 = XMLoadFloat3(&At(positions, positionStride, i0));
+        XMVECTOR e1 = XMLoadFloat3(&At(positions, positionStride, i1)) - p0;
+        XMVECTOR e2 = XMLoadFloat3(&At(positions, positionStride, i2)) - p0;
+
+        const XMFLOAT2& uv0 = texCAt(i0);
+        const float du1 = texCAt(i1).x - uv0.x;
+        const float dv1 = texCAt(i1).y - uv0.y;
+        const float du2 = texCAt(i2).x - uv0.x;
+        const float dv2 = texCAt(i2).y - uv0.y;
+
+        XMVECTOR T = XMVectorZero();
+        XMVECTOR B = XMVectorZero();
+
+        // Triangles whose texture coordinates do not span an area contribute
+        // nothing.
+        const float det = du1*dv2 - du2*dv1;
+        if(std::fabs(det) > 1.0e-12f)
+        {
+            const float r = 1.0f / det;
+            T = (e1*dv2 - e2*dv1)*r;
+            B = (e2*du1 - e1*du2)*r;
+        }
+
+        XMStoreFloat3(&faceTangents[t], T);
+        XMStoreFloat3(&faceBitangents[t], B);
+    });
+
+    const MeshUtil::VertexAdjacency adjacency(indices, triangleCount, vertexCount);
+
+    MeshUtil::ParallelFor(vertexCount, 6, [&](uint32 v)
+    {
+        XMVECTOR T = XMVectorZero();
+        XMVECTOR B = XMVectorZero();
+        for(uint32 k = adjacency.Offset[v]; k < adjacency.Offset[v+1]; ++k)
+        {
+            T += XMLoadFloat3(&faceTangents[adjacency.Triangles[k]]);
+            B += XMLoadFloat3(&faceBitangents[adjacency.Triangles[k]]);
+        }
+
+        XMVECTOR N = XMLoadFloat3(&At(normals, normalStride, v));
+
+        // Gram-Schmidt orthogonalize.
+        T = T - N*XMVector3Dot(N, T);
+        if(XMVectorGetX(XMVector3LengthSq(T)) <= 1.0e-20f)
+        {
+            // No usable texture coordinates around this vertex; any direction
+            // perpendicular to the normal will do.
+            XMVECTOR axis = std::fabs(XMVectorGetX(N)) < 0.9f ?
+                XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+            T = XMVector3Cross(N, axis);
+        }
+        T = XMVector3Normalize(T);
+
+        float* tangent = reinterpret_cast<float*>(reinterpret_cast<char*>(tangents) + v*tangentStride);
+        tangent[0] = XMVectorGetX(T);
+        tangent[1] = XMVectorGetY(T);
+        tangent[2] = XMVectorGetZ(T);
+
+        if(writeHandedness)
+            tangent[3] = XMVectorGetX(XMVector3Dot(XMVector3Cross(N, T), B)) < 0.0f ? -1.0f : 1.0f;
+    });
+}
+
+uint32 MeshCleanup::CompactVertices(uint32 vertexCount, uint32* indices, size_t indexCount,
+    std::vector<uint32>& newIndex)
+{
+    newIndex.assign(vertexCount, UINT32_MAX);
+    for(size_t i = 0; i < indexCount; ++i)
+        newIndex[indices[i]] = 0;
+
+    uint32 count = 0;
+    for(uint32 v = 0; v < vertexCount; ++v)
+    {
+        if(newIndex[v] != UINT32_MAX)
+            newIndex[v] = count++;
+    }
+
+    for(size_t i = 0; i < indexCount; ++i)
+        indices[i] = newIndex[indices[i]];
+
+    return count;
+}
@@ -0,0 +1,182 @@
+//***************************************************************************************
+// MeshCleanup.h
+//
+// Cleans up meshes loaded from files such as skull.txt and car.txt, which make no
+// promise that a position is only stored once.
+//
+//   -Welds vertices that lie within an epsilon of each other, found with a
+//    spatial hash grid, and whose normals agree.
+//   -Drops triangles that collapse to a line or a point.
+//   -Drops vertices that are no longer referenced.
+//   -Optionally recomputes area weighted smooth normals (in parallel).
+//
+// It also generates tangents from texture coordinates for meshes that do not come
+// with any, so they can be used with the normal mapping shaders.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class MeshCleanup
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+    struct Options
+    {
+        Options() :
+            WeldEpsilon(1.0e-5f),
+            WeldNormalCosine(0.99f),
+            RemoveDegenerates(true),
+            RecomputeNormals(false){}
+
+        // Vertices closer than this (in model units) are welded.  Must be > 0.
+        float WeldEpsilon;
+
+        // Vertices are only welded when the dot product of their normals is at
+        // least this, so hard edges survive.  Ignored when there are no normals or
+        // when they are recomputed.
+        float WeldNormalCosine;
+
+        bool RemoveDegenerates;
+        bool RecomputeNormals;
+    };
+
+    struct Stats
+    {
+        size_t VerticesBefore = 0;
+        size_t VerticesAfter = 0;
+        size_t TrianglesBefore = 0;
+        size_t TrianglesAfter = 0;
+    };
+
+    ///<summary>
+    /// Finds the vertices to weld.  remap[i] is the vertex that vertex i is welded
+    /// to, which is the first vertex (in input order) of its group.  Returns the
+    /// number of distinct vertices.  normals may be null.
+    ///</summary>
+    static uint32 Weld(const DirectX::XMFLOAT3* positions, size_t positionStride,
+        const DirectX::XMFLOAT3* normals, size_t normalStride, uint32 vertexCount,
+        float epsilon, float normalCosine, std::vector<uint32>& remap);
+
+    ///<summary>
+    /// Removes the triangles with repeated indices or zero area, keeping the order
+    /// of the rest.  Returns the new index count.
+    ///</summary>
+    static size_t RemoveDegenerateTriangles(const DirectX::XMFLOAT3* positions, size_t positionStride,
+        uint32* indices, size_t indexCount);
+
+    ///<summary>
+    /// Computes smooth normals by summing the (area weighted) face normals around
+    /// every vertex.  Unreferenced vertices get a zero normal.
+    ///</summary>
+    static void ComputeNormals(const DirectX::XMFLOAT3* positions, size_t positionStride, uint32 vertexCount,
+        const uint32* indices, size_t indexCount, DirectX::XMFLOAT3* normals, size_t normalStride);
+
+    ///<summary>
+    /// Computes per-vertex tangents (the direction of increasing u) by summing the
+    /// tangent and bitangent of every triangle around a vertex, then making the
+    /// tangent orthogonal to the normal.  The tangents are floats with the given
+    /// stride; if writeHandedness is true a fourth float receives +1 or -1 so that
+    /// the bitangent is w*cross(N, T).
+    ///</summary>
+    static void ComputeTangents(const DirectX::XMFLOAT3* positions, size_t positionStride,
+        const DirectX::XMFLOAT3* normals, size_t normalStride,
+        const DirectX::XMFLOAT2* texCs, size_t texCStride, uint32 vertexCount,
+        const uint32* indices, size_t indexCount,
+        float* tangents, size_t tangentStride, bool writeHandedness);
+
+    ///<summary>
+    /// ComputeTangents for an application mesh, e.g.,
+    /// ComputeTangents(vertices, indices, &Vertex::Pos, &Vertex::Normal, &Vertex::TexC, &Vertex::TangentU).
+    /// The handedness is written when the tangent member has four components.
+    ///</summary>
+    template<typename VertexT, typename TangentT>
+    static void ComputeTangents(std::vector<VertexT>& vertices, const std::vector<uint32>& indices,
+        DirectX::XMFLOAT3 VertexT::* position, DirectX::XMFLOAT3 VertexT::* normal,
+        DirectX::XMFLOAT2 VertexT::* texC, TangentT VertexT::* tangent)
+    {
+        static_assert(sizeof(TangentT) >= 3*sizeof(float), "Tangents need at least three floats.");
+
+        if(vertices.empty())
+            return;
+
+        ComputeTangents(&(vertices[0].*position), sizeof(VertexT), &(vertices[0].*normal), sizeof(VertexT),
+            &(vertices[0].*texC), sizeof(VertexT), (uint32)vertices.size(), indices.data(), indices.size(),
+            reinterpret_cast<float*>(&(vertices[0].*tangent)), sizeof(VertexT),
+            sizeof(TangentT) >= 4*sizeof(float));
+    }
+
+    ///<summary>
+    /// Removes the vertices that no index refers to, keeping the order of the rest,
+    /// and renumbers the indices.  Returns the new vertex count; newIndex[i] is the
+    /// new index of vertex i, or UINT32_MAX if it was removed.
+    ///</summary>
+    static uint32 CompactVertices(uint32 vertexCount, uint32* indices, size_t indexCount,
+        std::vector<uint32>& newIndex);
+
+    ///<summary>
+    /// Runs the whole cleanup on an application mesh, e.g.,
+    /// Clean(vertices, indices, &Vertex::Pos, &Vertex::Normal).
+    ///</summary>
+    template<typename VertexT>
+    static Stats Clean(std::vector<VertexT>& vertices, std::vector<uint32>& indices,
+        DirectX::XMFLOAT3 VertexT::* position, DirectX::XMFLOAT3 VertexT::* normal = nullptr,
+        const Options& options = Options());
+};
+
+template<typename VertexT>
+MeshCleanup::Stats MeshCleanup::Clean(std::vector<VertexT>& vertices, std::vector<uint32>& indices,
+    DirectX::XMFLOAT3 VertexT::* position, DirectX::XMFLOAT3 VertexT::* normal, const Options& options)
+{
+    Stats stats;
+    stats.VerticesBefore = vertices.size();
+    stats.TrianglesBefore = indices.size() / 3;
+
+    if(vertices.empty())
+        return stats;
+
+    const uint32 vertexCount = (uint32)vertices.size();
+    const DirectX::XMFLOAT3* positions = &(vertices[0].*position);
+    const DirectX::XMFLOAT3* normals = nullptr;
+    if(normal != nullptr && !options.RecomputeNormals)
+        normals = &(vertices[0].*normal);
+
+    std::vector<uint32> remap;
+    Weld(positions, sizeof(VertexT), normals, sizeof(VertexT), vertexCount,
+        options.WeldEpsilon, options.WeldNormalCosine, remap);
+
+    for(uint32& i : indices)
+        i = remap[i];
+
+    size_t indexCount = indices.size() - indices.size() % 3;
+    if(options.RemoveDegenerates)
+        indexCount = RemoveDegenerateTriangles(positions, sizeof(VertexT), indices.data(), indexCount);
+    indices.resize(indexCount);
+
+    // Welded and degenerate-only vertices are now unreferenced.
+    std::vector<uint32> newIndex;
+    uint32 newVertexCount = CompactVertices(vertexCount, indices.data(), indices.size(), newIndex);
+    for(uint32 i = 0; i < vertexCount; ++i)
+    {
+        if(newIndex[i] != UINT32_MAX)
+            vertices[newIndex[i]] = vertices[i];
+    }
+    vertices.resize(newVertexCount);
+
+    if(normal != nullptr && options.RecomputeNormals && !vertices.empty())
+    {
+        ComputeNormals(&(vertices[0].*position), sizeof(VertexT), newVertexCount,
+            indices.data(), indices.size(), &(vertices[0].*normal), sizeof(VertexT));
+    }
+
+    stats.VerticesAfter = vertices.size();
+    stats.TrianglesAfter = indices.size() / 3;
+
+    return stats;
+}
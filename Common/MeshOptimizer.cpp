@@ -0,0 +1,276 @@
+//***************************************************************************************
+// MeshOptimizer.cpp
+//***************************************************************************************
+
+#include "MeshOptimizer.h"
+#include "MeshUtil.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Forsyth's tuning constants.  The optimizer models a 32 entry LRU cache;
+    // this works well for the (smaller, FIFO) caches of real hardware too.
+    const MeshOptimizer::uint32 kOptimizerCacheSize = 32;
+    const float kCacheDecayPower = 1.5f;
+    const float kLastTriScore = 0.75f;
+    const float kValenceBoostScale = 2.0f;
+    const float kValenceBoostPower = 0.5f;
+    const MeshOptimizer::uint32 kMaxValenceTable = 32;
+
+    struct ScoreTables
+    {
+        ScoreTables()
+        {
+            for(MeshOptimizer::uint32 i = 0; i < kOptimizerCacheSize; ++i)
+            {
+                if(i < 3)
+                {
+                    // The vertices of the triangle just emitted get a fixed score so
+                    // that we do not favor reusing the same edge forever.
+                    Cache[i] = kLastTriScore;
+                }
+                else
+                {
+                    float scaler = 1.0f / (kOptimizerCacheSize - 3);
+                    Cache[i] = powf(1.0f - (i - 3)*scaler, kCacheDecayPower);
+                }
+            }
+
+            Valence[0] = 0.0f;
+            for(MeshOptimizer::uint32 i = 1; i < kMaxValenceTable; ++i)
+                Valence[i] = kValenceBoostScale * powf((float)i, -kValenceBoostPower);
+        }
+
+        float Cache[kOptimizerCacheSize];
+        float Valence[kMaxValenceTable];
+    };
+
+    float VertexScore(const ScoreTables& tables, int cachePosition, MeshOptimizer::uint32 liveTriangles)
+    {
+        // Vertices with no triangles left to draw are worthless.
+        if(liveTriangles == 0)
+            return -1.0f;
+
+        float score = cachePosition >= 0 ? tables.Cache[cachePosition] : 0.0f;
+
+        // Boost vertices with few triangles left so that we finish them off and
+        // do not leave lone triangles behind to be rendered with a cold cache.
+        if(liveTriangles < kMaxValenceTable)
+            score += tables.Valence[liveTriangles];
+        else
+            score += kValenceBoostScale * powf((float)liveTriangles, -kValenceBoostPower);
+
+        return score;
+    }
+}
+
+MeshOptimizer::VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const uint32* indices, size_t indexCount,
+    size_t vertexCount, uint32 cacheSize)
+{
+    VertexCacheStats stats;
+    stats.TriangleCount = (uint32)(indexCount / 3);
+
+    // A vertex is in the FIFO if it was inserted fewer than cacheSize insertions ago.
+    // Start the clock past cacheSize so that the zero initialized stamps count as misses.
+    std::vector<uint32> insertedAt(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    uint32 timestamp = cacheSize + 1;
+
+    for(size_t i = 0; i < indexCount; ++i)
+    {
+        uint32 v = indices[i];
+
+        if(timestamp - insertedAt[v] > cacheSize)
+        {
+            insertedAt[v] = timestamp++;
+            stats.TransformCount++;
+        }
+
+        if(!referenced[v])
+        {
+            referenced[v] = true;
+            stats.VertexCount++;
+        }
+    }
+
+    if(stats.TriangleCount > 0)
+        stats.ACMR = (float)stats.TransformCount / stats.TriangleCount;
+    if(stats.VertexCount > 0)
+        stats.ATVR = (float)stats.TransformCount / stats.VertexCount;
+
+    return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32* destination, const uint32* indices,
+    size_t indexCount, size_t vertexCount)
+{
+    static const ScoreTables tables;
+
+    const uint32 triangleCount = (uint32)(indexCount / 3);
+    if(triangleCount == 0)
+        return;
+
+    //
+    // Vertex -> triangle adjacency.  The first liveTriangles[v] triangles of a
+    // vertex are the ones not emitted yet.
+    //
+
+    MeshUtil::VertexAdjacency adjacency(indices, triangleCount, (uint32)vertexCount);
+
+    std::vector<uint32> liveTriangles(vertexCount);
+    for(size_t v = 0; v < vertexCount; ++v)
+        liveTriangles[v] = adjacency.Count((uint32)v);
+
+    //
+    // Initial scores.
+    //
+
+    std::vector<float> vertexScore(vertexCount);
+    for(size_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = VertexScore(tables, -1, liveTriangles[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    for(uint32 t = 0; t < triangleCount; ++t)
+    {
+        triangleScore[t] = vertexScore[indices[t*3+0]] +
+                           vertexScore[indices[t*3+1]] +
+                           vertexScore[indices[t*3+2]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+
+    // Room for the full cache plus the three vertices pushed by the next triangle.
+    uint32 cache[kOptimizerCacheSize + 3];
+    uint32 cacheCount = 0;
+
+    uint32 bestTriangle = 0;
+    float bestScore = triangleScore[0];
+    for(uint32 t = 1; t < triangleCount; ++t)
+    {
+        if(triangleScore[t] > bestScore)
+        {
+            bestScore = triangleScore[t];
+            bestTriangle = t;
+        }
+    }
+
+    // When the cache neighbourhood runs dry we fall back to the next triangle in
+    // input order; this cursor makes that lookup amortized linear.
+    uint32 inputCursor = 0;
+
+    for(uint32 output = 0; output < triangleCount; ++output)
+    {
+        if(bestTriangle == UINT32_MAX)
+        {
+            while(emitted[inputCursor])
+                ++inputCursor;
+            bestTriangle = inputCursor;
+        }
+
+        const uint32* tri = &indices[bestTriangle*3];
+        destination[output*3+0] = tri[0];
+        destination[output*3+1] = tri[1];
+        destination[output*3+2] = tri[2];
+        emitted[bestTriangle] = true;
+
+        //
+        // Remove the triangle from the live adjacency of its vertices.
+        //
+
+        for(uint32 k = 0; k < 3; ++k)
+        {
+            uint32 v = tri[k];
+            uint32* begin = &adjacency.Triangles[adjacency.Offset[v]];
+            uint32* end = begin + liveTriangles[v];
+            uint32* it = std::find(begin, end, bestTriangle);
+            *it = *(end - 1);
+            liveTriangles[v]--;
+        }
+
+        //
+        // Push the triangle's vertices to the front of the LRU cache.
+        //
+
+        uint32 newCache[kOptimizerCacheSize + 3];
+        uint32 newCount = 0;
+        newCache[newCount++] = tri[0];
+        newCache[newCount++] = tri[1];
+        newCache[newCount++] = tri[2];
+
+        for(uint32 i = 0; i < cacheCount; ++i)
+        {
+            uint32 v = cache[i];
+            if(v != tri[0] && v != tri[1] && v != tri[2])
+                newCache[newCount++] = v;
+        }
+
+        //
+        // Rescore every vertex whose cache position changed and propagate the
+        // difference to its live triangles, tracking the best candidate.
+        //
+
+        bestTriangle = UINT32_MAX;
+        bestScore = -1.0f;
+
+        for(uint32 i = 0; i < newCount; ++i)
+        {
+            uint32 v = newCache[i];
+            int position = i < kOptimizerCacheSize ? (int)i : -1;
+
+            float score = VertexScore(tables, position, liveTriangles[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            const uint32* adj = &adjacency.Triangles[adjacency.Offset[v]];
+            for(uint32 j = 0; j < liveTriangles[v]; ++j)
+            {
+                uint32 t = adj[j];
+                triangleScore[t] += delta;
+
+                if(triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        cacheCount = std::min(newCount, kOptimizerCacheSize);
+        std::copy(newCache, newCache + cacheCount, cache);
+    }
+}
+
+void MeshOptimizer::BuildVertexFetchRemap(std::vector<uint32>& remap, const uint32* indices,
+    size_t indexCount, size_t vertexCount)
+{
+    remap.assign(vertexCount, UINT32_MAX);
+
+    uint32 next = 0;
+    for(size_t i = 0; i < indexCount; ++i)
+    {
+        uint32 v = indices[i];
+        if(remap[v] == UINT32_MAX)
+            remap[v] = next++;
+    }
+
+    for(size_t v = 0; v < vertexCount; ++v)
+    {
+        if(remap[v] == UINT32_MAX)
+            remap[v] = next++;
+    }
+}
+
+MeshOptimizer::Report MeshOptimizer::Optimize(GeometryGenerator::MeshData& meshData)
+{
+    // Rebuild the mesh rather than editing it in place so that a stale 16-bit
+    // index copy cannot survive the reorder.
+    GeometryGenerator::MeshData optimized;
+    optimized.Vertices = std::move(meshData.Vertices);
+    optimized.Indices32 = std::move(meshData.Indices32);
+
+    Report report = Optimize(optimized.Vertices, optimized.Indices32);
+
+    meshData = std::move(optimized);
+    return report;
+}
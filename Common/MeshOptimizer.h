@@ -0,0 +1,194 @@
+//***************************************************************************************
+// MeshOptimizer.h
+//
+// Reorders indexed triangle lists for the GPU vertex pipeline.
+//
+//   -OptimizeVertexCache reorders triangles so that vertices are reused while
+//    they are still in the post-transform cache (Tom Forsyth's "Linear-Speed
+//    Vertex Cache Optimisation").
+//   -BuildVertexFetchRemap renumbers vertices in the order the (reordered)
+//    index buffer first references them, so that vertex fetch walks the
+//    vertex buffer nearly linearly.
+//   -AnalyzeVertexCache simulates a FIFO post-transform cache on the CPU and
+//    reports ACMR (average cache miss ratio = transformed vertices per
+//    triangle) and ATVR (average transform to vertex ratio = transformed
+//    vertices per unique vertex; 1.0 is optimal).
+//
+// None of these change what is drawn; they only change the order.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class MeshOptimizer
+{
+public:
+
+    using uint16 = std::uint16_t;
+    using uint32 = std::uint32_t;
+
+    // Cache size used when simulating the post-transform cache.  Real hardware
+    // varies, but a 16 entry FIFO is a good, conservative stand-in.
+    static const uint32 DefaultSimulatedCacheSize = 16;
+
+    struct VertexCacheStats
+    {
+        uint32 TriangleCount = 0;
+        uint32 VertexCount = 0;     // Unique vertices referenced by the indices.
+        uint32 TransformCount = 0;  // Cache misses, i.e., vertex shader invocations.
+        float ACMR = 0.0f;
+        float ATVR = 0.0f;
+    };
+
+    struct Report
+    {
+        VertexCacheStats Before;
+        VertexCacheStats After;
+    };
+
+    ///<summary>
+    /// Simulates a FIFO post-transform cache of the given size over a triangle list.
+    ///</summary>
+    static VertexCacheStats AnalyzeVertexCache(const uint32* indices, size_t indexCount,
+        size_t vertexCount, uint32 cacheSize = DefaultSimulatedCacheSize);
+
+    ///<summary>
+    /// Writes the triangles of indices to destination in cache friendly order.
+    /// destination must not alias indices.
+    ///</summary>
+    static void OptimizeVertexCache(uint32* destination, const uint32* indices,
+        size_t indexCount, size_t vertexCount);
+
+    ///<summary>
+    /// Builds remap[oldIndex] = newIndex so that vertices are numbered in the order
+    /// they are first referenced.  Unreferenced vertices are moved to the end so the
+    /// vertex count never changes.
+    ///</summary>
+    static void BuildVertexFetchRemap(std::vector<uint32>& remap, const uint32* indices,
+        size_t indexCount, size_t vertexCount);
+
+    ///<summary>
+    /// Applies a remap table built by BuildVertexFetchRemap.
+    ///</summary>
+    template<typename VertexT, typename IndexT>
+    static void ApplyVertexRemap(std::vector<VertexT>& vertices, std::vector<IndexT>& indices,
+        const std::vector<uint32>& remap)
+    {
+        std::vector<VertexT> reordered(vertices.size());
+        for(size_t i = 0; i < vertices.size(); ++i)
+            reordered[remap[i]] = vertices[i];
+        vertices.swap(reordered);
+
+        for(size_t i = 0; i < indices.size(); ++i)
+            indices[i] = static_cast<IndexT>(remap[static_cast<size_t>(indices[i])]);
+    }
+
+    ///<summary>
+    /// Runs the vertex cache and vertex fetch passes on a generated mesh.  Any
+    /// cached 16-bit copy of the indices is discarded.
+    ///</summary>
+    static Report Optimize(GeometryGenerator::MeshData& meshData);
+
+    ///<summary>
+    /// Runs the vertex cache and vertex fetch passes on an application mesh, such as
+    /// the vertices and indices read from skull.txt or car.txt.  Works with any
+    /// vertex struct and 16 or 32-bit (signed or unsigned) indices.
+    ///</summary>
+    template<typename VertexT, typename IndexT>
+    static Report Optimize(std::vector<VertexT>& vertices, std::vector<IndexT>& indices)
+    {
+        std::vector<uint32> indices32(indices.begin(), indices.end());
+
+        Report report;
+        report.Before = AnalyzeVertexCache(indices32.data(), indices32.size(), vertices.size());
+
+        std::vector<uint32> optimized(indices32.size());
+        OptimizeVertexCache(optimized.data(), indices32.data(), indices32.size(), vertices.size());
+
+        // Meshes exported from a DCC tool are often already cache optimized for some
+        // other cache model; never make them worse.
+        if(AnalyzeVertexCache(optimized.data(), optimized.size(), vertices.size()).TransformCount >=
+           report.Before.TransformCount)
+        {
+            optimized = indices32;
+        }
+
+        for(size_t i = 0; i < indices.size(); ++i)
+            indices[i] = static_cast<IndexT>(optimized[i]);
+
+        std::vector<uint32> remap;
+        BuildVertexFetchRemap(remap, optimized.data(), optimized.size(), vertices.size());
+        ApplyVertexRemap(vertices, indices, remap);
+
+        indices32.assign(indices.begin(), indices.end());
+        report.After = AnalyzeVertexCache(indices32.data(), indices32.size(), vertices.size());
+
+        return report;
+    }
+
+    ///<summary>
+    /// Same as above for meshes split into subsets (e.g., M3DLoader::Subset).  Triangles
+    /// are only reordered inside their own subset so FaceStart/FaceCount stay valid;
+    /// VertexStart/VertexCount are recomputed after the vertex fetch pass.
+    ///</summary>
+    template<typename VertexT, typename IndexT, typename SubsetT>
+    static Report Optimize(std::vector<VertexT>& vertices, std::vector<IndexT>& indices,
+        std::vector<SubsetT>& subsets)
+    {
+        std::vector<uint32> indices32(indices.begin(), indices.end());
+
+        Report report;
+        report.Before = AnalyzeVertexCache(indices32.data(), indices32.size(), vertices.size());
+
+        // Triangles not covered by any subset keep their position.
+        std::vector<uint32> optimized(indices32);
+        for(const SubsetT& subset : subsets)
+        {
+            size_t first = static_cast<size_t>(subset.FaceStart) * 3;
+            size_t count = static_cast<size_t>(subset.FaceCount) * 3;
+            OptimizeVertexCache(&optimized[first], &indices32[first], count, vertices.size());
+
+            if(AnalyzeVertexCache(&optimized[first], count, vertices.size()).TransformCount >=
+               AnalyzeVertexCache(&indices32[first], count, vertices.size()).TransformCount)
+            {
+                std::copy(&indices32[first], &indices32[first] + count, &optimized[first]);
+            }
+        }
+
+        for(size_t i = 0; i < indices.size(); ++i)
+            indices[i] = static_cast<IndexT>(optimized[i]);
+
+        std::vector<uint32> remap;
+        BuildVertexFetchRemap(remap, optimized.data(), optimized.size(), vertices.size());
+        ApplyVertexRemap(vertices, indices, remap);
+
+        for(SubsetT& subset : subsets)
+        {
+            size_t first = static_cast<size_t>(subset.FaceStart) * 3;
+            size_t count = static_cast<size_t>(subset.FaceCount) * 3;
+            if(count == 0)
+                continue;
+
+            uint32 minIndex = UINT32_MAX;
+            uint32 maxIndex = 0;
+            for(size_t i = first; i < first + count; ++i)
+            {
+                uint32 index = static_cast<uint32>(indices[i]);
+                minIndex = index < minIndex ? index : minIndex;
+                maxIndex = index > maxIndex ? index : maxIndex;
+            }
+
+            subset.VertexStart = minIndex;
+            subset.VertexCount = maxIndex - minIndex + 1;
+        }
+
+        indices32.assign(indices.begin(), indices.end());
+        report.After = AnalyzeVertexCache(indices32.data(), indices32.size(), vertices.size());
+
+        return report;
+    }
+};
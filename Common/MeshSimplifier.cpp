@@ -0,0 +1,729 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = MeshSimplifier::uint32;
+
+    // Normal xyz and texture coordinate uv.
+    const uint32 kMaxAttributes = 5;
+
+    struct Vec3
+    {
+        double x, y, z;
+    };
+
+    Vec3 operator-(const Vec3& a, const Vec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+    double Dot(const Vec3& a, const Vec3& b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+    Vec3 Cross(const Vec3& a, const Vec3& b)
+    {
+        return { a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x };
+    }
+
+    // Symmetric quadratic form  Q(p) = p^T A p + 2 b.p + c, accumulated with total
+    // weight W so that Q(p)/W is an area weighted mean squared distance.
+    struct Quadric
+    {
+        double A00 = 0, A11 = 0, A22 = 0, A01 = 0, A02 = 0, A12 = 0;
+        double B0 = 0, B1 = 0, B2 = 0;
+        double C = 0;
+        double W = 0;
+
+        void AddPlane(const Vec3& n, double d, double w)
+        {
+            A00 += w*n.x*n.x; A11 += w*n.y*n.y; A22 += w*n.z*n.z;
+            A01 += w*n.x*n.y; A02 += w*n.x*n.z; A12 += w*n.y*n.z;
+            B0 += w*d*n.x; B1 += w*d*n.y; B2 += w*d*n.z;
+            C += w*d*d;
+            W += w;
+        }
+
+        void Add(const Quadric& q)
+        {
+            A00 += q.A00; A11 += q.A11; A22 += q.A22;
+            A01 += q.A01; A02 += q.A02; A12 += q.A12;
+            B0 += q.B0; B1 += q.B1; B2 += q.B2;
+            C += q.C;
+            W += q.W;
+        }
+
+        double Raw(const Vec3& p)const
+        {
+            double rx = A00*p.x + A01*p.y + A02*p.z;
+            double ry = A01*p.x + A11*p.y + A12*p.z;
+            double rz = A02*p.x + A12*p.y + A22*p.z;
+
+            return p.x*rx + p.y*ry + p.z*rz + 2.0*(B0*p.x + B1*p.y + B2*p.z) + C;
+        }
+    };
+
+    // Attribute quadric: for every attribute component j of a triangle there is a
+    // linear function s_j(p) = g_j.p + d_j interpolating it over the triangle plane.
+    // The error of giving point p the attribute value s_j is (g_j.p + d_j - s_j)^2.
+    // The p-only terms are folded into Base; the terms involving s_j need G_j, D_j.
+    struct AttributeQuadric
+    {
+        Quadric Base;
+        double G[kMaxAttributes][3] = {};
+        double D[kMaxAttributes] = {};
+
+        void Add(const AttributeQuadric& q)
+        {
+            Base.Add(q.Base);
+            for(uint32 j = 0; j < kMaxAttributes; ++j)
+            {
+                G[j][0] += q.G[j][0];
+                G[j][1] += q.G[j][1];
+                G[j][2] += q.G[j][2];
+                D[j] += q.D[j];
+            }
+        }
+
+        double Eval(const Vec3& p, const double* s, uint32 count)const
+        {
+            if(Base.W <= 0.0)
+                return 0.0;
+
+            double r = Base.Raw(p);
+            for(uint32 j = 0; j < count; ++j)
+            {
+                double predicted = G[j][0]*p.x + G[j][1]*p.y + G[j][2]*p.z + D[j];
+                r += -2.0*s[j]*predicted + s[j]*s[j]*Base.W;
+            }
+
+            return std::fabs(r) / Base.W;
+        }
+    };
+
+    struct Plane
+    {
+        Vec3 N;
+        double D;
+    };
+
+    struct Collapse
+    {
+        uint32 From;
+        uint32 To;
+        double Cost;
+        double Deviation;
+    };
+
+    class Simplifier
+    {
+    public:
+        Simplifier(const MeshSimplifier::VertexAttributes& attributes, const uint32* indices,
+            size_t indexCount, const MeshSimplifier::Options& options);
+
+        // Continues collapsing from the current state.
+        void Run(uint32 targetTriangleCount, float maxError);
+
+        std::vector<uint32> Indices;
+
+        // Largest distance of a moved vertex from the planes of the original
+        // triangles it stands in for, relative to the extent.
+        double MaxDeviation = 0.0;
+        float Extent = 1.0f;
+
+    private:
+        void BuildAdjacency();
+        bool IsLinkConditionMet(uint32 from, uint32 to)const;
+        bool HasFlips(uint32 from, uint32 to)const;
+        double CollapseCost(uint32 from, uint32 to, double& geometricError)const;
+        double Deviation(uint32 from, uint32 to)const;
+        bool Evaluate(uint32 from, uint32 to, double maxError, Collapse& collapse)const;
+
+        size_t mVertexCount = 0;
+        uint32 mAttributeCount = 0;
+
+        std::vector<Vec3> mPositions;
+        std::vector<double> mAttributes;
+        std::vector<bool> mLocked;
+
+        std::vector<Quadric> mQuadrics;
+        std::vector<AttributeQuadric> mAttributeQuadrics;
+
+        // The planes of the original triangles, and for each vertex the sorted
+        // planes of the original triangles around it and around every vertex
+        // collapsed into it.
+        std::vector<Plane> mPlanes;
+        std::vector<std::vector<uint32>> mPlaneSets;
+
+        std::vector<uint32> mAdjacencyOffset;
+        std::vector<uint32> mAdjacency;
+    };
+
+    Simplifier::Simplifier(const MeshSimplifier::VertexAttributes& attributes, const uint32* indices,
+        size_t indexCount, const MeshSimplifier::Options& options)
+        : Indices(indices, indices + indexCount), mVertexCount(attributes.VertexCount)
+    {
+        //
+        // Copy positions, normalized to the unit cube so that errors are relative.
+        //
+
+        const char* posBytes = reinterpret_cast<const char*>(attributes.Positions);
+
+        XMFLOAT3 vMin(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+        XMFLOAT3 vMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for(size_t i = 0; i < mVertexCount; ++i)
+        {
+            const XMFLOAT3& p = *reinterpret_cast<const XMFLOAT3*>(posBytes + i*attributes.PositionStride);
+            vMin = XMFLOAT3(std::min(vMin.x, p.x), std::min(vMin.y, p.y), std::min(vMin.z, p.z));
+            vMax = XMFLOAT3(std::max(vMax.x, p.x), std::max(vMax.y, p.y), std::max(vMax.z, p.z));
+        }
+
+        Extent = std::max(vMax.x - vMin.x, std::max(vMax.y - vMin.y, vMax.z - vMin.z));
+        if(!(Extent > 0.0f))
+            Extent = 1.0f;
+
+        double invExtent = 1.0 / Extent;
+        mPositions.resize(mVertexCount);
+        for(size_t i = 0; i < mVertexCount; ++i)
+        {
+            const XMFLOAT3& p = *reinterpret_cast<const XMFLOAT3*>(posBytes + i*attributes.PositionStride);
+            mPositions[i] = { (p.x - vMin.x)*invExtent, (p.y - vMin.y)*invExtent, (p.z - vMin.z)*invExtent };
+        }
+
+        //
+        // Gather the weighted attributes.
+        //
+
+        bool useNormals = attributes.Normals != nullptr && options.NormalWeight > 0.0f;
+        bool useTexCs = attributes.TexCs != nullptr && options.TexCWeight > 0.0f;
+        mAttributeCount = (useNormals ? 3 : 0) + (useTexCs ? 2 : 0);
+
+        mAttributes.resize(mVertexCount * mAttributeCount);
+        for(size_t i = 0; i < mVertexCount && mAttributeCount > 0; ++i)
+        {
+            double* a = &mAttributes[i*mAttributeCount];
+            if(useNormals)
+            {
+                const XMFLOAT3& n = *reinterpret_cast<const XMFLOAT3*>(
+                    reinterpret_cast<const char*>(attributes.Normals) + i*attributes.NormalStride);
+                *a++ = n.x * options.NormalWeight;
+                *a++ = n.y * options.NormalWeight;
+                *a++ = n.z * options.NormalWeight;
+            }
+            if(useTexCs)
+            {
+                const XMFLOAT2& t = *reinterpret_cast<const XMFLOAT2*>(
+                    reinterpret_cast<const char*>(attributes.TexCs) + i*attributes.TexCStride);
+                *a++ = t.x * options.TexCWeight;
+                *a++ = t.y * options.TexCWeight;
+            }
+        }
+
+        //
+        // Lock vertices that share their position with another vertex (attribute
+        // seams) and vertices on open borders.  Borders are found on the welded
+        // topology so that seams are not mistaken for holes.
+        //
+
+        mLocked.assign(mVertexCount, false);
+
+        struct PositionKey
+        {
+            uint32 Bits[3];
+            bool operator==(const PositionKey& rhs)const { return std::memcmp(Bits, rhs.Bits, sizeof(Bits)) == 0; }
+        };
+        struct PositionHash
+        {
+            size_t operator()(const PositionKey& k)const
+            {
+                return (k.Bits[0] * 73856093u) ^ (k.Bits[1] * 19349663u) ^ (k.Bits[2] * 83492791u);
+            }
+        };
+
+        std::vector<uint32> weld(mVertexCount);
+        std::unordered_map<PositionKey, uint32, PositionHash> firstAtPosition;
+        firstAtPosition.reserve(mVertexCount);
+        for(size_t i = 0; i < mVertexCount; ++i)
+        {
+            const XMFLOAT3& p = *reinterpret_cast<const XMFLOAT3*>(posBytes + i*attributes.PositionStride);
+
+            PositionKey key;
+            std::memcpy(key.Bits, &p, sizeof(key.Bits));
+
+            auto inserted = firstAtPosition.insert({ key, (uint32)i });
+            weld[i] = inserted.first->second;
+            if(!inserted.second)
+            {
+                mLocked[i] = true;
+                mLocked[weld[i]] = true;
+            }
+        }
+
+        std::unordered_map<uint64_t, int> edgeUse;
+        edgeUse.reserve(indexCount);
+        for(size_t t = 0; t + 2 < indexCount; t += 3)
+        {
+            for(uint32 k = 0; k < 3; ++k)
+            {
+                uint32 a = weld[Indices[t + k]];
+                uint32 b = weld[Indices[t + (k+1)%3]];
+
+                // Count the edge a->b positively and b->a negatively; a manifold
+                // interior edge cancels out.
+                if(a < b)
+                    edgeUse[((uint64_t)a << 32) | b]++;
+                else
+                    edgeUse[((uint64_t)b << 32) | a]--;
+            }
+        }
+
+        std::vector<bool> borderWelded(mVertexCount, false);
+        for(const auto& e : edgeUse)
+        {
+            if(e.second != 0)
+            {
+                borderWelded[(uint32)(e.first >> 32)] = true;
+                borderWelded[(uint32)(e.first & 0xffffffff)] = true;
+            }
+        }
+
+        for(size_t i = 0; i < mVertexCount; ++i)
+        {
+            if(borderWelded[weld[i]])
+                mLocked[i] = true;
+        }
+
+        //
+        // Accumulate the per-vertex quadrics from every triangle.
+        //
+
+        mQuadrics.resize(mVertexCount);
+        mAttributeQuadrics.resize(mAttributeCount > 0 ? mVertexCount : 0);
+        mPlaneSets.resize(mVertexCount);
+
+        for(size_t t = 0; t + 2 < indexCount; t += 3)
+        {
+            uint32 i0 = Indices[t+0];
+            uint32 i1 = Indices[t+1];
+            uint32 i2 = Indices[t+2];
+
+            const Vec3& p0 = mPositions[i0];
+            Vec3 e1 = mPositions[i1] - p0;
+            Vec3 e2 = mPositions[i2] - p0;
+            Vec3 n = Cross(e1, e2);
+
+            double length = std::sqrt(Dot(n, n));
+            if(length <= 0.0)
+                continue;
+
+            double area = 0.5*length;
+            n = { n.x/length, n.y/length, n.z/length };
+
+            Quadric plane;
+            plane.AddPlane(n, -Dot(n, p0), area);
+            mQuadrics[i0].Add(plane);
+            mQuadrics[i1].Add(plane);
+            mQuadrics[i2].Add(plane);
+
+            // Triangles are visited in order, so the sets come out sorted.
+            const uint32 planeIndex = (uint32)mPlanes.size();
+            mPlanes.push_back({ n, -Dot(n, p0) });
+            mPlaneSets[i0].push_back(planeIndex);
+            mPlaneSets[i1].push_back(planeIndex);
+            mPlaneSets[i2].push_back(planeIndex);
+
+            if(mAttributeCount == 0)
+                continue;
+
+            // Solve for the gradient g in the triangle plane with g.e1 = da1, g.e2 = da2.
+            double m00 = Dot(e1, e1);
+            double m01 = Dot(e1, e2);
+            double m11 = Dot(e2, e2);
+            double det = m00*m11 - m01*m01;
+            if(std::fabs(det) <= 1e-30)
+                continue;
+
+            double invDet = 1.0 / det;
+
+            AttributeQuadric q;
+            for(uint32 j = 0; j < mAttributeCount; ++j)
+            {
+                double a0 = mAttributes[i0*mAttributeCount + j];
+                double da1 = mAttributes[i1*mAttributeCount + j] - a0;
+                double da2 = mAttributes[i2*mAttributeCount + j] - a0;
+
+                double alpha = ( m11*da1 - m01*da2) * invDet;
+                double beta  = (-m01*da1 + m00*da2) * invDet;
+
+                Vec3 g = { alpha*e1.x + beta*e2.x, alpha*e1.y + beta*e2.y, alpha*e1.z + beta*e2.z };
+                double d = a0 - Dot(g, p0);
+
+                q.Base.A00 += area*g.x*g.x; q.Base.A11 += area*g.y*g.y; q.Base.A22 += area*g.z*g.z;
+                q.Base.A01 += area*g.x*g.y; q.Base.A02 += area*g.x*g.z; q.Base.A12 += area*g.y*g.z;
+                q.Base.B0 += area*d*g.x; q.Base.B1 += area*d*g.y; q.Base.B2 += area*d*g.z;
+                q.Base.C += area*d*d;
+
+                q.G[j][0] = area*g.x;
+                q.G[j][1] = area*g.y;
+                q.G[j][2] = area*g.z;
+                q.D[j] = area*d;
+            }
+            q.Base.W = area;
+
+            mAttributeQuadrics[i0].Add(q);
+            mAttributeQuadrics[i1].Add(q);
+            mAttributeQuadrics[i2].Add(q);
+        }
+    }
+
+    void Simplifier::BuildAdjacency()
+    {
+        mAdjacencyOffset.assign(mVertexCount + 1, 0);
+        for(uint32 i : Indices)
+            mAdjacencyOffset[i+1]++;
+
+        for(size_t v = 0; v < mVertexCount; ++v)
+            mAdjacencyOffset[v+1] += mAdjacencyOffset[v];
+
+        mAdjacency.resize(Indices.size());
+        std::vector<uint32> fill(mAdjacencyOffset.begin(), mAdjacencyOffset.end() - 1);
+        for(size_t i = 0; i < Indices.size(); ++i)
+            mAdjacency[fill[Indices[i]]++] = (uint32)(i / 3);
+    }
+
+    bool Simplifier::IsLinkConditionMet(uint32 from, uint32 to)const
+    {
+        // Collapsing the edge from-to is only manifold preserving if the vertices
+        // adjacent to both are exactly the apexes of the triangles on the edge.
+        std::vector<uint32> fromRing;
+        uint32 sharedTriangles = 0;
+
+        for(uint32 k = mAdjacencyOffset[from]; k < mAdjacencyOffset[from+1]; ++k)
+        {
+            const uint32* tri = &Indices[mAdjacency[k]*3];
+            bool hasTo = tri[0] == to || tri[1] == to || tri[2] == to;
+            sharedTriangles += hasTo ? 1 : 0;
+
+            for(uint32 c = 0; c < 3; ++c)
+            {
+                if(tri[c] != from && tri[c] != to)
+                    fromRing.push_back(tri[c]);
+            }
+        }
+
+        std::sort(fromRing.begin(), fromRing.end());
+        fromRing.erase(std::unique(fromRing.begin(), fromRing.end()), fromRing.end());
+
+        std::vector<uint32> common;
+        for(uint32 k = mAdjacencyOffset[to]; k < mAdjacencyOffset[to+1]; ++k)
+        {
+            const uint32* tri = &Indices[mAdjacency[k]*3];
+            for(uint32 c = 0; c < 3; ++c)
+            {
+                if(tri[c] != from && tri[c] != to &&
+                   std::binary_search(fromRing.begin(), fromRing.end(), tri[c]))
+                {
+                    common.push_back(tri[c]);
+                }
+            }
+        }
+
+        std::sort(common.begin(), common.end());
+        common.erase(std::unique(common.begin(), common.end()), common.end());
+
+        return common.size() == sharedTriangles;
+    }
+
+    bool Simplifier::HasFlips(uint32 from, uint32 to)const
+    {
+        const Vec3& target = mPositions[to];
+
+        for(uint32 k = mAdjacencyOffset[from]; k < mAdjacencyOffset[from+1]; ++k)
+        {
+            const uint32* tri = &Indices[mAdjacency[k]*3];
+
+            // Triangles on the collapsed edge disappear.
+            if(tri[0] == to || tri[1] == to || tri[2] == to)
+                continue;
+
+            // Rotate so that 'from' is first.
+            uint32 c = tri[0] == from ? 0 : (tri[1] == from ? 1 : 2);
+            const Vec3& b = mPositions[tri[(c+1)%3]];
+            const Vec3& d = mPositions[tri[(c+2)%3]];
+            const Vec3& a = mPositions[from];
+
+            Vec3 before = Cross(b - a, d - a);
+            Vec3 after = Cross(b - target, d - target);
+
+            // Reject flipped and near degenerate results.
+            double dot = Dot(before, after);
+            if(dot <= 1e-3 * std::sqrt(Dot(before, before) * Dot(after, after)))
+                return true;
+        }
+
+        return false;
+    }
+
+    double Simplifier::CollapseCost(uint32 from, uint32 to, double& geometricError)const
+    {
+        const Quadric& q = mQuadrics[from];
+        geometricError = q.W > 0.0 ? std::fabs(q.Raw(mPositions[to])) / q.W : 0.0;
+
+        double cost = geometricError;
+        if(mAttributeCount > 0)
+        {
+            cost += mAttributeQuadrics[from].Eval(mPositions[to],
+                &mAttributes[to*mAttributeCount], mAttributeCount);
+        }
+
+        return cost;
+    }
+
+    double Simplifier::Deviation(uint32 from, uint32 to)const
+    {
+        const Vec3& p = mPositions[to];
+
+        double deviation = 0.0;
+        for(uint32 plane : mPlaneSets[from])
+            deviation = std::max(deviation, std::fabs(Dot(mPlanes[plane].N, p) + mPlanes[plane].D));
+
+        return deviation;
+    }
+
+    bool Simplifier::Evaluate(uint32 from, uint32 to, double maxError, Collapse& collapse)const
+    {
+        if(mLocked[from])
+            return false;
+
+        // The quadric error is a weighted mean of the squared plane distances, so a
+        // collapse over maxError there is over it in the maximum as well, and the
+        // plane sets need not be walked.
+        double geometricError = 0.0;
+        double cost = CollapseCost(from, to, geometricError);
+        if(geometricError > maxError*maxError)
+            return false;
+
+        double deviation = Deviation(from, to);
+        if(deviation > maxError)
+            return false;
+
+        collapse = { from, to, cost, deviation };
+        return true;
+    }
+
+    void Simplifier::Run(uint32 targetTriangleCount, float maxError)
+    {
+        uint32 triangleCount = (uint32)(Indices.size() / 3);
+
+        std::vector<uint32> remap(mVertexCount);
+        std::vector<bool> passLocked(mVertexCount);
+        std::vector<Collapse> candidates;
+        std::vector<uint32> merged;
+
+        while(triangleCount > targetTriangleCount)
+        {
+            BuildAdjacency();
+
+            //
+            // Cost every eligible half-edge collapse.  Both directions of an edge
+            // are candidates, so when the cheaper one moves the surface too far
+            // the other still gets its turn.
+            //
+
+            candidates.clear();
+            size_t edgeCount = 0;
+            for(size_t t = 0; t < Indices.size(); t += 3)
+            {
+                for(uint32 k = 0; k < 3; ++k)
+                {
+                    uint32 a = Indices[t + k];
+                    uint32 b = Indices[t + (k+1)%3];
+
+                    // Each interior edge is visited from both of its triangles; look
+                    // at both directions only from the one where a < b.
+                    if(a > b)
+                        continue;
+
+                    Collapse collapse;
+                    bool eligible = false;
+
+                    if(Evaluate(a, b, maxError, collapse))
+                    {
+                        candidates.push_back(collapse);
+                        eligible = true;
+                    }
+                    if(Evaluate(b, a, maxError, collapse))
+                    {
+                        candidates.push_back(collapse);
+                        eligible = true;
+                    }
+
+                    if(eligible)
+                        edgeCount++;
+                }
+            }
+
+            if(candidates.empty())
+                break;
+
+            std::sort(candidates.begin(), candidates.end(),
+                [](const Collapse& lhs, const Collapse& rhs) { return lhs.Cost < rhs.Cost; });
+
+            //
+            // Apply the cheapest independent collapses.  Each accepted collapse locks
+            // the one-ring of the removed vertex for the rest of the pass so that the
+            // link and flip tests above stay valid.
+            //
+
+            for(size_t v = 0; v < mVertexCount; ++v)
+                remap[v] = (uint32)v;
+            std::fill(passLocked.begin(), passLocked.end(), false);
+
+            // Limiting the work per pass keeps the order close to a true greedy one.
+            size_t passBudget = std::max<size_t>(edgeCount / 6, 1);
+            uint32 removedTriangles = 0;
+            size_t applied = 0;
+
+            for(const Collapse& c : candidates)
+            {
+                if(triangleCount - removedTriangles <= targetTriangleCount || applied >= passBudget)
+                    break;
+
+                if(passLocked[c.From] || passLocked[c.To])
+                    continue;
+
+                if(!IsLinkConditionMet(c.From, c.To) || HasFlips(c.From, c.To))
+                    continue;
+
+                for(uint32 k = mAdjacencyOffset[c.From]; k < mAdjacencyOffset[c.From+1]; ++k)
+                {
+                    const uint32* tri = &Indices[mAdjacency[k]*3];
+                    passLocked[tri[0]] = true;
+                    passLocked[tri[1]] = true;
+                    passLocked[tri[2]] = true;
+
+                    if(tri[0] == c.To || tri[1] == c.To || tri[2] == c.To)
+                        removedTriangles++;
+                }
+
+                remap[c.From] = c.To;
+                mQuadrics[c.To].Add(mQuadrics[c.From]);
+                if(mAttributeCount > 0)
+                    mAttributeQuadrics[c.To].Add(mAttributeQuadrics[c.From]);
+
+                std::vector<uint32>& toPlanes = mPlaneSets[c.To];
+                merged.clear();
+                std::set_union(toPlanes.begin(), toPlanes.end(),
+                    mPlaneSets[c.From].begin(), mPlaneSets[c.From].end(), std::back_inserter(merged));
+                toPlanes.swap(merged);
+                std::vector<uint32>().swap(mPlaneSets[c.From]);
+
+                // c.From has not taken in another vertex this pass (it would be
+                // locked), so the deviation found when costing still holds.
+                MaxDeviation = std::max(MaxDeviation, c.Deviation);
+                applied++;
+            }
+
+            if(applied == 0)
+                break;
+
+            //
+            // Rewrite the triangle list and drop the collapsed triangles.
+            //
+
+            size_t write = 0;
+            for(size_t t = 0; t < Indices.size(); t += 3)
+            {
+                uint32 i0 = remap[Indices[t+0]];
+                uint32 i1 = remap[Indices[t+1]];
+                uint32 i2 = remap[Indices[t+2]];
+
+                if(i0 == i1 || i1 == i2 || i0 == i2)
+                    continue;
+
+                Indices[write++] = i0;
+                Indices[write++] = i1;
+                Indices[write++] = i2;
+            }
+            Indices.resize(write);
+
+            triangleCount = (uint32)(Indices.size() / 3);
+        }
+    }
+
+    MeshSimplifier::Lod MakeLod(const Simplifier& simplifier, size_t vertexCount, bool optimize)
+    {
+        MeshSimplifier::Lod lod;
+        lod.Indices = simplifier.Indices;
+        lod.TriangleCount = (uint32)(lod.Indices.size() / 3);
+        lod.RelativeError = (float)simplifier.MaxDeviation;
+        lod.Error = lod.RelativeError * simplifier.Extent;
+
+        if(optimize && !lod.Indices.empty())
+        {
+            std::vector<uint32> source = lod.Indices;
+            MeshOptimizer::OptimizeVertexCache(lod.Indices.data(), source.data(), source.size(), vertexCount);
+        }
+
+        return lod;
+    }
+}
+
+MeshSimplifier::VertexAttributes MeshSimplifier::Attributes(const GeometryGenerator::MeshData& meshData)
+{
+    return Attributes(meshData.Vertices,
+        &GeometryGenerator::Vertex::Position,
+        &GeometryGenerator::Vertex::Normal,
+        &GeometryGenerator::Vertex::TexC);
+}
+
+MeshSimplifier::Lod MeshSimplifier::Simplify(const VertexAttributes& attributes, const uint32* indices,
+    size_t indexCount, uint32 targetTriangleCount, float maxError, const Options& options)
+{
+    Simplifier simplifier(attributes, indices, indexCount, options);
+    simplifier.Run(targetTriangleCount, maxError);
+
+    return MakeLod(simplifier, attributes.VertexCount, options.OptimizeVertexCache);
+}
+
+std::vector<MeshSimplifier::Lod> MeshSimplifier::BuildLodChain(const VertexAttributes& attributes,
+    const uint32* indices, size_t indexCount, const std::vector<LodTarget>& targets, const Options& options)
+{
+    std::vector<Lod> lods;
+
+    Simplifier simplifier(attributes, indices, indexCount, options);
+    lods.push_back(MakeLod(simplifier, attributes.VertexCount, false));
+
+    for(const LodTarget& target : targets)
+    {
+        simplifier.Run(target.TriangleCount, target.MaxError);
+        lods.push_back(MakeLod(simplifier, attributes.VertexCount, options.OptimizeVertexCache));
+    }
+
+    return lods;
+}
+
+std::vector<MeshSimplifier::Lod> MeshSimplifier::BuildLodChain(const GeometryGenerator::MeshData& meshData,
+    uint32 lodCount, const Options& options)
+{
+    std::vector<LodTarget> targets;
+
+    uint32 triangleCount = (uint32)(meshData.Indices32.size() / 3);
+    for(uint32 i = 1; i < lodCount; ++i)
+    {
+        triangleCount /= 2;
+
+        LodTarget target;
+        target.TriangleCount = triangleCount;
+        targets.push_back(target);
+    }
+
+    return BuildLodChain(Attributes(meshData), meshData.Indices32.data(), meshData.Indices32.size(),
+        targets, options);
+}
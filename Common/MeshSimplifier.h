@@ -0,0 +1,167 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Quadric error edge-collapse simplification (Garland and Heckbert) used to build
+// discrete level of detail chains.
+//
+//   -Collapses are half-edge collapses: a vertex is merged into one of its
+//    neighbours, so every LOD indexes the original vertex buffer.  The whole
+//    chain can therefore share one vertex buffer and one index buffer with a
+//    SubmeshGeometry entry per LOD.
+//   -The collapse cost combines the position quadric with attribute quadrics
+//    (Hoppe, "New Quadric Metric for Simplifying Meshes with Appearance
+//    Attributes") for normals and texture coordinates when they are present.
+//   -Vertices on open borders or on attribute seams (several vertices sharing
+//    one position, e.g., the u = 0/1 seam of CreateSphere) never move, so the
+//    simplified mesh does not crack.
+//
+// The error of a LOD is the largest distance of any of its vertices from the
+// planes of the original triangles that vertex now stands in for, and no
+// collapse may take it past the limit given.  The quadric cost only orders the
+// collapses.  Errors are reported relative to the mesh extent (the largest side
+// of the bounding box), so 0.01 means the surface moved about 1% of the model's
+// size.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <cstdint>
+#include <vector>
+
+class MeshSimplifier
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+    // Strided views of the vertex attributes used by the error metric.  Normals and
+    // texture coordinates are optional; set the pointer to null to ignore one.
+    struct VertexAttributes
+    {
+        size_t VertexCount = 0;
+
+        const DirectX::XMFLOAT3* Positions = nullptr;
+        size_t PositionStride = sizeof(DirectX::XMFLOAT3);
+
+        const DirectX::XMFLOAT3* Normals = nullptr;
+        size_t NormalStride = sizeof(DirectX::XMFLOAT3);
+
+        const DirectX::XMFLOAT2* TexCs = nullptr;
+        size_t TexCStride = sizeof(DirectX::XMFLOAT2);
+    };
+
+    struct Options
+    {
+        Options() :
+            NormalWeight(0.1f),
+            TexCWeight(0.1f),
+            OptimizeVertexCache(true){}
+
+        // Attribute values are scaled by these weights before being compared with
+        // the (extent normalized) positions.  Zero ignores the attribute.
+        float NormalWeight;
+        float TexCWeight;
+
+        // Reorder each LOD's triangles for the post-transform cache.
+        bool OptimizeVertexCache;
+    };
+
+    // Stop at whichever limit is reached first.
+    struct LodTarget
+    {
+        uint32 TriangleCount = 0;
+        float MaxError = 1.0f;
+    };
+
+    struct Lod
+    {
+        std::vector<uint32> Indices;
+        uint32 TriangleCount = 0;
+
+        // Largest distance of a vertex from the original surface it replaces,
+        // relative to the mesh extent and in model space units respectively.
+        float RelativeError = 0.0f;
+        float Error = 0.0f;
+    };
+
+    static VertexAttributes Attributes(const GeometryGenerator::MeshData& meshData);
+
+    ///<summary>
+    /// Builds an attribute view over an application vertex array, e.g.,
+    /// Attributes(vertices, &Vertex::Pos, &Vertex::Normal, &Vertex::TexC).
+    ///</summary>
+    template<typename VertexT>
+    static VertexAttributes Attributes(const std::vector<VertexT>& vertices,
+        DirectX::XMFLOAT3 VertexT::* position,
+        DirectX::XMFLOAT3 VertexT::* normal = nullptr,
+        DirectX::XMFLOAT2 VertexT::* texC = nullptr)
+    {
+        VertexAttributes attributes;
+        attributes.VertexCount = vertices.size();
+        if(vertices.empty())
+            return attributes;
+
+        attributes.Positions = &(vertices[0].*position);
+        attributes.PositionStride = sizeof(VertexT);
+
+        if(normal != nullptr)
+        {
+            attributes.Normals = &(vertices[0].*normal);
+            attributes.NormalStride = sizeof(VertexT);
+        }
+
+        if(texC != nullptr)
+        {
+            attributes.TexCs = &(vertices[0].*texC);
+            attributes.TexCStride = sizeof(VertexT);
+        }
+
+        return attributes;
+    }
+
+    ///<summary>
+    /// Simplifies a triangle list down to targetTriangleCount triangles or until the
+    /// next collapse would exceed maxError (relative to the mesh extent).  Returns the
+    /// simplified triangle list; it indexes the same vertices as the input.
+    ///</summary>
+    static Lod Simplify(const VertexAttributes& attributes, const uint32* indices, size_t indexCount,
+        uint32 targetTriangleCount, float maxError, const Options& options = Options());
+
+    ///<summary>
+    /// Builds a chain of progressively coarser LODs in a single simplification run,
+    /// so errors accumulate from the original mesh rather than from the previous
+    /// LOD.  The first entry is always the input mesh itself.
+    ///</summary>
+    static std::vector<Lod> BuildLodChain(const VertexAttributes& attributes, const uint32* indices,
+        size_t indexCount, const std::vector<LodTarget>& targets, const Options& options = Options());
+
+    ///<summary>
+    /// Convenience overload that halves the triangle count for each of lodCount - 1
+    /// coarser levels.
+    ///</summary>
+    static std::vector<Lod> BuildLodChain(const GeometryGenerator::MeshData& meshData, uint32 lodCount,
+        const Options& options = Options());
+
+    ///<summary>
+    /// Concatenates the LOD index lists into one index buffer and fills a submesh entry
+    /// (e.g., SubmeshGeometry) per LOD.  All LODs share the vertex buffer, so
+    /// BaseVertexLocation is baseVertex for every entry.
+    ///</summary>
+    template<typename IndexT, typename SubmeshT>
+    static void PackLods(const std::vector<Lod>& lods, std::vector<IndexT>& indices,
+        std::vector<SubmeshT>& submeshes, int baseVertex = 0)
+    {
+        for(const Lod& lod : lods)
+        {
+            SubmeshT submesh;
+            submesh.IndexCount = (uint32)lod.Indices.size();
+            submesh.StartIndexLocation = (uint32)indices.size();
+            submesh.BaseVertexLocation = baseVertex;
+            submeshes.push_back(submesh);
+
+            for(uint32 i : lod.Indices)
+                indices.push_back(static_cast<IndexT>(i));
+        }
+    }
+};
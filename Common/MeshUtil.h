@@ -0,0 +1,77 @@
+//***************************************************************************************
+// MeshUtil.h
+//
+// Helpers shared by the mesh processing code (GeometryGenerator, MeshCleanup,
+// MeshOptimizer, CompactIndices): a parallel loop that stays serial for small
+// meshes, and vertex to triangle adjacency.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ppl.h>
+#include <vector>
+
+class MeshUtil
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+    ///<summary>
+    /// Runs body(i) for i in [0, count), spread over worker threads when
+    /// count*workPerItem, the total amount of work in rough units such as
+    /// vertices written, is large enough.  Each call must write disjoint data.
+    ///</summary>
+    template<typename Body>
+    static void ParallelFor(uint32 count, uint32 workPerItem, const Body& body)
+    {
+        // Below this much work the thread hand-off costs more than it saves.
+        const std::uint64_t parallelThreshold = 64*1024;
+
+        if((std::uint64_t)count*workPerItem < parallelThreshold)
+        {
+            for(uint32 i = 0; i < count; ++i)
+                body(i);
+        }
+        else
+        {
+            concurrency::parallel_for(0u, count, body);
+        }
+    }
+
+    //
+    // Vertex -> triangle adjacency in one flat array: the triangles using vertex
+    // v are Triangles[Offset[v]..Offset[v+1]), in increasing order.  Gathering
+    // per-triangle values per vertex (rather than scattering them per triangle)
+    // needs no locks, and sums them in the same order whatever the number of
+    // threads.  Every index must be less than vertexCount.
+    //
+    struct VertexAdjacency
+    {
+        VertexAdjacency(const uint32* indices, uint32 triangleCount, uint32 vertexCount) :
+            Offset(vertexCount + 1, 0),
+            Triangles((size_t)triangleCount*3)
+        {
+            for(size_t i = 0; i < (size_t)triangleCount*3; ++i)
+                Offset[indices[i] + 1]++;
+            for(uint32 v = 0; v < vertexCount; ++v)
+                Offset[v+1] += Offset[v];
+
+            std::vector<uint32> fill(Offset.begin(), Offset.end() - 1);
+            for(uint32 t = 0; t < triangleCount; ++t)
+            {
+                Triangles[fill[indices[t*3+0]]++] = t;
+                Triangles[fill[indices[t*3+1]]++] = t;
+                Triangles[fill[indices[t*3+2]]++] = t;
+            }
+        }
+
+        // The number of triangles using vertex v.
+        uint32 Count(uint32 v)const { return Offset[v+1] - Offset[v]; }
+
+        std::vector<uint32> Offset;
+        std::vector<uint32> Triangles;
+    };
+};
@@ -0,0 +1,382 @@
+//***************************************************************************************
+// MeshletBuilder.cpp
+//***************************************************************************************
+
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = MeshletBuilder::uint32;
+
+    // Cones narrower than this (the minimum dot product between the axis and a
+    // triangle normal) are kept; wider ones almost never cull and are disabled.
+    const float kMinConeDot = 0.1f;
+
+    // How strongly meshlet growth prefers triangles facing the same way.
+    const float kConeWeight = 8.0f;
+
+    class MeshletWriter
+    {
+    public:
+        MeshletWriter(const XMFLOAT3* positions, size_t positionStride, size_t vertexCount,
+            MeshletBuilder::MeshletData& data) :
+            mPositions(reinterpret_cast<const char*>(positions)),
+            mPositionStride(positionStride),
+            mLocalIndex(vertexCount, UINT32_MAX),
+            mData(data)
+        {
+        }
+
+        uint32 VertexCount()const { return (uint32)mVertices.size(); }
+        uint32 TriangleCount()const { return (uint32)(mTriangles.size() / 3); }
+        bool Contains(uint32 v)const { return mLocalIndex[v] != UINT32_MAX; }
+
+        XMVECTOR Position(uint32 v)const
+        {
+            return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(mPositions + v*mPositionStride));
+        }
+
+        XMVECTOR Centroid()const
+        {
+            return mTriangles.empty() ? XMVectorZero() : mCentroidSum / (float)TriangleCount();
+        }
+
+        XMVECTOR AverageNormal()const
+        {
+            return XMVector3Normalize(mNormalSum);
+        }
+
+        void Add(const uint32* tri)
+        {
+            for(uint32 k = 0; k < 3; ++k)
+            {
+                if(mLocalIndex[tri[k]] == UINT32_MAX)
+                {
+                    mLocalIndex[tri[k]] = (uint32)mVertices.size();
+                    mVertices.push_back(tri[k]);
+                }
+                mTriangles.push_back(tri[k]);
+            }
+
+            XMVECTOR p0 = Position(tri[0]);
+            XMVECTOR p1 = Position(tri[1]);
+            XMVECTOR p2 = Position(tri[2]);
+            mCentroidSum += (p0 + p1 + p2) / 3.0f;
+            mNormalSum += XMVector3Normalize(XMVector3Cross(p1 - p0, p2 - p0));
+        }
+
+        void Flush();
+
+        const std::vector<uint32>& Vertices()const { return mVertices; }
+
+    private:
+        void ComputeBounds(MeshletBuilder::Meshlet& meshlet)const;
+
+        const char* mPositions;
+        size_t mPositionStride;
+
+        std::vector<uint32> mLocalIndex;
+        std::vector<uint32> mVertices;
+        std::vector<uint32> mTriangles;
+        XMVECTOR mCentroidSum = XMVectorZero();
+        XMVECTOR mNormalSum = XMVectorZero();
+
+        MeshletBuilder::MeshletData& mData;
+    };
+
+    void MeshletWriter::Flush()
+    {
+        if(mTriangles.empty())
+            return;
+
+        MeshletBuilder::Meshlet meshlet;
+        meshlet.VertexOffset = (uint32)mData.UniqueVertices.size();
+        meshlet.VertexCount = (uint32)mVertices.size();
+        meshlet.TriangleOffset = (uint32)(mData.Indices.size() / 3);
+        meshlet.TriangleCount = (uint32)(mTriangles.size() / 3);
+
+        mData.UniqueVertices.insert(mData.UniqueVertices.end(), mVertices.begin(), mVertices.end());
+        mData.Indices.insert(mData.Indices.end(), mTriangles.begin(), mTriangles.end());
+        for(uint32 v : mTriangles)
+            mData.LocalIndices.push_back((MeshletBuilder::uint8)mLocalIndex[v]);
+
+        ComputeBounds(meshlet);
+        mData.Meshlets.push_back(meshlet);
+
+        for(uint32 v : mVertices)
+            mLocalIndex[v] = UINT32_MAX;
+        mVertices.clear();
+        mTriangles.clear();
+        mCentroidSum = XMVectorZero();
+        mNormalSum = XMVectorZero();
+    }
+
+    void MeshletWriter::ComputeBounds(MeshletBuilder::Meshlet& meshlet)const
+    {
+        std::vector<XMFLOAT3> points(mVertices.size());
+        for(size_t i = 0; i < mVertices.size(); ++i)
+            XMStoreFloat3(&points[i], Position(mVertices[i]));
+
+        BoundingSphere::CreateFromPoints(meshlet.Bounds, points.size(), points.data(), sizeof(XMFLOAT3));
+
+        //
+        // Normal cone.  The axis is the area weighted average normal; the cutoff
+        // follows from the widest normal, and the apex is pushed back far enough
+        // that every triangle plane passes in front of it.
+        //
+
+        const uint32 triangleCount = (uint32)(mTriangles.size() / 3);
+        std::vector<XMFLOAT3> normals(triangleCount);
+
+        XMVECTOR axis = XMVectorZero();
+        for(uint32 t = 0; t < triangleCount; ++t)
+        {
+            XMVECTOR p0 = Position(mTriangles[t*3+0]);
+            XMVECTOR p1 = Position(mTriangles[t*3+1]);
+            XMVECTOR p2 = Position(mTriangles[t*3+2]);
+
+            // Clockwise front faces in a left-handed system: this points out of the front face.
+            XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+            axis += n;
+            XMStoreFloat3(&normals[t], XMVector3Normalize(n));
+        }
+
+        if(XMVectorGetX(XMVector3LengthSq(axis)) <= 0.0f)
+            return;
+
+        axis = XMVector3Normalize(axis);
+
+        float minDot = 1.0f;
+        for(uint32 t = 0; t < triangleCount; ++t)
+        {
+            XMVECTOR n = XMLoadFloat3(&normals[t]);
+            if(XMVectorGetX(XMVector3LengthSq(n)) > 0.0f)
+                minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(n, axis)));
+        }
+
+        if(minDot <= kMinConeDot)
+            return;
+
+        XMVECTOR center = XMLoadFloat3(&meshlet.Bounds.Center);
+
+        float maxT = 0.0f;
+        for(uint32 t = 0; t < triangleCount; ++t)
+        {
+            XMVECTOR n = XMLoadFloat3(&normals[t]);
+            XMVECTOR p0 = Position(mTriangles[t*3+0]);
+
+            // Solve dot(center - t*axis - p0, n) = 0 for t.
+            float dc = XMVectorGetX(XMVector3Dot(center - p0, n));
+            float dn = XMVectorGetX(XMVector3Dot(axis, n));
+            if(dn > 0.0f)
+                maxT = std::max(maxT, dc / dn);
+        }
+
+        XMStoreFloat3(&meshlet.ConeApex, center - axis*maxT);
+        XMStoreFloat3(&meshlet.ConeAxis, axis);
+        meshlet.ConeCutoff = sqrtf(1.0f - minDot*minDot);
+    }
+}
+
+MeshletBuilder::MeshletData MeshletBuilder::Build(const XMFLOAT3* positions, size_t positionStride,
+    size_t vertexCount, const uint32* indices, size_t indexCount)
+{
+    MeshletData data;
+
+    const uint32 triangleCount = (uint32)(indexCount / 3);
+    if(triangleCount == 0)
+        return data;
+
+    data.Indices.reserve(triangleCount * 3);
+    data.LocalIndices.reserve(triangleCount * 3);
+
+    //
+    // Vertex -> triangle adjacency.
+    //
+
+    std::vector<uint32> adjacencyOffset(vertexCount + 1, 0);
+    for(size_t i = 0; i < triangleCount * 3; ++i)
+        adjacencyOffset[indices[i]+1]++;
+    for(size_t v = 0; v < vertexCount; ++v)
+        adjacencyOffset[v+1] += adjacencyOffset[v];
+
+    std::vector<uint32> adjacency(triangleCount * 3);
+    std::vector<uint32> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for(size_t i = 0; i < triangleCount * 3; ++i)
+        adjacency[fill[indices[i]]++] = (uint32)(i / 3);
+
+    //
+    // Grow meshlets greedily.  Triangles that add no new vertex are taken first;
+    // otherwise the next triangle is the connected one closest to the meshlet's
+    // centroid, with the distance inflated for normals that deviate from the
+    // meshlet's average so that the normal cones stay narrow.
+    //
+
+    std::vector<bool> used(triangleCount, false);
+    MeshletWriter writer(positions, positionStride, vertexCount, data);
+
+    uint32 seedCursor = 0;
+    for(uint32 emitted = 0; emitted < triangleCount; ++emitted)
+    {
+        uint32 best = UINT32_MAX;
+
+        if(writer.TriangleCount() > 0)
+        {
+            XMVECTOR centroid = writer.Centroid();
+            XMVECTOR normal = writer.AverageNormal();
+            bool bestIsFree = false;
+            float bestScore = FLT_MAX;
+
+            for(uint32 v : writer.Vertices())
+            {
+                for(uint32 k = adjacencyOffset[v]; k < adjacencyOffset[v+1]; ++k)
+                {
+                    uint32 t = adjacency[k];
+                    if(used[t])
+                        continue;
+
+                    const uint32* tri = &indices[t*3];
+                    uint32 newVertices = (writer.Contains(tri[0]) ? 0 : 1) +
+                                         (writer.Contains(tri[1]) ? 0 : 1) +
+                                         (writer.Contains(tri[2]) ? 0 : 1);
+
+                    bool isFree = newVertices == 0;
+                    if(writer.VertexCount() + newVertices > MaxVertices || (bestIsFree && !isFree))
+                        continue;
+
+                    XMVECTOR p0 = writer.Position(tri[0]);
+                    XMVECTOR p1 = writer.Position(tri[1]);
+                    XMVECTOR p2 = writer.Position(tri[2]);
+
+                    XMVECTOR n = XMVector3Normalize(XMVector3Cross(p1 - p0, p2 - p0));
+                    float spread = 1.0f - XMVectorGetX(XMVector3Dot(n, normal));
+
+                    float distance = XMVectorGetX(XMVector3Length((p0 + p1 + p2) / 3.0f - centroid));
+                    float score = distance * (1.0f + kConeWeight*spread) * (1.0f + 0.5f*newVertices);
+
+                    if((isFree && !bestIsFree) || score < bestScore)
+                    {
+                        best = t;
+                        bestIsFree = isFree;
+                        bestScore = score;
+                    }
+                }
+            }
+
+            // Nothing connected fits; start a new meshlet.
+            if(best == UINT32_MAX)
+                writer.Flush();
+        }
+
+        if(best == UINT32_MAX)
+        {
+            while(used[seedCursor])
+                ++seedCursor;
+            best = seedCursor;
+        }
+
+        writer.Add(&indices[best*3]);
+        used[best] = true;
+
+        // A meshlet with a few vertex slots left can still take connected triangles,
+        // so only flush once it is completely full.
+        if(writer.TriangleCount() == MaxTriangles || writer.VertexCount() == MaxVertices)
+            writer.Flush();
+    }
+
+    writer.Flush();
+
+    return data;
+}
+
+MeshletBuilder::MeshletData MeshletBuilder::Build(const GeometryGenerator::MeshData& meshData)
+{
+    return Build(meshData.Vertices.empty() ? nullptr : &meshData.Vertices[0].Position,
+        sizeof(GeometryGenerator::Vertex), meshData.Vertices.size(),
+        meshData.Indices32.data(), meshData.Indices32.size());
+}
+
+void MeshletBuilder::Cull(const MeshletData& data, const BoundingFrustum& localFrustum,
+    const XMFLOAT3& localEyePos, std::vector<IndexRange>& ranges, CullStats* stats)
+{
+    XMVECTOR eye = XMLoadFloat3(&localEyePos);
+
+    CullStats result;
+    result.MeshletCount = (uint32)data.Meshlets.size();
+
+    // Index one past the end of the last range appended by this call, so that
+    // only ranges we emitted get extended.
+    uint32 openRangeEnd = UINT32_MAX;
+
+    for(const Meshlet& meshlet : data.Meshlets)
+    {
+        result.TriangleCount += meshlet.TriangleCount;
+
+        if(localFrustum.Contains(meshlet.Bounds) == DISJOINT)
+        {
+            result.FrustumCulled++;
+            continue;
+        }
+
+        if(meshlet.ConeCutoff <= 1.0f)
+        {
+            XMVECTOR toApex = XMLoadFloat3(&meshlet.ConeApex) - eye;
+            float distance = XMVectorGetX(XMVector3Length(toApex));
+            float d = XMVectorGetX(XMVector3Dot(toApex, XMLoadFloat3(&meshlet.ConeAxis)));
+
+            if(d >= meshlet.ConeCutoff * distance)
+            {
+                result.ConeCulled++;
+                continue;
+            }
+        }
+
+        result.VisibleTriangleCount += meshlet.TriangleCount;
+
+        uint32 start = meshlet.TriangleOffset * 3;
+        uint32 count = meshlet.TriangleCount * 3;
+
+        if(start == openRangeEnd)
+        {
+            ranges.back().IndexCount += count;
+        }
+        else
+        {
+            IndexRange range;
+            range.StartIndexLocation = start;
+            range.IndexCount = count;
+            ranges.push_back(range);
+        }
+
+        openRangeEnd = start + count;
+    }
+
+    if(stats != nullptr)
+        *stats = result;
+}
+
+void MeshletBuilder::Cull(const MeshletData& data, const BoundingFrustum& viewFrustum,
+    FXMMATRIX world, CXMMATRIX view, std::vector<IndexRange>& ranges, CullStats* stats)
+{
+    XMVECTOR viewDet = XMMatrixDeterminant(view);
+    XMMATRIX invView = XMMatrixInverse(&viewDet, view);
+
+    XMVECTOR worldDet = XMMatrixDeterminant(world);
+    XMMATRIX invWorld = XMMatrixInverse(&worldDet, world);
+
+    // View space to the object's local space.
+    XMMATRIX viewToLocal = XMMatrixMultiply(invView, invWorld);
+
+    BoundingFrustum localFrustum;
+    viewFrustum.Transform(localFrustum, viewToLocal);
+
+    XMFLOAT3 localEye;
+    XMStoreFloat3(&localEye, XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), viewToLocal));
+
+    Cull(data, localFrustum, localEye, ranges, stats);
+}
@@ -0,0 +1,124 @@
+//***************************************************************************************
+// MeshletBuilder.h
+//
+// Splits an indexed triangle list into small clusters ("meshlets") so that culling
+// can work below the object level.
+//
+//   -Each meshlet references at most MaxVertices unique vertices and MaxTriangles
+//    triangles, which matches the usual mesh shader limits.
+//   -The triangles of a meshlet are contiguous in MeshletData::Indices, so a
+//    meshlet (or a run of adjacent meshlets) can be drawn with a regular
+//    DrawIndexedInstanced call using the original vertex buffer.
+//   -Each meshlet stores a bounding sphere and a normal cone.  If the camera is
+//    inside the cone's "backface region" every triangle of the meshlet faces
+//    away from it and the whole meshlet can be skipped.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+class MeshletBuilder
+{
+public:
+
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+
+    static const uint32 MaxVertices = 64;
+    static const uint32 MaxTriangles = 124;
+
+    struct Meshlet
+    {
+        // Range in MeshletData::UniqueVertices.
+        uint32 VertexOffset = 0;
+        uint32 VertexCount = 0;
+
+        // Range in MeshletData::Indices (and MeshletData::LocalIndices), in triangles.
+        uint32 TriangleOffset = 0;
+        uint32 TriangleCount = 0;
+
+        DirectX::BoundingSphere Bounds;
+
+        // Backface cone.  The meshlet is entirely backfacing for any eye position E with
+        //   dot(normalize(ConeApex - E), ConeAxis) >= ConeCutoff.
+        // ConeCutoff > 1 marks a cone that is too wide to ever cull.
+        DirectX::XMFLOAT3 ConeApex = { 0.0f, 0.0f, 0.0f };
+        DirectX::XMFLOAT3 ConeAxis = { 0.0f, 0.0f, 0.0f };
+        float ConeCutoff = 2.0f;
+    };
+
+    struct MeshletData
+    {
+        std::vector<Meshlet> Meshlets;
+
+        // The input triangles reordered so that each meshlet is contiguous.  These
+        // index the original vertex buffer.
+        std::vector<uint32> Indices;
+
+        // Mesh shader style data: the vertices a meshlet uses and 8-bit per-meshlet
+        // local indices into that list (three per triangle).
+        std::vector<uint32> UniqueVertices;
+        std::vector<uint8> LocalIndices;
+    };
+
+    // A run of surviving triangles, in Indices, ready for DrawIndexedInstanced.
+    struct IndexRange
+    {
+        uint32 StartIndexLocation = 0;
+        uint32 IndexCount = 0;
+    };
+
+    struct CullStats
+    {
+        uint32 MeshletCount = 0;
+        uint32 FrustumCulled = 0;
+        uint32 ConeCulled = 0;
+        uint32 TriangleCount = 0;
+        uint32 VisibleTriangleCount = 0;
+    };
+
+    ///<summary>
+    /// Builds meshlets over a triangle list.  positions is a strided view of the vertex
+    /// positions.  For best results run MeshOptimizer first so that consecutive
+    /// triangles are spatially close.
+    ///</summary>
+    static MeshletData Build(const DirectX::XMFLOAT3* positions, size_t positionStride, size_t vertexCount,
+        const uint32* indices, size_t indexCount);
+
+    static MeshletData Build(const GeometryGenerator::MeshData& meshData);
+
+    ///<summary>
+    /// Builds meshlets over an application mesh, e.g., the skull:
+    /// Build(vertices, &Vertex::Pos, indices).
+    ///</summary>
+    template<typename VertexT, typename IndexT>
+    static MeshletData Build(const std::vector<VertexT>& vertices, DirectX::XMFLOAT3 VertexT::* position,
+        const std::vector<IndexT>& indices)
+    {
+        std::vector<uint32> indices32(indices.begin(), indices.end());
+
+        return Build(vertices.empty() ? nullptr : &(vertices[0].*position), sizeof(VertexT), vertices.size(),
+            indices32.data(), indices32.size());
+    }
+
+    ///<summary>
+    /// Culls meshlets against a frustum and an eye position given in the mesh's local
+    /// space.  Survivors are appended to ranges; adjacent survivors are merged into a
+    /// single range.
+    ///</summary>
+    static void Cull(const MeshletData& data, const DirectX::BoundingFrustum& localFrustum,
+        const DirectX::XMFLOAT3& localEyePos, std::vector<IndexRange>& ranges, CullStats* stats = nullptr);
+
+    ///<summary>
+    /// Same as above, taking the view space frustum (BoundingFrustum::CreateFromMatrix
+    /// of the projection) and the object's world and the camera's view matrices, like
+    /// InstancingAndCullingApp does per instance.
+    ///</summary>
+    static void Cull(const MeshletData& data, const DirectX::BoundingFrustum& viewFrustum,
+        DirectX::FXMMATRIX world, DirectX::CXMMATRIX view, std::vector<IndexRange>& ranges,
+        CullStats* stats = nullptr);
+};
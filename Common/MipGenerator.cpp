@@ -0,0 +1,598 @@
+//***************************************************************************************
+// MipGenerator.cpp
+//***************************************************************************************
+
+#include "MipGenerator.h"
+#include "DDSFile.h"
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ppl.h>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+    using uint8 = MipGenerator::uint8;
+    using uint16 = std::uint16_t;
+    using uint32 = MipGenerator::uint32;
+    using Filter = MipGenerator::Filter;
+    using Level = MipGenerator::Level;
+
+    // Rows handed to a core at a time.
+    const uint32 BandRows = 16;
+
+    template<typename Body>
+    void ParallelForBands(uint32 rows, uint32 pixelsPerRow, const Body& body)
+    {
+        // Below this many pixels the thread hand-off costs more than it saves.
+        const uint32 parallelThreshold = 64*1024;
+
+        if(rows*pixelsPerRow < parallelThreshold)
+        {
+            body(0u, rows);
+        }
+        else
+        {
+            const uint32 bands = (rows + BandRows - 1) / BandRows;
+            concurrency::parallel_for(0u, bands, [&](uint32 band)
+            {
+                body(band*BandRows, std::min(rows, (band + 1)*BandRows));
+            });
+        }
+    }
+
+    enum class Encoding
+    {
+        Unorm8,
+        Float16
+    };
+
+    struct PixelFormat
+    {
+        Encoding Type = Encoding::Unorm8;
+        bool SRGB = false;
+    };
+
+    bool GetPixelFormat(DXGI_FORMAT format, PixelFormat& pf)
+    {
+        // Every channel is filtered the same way and alpha is last in all of them,
+        // so RGBA and BGRA need no swizzle.
+        switch(format)
+        {
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+            pf.Type = Encoding::Unorm8;
+            pf.SRGB = false;
+            return true;
+
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+            pf.Type = Encoding::Unorm8;
+            pf.SRGB = true;
+            return true;
+
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            pf.Type = Encoding::Float16;
+            pf.SRGB = false;
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    size_t BytesPerPixel(const PixelFormat& pf)
+    {
+        return pf.Type == Encoding::Unorm8 ? 4 : 8;
+    }
+
+    //
+    // sRGB.  Decoding is a table lookup.  Encoding picks the 8-bit value whose
+    // interval contains the linear value: Thresholds[i] is the linear value of
+    // the code i + 0.5, so the code is the number of thresholds at or below it.
+    // Buckets gives that count at the start of each 1/BucketCount of the linear
+    // range, which is never more than one code short, so the search is a step or
+    // two instead of a binary search.
+    //
+
+    const int BucketCount = 4096;
+
+    float SRGBToLinear(float c)
+    {
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    struct SRGBTables
+    {
+        SRGBTables()
+        {
+            for(int i = 0; i < 256; ++i)
+                ToLinear[i] = SRGBToLinear(i / 255.0f);
+            for(int i = 0; i < 255; ++i)
+                Thresholds[i] = SRGBToLinear((i + 0.5f) / 255.0f);
+            Thresholds[255] = 2.0f;
+
+            int code = 0;
+            for(int i = 0; i < BucketCount; ++i)
+            {
+                while(code < 255 && Thresholds[code] <= float(i) / BucketCount)
+                    code++;
+                Buckets[i] = (uint8)code;
+            }
+        }
+
+        float ToLinear[256];
+        float Thresholds[256];
+        uint8 Buckets[BucketCount];
+    };
+
+    const SRGBTables& GetSRGBTables()
+    {
+        static const SRGBTables tables;
+        return tables;
+    }
+
+    uint8 LinearToSRGB8(const SRGBTables& tables, float v)
+    {
+        if(!(v > 0.0f))
+            return 0;
+        if(v >= 1.0f)
+            return 255;
+
+        int code = tables.Buckets[(int)(v*BucketCount)];
+        while(tables.Thresholds[code] <= v)
+            code++;
+        return (uint8)code;
+    }
+
+    uint8 ToUnorm8(float v)
+    {
+        return (uint8)(std::min(std::max(v, 0.0f), 1.0f)*255.0f + 0.5f);
+    }
+
+    //
+    // Conversion of rows to and from linear float RGBA.
+    //
+
+    void LoadRow(const PixelFormat& pf, const uint8* src, uint32 width, XMFLOAT4* dst)
+    {
+        if(pf.Type == Encoding::Float16)
+        {
+            const uint16* h = reinterpret_cast<const uint16*>(src);
+            for(uint32 x = 0; x < width; ++x, h += 4)
+            {
+                dst[x] = XMFLOAT4(XMConvertHalfToFloat(h[0]), XMConvertHalfToFloat(h[1]),
+                    XMConvertHalfToFloat(h[2]), XMConvertHalfToFloat(h[3]));
+            }
+        }
+        else if(pf.SRGB)
+        {
+            const SRGBTables& tables = GetSRGBTables();
+            for(uint32 x = 0; x < width; ++x, src += 4)
+            {
+                dst[x] = XMFLOAT4(tables.ToLinear[src[0]], tables.ToLinear[src[1]],
+                    tables.ToLinear[src[2]], src[3] / 255.0f);
+            }
+        }
+        else
+        {
+            for(uint32 x = 0; x < width; ++x, src += 4)
+                dst[x] = XMFLOAT4(src[0] / 255.0f, src[1] / 255.0f, src[2] / 255.0f, src[3] / 255.0f);
+        }
+    }
+
+    void StoreRow(const PixelFormat& pf, const XMFLOAT4* src, uint32 width, float alphaScale, uint8* dst)
+    {
+        if(pf.Type == Encoding::Float16)
+        {
+            uint16* h = reinterpret_cast<uint16*>(dst);
+            for(uint32 x = 0; x < width; ++x, h += 4)
+            {
+                const float a = alphaScale != 1.0f ? std::min(src[x].w*alphaScale, 1.0f) : src[x].w;
+                h[0] = XMConvertFloatToHalf(src[x].x);
+                h[1] = XMConvertFloatToHalf(src[x].y);
+                h[2] = XMConvertFloatToHalf(src[x].z);
+                h[3] = XMConvertFloatToHalf(a);
+            }
+        }
+        else if(pf.SRGB)
+        {
+            const SRGBTables& tables = GetSRGBTables();
+            for(uint32 x = 0; x < width; ++x, dst += 4)
+            {
+                dst[0] = LinearToSRGB8(tables, src[x].x);
+                dst[1] = LinearToSRGB8(tables, src[x].y);
+                dst[2] = LinearToSRGB8(tables, src[x].z);
+                dst[3] = ToUnorm8(src[x].w*alphaScale);
+            }
+        }
+        else
+        {
+            for(uint32 x = 0; x < width; ++x, dst += 4)
+            {
+                dst[0] = ToUnorm8(src[x].x);
+                dst[1] = ToUnorm8(src[x].y);
+                dst[2] = ToUnorm8(src[x].z);
+                dst[3] = ToUnorm8(src[x].w*alphaScale);
+            }
+        }
+    }
+
+    float LoadAlpha(const PixelFormat& pf, const uint8* pixel)
+    {
+        if(pf.Type == Encoding::Float16)
+            return XMConvertHalfToFloat(reinterpret_cast<const uint16*>(pixel)[3]);
+        return pixel[3] / 255.0f;
+    }
+
+    //
+    // Filter kernels.  A kernel maps each destination texel along one axis to
+    // TapCount source texels and weights; the source indices are already clamped
+    // to the edge, so the passes below never test bounds.
+    //
+
+    struct Kernel1D
+    {
+        uint32 TapCount = 0;
+        std::vector<uint32> Indices;
+        std::vector<float> Weights;
+    };
+
+    // Modified Bessel function of the first kind, order 0.
+    double BesselI0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+        const double q = x*x*0.25;
+        for(int k = 1; k < 50; ++k)
+        {
+            term *= q / (double(k)*k);
+            sum += term;
+            if(term < sum*1e-12)
+                break;
+        }
+        return sum;
+    }
+
+    // Windowed sinc at t destination texels from the center.
+    double Kaiser(double t, double width, double alpha)
+    {
+        const double r = t / width;
+        if(r*r >= 1.0)
+            return 0.0;
+
+        const double pi = 3.14159265358979323846;
+        const double sinc = t == 0.0 ? 1.0 : std::sin(pi*t) / (pi*t);
+        return sinc*BesselI0(alpha*std::sqrt(1.0 - r*r)) / BesselI0(alpha);
+    }
+
+    Kernel1D BuildKernel(uint32 srcSize, uint32 dstSize, const MipGenerator::Options& options)
+    {
+        Kernel1D kernel;
+
+        // An axis that is already 1 texel wide stays as it is.
+        if(srcSize == dstSize)
+        {
+            kernel.TapCount = 1;
+            kernel.Weights.assign(dstSize, 1.0f);
+            for(uint32 x = 0; x < dstSize; ++x)
+                kernel.Indices.push_back(x);
+            return kernel;
+        }
+
+        const double scale = double(srcSize) / dstSize;
+
+        std::vector<std::vector<std::pair<int, double>>> taps(dstSize);
+        for(uint32 x = 0; x < dstSize; ++x)
+        {
+            if(options.Kernel == Filter::Box)
+            {
+                // Weight each source texel by how much of it the destination texel covers.
+                const double lo = x*scale;
+                const double hi = (x + 1)*scale;
+                for(int i = (int)std::floor(lo); i < (int)std::ceil(hi); ++i)
+                {
+                    const double w = std::min<double>(hi, i + 1) - std::max<double>(lo, i);
+                    if(w > 0.0)
+                        taps[x].push_back({ i, w });
+                }
+            }
+            else
+            {
+                const double center = (x + 0.5)*scale;
+                const double radius = options.KaiserWidth*scale;
+                for(int i = (int)std::ceil(center - radius - 0.5); i <= (int)std::floor(center + radius - 0.5); ++i)
+                {
+                    const double w = Kaiser((i + 0.5 - center) / scale, options.KaiserWidth, options.KaiserAlpha);
+                    if(w != 0.0)
+                        taps[x].push_back({ i, w });
+                }
+            }
+
+            kernel.TapCount = std::max(kernel.TapCount, (uint32)taps[x].size());
+        }
+
+        kernel.Indices.resize(dstSize*kernel.TapCount, 0);
+        kernel.Weights.resize(dstSize*kernel.TapCount, 0.0f);
+        for(uint32 x = 0; x < dstSize; ++x)
+        {
+            double sum = 0.0;
+            for(const auto& tap : taps[x])
+                sum += tap.second;
+
+            // Unused taps repeat the last index with a weight of 0.
+            for(uint32 k = 0; k < kernel.TapCount; ++k)
+            {
+                const auto& tap = taps[x][std::min(k, (uint32)taps[x].size() - 1)];
+                const int i = std::min(std::max(tap.first, 0), (int)srcSize - 1);
+                kernel.Indices[x*kernel.TapCount + k] = (uint32)i;
+                kernel.Weights[x*kernel.TapCount + k] = k < taps[x].size() ? (float)(tap.second / sum) : 0.0f;
+            }
+        }
+
+        return kernel;
+    }
+
+    // A level in linear float RGBA.
+    struct FloatImage
+    {
+        uint32 Width = 0;
+        uint32 Height = 0;
+        std::vector<XMFLOAT4> Pixels;
+
+        XMFLOAT4* Row(uint32 y) { return Pixels.data() + (size_t)y*Width; }
+        const XMFLOAT4* Row(uint32 y)const { return Pixels.data() + (size_t)y*Width; }
+    };
+
+    ///<summary>
+    /// Filters src (read row by row through getRow) down to dst.  Each band of
+    /// destination rows filters the source rows it needs along x into a small
+    /// buffer, then filters that along y, so no full size intermediate is made.
+    /// Bands of a wide kernel overlap and filter a few source rows twice.
+    ///</summary>
+    template<typename GetRow>
+    void Downsample(uint32 srcWidth, uint32 srcHeight, const GetRow& getRow,
+        const MipGenerator::Options& options, FloatImage& dst)
+    {
+        const Kernel1D kx = BuildKernel(srcWidth, dst.Width, options);
+        const Kernel1D ky = BuildKernel(srcHeight, dst.Height, options);
+
+        ParallelForBands(dst.Height, dst.Width*(kx.TapCount + ky.TapCount), [&](uint32 begin, uint32 end)
+        {
+            const auto range = std::minmax_element(ky.Indices.begin() + begin*ky.TapCount,
+                ky.Indices.begin() + end*ky.TapCount);
+            const uint32 srcBegin = *range.first;
+            const uint32 srcEnd = *range.second + 1;
+
+            std::vector<XMFLOAT4> scratch(srcWidth);
+            std::vector<XMFLOAT4> rows((size_t)(srcEnd - srcBegin)*dst.Width);
+
+            for(uint32 y = srcBegin; y < srcEnd; ++y)
+            {
+                const XMFLOAT4* src = getRow(y, scratch.data());
+                XMFLOAT4* out = rows.data() + (size_t)(y - srcBegin)*dst.Width;
+
+                const uint32* index = kx.Indices.data();
+                const float* weight = kx.Weights.data();
+                for(uint32 x = 0; x < dst.Width; ++x)
+                {
+                    XMVECTOR sum = XMVectorZero();
+                    for(uint32 k = 0; k < kx.TapCount; ++k)
+                        sum = XMVectorMultiplyAdd(XMLoadFloat4(&src[*index++]), XMVectorReplicate(*weight++), sum);
+                    XMStoreFloat4(&out[x], sum);
+                }
+            }
+
+            for(uint32 y = begin; y < end; ++y)
+            {
+                XMFLOAT4* out = dst.Row(y);
+                std::fill(out, out + dst.Width, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+
+                for(uint32 k = 0; k < ky.TapCount; ++k)
+                {
+                    const XMFLOAT4* src = rows.data() + (size_t)(ky.Indices[y*ky.TapCount + k] - srcBegin)*dst.Width;
+                    const XMVECTOR w = XMVectorReplicate(ky.Weights[y*ky.TapCount + k]);
+                    for(uint32 x = 0; x < dst.Width; ++x)
+                        XMStoreFloat4(&out[x], XMVectorMultiplyAdd(XMLoadFloat4(&src[x]), w, XMLoadFloat4(&out[x])));
+                }
+            }
+        });
+    }
+
+    ///<summary>
+    /// The alpha scale that gives image the given coverage at reference.  With n
+    /// texels of which k should pass, the threshold goes halfway between the k-th
+    /// and (k+1)-th largest alpha, and the scale moves it onto the reference.
+    ///</summary>
+    float AlphaScaleForCoverage(const FloatImage& image, float coverage, float reference)
+    {
+        const size_t n = image.Pixels.size();
+        const size_t k = (size_t)(coverage*n + 0.5f);
+        if(k == 0 || k >= n)
+            return 1.0f;
+
+        std::vector<float> alpha(n);
+        for(size_t i = 0; i < n; ++i)
+            alpha[i] = image.Pixels[i].w;
+
+        std::nth_element(alpha.begin(), alpha.begin() + (n - k), alpha.end());
+        const float above = alpha[n - k];
+        const float below = *std::max_element(alpha.begin(), alpha.begin() + (n - k));
+        const float threshold = 0.5f*(above + below);
+
+        // Nothing but zeros below: any scale that keeps them out will do.
+        const float maxScale = 64.0f;
+        if(threshold <= reference / maxScale)
+            return maxScale;
+
+        return reference / threshold;
+    }
+}
+
+bool MipGenerator::CanGenerate(DXGI_FORMAT format)
+{
+    PixelFormat pf;
+    return GetPixelFormat(format, pf);
+}
+
+bool MipGenerator::Generate(DXGI_FORMAT format, const uint8* pixels, uint32 width, uint32 height, size_t rowPitch,
+    const Options& options, std::vector<Level>& levels)
+{
+    levels.clear();
+
+    PixelFormat pf;
+    if(!GetPixelFormat(format, pf) || pixels == nullptr || width == 0 || height == 0)
+        return false;
+
+    if(options.SRGB && pf.Type == Encoding::Unorm8)
+        pf.SRGB = true;
+
+    const size_t bpp = BytesPerPixel(pf);
+    if(rowPitch < width*bpp)
+        return false;
+
+    uint32 fullChain = 1;
+    while((width >> fullChain) > 0 || (height >> fullChain) > 0)
+        fullChain++;
+
+    const uint32 mipLevels = options.MipLevels == 0 ? fullChain : std::min(options.MipLevels, fullChain);
+    levels.resize(mipLevels);
+
+    // Level 0 is the source, repacked.
+    Level& top = levels[0];
+    top.Width = width;
+    top.Height = height;
+    top.RowPitch = width*bpp;
+    top.Pixels.resize(top.RowPitch*height);
+    for(uint32 y = 0; y < height; ++y)
+        std::memcpy(top.Pixels.data() + y*top.RowPitch, pixels + y*rowPitch, top.RowPitch);
+
+    const float coverage = options.PreserveAlphaCoverage ?
+        AlphaCoverage(format, top, options.AlphaReference) : 0.0f;
+
+    // Each level is filtered from the float image of the one before, so only the
+    // previous level is kept.
+    FloatImage previous;
+    for(uint32 mip = 1; mip < mipLevels; ++mip)
+    {
+        FloatImage current;
+        current.Width = std::max(width >> mip, 1u);
+        current.Height = std::max(height >> mip, 1u);
+        current.Pixels.resize((size_t)current.Width*current.Height);
+
+        if(mip == 1)
+        {
+            Downsample(width, height, [&](uint32 y, XMFLOAT4* scratch) -> const XMFLOAT4*
+            {
+                LoadRow(pf, top.Pixels.data() + y*top.RowPitch, width, scratch);
+                return scratch;
+            }, options, current);
+        }
+        else
+        {
+            Downsample(previous.Width, previous.Height, [&](uint32 y, XMFLOAT4*) -> const XMFLOAT4*
+            {
+                return previous.Row(y);
+            }, options, current);
+        }
+
+        // The scale only goes into the stored level; the next level is filtered
+        // from the unscaled alpha.
+        const float alphaScale = options.PreserveAlphaCoverage ?
+            AlphaScaleForCoverage(current, coverage, options.AlphaReference) : 1.0f;
+
+        Level& level = levels[mip];
+        level.Width = current.Width;
+        level.Height = current.Height;
+        level.RowPitch = current.Width*bpp;
+        level.Pixels.resize(level.RowPitch*level.Height);
+
+        ParallelForBands(level.Height, level.Width, [&](uint32 begin, uint32 end)
+        {
+            for(uint32 y = begin; y < end; ++y)
+                StoreRow(pf, current.Row(y), level.Width, alphaScale, level.Pixels.data() + y*level.RowPitch);
+        });
+
+        previous = std::move(current);
+    }
+
+    return true;
+}
+
+bool MipGenerator::Save(const std::wstring& filename, DXGI_FORMAT format, const std::vector<Level>& levels,
+    DXGI_FORMAT fileFormat, BlockCompression::Quality quality)
+{
+    if(levels.empty() || !CanGenerate(format))
+        return false;
+
+    if(fileFormat == DXGI_FORMAT_UNKNOWN)
+        fileFormat = format;
+
+    DDSFile::Description desc;
+    desc.Dimension = DDSFile::TextureDimension::Texture2D;
+    desc.Format = fileFormat;
+    desc.Width = levels[0].Width;
+    desc.Height = levels[0].Height;
+    desc.Depth = 1;
+    desc.MipLevels = (uint32)levels.size();
+    desc.ArraySize = 1;
+
+    std::vector<const uint8*> subresources;
+
+    if(fileFormat == format)
+    {
+        for(const Level& level : levels)
+            subresources.push_back(level.Pixels.data());
+
+        return DDSFile::Save(filename, desc, subresources);
+    }
+
+    if(!BlockCompression::CanEncode(fileFormat) ||
+       (format != DXGI_FORMAT_R8G8B8A8_UNORM && format != DXGI_FORMAT_R8G8B8A8_UNORM_SRGB))
+        return false;
+
+    std::vector<std::vector<uint8>> blocks(levels.size());
+    for(size_t i = 0; i < levels.size(); ++i)
+    {
+        const Level& level = levels[i];
+
+        size_t numBytes = 0;
+        size_t rowBytes = 0;
+        DDSFile::GetSurfaceInfo(level.Width, level.Height, fileFormat, &numBytes, &rowBytes, nullptr);
+
+        blocks[i].resize(numBytes);
+        if(!BlockCompression::Encode(fileFormat, level.Pixels.data(), level.Width, level.Height, level.RowPitch,
+            blocks[i].data(), rowBytes, quality))
+            return false;
+
+        subresources.push_back(blocks[i].data());
+    }
+
+    return DDSFile::Save(filename, desc, subresources);
+}
+
+float MipGenerator::AlphaCoverage(DXGI_FORMAT format, const Level& level, float reference)
+{
+    PixelFormat pf;
+    if(!GetPixelFormat(format, pf) || level.Width == 0 || level.Height == 0)
+        return 0.0f;
+
+    const size_t bpp = BytesPerPixel(pf);
+
+    size_t passed = 0;
+    for(uint32 y = 0; y < level.Height; ++y)
+    {
+        const uint8* row = level.Pixels.data() + y*level.RowPitch;
+        for(uint32 x = 0; x < level.Width; ++x)
+        {
+            if(LoadAlpha(pf, row + x*bpp) >= reference)
+                passed++;
+        }
+    }
+
+    return float(passed) / (float(level.Width)*level.Height);
+}
@@ -0,0 +1,103 @@
+//***************************************************************************************
+// MipGenerator.h
+//
+// Builds the mip chain of an RGBA8 or RGBA16F image on the CPU, for images that
+// come without one (the tree billboard bitmaps, say) and for tools that write DDS
+// files.
+//
+// Each level is filtered from the one before it with a separable box or Kaiser
+// windowed sinc filter, at full float precision: the 8-bit levels are only
+// rounded on output, so the error does not build up down the chain.  sRGB images
+// are filtered in linear space.  For alpha tested textures the alpha of every
+// level can be scaled so the fraction of texels that pass the alpha test stays
+// the same as in level 0; otherwise foliage thins out and vanishes in the
+// distance.  Each pass of each level is split into rows across cores.
+//***************************************************************************************
+
+#pragma once
+
+#include "BlockCompression.h"
+#include <dxgiformat.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class MipGenerator
+{
+public:
+
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+
+    enum class Filter
+    {
+        Box,
+        Kaiser
+    };
+
+    struct Options
+    {
+        Options() :
+            Kernel(Filter::Box),
+            MipLevels(0),
+            SRGB(false),
+            PreserveAlphaCoverage(false),
+            AlphaReference(0.5f),
+            KaiserWidth(3.0f),
+            KaiserAlpha(4.0f)
+        {
+        }
+
+        Filter Kernel;
+
+        // Levels to generate, counting the source; 0 for the full chain down to 1x1.
+        uint32 MipLevels;
+
+        // Treat the color of an 8-bit UNORM image as sRGB encoded.  The _SRGB
+        // formats are always filtered in linear space; RGBA16F is always linear.
+        bool SRGB;
+
+        // Keep the fraction of texels with alpha >= AlphaReference the same in
+        // every level.  AlphaReference should match the shader's alpha test (the
+        // tree sprites clip below 0.1).
+        bool PreserveAlphaCoverage;
+        float AlphaReference;
+
+        // Radius of the Kaiser filter in destination texels, and its window shape.
+        float KaiserWidth;
+        float KaiserAlpha;
+    };
+
+    // One level, tightly packed (RowPitch = Width * bytes per pixel).
+    struct Level
+    {
+        uint32 Width = 0;
+        uint32 Height = 0;
+        size_t RowPitch = 0;
+        std::vector<uint8> Pixels;
+    };
+
+    // R8G8B8A8 and B8G8R8A8 UNORM or UNORM_SRGB, and R16G16B16A16_FLOAT.
+    static bool CanGenerate(DXGI_FORMAT format);
+
+    ///<summary>
+    /// Fills levels with the mip chain of a width by height image (rows rowPitch
+    /// bytes apart), starting with a copy of the image itself.  Every level is
+    /// half the size of the one before, rounded down.
+    ///</summary>
+    static bool Generate(DXGI_FORMAT format, const uint8* pixels, uint32 width, uint32 height, size_t rowPitch,
+        const Options& options, std::vector<Level>& levels);
+
+    ///<summary>
+    /// Writes the chain as a 2D DDS texture through DDSFile::Save.  With a block
+    /// compressed fileFormat each level is compressed with BlockCompression first,
+    /// which requires an R8G8B8A8 chain.
+    ///</summary>
+    static bool Save(const std::wstring& filename, DXGI_FORMAT format, const std::vector<Level>& levels,
+        DXGI_FORMAT fileFormat = DXGI_FORMAT_UNKNOWN,
+        BlockCompression::Quality quality = BlockCompression::Quality::High);
+
+    // Fraction of the texels of a level with alpha >= reference.
+    static float AlphaCoverage(DXGI_FORMAT format, const Level& level, float reference);
+};
@@ -0,0 +1,313 @@
+//***************************************************************************************
+// OcclusionCuller.cpp
+//***************************************************************************************
+
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = OcclusionCuller::uint32;
+
+    const float FarDepth = 1.0f;
+
+    // The edge function of a->b: positive on the inside of a clockwise triangle
+    // (y grows downwards on the screen).  It is moved inwards by the most it
+    // changes between a pixel's center and its corners, so it is positive at a
+    // pixel center only when the whole pixel is inside the edge.
+    struct Edge
+    {
+        Edge(const XMFLOAT4& a, const XMFLOAT4& b) :
+            A(a.y - b.y),
+            B(b.x - a.x),
+            C(-(A*a.x + B*a.y) - 0.5f*(std::fabs(A) + std::fabs(B)))
+        {
+        }
+
+        float A;
+        float B;
+        float C;
+    };
+}
+
+OcclusionCuller::OcclusionCuller(uint32 width, uint32 height)
+{
+    XMStoreFloat4x4(&mViewProj, XMMatrixIdentity());
+    Resize(width, height);
+}
+
+void OcclusionCuller::Resize(uint32 width, uint32 height)
+{
+    mLevels.clear();
+
+    Level level;
+    level.Width = std::max(width, 1u);
+    level.Height = std::max(height, 1u);
+    level.Stride = (level.Width + 3) & ~3u;
+    level.Depth.assign((size_t)level.Stride*level.Height, FarDepth);
+    mLevels.push_back(level);
+
+    while(level.Width > 1 || level.Height > 1)
+    {
+        level.Width = (level.Width + 1)/2;
+        level.Height = (level.Height + 1)/2;
+        level.Stride = level.Width;
+        level.Depth.assign((size_t)level.Stride*level.Height, FarDepth);
+        mLevels.push_back(level);
+    }
+}
+
+void OcclusionCuller::Begin(FXMMATRIX viewProj)
+{
+    XMStoreFloat4x4(&mViewProj, viewProj);
+    std::fill(mLevels[0].Depth.begin(), mLevels[0].Depth.end(), FarDepth);
+}
+
+void OcclusionCuller::AddOccluder(const XMFLOAT3* positions, size_t positionStride, size_t vertexCount,
+    const uint32* indices, size_t indexCount, FXMMATRIX world)
+{
+    const XMMATRIX worldViewProj = XMMatrixMultiply(world, XMLoadFloat4x4(&mViewProj));
+    const float halfWidth = 0.5f*mLevels[0].Width;
+    const float halfHeight = 0.5f*mLevels[0].Height;
+
+    mScreen.resize(vertexCount);
+
+    const char* position = reinterpret_cast<const char*>(positions);
+    for(size_t i = 0; i < vertexCount; ++i, position += positionStride)
+    {
+        XMFLOAT4 clip;
+        XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(position)), worldViewProj));
+
+        XMFLOAT4& screen = mScreen[i];
+        if(clip.z < 0.0f || clip.w <= 0.0f)
+        {
+            screen.w = -1.0f;
+            continue;
+        }
+
+        const float invW = 1.0f/clip.w;
+        screen.x = (clip.x*invW + 1.0f)*halfWidth;
+        screen.y = (1.0f - clip.y*invW)*halfHeight;
+        screen.z = clip.z*invW;
+        screen.w = 1.0f;
+    }
+
+    // Triangles with a vertex in front of the near plane are left out rather
+    // than clipped; leaving out occluders never hides anything.
+    for(size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        const XMFLOAT4& v0 = mScreen[indices[i + 0]];
+        const XMFLOAT4& v1 = mScreen[indices[i + 1]];
+        const XMFLOAT4& v2 = mScreen[indices[i + 2]];
+        if(v0.w < 0.0f || v1.w < 0.0f || v2.w < 0.0f)
+            continue;
+
+        RasterizeTriangle(v0, v1, v2);
+    }
+}
+
+void OcclusionCuller::RasterizeTriangle(const XMFLOAT4& v0, const XMFLOAT4& v1, const XMFLOAT4& v2)
+{
+    // Back faces (and degenerate triangles) are skipped: the front faces of a
+    // closed occluder are nearer anyway.
+    const float area = (v1.x - v0.x)*(v2.y - v0.y) - (v2.x - v0.x)*(v1.y - v0.y);
+    if(!(area > 0.0f))
+        return;
+
+    Level& level = mLevels[0];
+
+    // Pixels whose centers (x + 0.5, y + 0.5) can be inside the triangle; only
+    // those the triangle covers entirely are written.
+    const float minX = std::max(std::ceil(std::min(std::min(v0.x, v1.x), v2.x) - 0.5f), 0.0f);
+    const float minY = std::max(std::ceil(std::min(std::min(v0.y, v1.y), v2.y) - 0.5f), 0.0f);
+    const float maxX = std::min(std::floor(std::max(std::max(v0.x, v1.x), v2.x) - 0.5f), (float)level.Width - 1.0f);
+    const float maxY = std::min(std::floor(std::max(std::max(v0.y, v1.y), v2.y) - 0.5f), (float)level.Height - 1.0f);
+    if(minX > maxX || minY > maxY)
+        return;
+
+    const Edge e0(v0, v1);
+    const Edge e1(v1, v2);
+    const Edge e2(v2, v0);
+
+    //
+    // Depth is linear in screen space.  Each pixel gets the farthest depth of
+    // the plane over its square, which is at most half a pixel of slope in x
+    // and y from the center, and never past the farthest vertex.
+    //
+    const float invArea = 1.0f/area;
+    const float dzdx = ((v1.z - v0.z)*(v2.y - v0.y) - (v2.z - v0.z)*(v1.y - v0.y))*invArea;
+    const float dzdy = ((v2.z - v0.z)*(v1.x - v0.x) - (v1.z - v0.z)*(v2.x - v0.x))*invArea;
+    const float z0 = v0.z - dzdx*v0.x - dzdy*v0.y + 0.5f*(std::fabs(dzdx) + std::fabs(dzdy));
+    const float zMax = std::max(std::max(v0.z, v1.z), v2.z);
+
+    const uint32 firstX = (uint32)minX;
+    const uint32 lastX = (uint32)maxX;
+    const uint32 firstY = (uint32)minY;
+    const uint32 lastY = (uint32)maxY;
+
+#if defined(_XM_SSE_INTRINSICS_)
+    // Groups of 4 pixels start at multiples of 4, so they stay inside the
+    // padded rows.
+    const __m128 laneX = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 a0 = _mm_set1_ps(e0.A);
+    const __m128 a1 = _mm_set1_ps(e1.A);
+    const __m128 a2 = _mm_set1_ps(e2.A);
+    const __m128 slopeX = _mm_set1_ps(dzdx);
+    const __m128 farthest = _mm_set1_ps(zMax);
+
+    for(uint32 y = firstY; y <= lastY; ++y)
+    {
+        const float py = y + 0.5f;
+        const __m128 rowE0 = _mm_set1_ps(e0.B*py + e0.C);
+        const __m128 rowE1 = _mm_set1_ps(e1.B*py + e1.C);
+        const __m128 rowE2 = _mm_set1_ps(e2.B*py + e2.C);
+        const __m128 rowZ = _mm_set1_ps(dzdy*py + z0);
+
+        float* row = &level.Depth[(size_t)y*level.Stride];
+        for(uint32 x = firstX & ~3u; x <= lastX; x += 4)
+        {
+            const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneX);
+
+            __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), rowE0), zero);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), rowE1), zero));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), rowE2), zero));
+            if(_mm_movemask_ps(inside) == 0)
+                continue;
+
+            const __m128 z = _mm_min_ps(_mm_add_ps(_mm_mul_ps(slopeX, px), rowZ), farthest);
+            const __m128 depth = _mm_loadu_ps(row + x);
+            const __m128 nearer = _mm_min_ps(depth, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, depth)));
+        }
+    }
+#else
+    for(uint32 y = firstY; y <= lastY; ++y)
+    {
+        const float py = y + 0.5f;
+
+        float* row = &level.Depth[(size_t)y*level.Stride];
+        for(uint32 x = firstX; x <= lastX; ++x)
+        {
+            const float px = x + 0.5f;
+            if(e0.A*px + e0.B*py + e0.C < 0.0f ||
+               e1.A*px + e1.B*py + e1.C < 0.0f ||
+               e2.A*px + e2.B*py + e2.C < 0.0f)
+                continue;
+
+            const float z = std::min(dzdx*px + dzdy*py + z0, zMax);
+            row[x] = std::min(row[x], z);
+        }
+    }
+#endif
+}
+
+void OcclusionCuller::End()
+{
+    for(size_t l = 1; l < mLevels.size(); ++l)
+    {
+        const Level& fine = mLevels[l - 1];
+        Level& coarse = mLevels[l];
+
+        for(uint32 y = 0; y < coarse.Height; ++y)
+        {
+            const float* row0 = &fine.Depth[(size_t)(2*y)*fine.Stride];
+            const float* row1 = &fine.Depth[(size_t)std::min(2*y + 1, fine.Height - 1)*fine.Stride];
+
+            for(uint32 x = 0; x < coarse.Width; ++x)
+            {
+                const uint32 x0 = 2*x;
+                const uint32 x1 = std::min(2*x + 1, fine.Width - 1);
+                coarse.Depth[(size_t)y*coarse.Stride + x] =
+                    std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::IsOccluded(const BoundingBox& worldBounds)const
+{
+    const Level& base = mLevels[0];
+    const float halfWidth = 0.5f*base.Width;
+    const float halfHeight = 0.5f*base.Height;
+
+    //
+    // The corners in clip space are the center's plus or minus the extents
+    // times the first three rows of the matrix.
+    //
+    const XMMATRIX viewProj = XMLoadFloat4x4(&mViewProj);
+    const XMVECTOR center = XMVector3Transform(XMLoadFloat3(&worldBounds.Center), viewProj);
+    const XMVECTOR axisX = XMVectorScale(viewProj.r[0], worldBounds.Extents.x);
+    const XMVECTOR axisY = XMVectorScale(viewProj.r[1], worldBounds.Extents.y);
+    const XMVECTOR axisZ = XMVectorScale(viewProj.r[2], worldBounds.Extents.z);
+
+    float minX = FLT_MAX;
+    float minY = FLT_MAX;
+    float maxX = -FLT_MAX;
+    float maxY = -FLT_MAX;
+    float minZ = FLT_MAX;
+    for(int i = 0; i < 8; ++i)
+    {
+        XMVECTOR corner = XMVectorAdd(center, (i & 1) ? axisX : XMVectorNegate(axisX));
+        corner = XMVectorAdd(corner, (i & 2) ? axisY : XMVectorNegate(axisY));
+        corner = XMVectorAdd(corner, (i & 4) ? axisZ : XMVectorNegate(axisZ));
+
+        XMFLOAT4 clip;
+        XMStoreFloat4(&clip, corner);
+
+        // A box reaching in front of the near plane is never hidden.
+        if(clip.z < 0.0f || clip.w <= 0.0f)
+            return false;
+
+        const float invW = 1.0f/clip.w;
+        const float x = (clip.x*invW + 1.0f)*halfWidth;
+        const float y = (1.0f - clip.y*invW)*halfHeight;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, clip.z*invW);
+    }
+
+    // Boxes off the screen are for the frustum culler.
+    if(maxX < 0.0f || maxY < 0.0f || minX >= (float)base.Width || minY >= (float)base.Height)
+        return false;
+
+    const uint32 x0 = (uint32)std::max(minX, 0.0f);
+    const uint32 y0 = (uint32)std::max(minY, 0.0f);
+    const uint32 x1 = (uint32)std::min(maxX, (float)base.Width - 1.0f);
+    const uint32 y1 = (uint32)std::min(maxY, (float)base.Height - 1.0f);
+
+    // The finest level where the rectangle covers at most 2x2 texels.
+    uint32 l = 0;
+    while(l + 1 < (uint32)mLevels.size() && ((x1 >> l) - (x0 >> l) > 1 || (y1 >> l) - (y0 >> l) > 1))
+        ++l;
+
+    const Level& level = mLevels[l];
+    for(uint32 y = y0 >> l; y <= y1 >> l; ++y)
+    {
+        for(uint32 x = x0 >> l; x <= x1 >> l; ++x)
+        {
+            if(minZ <= level.Depth[(size_t)y*level.Stride + x])
+                return false;
+        }
+    }
+
+    return true;
+}
+
+uint32 OcclusionCuller::Cull(const BoundingBox* worldBounds, uint32* indices, uint32 count)const
+{
+    uint32 kept = 0;
+    for(uint32 i = 0; i < count; ++i)
+    {
+        if(!IsOccluded(worldBounds[indices[i]]))
+            indices[kept++] = indices[i];
+    }
+
+    return kept;
+}
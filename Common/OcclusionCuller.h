@@ -0,0 +1,101 @@
+//***************************************************************************************
+// OcclusionCuller.h
+//
+// Occlusion culling on the CPU with a small software depth buffer.
+//
+// Each frame a few large occluders (simple meshes or low LODs, see MeshSimplifier)
+// are rasterized into a low resolution depth buffer, 4 pixels at a time with SSE.
+// A hierarchical-Z pyramid is then built over it, where each texel keeps the
+// farthest depth of the pixels under it.  A bounding box is hidden when its
+// nearest depth is behind every texel its screen rectangle touches, at the
+// pyramid level where the rectangle covers at most 2x2 texels, so each test is a
+// handful of reads whatever the size of the box.
+//
+// Every occluder pixel is written with the farthest depth the triangle reaches
+// inside it, and triangles crossing the near plane are skipped, so occluders are
+// never nearer than they really are.  Only pixels an occluder covers entirely are
+// written, so a box showing past the silhouette of an occluder, by however
+// little, is never culled; thin occluders may write no pixels at all.
+//
+// Depth follows Direct3D: 0 at the near plane and 1 at the far plane.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+class OcclusionCuller
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+    static const uint32 DefaultWidth = 256;
+    static const uint32 DefaultHeight = 128;
+
+    OcclusionCuller(uint32 width = DefaultWidth, uint32 height = DefaultHeight);
+
+    // Sets the size of the depth buffer.  Its aspect should match the camera's.
+    void Resize(uint32 width, uint32 height);
+
+    uint32 Width()const { return mLevels[0].Width; }
+    uint32 Height()const { return mLevels[0].Height; }
+
+    ///<summary>
+    /// Clears the depth buffer to the far plane and sets the camera of the frame.
+    ///</summary>
+    void Begin(DirectX::FXMMATRIX viewProj);
+
+    ///<summary>
+    /// Rasterizes the front faces (clockwise, as Direct3D draws by default) of
+    /// an indexed triangle list, placed in the world by world.  positionStride is
+    /// the distance in bytes between positions, so an application's vertex array
+    /// can be passed as is.
+    ///</summary>
+    void AddOccluder(const DirectX::XMFLOAT3* positions, size_t positionStride, size_t vertexCount,
+        const uint32* indices, size_t indexCount, DirectX::FXMMATRIX world);
+
+    ///<summary>
+    /// Builds the hierarchical-Z pyramid.  Call after the last occluder and before
+    /// testing boxes.
+    ///</summary>
+    void End();
+
+    // True when the world box is entirely behind the occluders.
+    bool IsOccluded(const DirectX::BoundingBox& worldBounds)const;
+
+    ///<summary>
+    /// Keeps the indices i of indices[0..count) whose worldBounds[i] is not
+    /// occluded, in order, and returns how many there are.  Chains after a
+    /// frustum culler's list of visible indices.
+    ///</summary>
+    uint32 Cull(const DirectX::BoundingBox* worldBounds, uint32* indices, uint32 count)const;
+
+    // Depth of level 0 (the rasterized buffer), Stride() floats per row.
+    const float* GetDepth()const { return mLevels[0].Depth.data(); }
+    uint32 Stride()const { return mLevels[0].Stride; }
+
+private:
+    void RasterizeTriangle(const DirectX::XMFLOAT4& v0, const DirectX::XMFLOAT4& v1, const DirectX::XMFLOAT4& v2);
+
+private:
+    struct Level
+    {
+        uint32 Width;
+        uint32 Height;
+
+        // Rows of level 0 are padded to a multiple of 4 floats.
+        uint32 Stride;
+        std::vector<float> Depth;
+    };
+
+    std::vector<Level> mLevels;
+
+    DirectX::XMFLOAT4X4 mViewProj;
+
+    // Screen positions (x, y, depth) of the occluder being rasterized; w is
+    // negative for vertices in front of the near plane.
+    std::vector<DirectX::XMFLOAT4> mScreen;
+};
@@ -0,0 +1,361 @@
+//***************************************************************************************
+// RayQuery.cpp
+//***************************************************************************************
+
+#include "RayQuery.h"
+#include <algorithm>
+#include <cmath>
+#include <ppl.h>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = RayQuery::uint32;
+    using Node = TriangleBVH::Node;
+    using Triangle = TriangleBVH::Triangle;
+
+    // Triangles seen this close to edge on are missed, as in TriangleTests.
+    const float DetEpsilon = 1e-20f;
+
+    //
+    // The few vector operations a packet needs, on the widest registers there
+    // are.  Masks are vectors with all bits set in the lanes that pass.  Without
+    // intrinsics a packet is a single ray and masks are 0 or 1.
+    //
+
+    namespace Lane
+    {
+#if defined(_XM_AVX_INTRINSICS_)
+        const uint32 Lanes = 8;
+        using Float = __m256;
+
+        Float Set(float x) { return _mm256_set1_ps(x); }
+        Float Load(const float* p) { return _mm256_loadu_ps(p); }
+        void Store(float* p, Float x) { _mm256_storeu_ps(p, x); }
+        Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+        Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+        Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+        Float Div(Float a, Float b) { return _mm256_div_ps(a, b); }
+        Float Min(Float a, Float b) { return _mm256_min_ps(a, b); }
+        Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+        Float Less(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        Float LessEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        Float And(Float a, Float b) { return _mm256_and_ps(a, b); }
+        Float AndNot(Float mask, Float a) { return _mm256_andnot_ps(mask, a); }
+        Float Or(Float a, Float b) { return _mm256_or_ps(a, b); }
+        Float Select(Float mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+        uint32 Bits(Float mask) { return (uint32)_mm256_movemask_ps(mask); }
+#elif defined(_XM_SSE_INTRINSICS_)
+        const uint32 Lanes = 4;
+        using Float = __m128;
+
+        Float Set(float x) { return _mm_set1_ps(x); }
+        Float Load(const float* p) { return _mm_loadu_ps(p); }
+        void Store(float* p, Float x) { _mm_storeu_ps(p, x); }
+        Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+        Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+        Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+        Float Div(Float a, Float b) { return _mm_div_ps(a, b); }
+        Float Min(Float a, Float b) { return _mm_min_ps(a, b); }
+        Float Max(Float a, Float b) { return _mm_max_ps(a, b); }
+        Float Less(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+        Float LessEqual(Float a, Float b) { return _mm_cmple_ps(a, b); }
+        Float And(Float a, Float b) { return _mm_and_ps(a, b); }
+        Float AndNot(Float mask, Float a) { return _mm_andnot_ps(mask, a); }
+        Float Or(Float a, Float b) { return _mm_or_ps(a, b); }
+        Float Select(Float mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+        uint32 Bits(Float mask) { return (uint32)_mm_movemask_ps(mask); }
+#else
+        const uint32 Lanes = 1;
+        using Float = float;
+
+        Float Set(float x) { return x; }
+        Float Load(const float* p) { return *p; }
+        void Store(float* p, Float x) { *p = x; }
+        Float Add(Float a, Float b) { return a + b; }
+        Float Sub(Float a, Float b) { return a - b; }
+        Float Mul(Float a, Float b) { return a*b; }
+        Float Div(Float a, Float b) { return a/b; }
+        Float Min(Float a, Float b) { return std::min(a, b); }
+        Float Max(Float a, Float b) { return std::max(a, b); }
+        Float Less(Float a, Float b) { return a < b ? 1.0f : 0.0f; }
+        Float LessEqual(Float a, Float b) { return a <= b ? 1.0f : 0.0f; }
+        Float And(Float a, Float b) { return a != 0.0f && b != 0.0f ? 1.0f : 0.0f; }
+        Float AndNot(Float mask, Float a) { return mask == 0.0f && a != 0.0f ? 1.0f : 0.0f; }
+        Float Or(Float a, Float b) { return a != 0.0f || b != 0.0f ? 1.0f : 0.0f; }
+        Float Select(Float mask, Float a, Float b) { return mask != 0.0f ? a : b; }
+        uint32 Bits(Float mask) { return mask != 0.0f ? 1u : 0u; }
+#endif
+    }
+
+    using namespace Lane;
+
+    // The lane operations as TriangleBVH::HitBox takes them.
+    struct LaneOps
+    {
+        static Float Set(float x) { return Lane::Set(x); }
+        static Float Sub(Float a, Float b) { return Lane::Sub(a, b); }
+        static Float Mul(Float a, Float b) { return Lane::Mul(a, b); }
+        static Float Min(Float a, Float b) { return Lane::Min(a, b); }
+        static Float Max(Float a, Float b) { return Lane::Max(a, b); }
+        static Float LessEqual(Float a, Float b) { return Lane::LessEqual(a, b); }
+        static Float And(Float a, Float b) { return Lane::And(a, b); }
+    };
+
+    // Lanes past the last ray, and any hit rays that are done, have a negative
+    // cut-off, so no box or triangle passes for them.
+    const float Done = -1.0f;
+
+    struct Packet
+    {
+        float OriginX[Lanes];
+        float OriginY[Lanes];
+        float OriginZ[Lanes];
+        float DirX[Lanes];
+        float DirY[Lanes];
+        float DirZ[Lanes];
+        float InvDirX[Lanes];
+        float InvDirY[Lanes];
+        float InvDirZ[Lanes];
+
+        // Nearest hit so far, or MaxDist.
+        float CutOff[Lanes];
+
+        uint32 Triangle[Lanes];
+        float Distance[Lanes];
+    };
+
+    struct PacketRegisters
+    {
+        explicit PacketRegisters(const Packet& p) :
+            OriginX(Load(p.OriginX)),
+            OriginY(Load(p.OriginY)),
+            OriginZ(Load(p.OriginZ)),
+            DirX(Load(p.DirX)),
+            DirY(Load(p.DirY)),
+            DirZ(Load(p.DirZ))
+        {
+            Box.OriginX = OriginX;
+            Box.OriginY = OriginY;
+            Box.OriginZ = OriginZ;
+            Box.InvDirX = Load(p.InvDirX);
+            Box.InvDirY = Load(p.InvDirY);
+            Box.InvDirZ = Load(p.InvDirZ);
+        }
+
+        Float OriginX, OriginY, OriginZ;
+        Float DirX, DirY, DirZ;
+        TriangleBVH::BoxRay<Float> Box;
+    };
+
+    // The rays that enter the node's box before cutOff, and where they enter,
+    // with the test TriangleBVH::Intersects uses.
+    Float HitBox(const Node& node, const PacketRegisters& r, Float cutOff, Float& entry)
+    {
+        return TriangleBVH::HitBox<LaneOps>(node, r.Box, cutOff, entry);
+    }
+
+    // The smallest entry of the rays in mask.
+    float NearestEntry(Float mask, Float entry)
+    {
+        float entries[Lanes];
+        Store(entries, Select(mask, entry, Set(FLT_MAX)));
+        return *std::min_element(entries, entries + Lanes);
+    }
+
+    //
+    // Moller-Trumbore against every ray of the packet, step for step as
+    // TriangleTests::Intersects does for one ray: u, v and the distance are
+    // tested against the unnormalized determinant, on the side it has, and the
+    // distance divided by it last, so the packet gets the same distances.
+    //
+    Float HitTriangle(const Triangle& tri, const PacketRegisters& r, Float cutOff, Float& dist)
+    {
+        const XMFLOAT3 e1(tri.V1.x - tri.V0.x, tri.V1.y - tri.V0.y, tri.V1.z - tri.V0.z);
+        const XMFLOAT3 e2(tri.V2.x - tri.V0.x, tri.V2.y - tri.V0.y, tri.V2.z - tri.V0.z);
+        const Float e1x = Set(e1.x), e1y = Set(e1.y), e1z = Set(e1.z);
+        const Float e2x = Set(e2.x), e2y = Set(e2.y), e2z = Set(e2.z);
+
+        const Float px = Sub(Mul(r.DirY, e2z), Mul(r.DirZ, e2y));
+        const Float py = Sub(Mul(r.DirZ, e2x), Mul(r.DirX, e2z));
+        const Float pz = Sub(Mul(r.DirX, e2y), Mul(r.DirY, e2x));
+        const Float det = Add(Add(Mul(e1x, px), Mul(e1y, py)), Mul(e1z, pz));
+
+        const Float sx = Sub(r.OriginX, Set(tri.V0.x));
+        const Float sy = Sub(r.OriginY, Set(tri.V0.y));
+        const Float sz = Sub(r.OriginZ, Set(tri.V0.z));
+        const Float u = Add(Add(Mul(sx, px), Mul(sy, py)), Mul(sz, pz));
+
+        const Float qx = Sub(Mul(sy, e1z), Mul(sz, e1y));
+        const Float qy = Sub(Mul(sz, e1x), Mul(sx, e1z));
+        const Float qz = Sub(Mul(sx, e1y), Mul(sy, e1x));
+        const Float v = Add(Add(Mul(r.DirX, qx), Mul(r.DirY, qy)), Mul(r.DirZ, qz));
+        const Float uv = Add(u, v);
+
+        const Float t = Add(Add(Mul(e2x, qx), Mul(e2y, qy)), Mul(e2z, qz));
+
+        // Front side: the determinant is positive.
+        const Float zero = Set(0.0f);
+        Float missFront = Less(u, zero);
+        missFront = Or(missFront, Less(det, u));
+        missFront = Or(missFront, Less(v, zero));
+        missFront = Or(missFront, Less(det, uv));
+        missFront = Or(missFront, Less(t, zero));
+
+        // Back side: the determinant is negative.
+        Float missBack = Less(zero, u);
+        missBack = Or(missBack, Less(u, det));
+        missBack = Or(missBack, Less(zero, v));
+        missBack = Or(missBack, Less(uv, det));
+        missBack = Or(missBack, Less(zero, t));
+
+        const Float front = AndNot(missFront, LessEqual(Set(DetEpsilon), det));
+        const Float back = AndNot(missBack, LessEqual(det, Set(-DetEpsilon)));
+
+        dist = Div(t, det);
+        return And(Or(front, back), LessEqual(dist, cutOff));
+    }
+
+    void TracePacket(const TriangleBVH& bvh, Packet& p, RayQuery::Mode mode)
+    {
+        const std::vector<Node>& nodes = bvh.GetNodes();
+        const std::vector<Triangle>& triangles = bvh.GetTriangles();
+        const PacketRegisters r(p);
+
+        Float cutOff = Load(p.CutOff);
+
+        Float entry;
+        if(Bits(HitBox(nodes[0], r, cutOff, entry)) == 0)
+            return;
+
+        uint32 stack[TriangleBVH::MaxDepth];
+        uint32 stackSize = 0;
+
+        uint32 nodeIndex = 0;
+        for(;;)
+        {
+            const Node& node = nodes[nodeIndex];
+            if(node.Children == 0)
+            {
+                for(uint32 i = node.First; i < node.First + node.Count; ++i)
+                {
+                    Float dist;
+                    uint32 hits = Bits(HitTriangle(triangles[i], r, cutOff, dist));
+                    if(hits == 0)
+                        continue;
+
+                    float dists[Lanes];
+                    Store(dists, dist);
+
+                    const uint32 index = bvh.GetTriangleIndex(i);
+                    for(uint32 lane = 0; hits != 0; ++lane, hits >>= 1)
+                    {
+                        if((hits & 1) == 0)
+                            continue;
+
+                        // Hits at the cut-off are ties; they go to the lower index.
+                        if(mode == RayQuery::Mode::ClosestHit &&
+                           dists[lane] == p.CutOff[lane] && index > p.Triangle[lane])
+                            continue;
+
+                        p.Triangle[lane] = index;
+                        p.Distance[lane] = dists[lane];
+                        p.CutOff[lane] = mode == RayQuery::Mode::AnyHit ? Done : dists[lane];
+                    }
+
+                    cutOff = Load(p.CutOff);
+                }
+
+                if(mode == RayQuery::Mode::AnyHit && Bits(LessEqual(Set(0.0f), cutOff)) == 0)
+                    return;
+            }
+            else
+            {
+                // Visit the child the packet reaches first; the other one waits
+                // on the stack.
+                Float entry0;
+                Float entry1;
+                const Float hit0 = HitBox(nodes[node.Children], r, cutOff, entry0);
+                const Float hit1 = HitBox(nodes[node.Children + 1], r, cutOff, entry1);
+                const bool any0 = Bits(hit0) != 0;
+                const bool any1 = Bits(hit1) != 0;
+
+                if(any0 && any1)
+                {
+                    const bool firstNearer = NearestEntry(hit0, entry0) <= NearestEntry(hit1, entry1);
+                    stack[stackSize++] = firstNearer ? node.Children + 1 : node.Children;
+                    nodeIndex = firstNearer ? node.Children : node.Children + 1;
+                    continue;
+                }
+                if(any0 || any1)
+                {
+                    nodeIndex = any0 ? node.Children : node.Children + 1;
+                    continue;
+                }
+            }
+
+            // Take the next waiting node that a ray still reaches before its
+            // cut-off.
+            bool found = false;
+            while(stackSize > 0 && !found)
+            {
+                nodeIndex = stack[--stackSize];
+                found = Bits(HitBox(nodes[nodeIndex], r, cutOff, entry)) != 0;
+            }
+
+            if(!found)
+                return;
+        }
+    }
+}
+
+void RayQuery::Intersect(const TriangleBVH& bvh, const Ray* rays, uint32 count, Hit* hits, Mode mode)
+{
+    if(bvh.GetNodes().empty())
+    {
+        for(uint32 i = 0; i < count; ++i)
+        {
+            hits[i].Triangle = NoHit;
+            hits[i].Distance = rays[i].MaxDist;
+        }
+        return;
+    }
+
+    static_assert(RaysPerTask % Lanes == 0, "Tasks hold whole packets.");
+
+    const uint32 taskCount = (count + RaysPerTask - 1)/RaysPerTask;
+    concurrency::parallel_for(0u, taskCount, [&](uint32 task)
+    {
+        const uint32 last = std::min((task + 1)*RaysPerTask, count);
+        for(uint32 first = task*RaysPerTask; first < last; first += Lanes)
+        {
+            Packet p;
+            for(uint32 lane = 0; lane < Lanes; ++lane)
+            {
+                // Lanes past the last ray repeat it, done from the start.
+                const Ray& ray = rays[std::min(first + lane, last - 1)];
+                p.OriginX[lane] = ray.Origin.x;
+                p.OriginY[lane] = ray.Origin.y;
+                p.OriginZ[lane] = ray.Origin.z;
+                p.DirX[lane] = ray.Direction.x;
+                p.DirY[lane] = ray.Direction.y;
+                p.DirZ[lane] = ray.Direction.z;
+                p.InvDirX[lane] = TriangleBVH::SafeInverse(ray.Direction.x);
+                p.InvDirY[lane] = TriangleBVH::SafeInverse(ray.Direction.y);
+                p.InvDirZ[lane] = TriangleBVH::SafeInverse(ray.Direction.z);
+                p.CutOff[lane] = first + lane < last ? ray.MaxDist : Done;
+                p.Triangle[lane] = NoHit;
+                p.Distance[lane] = ray.MaxDist;
+            }
+
+            TracePacket(bvh, p, mode);
+
+            for(uint32 lane = 0; lane < Lanes && first + lane < last; ++lane)
+            {
+                hits[first + lane].Triangle = p.Triangle[lane];
+                hits[first + lane].Distance = p.Distance[lane];
+            }
+        }
+    });
+}
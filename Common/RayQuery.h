@@ -0,0 +1,66 @@
+//***************************************************************************************
+// RayQuery.h
+//
+// Many ray queries at once against a TriangleBVH (picking, line of sight,
+// placement).
+//
+// Consecutive rays are grouped into packets of 8 (AVX) or 4 (SSE) and each
+// packet walks the tree together: a node is entered when any ray of the packet
+// enters its box, and each triangle is tested against all the rays of the
+// packet at once.  Packets share most of their nodes when their rays are
+// coherent (e.g., rays through neighbouring pixels, or from one origin to
+// nearby targets), so put such rays next to each other in the array.  The
+// packets are spread across threads.
+//
+// Closest hits give the nearest triangle of each ray, with equal distances going
+// to the lower triangle index as in TriangleBVH::Intersects.  Any hits stop a
+// ray at the first triangle found before its MaxDist, which is all a line of
+// sight query needs.
+//***************************************************************************************
+
+#pragma once
+
+#include "TriangleBVH.h"
+#include <cfloat>
+
+class RayQuery
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+    // Triangle of a ray that hits nothing.
+    static const uint32 NoHit = 0xffffffff;
+
+    // Rays per work item of the threads.
+    static const uint32 RaysPerTask = 256;
+
+    enum class Mode
+    {
+        ClosestHit,
+        AnyHit
+    };
+
+    // Rays are in the space of the tree's positions; Direction is unit length.
+    struct Ray
+    {
+        DirectX::XMFLOAT3 Origin;
+        DirectX::XMFLOAT3 Direction;
+
+        // Hits farther than this are ignored.
+        float MaxDist = FLT_MAX;
+    };
+
+    struct Hit
+    {
+        // The index of the triangle in the tree's index list, or NoHit.
+        uint32 Triangle;
+        float Distance;
+    };
+
+    ///<summary>
+    /// Traces rays[0..count) against the tree and writes hits[0..count).
+    ///</summary>
+    static void Intersect(const TriangleBVH& bvh, const Ray* rays, uint32 count, Hit* hits,
+        Mode mode = Mode::ClosestHit);
+};
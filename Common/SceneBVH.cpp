@@ -0,0 +1,218 @@
+//***************************************************************************************
+// SceneBVH.cpp
+//***************************************************************************************
+
+#include "SceneBVH.h"
+#include "BinnedSAH.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = SceneBVH::uint32;
+
+    const uint32 AllPlanes = 0x3f;
+
+    using Range = BinnedSAH::Range;
+
+    Range BoxRange(const BoundingBox& box)
+    {
+        Range range;
+        range.Grow(XMFLOAT3(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z),
+                   XMFLOAT3(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z));
+        return range;
+    }
+
+    //
+    // A box is outside a plane when its center is further behind it than its
+    // projected radius, and inside when further in front.  Planes the box is
+    // inside of are cleared from mask.
+    //
+    bool Outside(const XMFLOAT4 planes[6], const XMFLOAT3& center, const XMFLOAT3& extents, uint32& mask)
+    {
+        for(int p = 0; p < 6; ++p)
+        {
+            if((mask & (1u << p)) == 0)
+                continue;
+
+            const XMFLOAT4& plane = planes[p];
+            const float dist = plane.x*center.x + plane.y*center.y + plane.z*center.z + plane.w;
+            const float radius = std::fabs(plane.x)*extents.x + std::fabs(plane.y)*extents.y + std::fabs(plane.z)*extents.z;
+
+            if(dist + radius < 0.0f)
+                return true;
+            if(dist - radius >= 0.0f)
+                mask &= ~(1u << p);
+        }
+
+        return false;
+    }
+}
+
+void SceneBVH::Build(const BoundingBox* worldBounds, uint32 count)
+{
+    mNodes.clear();
+    mObjects.resize(count);
+    mBounds.resize(count);
+    mSlots.resize(count);
+
+    if(count == 0)
+        return;
+
+    std::vector<Range> bounds(count);
+    std::vector<XMFLOAT3> centers(count);
+    Range scene;
+    for(uint32 i = 0; i < count; ++i)
+    {
+        mObjects[i] = i;
+        bounds[i] = BoxRange(worldBounds[i]);
+        centers[i] = worldBounds[i].Center;
+        scene.Grow(centers[i]);
+    }
+
+    const float extent = std::max(std::max(scene.Max.x - scene.Min.x, scene.Max.y - scene.Min.y), scene.Max.z - scene.Min.z);
+
+    // A node is at most one leaf per object plus the nodes above them.
+    mNodes.reserve(2*(size_t)count);
+
+    Node root;
+    root.First = 0;
+    root.Count = count;
+    root.Children = 0;
+    mNodes.push_back(root);
+
+    std::vector<uint32> toSplit(1, 0);
+    while(!toSplit.empty())
+    {
+        const uint32 nodeIndex = toSplit.back();
+        toSplit.pop_back();
+
+        const uint32 first = mNodes[nodeIndex].First;
+        const uint32 nodeCount = mNodes[nodeIndex].Count;
+        if(nodeCount <= MaxLeafSize)
+            continue;
+
+        const uint32 leftCount = BinnedSAH::SplitItems(mObjects.data() + first, nodeCount,
+            bounds.data(), centers.data(), extent).LeftCount;
+
+        Node child;
+        child.Children = 0;
+
+        mNodes[nodeIndex].Children = (uint32)mNodes.size();
+
+        child.First = first;
+        child.Count = leftCount;
+        mNodes.push_back(child);
+
+        child.First = first + leftCount;
+        child.Count = nodeCount - leftCount;
+        mNodes.push_back(child);
+
+        toSplit.push_back(mNodes[nodeIndex].Children + 1);
+        toSplit.push_back(mNodes[nodeIndex].Children);
+    }
+
+    for(uint32 slot = 0; slot < count; ++slot)
+    {
+        mBounds[slot] = worldBounds[mObjects[slot]];
+        mSlots[mObjects[slot]] = slot;
+    }
+
+    Refit();
+}
+
+void SceneBVH::SetBounds(uint32 index, const BoundingBox& worldBounds)
+{
+    mBounds[mSlots[index]] = worldBounds;
+}
+
+BoundingBox SceneBVH::GetBounds(uint32 index)const
+{
+    return mBounds[mSlots[index]];
+}
+
+void SceneBVH::Refit()
+{
+    // Children come after their parents, so going backwards visits every node
+    // after its children.
+    for(size_t i = mNodes.size(); i-- > 0; )
+    {
+        Node& node = mNodes[i];
+
+        Range range;
+        if(node.Children == 0)
+        {
+            for(uint32 slot = node.First; slot < node.First + node.Count; ++slot)
+                range.Grow(BoxRange(mBounds[slot]));
+        }
+        else
+        {
+            for(uint32 c = node.Children; c < node.Children + 2; ++c)
+            {
+                const Node& child = mNodes[c];
+                range.Grow(XMFLOAT3(child.Center.x - child.Extents.x, child.Center.y - child.Extents.y, child.Center.z - child.Extents.z),
+                           XMFLOAT3(child.Center.x + child.Extents.x, child.Center.y + child.Extents.y, child.Center.z + child.Extents.z));
+            }
+        }
+
+        node.Center = XMFLOAT3(0.5f*(range.Min.x + range.Max.x), 0.5f*(range.Min.y + range.Max.y), 0.5f*(range.Min.z + range.Max.z));
+        node.Extents = XMFLOAT3(0.5f*(range.Max.x - range.Min.x), 0.5f*(range.Max.y - range.Min.y), 0.5f*(range.Max.z - range.Min.z));
+    }
+}
+
+uint32 SceneBVH::Cull(const XMFLOAT4 planes[6], uint32* visible)const
+{
+    uint32 count = 0;
+    if(mNodes.empty())
+        return 0;
+
+    // Nodes to visit, with the planes they still straddle.
+    struct Visit
+    {
+        uint32 Node;
+        uint32 Mask;
+    };
+
+    std::vector<Visit> stack;
+    stack.reserve(64);
+    stack.push_back({ 0, AllPlanes });
+
+    while(!stack.empty())
+    {
+        const Visit visit = stack.back();
+        stack.pop_back();
+
+        const Node& node = mNodes[visit.Node];
+
+        uint32 mask = visit.Mask;
+        if(Outside(planes, node.Center, node.Extents, mask))
+            continue;
+
+        if(mask == 0)
+        {
+            std::memcpy(visible + count, &mObjects[node.First], node.Count*sizeof(uint32));
+            count += node.Count;
+        }
+        else if(node.Children == 0)
+        {
+            for(uint32 slot = node.First; slot < node.First + node.Count; ++slot)
+            {
+                uint32 objectMask = mask;
+                if(!Outside(planes, mBounds[slot].Center, mBounds[slot].Extents, objectMask))
+                    visible[count++] = mObjects[slot];
+            }
+        }
+        else
+        {
+            // The left child goes on top, so objects come out in tree order.
+            stack.push_back({ node.Children + 1, mask });
+            stack.push_back({ node.Children, mask });
+        }
+    }
+
+    return count;
+}
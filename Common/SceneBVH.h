@@ -0,0 +1,82 @@
+//***************************************************************************************
+// SceneBVH.h
+//
+// A bounding volume hierarchy over the world-space boxes of render items or
+// instances, for frustum culling large scenes.
+//
+// The tree is built top down: each node's objects are sorted into bins along the
+// axis where their centers spread the most, and the node is split at the bin
+// boundary with the lowest surface area heuristic cost (see BinnedSAH).  When
+// objects move, their boxes are updated and Refit grows the node boxes to match
+// without changing the tree; Build again after large movements, when the
+// refitted boxes become loose.
+//
+// Culling walks the tree from the root and drops a subtree as soon as its box is
+// outside a plane.  A box that is entirely inside a plane takes that plane off
+// the tests of its subtree, so a subtree entirely inside the frustum is accepted
+// as a whole, without testing its objects.  The objects of every subtree are
+// contiguous, so accepting one is a single copy.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+class SceneBVH
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+    // Nodes with this many objects or fewer are leaves.
+    static const uint32 MaxLeafSize = 4;
+
+    ///<summary>
+    /// Builds the tree over objects 0..count - 1 with the given world boxes.
+    ///</summary>
+    void Build(const DirectX::BoundingBox* worldBounds, uint32 count);
+
+    uint32 Count()const { return (uint32)mObjects.size(); }
+    uint32 NodeCount()const { return (uint32)mNodes.size(); }
+
+    // Changes the box of an object; the tree is out of date until Refit.
+    void SetBounds(uint32 index, const DirectX::BoundingBox& worldBounds);
+
+    DirectX::BoundingBox GetBounds(uint32 index)const;
+
+    // Recomputes the node boxes from the object boxes, bottom up.
+    void Refit();
+
+    ///<summary>
+    /// Writes the indices of the objects that are not entirely outside one of
+    /// the planes (see FrustumCuller::ExtractPlanes), in tree order, and returns
+    /// how many there are.  visible must have room for Count() indices.
+    ///</summary>
+    uint32 Cull(const DirectX::XMFLOAT4 planes[6], uint32* visible)const;
+
+private:
+    struct Node
+    {
+        DirectX::XMFLOAT3 Center;
+        DirectX::XMFLOAT3 Extents;
+
+        // The objects of the subtree are mObjects[First..First + Count).
+        uint32 First;
+        uint32 Count;
+
+        // The two children are Children and Children + 1; 0 for leaves.
+        uint32 Children;
+    };
+
+private:
+    std::vector<Node> mNodes;
+
+    // Object indices in tree order, and the boxes in the same order.
+    std::vector<uint32> mObjects;
+    std::vector<DirectX::BoundingBox> mBounds;
+
+    // Where each object is in tree order.
+    std::vector<uint32> mSlots;
+};
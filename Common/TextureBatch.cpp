@@ -0,0 +1,236 @@
+//***************************************************************************************
+// TextureBatch.cpp
+//***************************************************************************************
+
+#include "TextureBatch.h"
+#include <cstring>
+#include <ppl.h>
+
+namespace
+{
+    using uint32 = TextureBatch::uint32;
+    using uint64 = TextureBatch::uint64;
+
+    uint64 AlignUp(uint64 value, uint64 alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Footprint widths and heights are whole blocks: 4x4 for the BC formats and 2x1
+    // for the packed 4:2:2 formats.
+    void GetBlockSize(DXGI_FORMAT format, uint32& blockWidth, uint32& blockHeight)
+    {
+        switch(format)
+        {
+        case DXGI_FORMAT_BC1_TYPELESS:
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC2_TYPELESS:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_TYPELESS:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_TYPELESS:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+        case DXGI_FORMAT_BC5_TYPELESS:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+        case DXGI_FORMAT_BC6H_TYPELESS:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+        case DXGI_FORMAT_BC7_TYPELESS:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            blockWidth = 4;
+            blockHeight = 4;
+            break;
+
+        case DXGI_FORMAT_R8G8_B8G8_UNORM:
+        case DXGI_FORMAT_G8R8_G8B8_UNORM:
+        case DXGI_FORMAT_YUY2:
+        case DXGI_FORMAT_Y210:
+        case DXGI_FORMAT_Y216:
+            blockWidth = 2;
+            blockHeight = 1;
+            break;
+
+        default:
+            blockWidth = 1;
+            blockHeight = 1;
+            break;
+        }
+    }
+
+    // Lays the subresources out from offset 0 and returns the bytes they span,
+    // without the padding after the last row (as GetCopyableFootprints does).
+    uint64 LayOut(const DDSFile& file, std::vector<TextureBatch::Footprint>& footprints)
+    {
+        uint32 blockWidth, blockHeight;
+        GetBlockSize(file.GetDescription().Format, blockWidth, blockHeight);
+
+        const std::vector<DDSFile::Subresource>& subresources = file.GetSubresources();
+        footprints.resize(subresources.size());
+
+        uint64 offset = 0;
+        uint64 end = 0;
+        for(size_t i = 0; i < subresources.size(); ++i)
+        {
+            const DDSFile::Subresource& s = subresources[i];
+            TextureBatch::Footprint& f = footprints[i];
+
+            f.Offset = AlignUp(offset, TextureBatch::PlacementAlignment);
+            f.Width = (uint32)AlignUp(s.Width, blockWidth);
+            f.Height = (uint32)AlignUp(s.Height, blockHeight);
+            f.Depth = s.Depth;
+            f.RowPitch = (uint32)AlignUp(s.RowPitch, TextureBatch::RowPitchAlignment);
+            f.NumRows = (uint32)s.NumRows;
+            f.RowBytes = s.RowPitch;
+
+            end = f.Offset + (uint64)f.RowPitch*(f.NumRows*f.Depth - 1) + f.RowBytes;
+            offset = f.Offset + (uint64)f.RowPitch*f.NumRows*f.Depth;
+        }
+
+        return end;
+    }
+}
+
+bool TextureBatch::Load(const std::vector<std::wstring>& filenames)
+{
+    mTextures.clear();
+    mTextures.resize(filenames.size());
+    mArenaSize = 0;
+    mPayloadSize = 0;
+
+    // Opening and parsing is mostly page faults and small reads, so the files
+    // overlap well even on few cores.
+    concurrency::parallel_for(size_t(0), filenames.size(), [&](size_t i)
+    {
+        Texture& texture = mTextures[i];
+        texture.Filename = filenames[i];
+        texture.File.reset(new DDSFile());
+        texture.Status = texture.File->Open(texture.Filename);
+
+        if(texture.Status == DDSFile::Status::Ok)
+            texture.ArenaBytes = LayOut(*texture.File, texture.Footprints);
+    });
+
+    bool ok = true;
+    for(Texture& texture : mTextures)
+    {
+        if(texture.Status != DDSFile::Status::Ok)
+        {
+            ok = false;
+            continue;
+        }
+
+        texture.ArenaOffset = AlignUp(mArenaSize, PlacementAlignment);
+        for(Footprint& f : texture.Footprints)
+        {
+            f.Offset += texture.ArenaOffset;
+            mPayloadSize += f.RowBytes*f.NumRows*f.Depth;
+        }
+
+        mArenaSize = texture.ArenaOffset + texture.ArenaBytes;
+    }
+
+    return ok;
+}
+
+bool TextureBatch::CopyToArena(uint8* arena)const
+{
+    // One work item per subresource, or per chunk of a compressed file, so a
+    // texture with a long mip chain does not hold up the rest of the batch.
+    struct CopyItem
+    {
+        const Texture* Owner;
+        size_t Index;
+        bool IsChunk;
+    };
+
+    std::vector<CopyItem> items;
+    for(const Texture& texture : mTextures)
+    {
+        if(texture.Status != DDSFile::Status::Ok)
+            continue;
+
+        if(texture.File->IsCompressed())
+        {
+            for(size_t i = 0; i < texture.File->GetChunks().size(); ++i)
+                items.push_back({ &texture, i, true });
+        }
+        else
+        {
+            for(size_t i = 0; i < texture.Footprints.size(); ++i)
+                items.push_back({ &texture, i, false });
+        }
+    }
+
+    bool ok = true;
+    concurrency::parallel_for(size_t(0), items.size(), [&](size_t i)
+    {
+        const DDSFile& file = *items[i].Owner->File;
+
+        if(items[i].IsChunk)
+        {
+            const DDSFile::Chunk& chunk = file.GetChunks()[items[i].Index];
+            const DDSFile::Subresource& src = file.GetSubresources()[chunk.Subresource];
+            const Footprint& dst = items[i].Owner->Footprints[chunk.Subresource];
+
+            // The chunk's rows are consecutive in the footprint too (depth
+            // slices follow each other at RowPitch*NumRows).
+            uint8* dstRows = arena + dst.Offset + (uint64)chunk.FirstRow*dst.RowPitch;
+
+            // Matches read back what was just decompressed, and the upload heap
+            // is write-combined memory that is very slow to read, so chunks go
+            // through a scratch buffer that stays in the cache.  Stored chunks
+            // are copied straight from the file.
+            const uint8* rows = file.Data() + chunk.SourceOffset;
+            if(chunk.CompressedSize != chunk.Size)
+            {
+                thread_local std::vector<uint8> scratch;
+                scratch.resize(chunk.Size);
+                if(!file.DecompressChunk(chunk, scratch.data()))
+                {
+                    ok = false;
+                    return;
+                }
+                rows = scratch.data();
+            }
+
+            if(dst.RowPitch == src.RowPitch)
+            {
+                std::memcpy(dstRows, rows, chunk.Size);
+                return;
+            }
+
+            for(uint32 row = 0; row < chunk.RowCount; ++row)
+                std::memcpy(dstRows + (uint64)row*dst.RowPitch, rows + row*src.RowPitch, (size_t)dst.RowBytes);
+            return;
+        }
+
+        const DDSFile::Subresource& src = file.GetSubresources()[items[i].Index];
+        const Footprint& dst = items[i].Owner->Footprints[items[i].Index];
+
+        const uint8* srcData = file.SubresourceData(src);
+        uint8* dstData = arena + dst.Offset;
+
+        for(uint32 z = 0; z < dst.Depth; ++z)
+        {
+            const uint8* srcSlice = srcData + z*src.SlicePitch;
+            uint8* dstSlice = dstData + (uint64)z*dst.RowPitch*dst.NumRows;
+
+            if(dst.RowPitch == src.RowPitch)
+            {
+                std::memcpy(dstSlice, srcSlice, src.SlicePitch);
+                continue;
+            }
+
+            for(uint32 row = 0; row < dst.NumRows; ++row)
+                std::memcpy(dstSlice + (uint64)row*dst.RowPitch, srcSlice + row*src.RowPitch, (size_t)dst.RowBytes);
+        }
+    });
+
+    return ok;
+}
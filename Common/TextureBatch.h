@@ -0,0 +1,98 @@
+//***************************************************************************************
+// TextureBatch.h
+//
+// Lays out a batch of DDS textures in one upload arena.
+//
+// The files are memory mapped and parsed in parallel (see DDSFile); compressed
+// files stay compressed until CopyToArena.  Every subresource then gets a
+// footprint in the arena that follows the Direct3D 12 copy rules, so the whole
+// batch needs a single upload buffer and one CopyTextureRegion per subresource.
+// The footprints are the same ones ID3D12Device::GetCopyableFootprints returns
+// for the textures placed back to back.
+//
+// Nothing here needs a device: CopyToArena writes into any memory of ArenaSize()
+// bytes (the mapped upload buffer, or a plain CPU buffer).
+// DirectX::CreateDDSTexturesFromFiles12 is built on top of this.
+//***************************************************************************************
+
+#pragma once
+
+#include "DDSFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class TextureBatch
+{
+public:
+
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    // D3D12_TEXTURE_DATA_PITCH_ALIGNMENT and D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT.
+    static const uint32 RowPitchAlignment = 256;
+    static const uint32 PlacementAlignment = 512;
+
+    // Matches D3D12_PLACED_SUBRESOURCE_FOOTPRINT plus the row count and row size
+    // that GetCopyableFootprints returns next to it.
+    struct Footprint
+    {
+        uint64 Offset = 0;      // from the start of the arena
+        uint32 Width = 0;       // rounded up to whole blocks
+        uint32 Height = 0;
+        uint32 Depth = 0;
+        uint32 RowPitch = 0;    // in the arena
+        uint32 NumRows = 0;     // per depth slice
+        uint64 RowBytes = 0;    // bytes of texel data in each row
+    };
+
+    struct Texture
+    {
+        std::wstring Filename;
+        DDSFile::Status Status = DDSFile::Status::FileNotFound;
+
+        // Valid while the batch is alive.
+        std::unique_ptr<DDSFile> File;
+
+        // One footprint per subresource, in Direct3D order.
+        std::vector<Footprint> Footprints;
+
+        uint64 ArenaOffset = 0;
+        uint64 ArenaBytes = 0;
+    };
+
+    TextureBatch() = default;
+    TextureBatch(const TextureBatch& rhs) = delete;
+    TextureBatch& operator=(const TextureBatch& rhs) = delete;
+
+    ///<summary>
+    /// Opens, parses and lays out every file.  Returns false if any file failed;
+    /// each texture keeps its own status.
+    ///</summary>
+    bool Load(const std::vector<std::wstring>& filenames);
+
+    size_t Count()const { return mTextures.size(); }
+    const Texture& operator[](size_t i)const { return mTextures[i]; }
+
+    // Bytes the upload buffer needs.
+    uint64 ArenaSize()const { return mArenaSize; }
+
+    // Bytes of texel data in the arena; the rest is alignment padding.
+    uint64 PayloadSize()const { return mPayloadSize; }
+
+    ///<summary>
+    /// Copies every subresource of every texture to its footprint, decompressing
+    /// the chunks of compressed files in parallel on the way.  arena must hold
+    /// ArenaSize() bytes.  Padding bytes are left untouched.  Returns false if a
+    /// compressed chunk is damaged.
+    ///</summary>
+    bool CopyToArena(uint8* arena)const;
+
+private:
+    std::vector<Texture> mTextures;
+    uint64 mArenaSize = 0;
+    uint64 mPayloadSize = 0;
+};
@@ -0,0 +1,331 @@
+//***************************************************************************************
+// TextureIndex.cpp
+//***************************************************************************************
+
+#include "TextureIndex.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+#include <ppl.h>
+
+namespace
+{
+    using uint8 = std::uint8_t;
+    using uint32 = TextureIndex::uint32;
+    using uint64 = TextureIndex::uint64;
+
+    const uint32 FileMagic = 0x58444954; // "TIDX"
+
+    struct FileHeader
+    {
+        uint32 Magic;
+        uint32 FormatVersion;
+        uint32 EntryCount;
+        uint32 NameBytes;
+    };
+
+    // Followed by the names, UTF-8, one after another.
+    struct FileEntry
+    {
+        uint64 FileSize;
+        uint64 ModifiedTime;
+        uint64 DataBytes;
+        uint32 NameOffset;
+        uint32 NameLength;
+        uint32 Status;
+        uint32 Format;
+        uint32 Width;
+        uint32 Height;
+        uint32 Depth;
+        uint32 MipLevels;
+        uint32 ArraySize;
+        uint8 Dimension;
+        uint8 Alpha;
+        uint8 IsCubeMap;
+        uint8 Reserved;
+    };
+
+    static_assert(sizeof(FileHeader) == 16, "The index header is written as is.");
+    static_assert(sizeof(FileEntry) == 64, "Index entries are written as is.");
+
+    std::wstring LowerCase(const std::wstring& name)
+    {
+        std::wstring lower(name);
+        for(wchar_t& c : lower)
+            c = (wchar_t)std::towlower(c);
+        return lower;
+    }
+
+    //
+    // Names are stored as UTF-8 with one sequence per wchar_t (surrogate halves
+    // included), so they come back unchanged whatever the size of wchar_t.
+    //
+
+    void AppendUtf8(const std::wstring& name, std::vector<uint8>& out)
+    {
+        for(wchar_t wc : name)
+        {
+            const uint32 c = (uint32)wc;
+            if(c < 0x80)
+            {
+                out.push_back((uint8)c);
+            }
+            else if(c < 0x800)
+            {
+                out.push_back((uint8)(0xc0 | (c >> 6)));
+                out.push_back((uint8)(0x80 | (c & 0x3f)));
+            }
+            else if(c < 0x10000)
+            {
+                out.push_back((uint8)(0xe0 | (c >> 12)));
+                out.push_back((uint8)(0x80 | ((c >> 6) & 0x3f)));
+                out.push_back((uint8)(0x80 | (c & 0x3f)));
+            }
+            else
+            {
+                out.push_back((uint8)(0xf0 | ((c >> 18) & 0x07)));
+                out.push_back((uint8)(0x80 | ((c >> 12) & 0x3f)));
+                out.push_back((uint8)(0x80 | ((c >> 6) & 0x3f)));
+                out.push_back((uint8)(0x80 | (c & 0x3f)));
+            }
+        }
+    }
+
+    bool DecodeUtf8(const uint8* data, size_t size, std::wstring& name)
+    {
+        name.clear();
+        for(size_t i = 0; i < size; )
+        {
+            const uint8 lead = data[i];
+            size_t length = lead < 0x80 ? 1 : lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : 4;
+            if(lead >= 0x80 && lead < 0xc0)
+                return false;
+            if(i + length > size)
+                return false;
+
+            uint32 c = length == 1 ? lead : lead & (0xff >> (length + 1));
+            for(size_t k = 1; k < length; ++k)
+            {
+                if((data[i + k] & 0xc0) != 0x80)
+                    return false;
+                c = (c << 6) | (data[i + k] & 0x3f);
+            }
+
+            name.push_back((wchar_t)c);
+            i += length;
+        }
+
+        return true;
+    }
+}
+
+bool TextureIndex::Build(const std::wstring& directory, BuildStats* stats)
+{
+    std::vector<MappedFile::DirectoryEntry> files;
+    if(!MappedFile::ListDirectory(directory, L".dds", files))
+        return false;
+
+    std::sort(files.begin(), files.end(), [](const MappedFile::DirectoryEntry& a, const MappedFile::DirectoryEntry& b)
+    {
+        return a.Name < b.Name;
+    });
+
+    BuildStats result;
+    result.Files = (uint32)files.size();
+
+    std::vector<Entry> entries(files.size());
+    std::vector<uint32> toRead;
+    size_t stillThere = 0;
+    for(uint32 i = 0; i < (uint32)files.size(); ++i)
+    {
+        const Entry* current = Find(files[i].Name);
+        if(current != nullptr)
+            stillThere++;
+
+        if(current != nullptr && current->FileSize == files[i].Size && current->ModifiedTime == files[i].ModifiedTime)
+        {
+            entries[i] = *current;
+            entries[i].Name = files[i].Name;
+            result.Reused++;
+        }
+        else
+        {
+            entries[i].Name = files[i].Name;
+            entries[i].FileSize = files[i].Size;
+            entries[i].ModifiedTime = files[i].ModifiedTime;
+            toRead.push_back(i);
+        }
+    }
+
+    result.Read = (uint32)toRead.size();
+    result.Removed = (uint32)(mEntries.size() - stillThere);
+
+    const std::wstring prefix = (directory.empty() || directory.back() == L'/' || directory.back() == L'\\') ?
+        directory : directory + L"/";
+
+    auto readHeader = [&](uint32 i)
+    {
+        Entry& entry = entries[toRead[i]];
+
+        uint8 header[DDSFile::MaxHeaderSize];
+        const size_t size = MappedFile::ReadHead(prefix + entry.Name, header, sizeof(header));
+
+        entry.Status = size == 0 ? DDSFile::Status::FileNotFound :
+            DDSFile::ParseHeader(header, size, entry.FileSize, entry.Desc, &entry.DataBytes);
+    };
+
+    // The reads are small and mostly wait on the file system, so they overlap
+    // well even on few cores.
+    const uint32 parallelThreshold = 64;
+    if(toRead.size() < parallelThreshold)
+    {
+        for(uint32 i = 0; i < (uint32)toRead.size(); ++i)
+            readHeader(i);
+    }
+    else
+    {
+        concurrency::parallel_for(0u, (uint32)toRead.size(), readHeader);
+    }
+
+    mEntries.swap(entries);
+    Rehash();
+
+    if(stats != nullptr)
+        *stats = result;
+
+    return true;
+}
+
+bool TextureIndex::Load(const std::wstring& filename)
+{
+    mEntries.clear();
+    mLookup.clear();
+
+    MappedFile file;
+    if(!file.Open(filename) || file.Size() < sizeof(FileHeader))
+        return false;
+
+    FileHeader header;
+    std::memcpy(&header, file.Data(), sizeof(FileHeader));
+
+    const uint64 namesOffset = sizeof(FileHeader) + (uint64)header.EntryCount*sizeof(FileEntry);
+    if(header.Magic != FileMagic ||
+       header.FormatVersion != FormatVersion ||
+       file.Size() != namesOffset + header.NameBytes)
+        return false;
+
+    const uint8* names = file.Data() + namesOffset;
+
+    std::vector<Entry> entries(header.EntryCount);
+    for(uint32 i = 0; i < header.EntryCount; ++i)
+    {
+        FileEntry e;
+        std::memcpy(&e, file.Data() + sizeof(FileHeader) + (size_t)i*sizeof(FileEntry), sizeof(FileEntry));
+
+        if((uint64)e.NameOffset + e.NameLength > header.NameBytes ||
+           e.Status > (uint32)DDSFile::Status::EndOfFile ||
+           e.Alpha > (uint8)DDSFile::AlphaMode::Custom ||
+           (e.Dimension != 0 && (e.Dimension < 2 || e.Dimension > 4)))
+            return false;
+
+        Entry& entry = entries[i];
+        if(!DecodeUtf8(names + e.NameOffset, e.NameLength, entry.Name))
+            return false;
+
+        entry.FileSize = e.FileSize;
+        entry.ModifiedTime = e.ModifiedTime;
+        entry.DataBytes = e.DataBytes;
+        entry.Status = (DDSFile::Status)e.Status;
+        entry.Desc.Dimension = (DDSFile::TextureDimension)e.Dimension;
+        entry.Desc.Format = (DXGI_FORMAT)e.Format;
+        entry.Desc.Width = e.Width;
+        entry.Desc.Height = e.Height;
+        entry.Desc.Depth = e.Depth;
+        entry.Desc.MipLevels = e.MipLevels;
+        entry.Desc.ArraySize = e.ArraySize;
+        entry.Desc.IsCubeMap = e.IsCubeMap != 0;
+        entry.Desc.Alpha = (DDSFile::AlphaMode)e.Alpha;
+    }
+
+    mEntries.swap(entries);
+    Rehash();
+
+    return true;
+}
+
+bool TextureIndex::Save(const std::wstring& filename)const
+{
+    std::vector<uint8> names;
+    std::vector<FileEntry> records(mEntries.size());
+    for(size_t i = 0; i < mEntries.size(); ++i)
+    {
+        const Entry& entry = mEntries[i];
+        FileEntry& e = records[i];
+        std::memset(&e, 0, sizeof(FileEntry));
+
+        e.NameOffset = (uint32)names.size();
+        AppendUtf8(entry.Name, names);
+        e.NameLength = (uint32)names.size() - e.NameOffset;
+
+        e.FileSize = entry.FileSize;
+        e.ModifiedTime = entry.ModifiedTime;
+        e.DataBytes = entry.DataBytes;
+        e.Status = (uint32)entry.Status;
+        e.Format = (uint32)entry.Desc.Format;
+        e.Width = entry.Desc.Width;
+        e.Height = entry.Desc.Height;
+        e.Depth = entry.Desc.Depth;
+        e.MipLevels = entry.Desc.MipLevels;
+        e.ArraySize = entry.Desc.ArraySize;
+        e.Dimension = (uint8)entry.Desc.Dimension;
+        e.Alpha = (uint8)entry.Desc.Alpha;
+        e.IsCubeMap = entry.Desc.IsCubeMap ? 1 : 0;
+    }
+
+    FileHeader header;
+    header.Magic = FileMagic;
+    header.FormatVersion = FormatVersion;
+    header.EntryCount = (uint32)records.size();
+    header.NameBytes = (uint32)names.size();
+
+    std::vector<uint8> data(sizeof(FileHeader) + records.size()*sizeof(FileEntry) + names.size());
+    std::memcpy(data.data(), &header, sizeof(FileHeader));
+    if(!records.empty())
+        std::memcpy(data.data() + sizeof(FileHeader), records.data(), records.size()*sizeof(FileEntry));
+    if(!names.empty())
+        std::memcpy(data.data() + sizeof(FileHeader) + records.size()*sizeof(FileEntry), names.data(), names.size());
+
+    return MappedFile::WriteAtomic(filename, data.data(), data.size());
+}
+
+bool TextureIndex::Update(const std::wstring& directory, const std::wstring& filename, BuildStats* stats)
+{
+    const bool loaded = Load(filename);
+
+    BuildStats result;
+    if(!Build(directory, &result))
+        return false;
+
+    if(stats != nullptr)
+        *stats = result;
+
+    if(loaded && result.Read == 0 && result.Removed == 0)
+        return true;
+
+    return Save(filename);
+}
+
+const TextureIndex::Entry* TextureIndex::Find(const std::wstring& name)const
+{
+    auto it = mLookup.find(LowerCase(name));
+    return it == mLookup.end() ? nullptr : &mEntries[it->second];
+}
+
+void TextureIndex::Rehash()
+{
+    mLookup.clear();
+    mLookup.reserve(mEntries.size());
+    for(uint32 i = 0; i < (uint32)mEntries.size(); ++i)
+        mLookup[LowerCase(mEntries[i].Name)] = i;
+}
@@ -0,0 +1,91 @@
+//***************************************************************************************
+// TextureIndex.h
+//
+// The size, format and layout of every DDS file in a directory, for tools and
+// startup code that plan allocations before any texture is loaded.
+//
+// Build lists the directory and reads only the first DDSFile::MaxHeaderSize bytes
+// of each file, which DDSFile::ParseHeader checks exactly as the loader would,
+// so a file the loader rejects is indexed with the same status.  The index is
+// saved as one compact binary file.  When it is built again, files whose size
+// and write time have not changed keep their entry without being opened; only
+// new and changed files are read.
+//***************************************************************************************
+
+#pragma once
+
+#include "DDSFile.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class TextureIndex
+{
+public:
+
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    // Bump when the file layout changes; older index files are then ignored.
+    static const uint32 FormatVersion = 1;
+
+    struct Entry
+    {
+        // The file name within the directory.
+        std::wstring Name;
+
+        // What the entry was read from.
+        uint64 FileSize = 0;
+        uint64 ModifiedTime = 0;
+
+        DDSFile::Status Status = DDSFile::Status::InvalidFile;
+        DDSFile::Description Desc;
+
+        // Bytes of texel data (all subresources, uncompressed).
+        uint64 DataBytes = 0;
+    };
+
+    struct BuildStats
+    {
+        uint32 Files = 0;       // DDS files in the directory
+        uint32 Reused = 0;      // unchanged since the last build
+        uint32 Read = 0;        // new or changed, so their headers were read
+        uint32 Removed = 0;     // in the index but gone from the directory
+    };
+
+    ///<summary>
+    /// Indexes the .dds files in directory (not its subdirectories), reusing the
+    /// current entries of unchanged files.  Returns false if the directory cannot
+    /// be listed.
+    ///</summary>
+    bool Build(const std::wstring& directory, BuildStats* stats = nullptr);
+
+    ///<summary>
+    /// Replaces the entries with those of an index file.  Returns false, and
+    /// leaves the index empty, if the file is missing or does not pass the checks.
+    ///</summary>
+    bool Load(const std::wstring& filename);
+    bool Save(const std::wstring& filename)const;
+
+    ///<summary>
+    /// Loads filename if it is there, rebuilds from directory and saves the index
+    /// back if anything changed.
+    ///</summary>
+    bool Update(const std::wstring& directory, const std::wstring& filename, BuildStats* stats = nullptr);
+
+    // Looks up a file name, without case.  Returns nullptr if it is not indexed.
+    const Entry* Find(const std::wstring& name)const;
+
+    size_t Count()const { return mEntries.size(); }
+    const Entry& operator[](size_t i)const { return mEntries[i]; }
+
+private:
+    void Rehash();
+
+private:
+    std::vector<Entry> mEntries;
+
+    // Lower case name to position in mEntries.
+    std::unordered_map<std::wstring, uint32> mLookup;
+};
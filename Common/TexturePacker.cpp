@@ -0,0 +1,518 @@
+//***************************************************************************************
+// TexturePacker.cpp
+//***************************************************************************************
+
+#include "TexturePacker.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint8 = TexturePacker::uint8;
+    using uint32 = TexturePacker::uint32;
+    using uint64 = TexturePacker::uint64;
+
+    uint32 RoundUp(uint32 value, uint32 alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    ///<summary>
+    /// Texels per block side: 4 for block compressed formats, 1 for formats with
+    /// whole bytes per texel, and 0 for packed and planar formats, which cannot go
+    /// in an atlas.
+    ///</summary>
+    uint32 BlockDimension(DXGI_FORMAT format)
+    {
+        size_t rowBytes = 0;
+        size_t numRows = 0;
+        DDSFile::GetSurfaceInfo(8, 8, format, nullptr, &rowBytes, &numRows);
+
+        const size_t bpp = DDSFile::BitsPerPixel(format);
+        if(numRows == 2 && rowBytes == bpp*4)
+            return 4;
+        if(bpp >= 8 && bpp % 8 == 0 && numRows == 8 && rowBytes == bpp)
+            return 1;
+        return 0;
+    }
+
+    uint64 SubresourceBytes(const DDSFile& file, uint32 mip, uint32 slice)
+    {
+        const DDSFile::Subresource& s = file.GetSubresource(mip, slice);
+        return (uint64)s.SlicePitch*s.Depth;
+    }
+
+    //
+    // Skyline packer.  The skyline is the top edge of the placed rectangles, as
+    // segments sorted by x.  Each rectangle goes where its bottom is lowest
+    // (leftmost on ties).
+    //
+
+    struct Segment
+    {
+        uint32 X;
+        uint32 Y;
+        uint32 Width;
+    };
+
+    template<typename RectT>
+    uint32 PackSkyline(uint32 width, uint32 height, std::vector<RectT>& rects, std::vector<bool>& placed)
+    {
+        std::vector<Segment> skyline = { { 0, 0, width } };
+        uint32 count = 0;
+
+        for(size_t r = 0; r < rects.size(); ++r)
+        {
+            if(placed[r])
+                continue;
+
+            RectT& rect = rects[r];
+
+            uint32 bestY = 0xffffffff;
+            size_t bestIndex = 0;
+            for(size_t i = 0; i < skyline.size(); ++i)
+            {
+                if(skyline[i].X + rect.Width > width)
+                    break;
+
+                uint32 y = 0;
+                uint32 remaining = rect.Width;
+                for(size_t j = i; j < skyline.size(); ++j)
+                {
+                    y = std::max(y, skyline[j].Y);
+                    if(skyline[j].Width >= remaining)
+                        break;
+                    remaining -= skyline[j].Width;
+                }
+
+                if(y + rect.Height <= height && y < bestY)
+                {
+                    bestY = y;
+                    bestIndex = i;
+                }
+            }
+
+            if(bestY == 0xffffffff)
+                continue;
+
+            rect.X = skyline[bestIndex].X;
+            rect.Y = bestY;
+            placed[r] = true;
+            count++;
+
+            // Raise the skyline under the rectangle.
+            const uint32 end = rect.X + rect.Width;
+            skyline.insert(skyline.begin() + bestIndex, { rect.X, bestY + rect.Height, rect.Width });
+            for(size_t j = bestIndex + 1; j < skyline.size() && skyline[j].X < end; )
+            {
+                const uint32 segmentEnd = skyline[j].X + skyline[j].Width;
+                if(segmentEnd <= end)
+                {
+                    skyline.erase(skyline.begin() + j);
+                }
+                else
+                {
+                    skyline[j].X = end;
+                    skyline[j].Width = segmentEnd - end;
+                    break;
+                }
+            }
+
+            for(size_t j = 0; j + 1 < skyline.size(); )
+            {
+                if(skyline[j].Y == skyline[j + 1].Y)
+                {
+                    skyline[j].Width += skyline[j + 1].Width;
+                    skyline.erase(skyline.begin() + j + 1);
+                }
+                else
+                {
+                    ++j;
+                }
+            }
+        }
+
+        return count;
+    }
+}
+
+TexturePacker::TexturePacker(const Options& options) :
+    mOptions(options)
+{
+}
+
+TexturePacker::uint32 TexturePacker::AddTexture(const DDSFile& file, bool allowAtlas)
+{
+    const DDSFile::Description& desc = file.GetDescription();
+    if(desc.Dimension != DDSFile::TextureDimension::Texture2D || desc.IsCubeMap || desc.ArraySize == 0 ||
+       file.IsCompressed())
+        return InvalidIndex;
+
+    const uint32 first = (uint32)mInputs.size();
+    for(uint32 slice = 0; slice < desc.ArraySize; ++slice)
+    {
+        Input input;
+        input.File = &file;
+        input.Slice = slice;
+        input.AllowAtlas = allowAtlas;
+        mInputs.push_back(input);
+    }
+
+    return first;
+}
+
+void TexturePacker::Pack()
+{
+    mPages.clear();
+    mAtlases.clear();
+    mPlacements.assign(mInputs.size(), Placement());
+
+    // Inputs that can share an array: same format, size and mip count.
+    std::map<std::tuple<int, uint32, uint32, uint32>, std::vector<uint32>> arrays;
+    for(uint32 i = 0; i < (uint32)mInputs.size(); ++i)
+    {
+        const DDSFile::Description& desc = mInputs[i].File->GetDescription();
+        arrays[std::make_tuple((int)desc.Format, desc.Width, desc.Height, desc.MipLevels)].push_back(i);
+    }
+
+    std::map<int, std::vector<uint32>> atlases;
+    for(const auto& group : arrays)
+    {
+        const std::vector<uint32>& inputs = group.second;
+        const uint32 index = inputs[0];
+
+        if(inputs.size() > 1)
+        {
+            for(size_t first = 0; first < inputs.size(); first += mOptions.MaxArraySize)
+            {
+                const size_t last = std::min(inputs.size(), first + mOptions.MaxArraySize);
+                AddArrayPage(std::vector<uint32>(inputs.begin() + first, inputs.begin() + last));
+            }
+        }
+        else if(mInputs[index].AllowAtlas && BlockDimension((DXGI_FORMAT)std::get<0>(group.first)) != 0)
+        {
+            atlases[std::get<0>(group.first)].push_back(index);
+        }
+        else
+        {
+            AddArrayPage(inputs);
+        }
+    }
+
+    for(const auto& group : atlases)
+    {
+        // One texture alone gains nothing from an atlas.
+        if(group.second.size() == 1)
+            AddArrayPage(group.second);
+        else
+            AddAtlasPages(group.second);
+    }
+}
+
+void TexturePacker::AddArrayPage(const std::vector<uint32>& inputs)
+{
+    const DDSFile& file = *mInputs[inputs[0]].File;
+
+    Page page;
+    page.Desc = file.GetDescription();
+    page.Desc.ArraySize = (uint32)inputs.size();
+    page.Inputs = inputs;
+
+    const uint32 pageIndex = (uint32)mPages.size();
+    for(uint32 slice = 0; slice < (uint32)inputs.size(); ++slice)
+    {
+        const Input& input = mInputs[inputs[slice]];
+        for(uint32 mip = 0; mip < page.Desc.MipLevels; ++mip)
+            page.ContentBytes += SubresourceBytes(*input.File, mip, input.Slice);
+
+        Placement& placement = mPlacements[inputs[slice]];
+        placement.Page = pageIndex;
+        placement.Slice = slice;
+    }
+    page.PageBytes = page.ContentBytes;
+
+    mPages.push_back(page);
+    mAtlases.push_back(Atlas());
+}
+
+void TexturePacker::AddAtlasPages(const std::vector<uint32>& inputs)
+{
+    const DDSFile::Description& first = mInputs[inputs[0]].File->GetDescription();
+    const DXGI_FORMAT format = first.Format;
+    const uint32 blockDim = BlockDimension(format);
+
+    // Every level the atlas keeps needs a gutter of at least one block, and
+    // entries aligned so their blocks line up at the last level.
+    uint32 levels = 1;
+    while(mOptions.Padding >= (blockDim << levels))
+        levels++;
+    for(uint32 i : inputs)
+        levels = std::min(levels, mInputs[i].File->GetDescription().MipLevels);
+
+    const uint32 alignment = blockDim << (levels - 1);
+    const uint32 pad = mOptions.Padding > 0 ? RoundUp(mOptions.Padding, alignment) : 0;
+    const uint32 maxSize = std::max(mOptions.MaxAtlasSize / alignment*alignment, alignment);
+
+    std::vector<Rect> rects;
+    for(uint32 i : inputs)
+    {
+        const DDSFile::Description& desc = mInputs[i].File->GetDescription();
+        const Rect rect = { i, RoundUp(desc.Width + 2*pad, alignment), RoundUp(desc.Height + 2*pad, alignment), 0, 0 };
+
+        // Too big for any atlas page.
+        if(rect.Width > maxSize || rect.Height > maxSize)
+        {
+            AddArrayPage({ i });
+            continue;
+        }
+
+        rects.push_back(rect);
+    }
+
+    std::sort(rects.begin(), rects.end(), [](const Rect& a, const Rect& b)
+    {
+        if(a.Height != b.Height)
+            return a.Height > b.Height;
+        return a.Width > b.Width;
+    });
+
+    std::vector<bool> placed(rects.size(), false);
+    size_t remaining = rects.size();
+    while(remaining > 0)
+    {
+        uint32 minWidth = alignment;
+        for(size_t r = 0; r < rects.size(); ++r)
+        {
+            if(!placed[r])
+                minWidth = std::max(minWidth, rects[r].Width);
+        }
+
+        // Pack into strips of a range of widths, each as tall as it needs, and
+        // keep the smallest page.  Pages only have to be multiples of the
+        // alignment, not powers of two.  If nothing fits in maxSize by maxSize,
+        // fill one such page and go around again.
+        const uint32 step = std::max(alignment, RoundUp((maxSize - minWidth) / 64, alignment));
+
+        uint32 pageWidth = maxSize;
+        uint32 pageHeight = maxSize;
+        uint64 bestArea = ~0ull;
+        std::vector<Rect> best;
+        std::vector<bool> bestPlaced;
+        for(uint32 w = minWidth; w <= maxSize; w += step)
+        {
+            std::vector<Rect> trial = rects;
+            std::vector<bool> trialPlaced = placed;
+            if(PackSkyline(w, maxSize, trial, trialPlaced) != remaining)
+                continue;
+
+            uint32 h = alignment;
+            for(size_t r = 0; r < trial.size(); ++r)
+            {
+                if(!placed[r])
+                    h = std::max(h, trial[r].Y + trial[r].Height);
+            }
+
+            const uint64 pageArea = (uint64)w*h;
+            if(pageArea < bestArea || (pageArea == bestArea && std::max(w, h) < std::max(pageWidth, pageHeight)))
+            {
+                bestArea = pageArea;
+                pageWidth = w;
+                pageHeight = h;
+                best.swap(trial);
+                bestPlaced.swap(trialPlaced);
+            }
+        }
+
+        if(best.empty())
+        {
+            best = rects;
+            bestPlaced = placed;
+            PackSkyline(maxSize, maxSize, best, bestPlaced);
+        }
+
+        Page page;
+        page.IsAtlas = true;
+        page.Desc.Dimension = DDSFile::TextureDimension::Texture2D;
+        page.Desc.Format = format;
+        page.Desc.Width = pageWidth;
+        page.Desc.Height = pageHeight;
+        page.Desc.Depth = 1;
+        page.Desc.MipLevels = levels;
+        page.Desc.ArraySize = 1;
+        page.Desc.Alpha = first.Alpha;
+
+        Atlas atlas;
+        atlas.Levels = levels;
+        atlas.Pad = pad;
+
+        const uint32 pageIndex = (uint32)mPages.size();
+        for(size_t r = 0; r < rects.size(); ++r)
+        {
+            if(placed[r] || !bestPlaced[r])
+                continue;
+
+            const Rect& rect = best[r];
+            const Input& input = mInputs[rect.Input];
+            const DDSFile::Description& desc = input.File->GetDescription();
+
+            Placement& placement = mPlacements[rect.Input];
+            placement.Page = pageIndex;
+            placement.Slice = 0;
+            placement.Scale = XMFLOAT2(float(desc.Width) / pageWidth, float(desc.Height) / pageHeight);
+            placement.Offset = XMFLOAT2(float(rect.X + pad) / pageWidth, float(rect.Y + pad) / pageHeight);
+
+            for(uint32 mip = 0; mip < levels; ++mip)
+                page.ContentBytes += SubresourceBytes(*input.File, mip, input.Slice);
+
+            page.Inputs.push_back(rect.Input);
+            atlas.Rects.push_back(rect);
+            placed[r] = true;
+            remaining--;
+        }
+
+        for(uint32 mip = 0; mip < levels; ++mip)
+        {
+            size_t numBytes = 0;
+            DDSFile::GetSurfaceInfo(std::max(pageWidth >> mip, 1u), std::max(pageHeight >> mip, 1u), format,
+                &numBytes, nullptr, nullptr);
+            page.PageBytes += numBytes;
+        }
+
+        mPages.push_back(page);
+        mAtlases.push_back(atlas);
+    }
+}
+
+bool TexturePacker::BuildAtlas(uint32 pageIndex, std::vector<std::vector<uint8>>& levels)const
+{
+    const Page& page = mPages[pageIndex];
+    const Atlas& atlas = mAtlases[pageIndex];
+    const uint32 blockDim = BlockDimension(page.Desc.Format);
+
+    levels.assign(atlas.Levels, std::vector<uint8>());
+    for(uint32 mip = 0; mip < atlas.Levels; ++mip)
+    {
+        const uint32 width = std::max(page.Desc.Width >> mip, 1u);
+        const uint32 height = std::max(page.Desc.Height >> mip, 1u);
+
+        size_t numBytes = 0;
+        size_t rowBytes = 0;
+        DDSFile::GetSurfaceInfo(width, height, page.Desc.Format, &numBytes, &rowBytes, nullptr);
+
+        const size_t elementBytes = rowBytes / ((width + blockDim - 1) / blockDim);
+        std::vector<uint8>& level = levels[mip];
+        level.assign(numBytes, 0);
+
+        for(const Rect& rect : atlas.Rects)
+        {
+            const Input& input = mInputs[rect.Input];
+            const DDSFile::Subresource& sub = input.File->GetSubresource(mip, input.Slice);
+            const uint8* src = input.File->SubresourceData(sub);
+
+            // In blocks at this level: the content and the whole entry with its gutter.
+            const uint32 contentX = ((rect.X + atlas.Pad) >> mip) / blockDim;
+            const uint32 contentY = ((rect.Y + atlas.Pad) >> mip) / blockDim;
+            const uint32 contentWidth = (uint32)(sub.RowPitch / elementBytes);
+            const uint32 contentHeight = (uint32)sub.NumRows;
+            const uint32 x0 = (rect.X >> mip) / blockDim;
+            const uint32 y0 = (rect.Y >> mip) / blockDim;
+            const uint32 x1 = ((rect.X + rect.Width) >> mip) / blockDim;
+            const uint32 y1 = ((rect.Y + rect.Height) >> mip) / blockDim;
+
+            if(contentX + contentWidth > x1 || contentY + contentHeight > y1)
+                return false;
+
+            // The gutter repeats the nearest edge row or column.
+            for(uint32 y = y0; y < y1; ++y)
+            {
+                const uint32 srcY = std::min(std::max(y, contentY) - contentY, contentHeight - 1);
+                const uint8* srcRow = src + srcY*sub.RowPitch;
+                uint8* dstRow = level.data() + y*rowBytes;
+
+                std::memcpy(dstRow + contentX*elementBytes, srcRow, sub.RowPitch);
+                for(uint32 x = x0; x < contentX; ++x)
+                    std::memcpy(dstRow + x*elementBytes, srcRow, elementBytes);
+                for(uint32 x = contentX + contentWidth; x < x1; ++x)
+                    std::memcpy(dstRow + x*elementBytes, srcRow + (contentWidth - 1)*elementBytes, elementBytes);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool TexturePacker::GetSubresources(uint32 pageIndex, std::vector<const uint8*>& subresources,
+    std::vector<std::vector<uint8>>& levels)const
+{
+    if(pageIndex >= mPages.size())
+        return false;
+
+    const Page& page = mPages[pageIndex];
+    if(page.IsAtlas)
+    {
+        if(!BuildAtlas(pageIndex, levels))
+            return false;
+
+        for(const std::vector<uint8>& level : levels)
+            subresources.push_back(level.data());
+    }
+    else
+    {
+        for(uint32 i : page.Inputs)
+        {
+            const Input& input = mInputs[i];
+            for(uint32 mip = 0; mip < page.Desc.MipLevels; ++mip)
+                subresources.push_back(input.File->SubresourceData(input.File->GetSubresource(mip, input.Slice)));
+        }
+    }
+
+    return true;
+}
+
+bool TexturePacker::Serialize(uint32 page, std::vector<uint8>& file)const
+{
+    std::vector<const uint8*> subresources;
+    std::vector<std::vector<uint8>> levels;
+    if(!GetSubresources(page, subresources, levels))
+        return false;
+
+    return DDSFile::Serialize(mPages[page].Desc, subresources, file);
+}
+
+bool TexturePacker::Save(uint32 page, const std::wstring& filename)const
+{
+    std::vector<const uint8*> subresources;
+    std::vector<std::vector<uint8>> levels;
+    if(!GetSubresources(page, subresources, levels))
+        return false;
+
+    return DDSFile::Save(filename, mPages[page].Desc, subresources);
+}
+
+float TexturePacker::Efficiency()const
+{
+    uint64 content = 0;
+    uint64 total = 0;
+    for(const Page& page : mPages)
+    {
+        content += page.ContentBytes;
+        total += page.PageBytes;
+    }
+
+    return total > 0 ? float(content) / float(total) : 1.0f;
+}
+
+XMFLOAT4X4 TexturePacker::RemapTransform(const XMFLOAT4X4& matTransform, const Placement& placement)
+{
+    const XMMATRIX toPage = XMMatrixMultiply(
+        XMMatrixScaling(placement.Scale.x, placement.Scale.y, 1.0f),
+        XMMatrixTranslation(placement.Offset.x, placement.Offset.y, 0.0f));
+
+    XMFLOAT4X4 result;
+    XMStoreFloat4x4(&result, XMMatrixMultiply(XMLoadFloat4x4(&matTransform), toPage));
+    return result;
+}
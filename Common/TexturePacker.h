@@ -0,0 +1,162 @@
+//***************************************************************************************
+// TexturePacker.h
+//
+// Combines DDS textures of the same format into fewer, larger textures, so a
+// scene needs fewer SRVs in the descriptor heap and fewer texture binds.
+//
+// Textures (array slices count separately) with the same format, size and mip
+// count become slices of one Texture2DArray, the way treeArray2.dds was built by
+// hand; their UVs do not change.  Textures the caller allows in an atlas, and
+// that have no partner for an array, are packed side by side into a 2D atlas of
+// their format with a skyline packer.  Each one is surrounded by a gutter that
+// repeats its edge (whole blocks, for block compressed formats) so bilinear
+// filtering does not pick up the neighbors, and the atlas keeps only the mip
+// levels whose gutter is still at least one block wide.  An atlas cannot wrap,
+// so only textures whose UVs stay in [0,1] (sprites, UI, decals) should go
+// there.  Everything else keeps a page of its own.
+//
+// Each source gets a Placement: the page (one SRV), the array slice and the
+// scale and offset that map its UVs into the page, which RemapTransform folds
+// into a material's MatTransform.  The packer works on parsed DDSFiles, which
+// must outlive it, and writes the pages with DDSFile::Serialize.
+//***************************************************************************************
+
+#pragma once
+
+#include "DDSFile.h"
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class TexturePacker
+{
+public:
+
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    static const uint32 InvalidIndex = 0xffffffff;
+
+    struct Options
+    {
+        Options() :
+            MaxAtlasSize(4096),
+            Padding(16),
+            MaxArraySize(2048)
+        {
+        }
+
+        // Largest atlas width and height (D3D12 allows 16384).
+        uint32 MaxAtlasSize;
+
+        // Gutter around each atlas entry, in texels of level 0.
+        uint32 Padding;
+
+        // D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION.
+        uint32 MaxArraySize;
+    };
+
+    struct Placement
+    {
+        uint32 Page = InvalidIndex;
+        uint32 Slice = 0;
+
+        // uv in the source maps to uv*Scale + Offset in the page.
+        DirectX::XMFLOAT2 Scale = { 1.0f, 1.0f };
+        DirectX::XMFLOAT2 Offset = { 0.0f, 0.0f };
+    };
+
+    struct Page
+    {
+        DDSFile::Description Desc;
+        bool IsAtlas = false;
+
+        // The inputs in the page: one per slice for arrays, in slice order.
+        std::vector<uint32> Inputs;
+
+        // Bytes of source texels in the page, and of the page (all levels).
+        uint64 ContentBytes = 0;
+        uint64 PageBytes = 0;
+    };
+
+    explicit TexturePacker(const Options& options = Options());
+
+    ///<summary>
+    /// Adds every array slice of a 2D texture as an input and returns the index
+    /// of the first (the others follow it).  Returns InvalidIndex for cube maps,
+    /// 1D and 3D textures, and for compressed files that were not decompressed.
+    ///</summary>
+    uint32 AddTexture(const DDSFile& file, bool allowAtlas);
+
+    ///<summary>
+    /// Groups and places all inputs.  Can be called again after adding more.
+    ///</summary>
+    void Pack();
+
+    size_t InputCount()const { return mInputs.size(); }
+    size_t PageCount()const { return mPages.size(); }
+    const Page& GetPage(uint32 page)const { return mPages[page]; }
+    const Placement& GetPlacement(uint32 input)const { return mPlacements[input]; }
+
+    ///<summary>
+    /// Builds the DDS file of a page.  Array pages point straight at the source
+    /// subresources; atlas pages are assembled level by level.
+    ///</summary>
+    bool Serialize(uint32 page, std::vector<uint8>& file)const;
+    bool Save(uint32 page, const std::wstring& filename)const;
+
+    // ContentBytes over PageBytes, over all pages.
+    float Efficiency()const;
+
+    ///<summary>
+    /// A material's MatTransform followed by the mapping into the page, for the
+    /// row vector convention the shaders use (mul(float4(uv, 0, 1), M)).
+    ///</summary>
+    static DirectX::XMFLOAT4X4 RemapTransform(const DirectX::XMFLOAT4X4& matTransform, const Placement& placement);
+
+private:
+    struct Input
+    {
+        const DDSFile* File = nullptr;
+        uint32 Slice = 0;
+        bool AllowAtlas = false;
+    };
+
+    // An atlas entry, in texels of level 0.  X and Y are those of the gutter.
+    struct Rect
+    {
+        uint32 Input;
+        uint32 Width;
+        uint32 Height;
+        uint32 X;
+        uint32 Y;
+    };
+
+    struct Atlas
+    {
+        uint32 Levels = 1;
+        uint32 Pad = 0;
+        std::vector<Rect> Rects;
+    };
+
+    void AddArrayPage(const std::vector<uint32>& inputs);
+    void AddAtlasPages(const std::vector<uint32>& inputs);
+
+    bool BuildAtlas(uint32 page, std::vector<std::vector<uint8>>& levels)const;
+
+    // The subresources of a page; levels holds the texels of an atlas page.
+    bool GetSubresources(uint32 page, std::vector<const uint8*>& subresources,
+        std::vector<std::vector<uint8>>& levels)const;
+
+private:
+    Options mOptions;
+    std::vector<Input> mInputs;
+    std::vector<Placement> mPlacements;
+    std::vector<Page> mPages;
+
+    // Parallel to mPages; empty for array pages.
+    std::vector<Atlas> mAtlases;
+};
@@ -0,0 +1,229 @@
+//***************************************************************************************
+// TextureStreamer.cpp
+//***************************************************************************************
+
+#include "TextureStreamer.h"
+#include "DDSFile.h"
+#include <algorithm>
+#include <cmath>
+
+TextureStreamer::TextureStreamer(const Options& options) :
+    mOptions(options)
+{
+}
+
+TextureStreamer::uint32 TextureStreamer::AddTexture(uint32 width, uint32 height, const std::vector<uint64>& mipBytes)
+{
+    TextureState texture;
+    texture.MipBytes = mipBytes;
+
+    const uint32 mipLevels = (uint32)mipBytes.size();
+
+    texture.TailMip = mipLevels > 0 ? mipLevels - 1 : 0;
+    for(uint32 mip = 0; mip < mipLevels; ++mip)
+    {
+        if(std::max(width >> mip, 1u) <= mOptions.TailSize &&
+           std::max(height >> mip, 1u) <= mOptions.TailSize)
+        {
+            texture.TailMip = mip;
+            break;
+        }
+    }
+
+    texture.ResidentMip = texture.TailMip;
+    texture.DemandedMip = mipLevels;
+
+    for(uint32 mip = texture.TailMip; mip < mipLevels; ++mip)
+        mStats.ResidentBytes += mipBytes[mip];
+    mStats.PeakResidentBytes = std::max(mStats.PeakResidentBytes, mStats.ResidentBytes);
+
+    mTextures.push_back(texture);
+
+    return (uint32)mTextures.size() - 1;
+}
+
+TextureStreamer::uint32 TextureStreamer::AddTexture(const DDSFile& file)
+{
+    const DDSFile::Description& desc = file.GetDescription();
+
+    std::vector<uint64> mipBytes(desc.MipLevels, 0);
+    for(uint32 slice = 0; slice < desc.ArraySize; ++slice)
+    {
+        for(uint32 mip = 0; mip < desc.MipLevels; ++mip)
+        {
+            const DDSFile::Subresource& s = file.GetSubresource(mip, slice);
+            mipBytes[mip] += (uint64)s.SlicePitch*s.Depth;
+        }
+    }
+
+    return AddTexture(desc.Width, desc.Height, mipBytes);
+}
+
+void TextureStreamer::SetDemand(uint32 texture, uint32 mip)
+{
+    TextureState& t = mTextures[texture];
+
+    mip = std::min(mip, t.TailMip);
+
+    if(t.LastDemandFrame != mFrame)
+    {
+        t.LastDemandFrame = mFrame;
+        t.DemandedMip = mip;
+        mDemanded.push_back(texture);
+    }
+    else
+    {
+        t.DemandedMip = std::min(t.DemandedMip, mip);
+    }
+}
+
+bool TextureStreamer::EvictFor(uint64 bytes, uint32 requester, std::vector<Request>& evictions)
+{
+    const uint64 used = mStats.ResidentBytes + mStats.PendingBytes;
+    if(used + bytes <= mOptions.Budget)
+        return true;
+
+    uint64 needed = used + bytes - mOptions.Budget;
+
+    // Levels that can go: above the tail, not demanded this frame, and not under a
+    // load.  Least recently used textures first, and a texture's finest level
+    // before its coarser ones.
+    struct Victim
+    {
+        uint64 LastDemandFrame;
+        uint32 Texture;
+        uint32 Mip;
+        uint64 Bytes;
+    };
+
+    std::vector<Victim> victims;
+    for(uint32 i = 0; i < (uint32)mTextures.size(); ++i)
+    {
+        const TextureState& t = mTextures[i];
+        if(i == requester || t.LoadPending)
+            continue;
+
+        const uint32 keepFrom = (t.LastDemandFrame == mFrame) ? std::min(t.DemandedMip, t.TailMip) : t.TailMip;
+        for(uint32 mip = t.ResidentMip; mip < keepFrom; ++mip)
+            victims.push_back({ t.LastDemandFrame, i, mip, t.MipBytes[mip] });
+    }
+
+    std::sort(victims.begin(), victims.end(), [](const Victim& a, const Victim& b)
+    {
+        if(a.LastDemandFrame != b.LastDemandFrame)
+            return a.LastDemandFrame < b.LastDemandFrame;
+        if(a.Texture != b.Texture)
+            return a.Texture < b.Texture;
+        return a.Mip < b.Mip;
+    });
+
+    // Only evict if that makes enough room; otherwise the load waits.
+    size_t count = 0;
+    uint64 freed = 0;
+    while(count < victims.size() && freed < needed)
+        freed += victims[count++].Bytes;
+
+    if(freed < needed)
+        return false;
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        TextureState& t = mTextures[victims[i].Texture];
+        t.ResidentMip = victims[i].Mip + 1;
+        mStats.ResidentBytes -= victims[i].Bytes;
+        mStats.Evictions++;
+
+        evictions.push_back({ victims[i].Texture, victims[i].Mip });
+    }
+
+    return true;
+}
+
+void TextureStreamer::Update(std::vector<Request>& loads, std::vector<Request>& evictions)
+{
+    loads.clear();
+    evictions.clear();
+
+    // Textures furthest from their demand go first, so everything on screen gets
+    // a usable level before anything gets its finest one.
+    std::vector<uint32> wanting;
+    for(uint32 i : mDemanded)
+    {
+        const TextureState& t = mTextures[i];
+        if(t.DemandedMip < t.ResidentMip && !t.LoadPending)
+            wanting.push_back(i);
+    }
+
+    std::stable_sort(wanting.begin(), wanting.end(), [this](uint32 a, uint32 b)
+    {
+        const TextureState& ta = mTextures[a];
+        const TextureState& tb = mTextures[b];
+        return ta.ResidentMip - ta.DemandedMip > tb.ResidentMip - tb.DemandedMip;
+    });
+
+    uint64 bytesThisUpdate = 0;
+    for(uint32 i : wanting)
+    {
+        if(mLoadsInFlight >= mOptions.MaxLoadsInFlight)
+            break;
+
+        TextureState& t = mTextures[i];
+        const uint32 mip = t.ResidentMip - 1;
+        const uint64 bytes = t.MipBytes[mip];
+
+        // Always let one load through, however large.
+        if(!loads.empty() && bytesThisUpdate + bytes > mOptions.MaxLoadBytesPerUpdate)
+            break;
+
+        if(!EvictFor(bytes, i, evictions))
+            continue;
+
+        t.LoadPending = true;
+        mStats.PendingBytes += bytes;
+        mStats.LoadsIssued++;
+        mLoadsInFlight++;
+        bytesThisUpdate += bytes;
+
+        loads.push_back({ i, mip });
+    }
+
+    if(mStats.ResidentBytes + mStats.PendingBytes > mOptions.Budget)
+        mStats.BudgetViolations++;
+
+    mStats.UnmetDemand = 0;
+    for(uint32 i : mDemanded)
+    {
+        if(mTextures[i].DemandedMip < mTextures[i].ResidentMip)
+            mStats.UnmetDemand++;
+    }
+
+    mDemanded.clear();
+    mFrame++;
+}
+
+void TextureStreamer::OnLoaded(const Request& load)
+{
+    TextureState& t = mTextures[load.Texture];
+    const uint64 bytes = t.MipBytes[load.Mip];
+
+    t.LoadPending = false;
+    t.ResidentMip = load.Mip;
+
+    mStats.PendingBytes -= bytes;
+    mStats.ResidentBytes += bytes;
+    mStats.PeakResidentBytes = std::max(mStats.PeakResidentBytes, mStats.ResidentBytes);
+    mLoadsInFlight--;
+}
+
+TextureStreamer::uint32 TextureStreamer::DesiredMip(uint32 width, uint32 height, float screenWidth, float screenHeight,
+    float bias)
+{
+    if(screenWidth <= 0.0f || screenHeight <= 0.0f)
+        return 31;
+
+    // Texels per pixel along the more minified axis.
+    const float ratio = std::max(width / screenWidth, height / screenHeight);
+    const float mip = std::log2(ratio) + bias;
+
+    return mip <= 0.0f ? 0 : (uint32)std::min(mip, 31.0f);
+}
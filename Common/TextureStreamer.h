@@ -0,0 +1,149 @@
+//***************************************************************************************
+// TextureStreamer.h
+//
+// Decides which mip levels of which textures are resident under a memory budget.
+//
+// Every texture is registered with the size of each of its mip levels.  The mip
+// tail (the levels no larger than Options::TailSize) is resident from the start,
+// so a texture can be drawn as soon as it is registered.  The finer levels are
+// streamed in one at a time, finest last, when the renderer asks for them:
+// each frame the renderer calls SetDemand with the finest mip a material needs
+// (see DesiredMip), and Update returns the loads to start and the levels to
+// evict.  The resident levels of a texture are always a contiguous range
+// ResidentMip(texture)..MipLevels-1, so the renderer only needs to clamp the
+// sampler (e.g., D3D12_TEX2D_SRV::ResourceMinLODClamp) to ResidentMip.
+//
+// When a load does not fit in the budget, the least recently used textures lose
+// their finest levels first.  A texture never loses its tail, nor a level that
+// is still demanded this frame.
+//
+// The streamer owns no memory and makes no device calls.  The caller performs
+// the loads and evictions (reading the texels from a DDSFile, for example) and
+// reports finished loads with OnLoaded, so it runs headless as well.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class DDSFile;
+
+class TextureStreamer
+{
+public:
+
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    struct Options
+    {
+        Options() :
+            Budget(256ull*1024*1024),
+            TailSize(64),
+            MaxLoadBytesPerUpdate(16ull*1024*1024),
+            MaxLoadsInFlight(16)
+        {
+        }
+
+        // Bytes the resident levels (and the loads in flight) may use.
+        uint64 Budget;
+
+        // Levels no wider or taller than this are always resident.
+        uint32 TailSize;
+
+        // Limits on the loads started by one Update.
+        uint64 MaxLoadBytesPerUpdate;
+        uint32 MaxLoadsInFlight;
+    };
+
+    struct Request
+    {
+        uint32 Texture;
+        uint32 Mip;
+    };
+
+    struct Stats
+    {
+        uint64 ResidentBytes = 0;
+        uint64 PendingBytes = 0;
+        uint64 PeakResidentBytes = 0;
+
+        uint64 LoadsIssued = 0;
+        uint64 Evictions = 0;
+
+        // Updates that ended with resident + pending bytes over the budget.  Only
+        // the mip tails can cause this, since nothing else is loaded without room.
+        uint64 BudgetViolations = 0;
+
+        // Demanded levels that were not resident at the end of the last Update.
+        uint32 UnmetDemand = 0;
+    };
+
+    explicit TextureStreamer(const Options& options = Options());
+
+    ///<summary>
+    /// Registers a texture.  mipBytes[i] is the size of level i (finest first) over
+    /// all array slices.  The tail is counted as resident right away; the caller
+    /// uploads it along with the texture.
+    ///</summary>
+    uint32 AddTexture(uint32 width, uint32 height, const std::vector<uint64>& mipBytes);
+
+    // Same, with the sizes taken from a parsed DDS file.
+    uint32 AddTexture(const DDSFile& file);
+
+    ///<summary>
+    /// The texture is drawn this frame and needs the given level.  Several calls
+    /// in a frame keep the finest level.
+    ///</summary>
+    void SetDemand(uint32 texture, uint32 mip);
+
+    ///<summary>
+    /// Ends the frame: returns the loads to start and the levels the caller must
+    /// release.  Evictions take effect immediately; loads when OnLoaded is called.
+    ///</summary>
+    void Update(std::vector<Request>& loads, std::vector<Request>& evictions);
+
+    void OnLoaded(const Request& load);
+
+    uint32 ResidentMip(uint32 texture)const { return mTextures[texture].ResidentMip; }
+    uint32 TailMip(uint32 texture)const { return mTextures[texture].TailMip; }
+    uint32 MipLevels(uint32 texture)const { return (uint32)mTextures[texture].MipBytes.size(); }
+    size_t TextureCount()const { return mTextures.size(); }
+
+    const Stats& GetStats()const { return mStats; }
+    const Options& GetOptions()const { return mOptions; }
+    void SetBudget(uint64 budget) { mOptions.Budget = budget; }
+
+    ///<summary>
+    /// The finest level worth having for a texture that covers about screenWidth by
+    /// screenHeight pixels (for one repetition of the texture).  bias > 0 asks
+    /// for coarser levels.
+    ///</summary>
+    static uint32 DesiredMip(uint32 width, uint32 height, float screenWidth, float screenHeight,
+        float bias = 0.0f);
+
+private:
+    struct TextureState
+    {
+        std::vector<uint64> MipBytes;
+        uint32 TailMip = 0;
+        uint32 ResidentMip = 0;
+        uint32 DemandedMip = 0;
+        uint64 LastDemandFrame = 0;
+        bool LoadPending = false;
+    };
+
+    bool EvictFor(uint64 bytes, uint32 requester, std::vector<Request>& evictions);
+
+private:
+    Options mOptions;
+    Stats mStats;
+    std::vector<TextureState> mTextures;
+    uint64 mFrame = 1;
+    uint32 mLoadsInFlight = 0;
+
+    // Textures demanded this frame.
+    std::vector<uint32> mDemanded;
+};
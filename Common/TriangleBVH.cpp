@@ -0,0 +1,248 @@
+//***************************************************************************************
+// TriangleBVH.cpp
+//***************************************************************************************
+
+#include "TriangleBVH.h"
+#include "BinnedSAH.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = TriangleBVH::uint32;
+    using Node = TriangleBVH::Node;
+    using Range = BinnedSAH::Range;
+
+    // The cost of visiting a node, relative to testing one triangle.
+    const float NodeCost = 1.0f;
+
+    // Node boxes are grown by this fraction of the mesh size, so rounding in the
+    // box tests never skips a triangle the triangle test would hit.
+    const float BoxPadding = 1e-5f;
+}
+
+const float TriangleBVH::DistanceSlack = 1.0f + 1e-5f;
+
+float TriangleBVH::SafeInverse(float d)
+{
+    const float tiny = 1e-20f;
+    return 1.0f/(std::fabs(d) > tiny ? d : std::copysign(tiny, d));
+}
+
+void TriangleBVH::Build(const XMFLOAT3* positions, size_t positionStride, size_t vertexCount,
+    const uint32* indices, size_t indexCount)
+{
+    mNodes.clear();
+    mTriangles.clear();
+    mTriangleIndices.clear();
+
+    // Triangles with an index past the last vertex are left out of the tree.
+    for(uint32 i = 0; i < (uint32)(indexCount/3); ++i)
+    {
+        if(indices[3*i + 0] < vertexCount && indices[3*i + 1] < vertexCount && indices[3*i + 2] < vertexCount)
+            mTriangleIndices.push_back(i);
+    }
+
+    const uint32 triangleCount = (uint32)mTriangleIndices.size();
+    mTriangles.resize(triangleCount);
+
+    if(triangleCount == 0)
+        return;
+
+    auto position = [&](uint32 index)
+    {
+        return *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const char*>(positions) + index*positionStride);
+    };
+
+    // bounds and centers are indexed by the triangle's position in the index
+    // list, so entries for skipped triangles are never read.
+    std::vector<Range> bounds(indexCount/3);
+    std::vector<XMFLOAT3> centers(indexCount/3);
+    Range mesh;
+    for(uint32 i : mTriangleIndices)
+    {
+        bounds[i].Grow(position(indices[3*i + 0]));
+        bounds[i].Grow(position(indices[3*i + 1]));
+        bounds[i].Grow(position(indices[3*i + 2]));
+        mesh.Grow(bounds[i]);
+
+        centers[i] = XMFLOAT3(0.5f*(bounds[i].Min.x + bounds[i].Max.x),
+                              0.5f*(bounds[i].Min.y + bounds[i].Max.y),
+                              0.5f*(bounds[i].Min.z + bounds[i].Max.z));
+    }
+
+    const float extent = std::max(std::max(mesh.Max.x - mesh.Min.x, mesh.Max.y - mesh.Min.y), mesh.Max.z - mesh.Min.z);
+
+    mNodes.reserve(2*(size_t)triangleCount);
+
+    Node root;
+    root.First = 0;
+    root.Count = triangleCount;
+    root.Children = 0;
+    mNodes.push_back(root);
+
+    // Nodes to split, with their depths.
+    std::vector<std::pair<uint32, uint32>> toSplit(1, std::make_pair(0u, 0u));
+    while(!toSplit.empty())
+    {
+        const uint32 nodeIndex = toSplit.back().first;
+        const uint32 depth = toSplit.back().second;
+        toSplit.pop_back();
+
+        const uint32 first = mNodes[nodeIndex].First;
+        const uint32 nodeCount = mNodes[nodeIndex].Count;
+        if(nodeCount <= 1 || depth + 1 >= MaxDepth)
+            continue;
+
+        const BinnedSAH::Split split = BinnedSAH::SplitItems(mTriangleIndices.data() + first, nodeCount,
+            bounds.data(), centers.data(), extent);
+
+        // Small nodes stay leaves when testing all their triangles costs less
+        // than visiting the children, and always when their centers are all at
+        // one point.
+        if(nodeCount <= MaxLeafSize && nodeCount*split.HalfArea <= NodeCost*split.HalfArea + split.Cost)
+            continue;
+
+        const uint32 leftCount = split.LeftCount;
+
+        const uint32 children = (uint32)mNodes.size();
+        mNodes[nodeIndex].Children = children;
+
+        Node child;
+        child.Children = 0;
+
+        child.First = first;
+        child.Count = leftCount;
+        mNodes.push_back(child);
+
+        child.First = first + leftCount;
+        child.Count = nodeCount - leftCount;
+        mNodes.push_back(child);
+
+        toSplit.push_back(std::make_pair(children + 1, depth + 1));
+        toSplit.push_back(std::make_pair(children, depth + 1));
+    }
+
+    for(uint32 i = 0; i < triangleCount; ++i)
+    {
+        const uint32 t = mTriangleIndices[i];
+        mTriangles[i].V0 = position(indices[3*t + 0]);
+        mTriangles[i].V1 = position(indices[3*t + 1]);
+        mTriangles[i].V2 = position(indices[3*t + 2]);
+    }
+
+    // Children come after their parents, so going backwards visits every node
+    // after its children.
+    const float padding = BoxPadding*extent;
+    for(size_t i = mNodes.size(); i-- > 0; )
+    {
+        Node& node = mNodes[i];
+
+        Range range;
+        if(node.Children == 0)
+        {
+            for(uint32 t = node.First; t < node.First + node.Count; ++t)
+                range.Grow(bounds[mTriangleIndices[t]]);
+
+            range.Min = XMFLOAT3(range.Min.x - padding, range.Min.y - padding, range.Min.z - padding);
+            range.Max = XMFLOAT3(range.Max.x + padding, range.Max.y + padding, range.Max.z + padding);
+        }
+        else
+        {
+            range.Grow(mNodes[node.Children].Min, mNodes[node.Children].Max);
+            range.Grow(mNodes[node.Children + 1].Min, mNodes[node.Children + 1].Max);
+        }
+
+        node.Min = range.Min;
+        node.Max = range.Max;
+    }
+}
+
+bool TriangleBVH::Intersects(FXMVECTOR origin, FXMVECTOR direction, uint32& triangle, float& dist)const
+{
+    if(mNodes.empty())
+        return false;
+
+    XMFLOAT3 o;
+    XMFLOAT3 d;
+    XMStoreFloat3(&o, origin);
+    XMStoreFloat3(&d, direction);
+    const BoxRay<float> ray = { o.x, o.y, o.z, SafeInverse(d.x), SafeInverse(d.y), SafeInverse(d.z) };
+
+    float nearest = FLT_MAX;
+    uint32 nearestTriangle = UINT32_MAX;
+
+    float entry;
+    if(HitBox<ScalarOps>(mNodes[0], ray, nearest, entry) == 0.0f)
+        return false;
+
+    uint32 stack[MaxDepth];
+    uint32 stackSize = 0;
+
+    uint32 nodeIndex = 0;
+    for(;;)
+    {
+        const Node& node = mNodes[nodeIndex];
+        if(node.Children == 0)
+        {
+            for(uint32 i = node.First; i < node.First + node.Count; ++i)
+            {
+                const Triangle& tri = mTriangles[i];
+
+                float t = 0.0f;
+                if(TriangleTests::Intersects(origin, direction, XMLoadFloat3(&tri.V0), XMLoadFloat3(&tri.V1), XMLoadFloat3(&tri.V2), t))
+                {
+                    // Ties go to the lower index, as in a loop over the indices.
+                    const uint32 index = mTriangleIndices[i];
+                    if(t < nearest || (t == nearest && index < nearestTriangle))
+                    {
+                        nearest = t;
+                        nearestTriangle = index;
+                    }
+                }
+            }
+        }
+        else
+        {
+            // Visit the nearer child first; the farther one waits on the stack.
+            float entry0;
+            float entry1;
+            const bool hit0 = HitBox<ScalarOps>(mNodes[node.Children], ray, nearest, entry0) != 0.0f;
+            const bool hit1 = HitBox<ScalarOps>(mNodes[node.Children + 1], ray, nearest, entry1) != 0.0f;
+
+            if(hit0 && hit1)
+            {
+                const bool firstNearer = entry0 <= entry1;
+                stack[stackSize++] = firstNearer ? node.Children + 1 : node.Children;
+                nodeIndex = firstNearer ? node.Children : node.Children + 1;
+                continue;
+            }
+            if(hit0 || hit1)
+            {
+                nodeIndex = hit0 ? node.Children : node.Children + 1;
+                continue;
+            }
+        }
+
+        // Take the next waiting node that still starts before the nearest hit.
+        bool found = false;
+        while(stackSize > 0 && !found)
+        {
+            nodeIndex = stack[--stackSize];
+            found = HitBox<ScalarOps>(mNodes[nodeIndex], ray, nearest, entry) != 0.0f;
+        }
+
+        if(!found)
+            break;
+    }
+
+    if(nearestTriangle == UINT32_MAX)
+        return false;
+
+    triangle = nearestTriangle;
+    dist = nearest;
+    return true;
+}
@@ -0,0 +1,154 @@
+//***************************************************************************************
+// TriangleBVH.h
+//
+// A bounding volume hierarchy over the triangles of a mesh, for ray queries such
+// as picking against geometry kept on the CPU (MeshGeometry::VertexBufferCPU and
+// IndexBufferCPU).
+//
+// The tree is built once, in model space, with binned surface area heuristic
+// splits (see BinnedSAH); the triangles are copied into leaf order so a leaf's
+// vertices are next to each other in memory.  The nearest hit visits the nearer
+// child first and skips every node that starts beyond the nearest hit found so
+// far.
+//
+// Each triangle is tested with TriangleTests::Intersects on the same vertex
+// values as a loop over the index buffer would use, and equal distances go to
+// the lower triangle index, so the result is the triangle a linear scan finds.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class TriangleBVH
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+    // Nodes with this many triangles or fewer may become leaves.
+    static const uint32 MaxLeafSize = 4;
+
+    // Deeper nodes become leaves however many triangles they have, so a
+    // traversal stack of this many entries is always enough.
+    static const uint32 MaxDepth = 64;
+
+    struct Node
+    {
+        DirectX::XMFLOAT3 Min;
+        DirectX::XMFLOAT3 Max;
+
+        // The triangles of the subtree are First..First + Count - 1 in leaf
+        // order.
+        uint32 First;
+        uint32 Count;
+
+        // The two children are Children and Children + 1; 0 for leaves.
+        uint32 Children;
+    };
+
+    struct Triangle
+    {
+        DirectX::XMFLOAT3 V0;
+        DirectX::XMFLOAT3 V1;
+        DirectX::XMFLOAT3 V2;
+    };
+
+    // Nodes are visited up to this fraction past the nearest hit, so rounding in
+    // the box tests never skips a triangle the triangle test would hit (the boxes
+    // are padded as well).
+    static const float DistanceSlack;
+
+    // Directions along an axis get a huge finite inverse instead of an infinite
+    // one, so the box tests never compute 0*infinity.
+    static float SafeInverse(float d);
+
+    // A ray as the box test takes it, or a packet of rays when F is a SIMD
+    // register.
+    template<typename F>
+    struct BoxRay
+    {
+        F OriginX, OriginY, OriginZ;
+        F InvDirX, InvDirY, InvDirZ;
+    };
+
+    // The arithmetic HitBox needs, for a single ray: masks are 1 or 0.
+    struct ScalarOps
+    {
+        static float Set(float x) { return x; }
+        static float Sub(float a, float b) { return a - b; }
+        static float Mul(float a, float b) { return a*b; }
+        static float Min(float a, float b) { return std::min(a, b); }
+        static float Max(float a, float b) { return std::max(a, b); }
+        static float LessEqual(float a, float b) { return a <= b ? 1.0f : 0.0f; }
+        static float And(float a, float b) { return a != 0.0f && b != 0.0f ? 1.0f : 0.0f; }
+    };
+
+    ///<summary>
+    /// The slab test every traversal of the tree uses: the mask of the rays that
+    /// enter the node's box no later than DistanceSlack times cutOff, and where
+    /// they enter it.  Ops provides the arithmetic on F, as ScalarOps does for
+    /// float.
+    ///</summary>
+    template<typename Ops, typename F>
+    static F HitBox(const Node& node, const BoxRay<F>& ray, F cutOff, F& entry)
+    {
+        F t0 = Ops::Mul(Ops::Sub(Ops::Set(node.Min.x), ray.OriginX), ray.InvDirX);
+        F t1 = Ops::Mul(Ops::Sub(Ops::Set(node.Max.x), ray.OriginX), ray.InvDirX);
+        F tNear = Ops::Min(t0, t1);
+        F tFar = Ops::Max(t0, t1);
+
+        t0 = Ops::Mul(Ops::Sub(Ops::Set(node.Min.y), ray.OriginY), ray.InvDirY);
+        t1 = Ops::Mul(Ops::Sub(Ops::Set(node.Max.y), ray.OriginY), ray.InvDirY);
+        tNear = Ops::Max(tNear, Ops::Min(t0, t1));
+        tFar = Ops::Min(tFar, Ops::Max(t0, t1));
+
+        t0 = Ops::Mul(Ops::Sub(Ops::Set(node.Min.z), ray.OriginZ), ray.InvDirZ);
+        t1 = Ops::Mul(Ops::Sub(Ops::Set(node.Max.z), ray.OriginZ), ray.InvDirZ);
+        tNear = Ops::Max(tNear, Ops::Min(t0, t1));
+        tFar = Ops::Min(tFar, Ops::Max(t0, t1));
+
+        entry = Ops::Max(tNear, Ops::Set(0.0f));
+
+        F hit = Ops::LessEqual(tNear, tFar);
+        hit = Ops::And(hit, Ops::LessEqual(Ops::Set(0.0f), tFar));
+        return Ops::And(hit, Ops::LessEqual(entry, Ops::Mul(cutOff, Ops::Set(DistanceSlack))));
+    }
+
+    ///<summary>
+    /// Builds the tree over the triangle list indices[0..indexCount).
+    /// positionStride is the distance in bytes between positions, so a vertex
+    /// buffer can be passed as is, e.g., (&vertices[0].Pos, sizeof(Vertex)).
+    /// Triangles with an index at or past vertexCount are skipped, so
+    /// TriangleCount() can be less than indexCount/3.
+    ///</summary>
+    void Build(const DirectX::XMFLOAT3* positions, size_t positionStride, size_t vertexCount,
+        const uint32* indices, size_t indexCount);
+
+    uint32 TriangleCount()const { return (uint32)mTriangles.size(); }
+
+    ///<summary>
+    /// Finds the nearest triangle hit by the ray, in the space the positions are
+    /// in, with direction unit length as for TriangleTests::Intersects.  Returns
+    /// false if no triangle is hit; otherwise triangle is the index of the
+    /// triangle in the index list (indices[3*triangle]) and dist its distance.
+    ///</summary>
+    bool Intersects(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, uint32& triangle, float& dist)const;
+
+    // The tree, for other ray queries.  Node 0 is the root.
+    const std::vector<Node>& GetNodes()const { return mNodes; }
+    const std::vector<Triangle>& GetTriangles()const { return mTriangles; }
+
+    // The index in the index list of the triangle at a leaf position.
+    uint32 GetTriangleIndex(uint32 leafTriangle)const { return mTriangleIndices[leafTriangle]; }
+
+private:
+    std::vector<Node> mNodes;
+
+    // Triangles in leaf order, and their indices in the index list.
+    std::vector<Triangle> mTriangles;
+    std::vector<uint32> mTriangleIndices;
+};
@@ -0,0 +1,586 @@
+//***************************************************************************************
+// VertexCompressor.cpp
+//***************************************************************************************
+
+#include "VertexCompressor.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+    template<typename T>
+    const T& Element(const T* base, size_t stride, size_t i)
+    {
+        return *reinterpret_cast<const T*>(reinterpret_cast<const std::uint8_t*>(base) + i*stride);
+    }
+
+    XMFLOAT3 LoadTangent(const float* base, size_t stride, size_t i)
+    {
+        const float* t = &Element(base, stride, i);
+        return XMFLOAT3(t[0], t[1], t[2]);
+    }
+
+    VertexCompressor::uint32 AlignUp(VertexCompressor::uint32 value, VertexCompressor::uint32 alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    VertexCompressor::uint32 DirectionSize(VertexCompressor::DirectionEncoding encoding)
+    {
+        switch(encoding)
+        {
+        case VertexCompressor::DirectionEncoding::Float3: return 12;
+        case VertexCompressor::DirectionEncoding::Oct16:  return 2;
+        case VertexCompressor::DirectionEncoding::Oct32:  return 4;
+        default:                                          return 0;
+        }
+    }
+
+    DXGI_FORMAT DirectionFormat(VertexCompressor::DirectionEncoding encoding)
+    {
+        switch(encoding)
+        {
+        case VertexCompressor::DirectionEncoding::Float3: return DXGI_FORMAT_R32G32B32_FLOAT;
+        case VertexCompressor::DirectionEncoding::Oct16:  return DXGI_FORMAT_R8G8_SNORM;
+        case VertexCompressor::DirectionEncoding::Oct32:  return DXGI_FORMAT_R16G16_SNORM;
+        default:                                          return DXGI_FORMAT_UNKNOWN;
+        }
+    }
+
+    float ClampUnit(float x)
+    {
+        return std::min(std::max(x, -1.0f), 1.0f);
+    }
+
+    float SnormToFloat(int value, int maxValue)
+    {
+        // Both -maxValue-1 and -maxValue map to -1, as on the GPU.
+        return std::max((float)value / maxValue, -1.0f);
+    }
+
+    int QuantizeUnorm(float x, int maxValue)
+    {
+        x = std::min(std::max(x, 0.0f), 1.0f);
+        return (int)(x*maxValue + 0.5f);
+    }
+
+    // Octahedral encoding with bits per component.  Rounding each component to the
+    // nearest value is not always the best choice once the result is unfolded back
+    // onto the sphere, so try the four neighbours and keep the closest.
+    void EncodeOctahedral(const XMFLOAT3& n, int maxValue, int& outX, int& outY)
+    {
+        XMFLOAT2 e = VertexCompressor::OctEncode(n);
+
+        float length = sqrtf(n.x*n.x + n.y*n.y + n.z*n.z);
+        XMFLOAT3 unit = length > 0.0f ? XMFLOAT3(n.x/length, n.y/length, n.z/length) : XMFLOAT3(0.0f, 0.0f, 1.0f);
+
+        int baseX = (int)floorf(e.x*maxValue);
+        int baseY = (int)floorf(e.y*maxValue);
+
+        float bestDot = -FLT_MAX;
+        outX = 0;
+        outY = 0;
+
+        for(int dy = 0; dy <= 1; ++dy)
+        {
+            for(int dx = 0; dx <= 1; ++dx)
+            {
+                int qx = std::min(std::max(baseX + dx, -maxValue), maxValue);
+                int qy = std::min(std::max(baseY + dy, -maxValue), maxValue);
+
+                XMFLOAT3 d = VertexCompressor::OctDecode(
+                    XMFLOAT2(SnormToFloat(qx, maxValue), SnormToFloat(qy, maxValue)));
+
+                float dot = d.x*unit.x + d.y*unit.y + d.z*unit.z;
+                if(dot > bestDot)
+                {
+                    bestDot = dot;
+                    outX = qx;
+                    outY = qy;
+                }
+            }
+        }
+    }
+
+    void WriteDirection(std::uint8_t* dst, const XMFLOAT3& n, VertexCompressor::DirectionEncoding encoding)
+    {
+        int x, y;
+        switch(encoding)
+        {
+        case VertexCompressor::DirectionEncoding::Float3:
+            std::memcpy(dst, &n, sizeof(XMFLOAT3));
+            break;
+        case VertexCompressor::DirectionEncoding::Oct16:
+        {
+            EncodeOctahedral(n, 127, x, y);
+            std::int8_t packed[2] = { (std::int8_t)x, (std::int8_t)y };
+            std::memcpy(dst, packed, sizeof(packed));
+            break;
+        }
+        case VertexCompressor::DirectionEncoding::Oct32:
+        {
+            EncodeOctahedral(n, 32767, x, y);
+            std::int16_t packed[2] = { (std::int16_t)x, (std::int16_t)y };
+            std::memcpy(dst, packed, sizeof(packed));
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // Does what the input assembler does when it converts an element to floats.
+    XMFLOAT4 LoadElement(const std::uint8_t* src, DXGI_FORMAT format)
+    {
+        XMFLOAT4 v(0.0f, 0.0f, 0.0f, 1.0f);
+
+        switch(format)
+        {
+        case DXGI_FORMAT_R32G32B32_FLOAT:
+            std::memcpy(&v, src, 3*sizeof(float));
+            break;
+        case DXGI_FORMAT_R32G32_FLOAT:
+            std::memcpy(&v, src, 2*sizeof(float));
+            break;
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+        {
+            std::uint16_t q[4];
+            std::memcpy(q, src, sizeof(q));
+            v = XMFLOAT4(q[0]/65535.0f, q[1]/65535.0f, q[2]/65535.0f, q[3]/65535.0f);
+            break;
+        }
+        case DXGI_FORMAT_R16G16_UNORM:
+        {
+            std::uint16_t q[2];
+            std::memcpy(q, src, sizeof(q));
+            v.x = q[0]/65535.0f;
+            v.y = q[1]/65535.0f;
+            break;
+        }
+        case DXGI_FORMAT_R16G16_FLOAT:
+        {
+            HALF h[2];
+            std::memcpy(h, src, sizeof(h));
+            v.x = XMConvertHalfToFloat(h[0]);
+            v.y = XMConvertHalfToFloat(h[1]);
+            break;
+        }
+        case DXGI_FORMAT_R16G16_SNORM:
+        {
+            std::int16_t q[2];
+            std::memcpy(q, src, sizeof(q));
+            v.x = SnormToFloat(q[0], 32767);
+            v.y = SnormToFloat(q[1], 32767);
+            break;
+        }
+        case DXGI_FORMAT_R8G8_SNORM:
+        {
+            std::int8_t q[2];
+            std::memcpy(q, src, sizeof(q));
+            v.x = SnormToFloat(q[0], 127);
+            v.y = SnormToFloat(q[1], 127);
+            break;
+        }
+        default:
+            break;
+        }
+
+        return v;
+    }
+
+    XMFLOAT4 DecodeAttribute(const std::uint8_t* vertex, const VertexCompressor::AttributeDesc& desc)
+    {
+        XMFLOAT4 v = LoadElement(vertex + desc.AlignedByteOffset, desc.Format);
+
+        v.x = v.x*desc.Scale.x + desc.Bias.x;
+        v.y = v.y*desc.Scale.y + desc.Bias.y;
+        v.z = v.z*desc.Scale.z + desc.Bias.z;
+        v.w = v.w*desc.Scale.w + desc.Bias.w;
+
+        if(desc.Octahedral)
+        {
+            XMFLOAT3 n = VertexCompressor::OctDecode(XMFLOAT2(v.x, v.y));
+            v = XMFLOAT4(n.x, n.y, n.z, 0.0f);
+        }
+
+        return v;
+    }
+
+    float AngleDegrees(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        float la = sqrtf(a.x*a.x + a.y*a.y + a.z*a.z);
+        float lb = sqrtf(b.x*b.x + b.y*b.y + b.z*b.z);
+        if(la == 0.0f || lb == 0.0f)
+            return 0.0f;
+
+        float c = ClampUnit((a.x*b.x + a.y*b.y + a.z*b.z) / (la*lb));
+        return XMConvertToDegrees(acosf(c));
+    }
+}
+
+const VertexCompressor::AttributeDesc* VertexCompressor::PackedVertices::Find(const char* semanticName,
+    uint32 semanticIndex)const
+{
+    for(const AttributeDesc& desc : Attributes)
+    {
+        if(desc.SemanticIndex == semanticIndex && std::strcmp(desc.SemanticName, semanticName) == 0)
+            return &desc;
+    }
+
+    return nullptr;
+}
+
+XMFLOAT2 VertexCompressor::OctEncode(const XMFLOAT3& n)
+{
+    float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    if(l1 == 0.0f)
+        return XMFLOAT2(0.0f, 0.0f);
+
+    // Project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over
+    // the diagonals.
+    float x = n.x / l1;
+    float y = n.y / l1;
+
+    if(n.z < 0.0f)
+    {
+        float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+
+    return XMFLOAT2(x, y);
+}
+
+XMFLOAT3 VertexCompressor::OctDecode(const XMFLOAT2& e)
+{
+    XMFLOAT3 n(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+
+    float length = sqrtf(n.x*n.x + n.y*n.y + n.z*n.z);
+    return XMFLOAT3(n.x/length, n.y/length, n.z/length);
+}
+
+VertexCompressor::SourceAttributes VertexCompressor::Attributes(const GeometryGenerator::MeshData& meshData)
+{
+    return Attributes(meshData.Vertices,
+        &GeometryGenerator::Vertex::Position,
+        &GeometryGenerator::Vertex::Normal,
+        &GeometryGenerator::Vertex::TexC,
+        &GeometryGenerator::Vertex::TangentU);
+}
+
+VertexCompressor::PackedVertices VertexCompressor::Compress(const GeometryGenerator::MeshData& meshData,
+    const Encoding& encoding, Report* report)
+{
+    return Compress(Attributes(meshData), encoding, report);
+}
+
+VertexCompressor::PackedVertices VertexCompressor::Compress(const SourceAttributes& attributes,
+    const Encoding& encoding, Report* report)
+{
+    const size_t vertexCount = attributes.Positions != nullptr ? attributes.VertexCount : 0;
+
+    const DirectionEncoding normalEncoding = attributes.Normals != nullptr ? encoding.Normal : DirectionEncoding::None;
+    const DirectionEncoding tangentEncoding = attributes.Tangents != nullptr ? encoding.Tangent : DirectionEncoding::None;
+    const TexCEncoding texCEncoding = attributes.TexCs != nullptr ? encoding.TexC : TexCEncoding::None;
+
+    //
+    // Bounds for the quantized encodings.
+    //
+
+    XMFLOAT3 posMin(0.0f, 0.0f, 0.0f), posMax(0.0f, 0.0f, 0.0f);
+    XMFLOAT2 uvMin(0.0f, 0.0f), uvMax(0.0f, 0.0f);
+
+    for(size_t i = 0; i < vertexCount; ++i)
+    {
+        const XMFLOAT3& p = Element(attributes.Positions, attributes.PositionStride, i);
+        if(i == 0)
+        {
+            posMin = posMax = p;
+        }
+        else
+        {
+            posMin = XMFLOAT3(std::min(posMin.x, p.x), std::min(posMin.y, p.y), std::min(posMin.z, p.z));
+            posMax = XMFLOAT3(std::max(posMax.x, p.x), std::max(posMax.y, p.y), std::max(posMax.z, p.z));
+        }
+
+        if(texCEncoding == TexCEncoding::Unorm16)
+        {
+            const XMFLOAT2& uv = Element(attributes.TexCs, attributes.TexCStride, i);
+            if(i == 0)
+            {
+                uvMin = uvMax = uv;
+            }
+            else
+            {
+                uvMin = XMFLOAT2(std::min(uvMin.x, uv.x), std::min(uvMin.y, uv.y));
+                uvMax = XMFLOAT2(std::max(uvMax.x, uv.x), std::max(uvMax.y, uv.y));
+            }
+        }
+    }
+
+    //
+    // Layout.  4 byte aligned attributes come first; the 2 byte octahedral ones go
+    // last so that a normal and a tangent share one 4 byte slot.
+    //
+
+    PackedVertices packed;
+    packed.VertexCount = vertexCount;
+
+    uint32 offset = 0;
+
+    AttributeDesc position;
+    position.SemanticName = "POSITION";
+    position.AlignedByteOffset = offset;
+    if(encoding.Position == PositionEncoding::Unorm16)
+    {
+        position.Format = DXGI_FORMAT_R16G16B16A16_UNORM;
+        position.Scale = XMFLOAT4(posMax.x - posMin.x, posMax.y - posMin.y, posMax.z - posMin.z, 1.0f);
+        position.Bias = XMFLOAT4(posMin.x, posMin.y, posMin.z, 0.0f);
+        offset += 8;
+    }
+    else
+    {
+        position.Format = DXGI_FORMAT_R32G32B32_FLOAT;
+        offset += 12;
+    }
+    packed.Attributes.push_back(position);
+
+    if(texCEncoding != TexCEncoding::None)
+    {
+        AttributeDesc texC;
+        texC.SemanticName = "TEXCOORD";
+        texC.AlignedByteOffset = offset;
+        switch(texCEncoding)
+        {
+        case TexCEncoding::Float2:
+            texC.Format = DXGI_FORMAT_R32G32_FLOAT;
+            offset += 8;
+            break;
+        case TexCEncoding::Half2:
+            texC.Format = DXGI_FORMAT_R16G16_FLOAT;
+            offset += 4;
+            break;
+        default:
+            texC.Format = DXGI_FORMAT_R16G16_UNORM;
+            texC.Scale = XMFLOAT4(uvMax.x - uvMin.x, uvMax.y - uvMin.y, 1.0f, 1.0f);
+            texC.Bias = XMFLOAT4(uvMin.x, uvMin.y, 0.0f, 0.0f);
+            offset += 4;
+            break;
+        }
+        packed.Attributes.push_back(texC);
+    }
+
+    std::vector<uint32> rawOffsets;
+    for(const RawAttribute& raw : attributes.Raw)
+    {
+        AttributeDesc desc;
+        desc.SemanticName = raw.SemanticName;
+        desc.SemanticIndex = raw.SemanticIndex;
+        desc.Format = raw.Format;
+        desc.AlignedByteOffset = offset;
+        packed.Attributes.push_back(desc);
+
+        rawOffsets.push_back(offset);
+        offset += AlignUp(raw.ByteSize, 4);
+    }
+
+    // A lone 12 byte float3 normal/tangent also keeps 4 byte alignment.
+    const DirectionEncoding directionEncodings[2] = { normalEncoding, tangentEncoding };
+    const char* directionSemantics[2] = { "NORMAL", "TANGENT" };
+    uint32 directionOffsets[2] = { 0, 0 };
+
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        for(int k = 0; k < 2; ++k)
+        {
+            // Wide encodings in the first pass, 2 byte ones in the second.
+            bool small = directionEncodings[k] == DirectionEncoding::Oct16;
+            if(directionEncodings[k] == DirectionEncoding::None || small != (pass == 1))
+                continue;
+
+            AttributeDesc desc;
+            desc.SemanticName = directionSemantics[k];
+            desc.Format = DirectionFormat(directionEncodings[k]);
+            desc.AlignedByteOffset = offset;
+            desc.Octahedral = directionEncodings[k] != DirectionEncoding::Float3;
+            packed.Attributes.push_back(desc);
+
+            directionOffsets[k] = offset;
+            offset += DirectionSize(directionEncodings[k]);
+        }
+    }
+
+    packed.Stride = AlignUp(offset, 4);
+    packed.Data.assign(vertexCount*packed.Stride, 0);
+
+    //
+    // Pack.
+    //
+
+    for(size_t i = 0; i < vertexCount; ++i)
+    {
+        uint8* dst = &packed.Data[i*packed.Stride];
+
+        const XMFLOAT3& p = Element(attributes.Positions, attributes.PositionStride, i);
+        if(encoding.Position == PositionEncoding::Unorm16)
+        {
+            const XMFLOAT4& s = position.Scale;
+            uint16 q[4] =
+            {
+                (uint16)QuantizeUnorm(s.x > 0.0f ? (p.x - posMin.x) / s.x : 0.0f, 65535),
+                (uint16)QuantizeUnorm(s.y > 0.0f ? (p.y - posMin.y) / s.y : 0.0f, 65535),
+                (uint16)QuantizeUnorm(s.z > 0.0f ? (p.z - posMin.z) / s.z : 0.0f, 65535),
+                65535
+            };
+            std::memcpy(dst + position.AlignedByteOffset, q, sizeof(q));
+        }
+        else
+        {
+            std::memcpy(dst + position.AlignedByteOffset, &p, sizeof(XMFLOAT3));
+        }
+
+        if(texCEncoding != TexCEncoding::None)
+        {
+            const XMFLOAT2& uv = Element(attributes.TexCs, attributes.TexCStride, i);
+            uint8* t = dst + packed.Attributes[1].AlignedByteOffset;
+
+            if(texCEncoding == TexCEncoding::Float2)
+            {
+                std::memcpy(t, &uv, sizeof(XMFLOAT2));
+            }
+            else if(texCEncoding == TexCEncoding::Half2)
+            {
+                HALF h[2] = { XMConvertFloatToHalf(uv.x), XMConvertFloatToHalf(uv.y) };
+                std::memcpy(t, h, sizeof(h));
+            }
+            else
+            {
+                float su = uvMax.x - uvMin.x;
+                float sv = uvMax.y - uvMin.y;
+                uint16 q[2] =
+                {
+                    (uint16)QuantizeUnorm(su > 0.0f ? (uv.x - uvMin.x) / su : 0.0f, 65535),
+                    (uint16)QuantizeUnorm(sv > 0.0f ? (uv.y - uvMin.y) / sv : 0.0f, 65535)
+                };
+                std::memcpy(t, q, sizeof(q));
+            }
+        }
+
+        for(size_t r = 0; r < attributes.Raw.size(); ++r)
+        {
+            const RawAttribute& raw = attributes.Raw[r];
+            const uint8* src = reinterpret_cast<const uint8*>(raw.Data) + i*raw.Stride;
+            std::memcpy(dst + rawOffsets[r], src, raw.ByteSize);
+        }
+
+        if(normalEncoding != DirectionEncoding::None)
+        {
+            WriteDirection(dst + directionOffsets[0],
+                Element(attributes.Normals, attributes.NormalStride, i), normalEncoding);
+        }
+
+        if(tangentEncoding != DirectionEncoding::None)
+        {
+            WriteDirection(dst + directionOffsets[1],
+                LoadTangent(attributes.Tangents, attributes.TangentStride, i), tangentEncoding);
+        }
+    }
+
+    //
+    // Measure.
+    //
+
+    if(report != nullptr)
+    {
+        *report = Report();
+
+        size_t sourceStride = attributes.SourceStride;
+        if(sourceStride == 0)
+        {
+            sourceStride = sizeof(XMFLOAT3);
+            if(attributes.Normals != nullptr)  sourceStride += sizeof(XMFLOAT3);
+            if(attributes.Tangents != nullptr) sourceStride += sizeof(XMFLOAT3);
+            if(attributes.TexCs != nullptr)    sourceStride += sizeof(XMFLOAT2);
+            for(const RawAttribute& raw : attributes.Raw)
+                sourceStride += raw.ByteSize;
+        }
+
+        report->SourceBytes = sourceStride*vertexCount;
+        report->PackedBytes = packed.Data.size();
+
+        for(size_t i = 0; i < vertexCount; ++i)
+        {
+            DecodedVertex v = Decode(packed, i);
+
+            const XMFLOAT3& p = Element(attributes.Positions, attributes.PositionStride, i);
+            float dx = v.Position.x - p.x;
+            float dy = v.Position.y - p.y;
+            float dz = v.Position.z - p.z;
+            report->MaxPositionError = std::max(report->MaxPositionError, sqrtf(dx*dx + dy*dy + dz*dz));
+
+            if(normalEncoding != DirectionEncoding::None)
+            {
+                report->MaxNormalError = std::max(report->MaxNormalError,
+                    AngleDegrees(v.Normal, Element(attributes.Normals, attributes.NormalStride, i)));
+            }
+
+            if(tangentEncoding != DirectionEncoding::None)
+            {
+                report->MaxTangentError = std::max(report->MaxTangentError,
+                    AngleDegrees(v.TangentU, LoadTangent(attributes.Tangents, attributes.TangentStride, i)));
+            }
+
+            if(texCEncoding != TexCEncoding::None)
+            {
+                const XMFLOAT2& uv = Element(attributes.TexCs, attributes.TexCStride, i);
+                report->MaxTexCError = std::max(report->MaxTexCError,
+                    std::max(fabsf(v.TexC.x - uv.x), fabsf(v.TexC.y - uv.y)));
+            }
+        }
+    }
+
+    return packed;
+}
+
+VertexCompressor::DecodedVertex VertexCompressor::Decode(const PackedVertices& packed, size_t index)
+{
+    DecodedVertex v;
+    const uint8* vertex = &packed.Data[index*packed.Stride];
+
+    if(const AttributeDesc* desc = packed.Find("POSITION"))
+    {
+        XMFLOAT4 p = DecodeAttribute(vertex, *desc);
+        v.Position = XMFLOAT3(p.x, p.y, p.z);
+    }
+
+    if(const AttributeDesc* desc = packed.Find("NORMAL"))
+    {
+        XMFLOAT4 n = DecodeAttribute(vertex, *desc);
+        v.Normal = XMFLOAT3(n.x, n.y, n.z);
+    }
+
+    if(const AttributeDesc* desc = packed.Find("TANGENT"))
+    {
+        XMFLOAT4 t = DecodeAttribute(vertex, *desc);
+        v.TangentU = XMFLOAT3(t.x, t.y, t.z);
+    }
+
+    if(const AttributeDesc* desc = packed.Find("TEXCOORD"))
+    {
+        XMFLOAT4 uv = DecodeAttribute(vertex, *desc);
+        v.TexC = XMFLOAT2(uv.x, uv.y);
+    }
+
+    return v;
+}
@@ -0,0 +1,242 @@
+//***************************************************************************************
+// VertexCompressor.h
+//
+// Packs vertex attributes into compact, GPU readable formats.
+//
+//   -Normals and tangents are stored as octahedral encoded unit vectors in two
+//    snorm8 (2 bytes) or two snorm16 (4 bytes) components.
+//   -Texture coordinates are stored as halfs or as unorm16 values quantized
+//    against the mesh's UV bounds.
+//   -Positions are optionally stored as unorm16 values quantized against the
+//    mesh's bounding box.
+//
+// The default encoding packs a GeometryGenerator::Vertex (44 bytes) into 16 bytes.
+//
+// Every packed attribute comes with an AttributeDesc that gives the DXGI format to
+// put in the input layout and the scale/bias the vertex shader applies to get the
+// original value back:
+//
+//   value = input*Scale + Bias;
+//   if(Octahedral) value.xyz = OctDecode(value.xy);
+//
+// Tangents are stored without a handedness sign, as in the rest of the samples.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <dxgiformat.h>
+#include <cstdint>
+#include <vector>
+
+class VertexCompressor
+{
+public:
+
+    using uint8 = std::uint8_t;
+    using uint16 = std::uint16_t;
+    using uint32 = std::uint32_t;
+
+    enum class PositionEncoding
+    {
+        Float3,     // R32G32B32_FLOAT, 12 bytes
+        Unorm16     // R16G16B16A16_UNORM against the bounding box, 8 bytes
+    };
+
+    enum class DirectionEncoding
+    {
+        None,       // attribute is dropped
+        Float3,     // R32G32B32_FLOAT, 12 bytes
+        Oct16,      // R8G8_SNORM octahedral, 2 bytes
+        Oct32       // R16G16_SNORM octahedral, 4 bytes
+    };
+
+    enum class TexCEncoding
+    {
+        None,       // attribute is dropped
+        Float2,     // R32G32_FLOAT, 8 bytes
+        Half2,      // R16G16_FLOAT, 4 bytes
+        Unorm16     // R16G16_UNORM against the UV bounds, 4 bytes
+    };
+
+    struct Encoding
+    {
+        Encoding() :
+            Position(PositionEncoding::Unorm16),
+            Normal(DirectionEncoding::Oct16),
+            Tangent(DirectionEncoding::Oct16),
+            TexC(TexCEncoding::Half2){}
+
+        PositionEncoding Position;
+        DirectionEncoding Normal;
+        DirectionEncoding Tangent;
+        TexCEncoding TexC;
+    };
+
+    // An attribute that is copied through unchanged, e.g., skinning weights and
+    // bone indices.
+    struct RawAttribute
+    {
+        const char* SemanticName = nullptr;
+        uint32 SemanticIndex = 0;
+        DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+        uint32 ByteSize = 0;
+
+        const void* Data = nullptr;
+        size_t Stride = 0;
+    };
+
+    // Strided views of the source attributes.  Everything but the positions is
+    // optional; set the pointer to null to drop an attribute.  Tangents only need
+    // their first three components to be floats, so XMFLOAT4 tangents work too.
+    struct SourceAttributes
+    {
+        size_t VertexCount = 0;
+
+        // Size of one source vertex, used to report the memory saved.  Zero means
+        // the sum of the attributes that are packed.
+        size_t SourceStride = 0;
+
+        const DirectX::XMFLOAT3* Positions = nullptr;
+        size_t PositionStride = sizeof(DirectX::XMFLOAT3);
+
+        const DirectX::XMFLOAT3* Normals = nullptr;
+        size_t NormalStride = sizeof(DirectX::XMFLOAT3);
+
+        const float* Tangents = nullptr;
+        size_t TangentStride = sizeof(DirectX::XMFLOAT3);
+
+        const DirectX::XMFLOAT2* TexCs = nullptr;
+        size_t TexCStride = sizeof(DirectX::XMFLOAT2);
+
+        std::vector<RawAttribute> Raw;
+    };
+
+    struct AttributeDesc
+    {
+        const char* SemanticName = nullptr;
+        uint32 SemanticIndex = 0;
+        DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+        uint32 AlignedByteOffset = 0;
+
+        DirectX::XMFLOAT4 Scale = { 1.0f, 1.0f, 1.0f, 1.0f };
+        DirectX::XMFLOAT4 Bias = { 0.0f, 0.0f, 0.0f, 0.0f };
+        bool Octahedral = false;
+    };
+
+    struct PackedVertices
+    {
+        uint32 Stride = 0;
+        size_t VertexCount = 0;
+        std::vector<AttributeDesc> Attributes;
+        std::vector<uint8> Data;
+
+        // Returns the attribute with the given semantic, or null.
+        const AttributeDesc* Find(const char* semanticName, uint32 semanticIndex = 0)const;
+    };
+
+    // Largest error found by decoding every vertex again.  Angles are in degrees.
+    struct Report
+    {
+        size_t SourceBytes = 0;
+        size_t PackedBytes = 0;
+
+        float MaxPositionError = 0.0f;
+        float MaxNormalError = 0.0f;
+        float MaxTangentError = 0.0f;
+        float MaxTexCError = 0.0f;
+    };
+
+    struct DecodedVertex
+    {
+        DirectX::XMFLOAT3 Position = { 0.0f, 0.0f, 0.0f };
+        DirectX::XMFLOAT3 Normal = { 0.0f, 0.0f, 0.0f };
+        DirectX::XMFLOAT3 TangentU = { 0.0f, 0.0f, 0.0f };
+        DirectX::XMFLOAT2 TexC = { 0.0f, 0.0f };
+    };
+
+    static SourceAttributes Attributes(const GeometryGenerator::MeshData& meshData);
+
+    ///<summary>
+    /// Builds an attribute view over an application vertex array, e.g.,
+    /// Attributes(vertices, &Vertex::Pos, &Vertex::Normal, &Vertex::TexC).
+    ///</summary>
+    template<typename VertexT, typename TangentT = DirectX::XMFLOAT3>
+    static SourceAttributes Attributes(const std::vector<VertexT>& vertices,
+        DirectX::XMFLOAT3 VertexT::* position,
+        DirectX::XMFLOAT3 VertexT::* normal = nullptr,
+        DirectX::XMFLOAT2 VertexT::* texC = nullptr,
+        TangentT VertexT::* tangent = nullptr)
+    {
+        static_assert(sizeof(TangentT) >= 3*sizeof(float), "Tangents need at least three floats.");
+
+        SourceAttributes attributes;
+        attributes.VertexCount = vertices.size();
+        attributes.SourceStride = sizeof(VertexT);
+        if(vertices.empty())
+            return attributes;
+
+        attributes.Positions = &(vertices[0].*position);
+        attributes.PositionStride = sizeof(VertexT);
+
+        if(normal != nullptr)
+        {
+            attributes.Normals = &(vertices[0].*normal);
+            attributes.NormalStride = sizeof(VertexT);
+        }
+
+        if(texC != nullptr)
+        {
+            attributes.TexCs = &(vertices[0].*texC);
+            attributes.TexCStride = sizeof(VertexT);
+        }
+
+        if(tangent != nullptr)
+        {
+            attributes.Tangents = reinterpret_cast<const float*>(&(vertices[0].*tangent));
+            attributes.TangentStride = sizeof(VertexT);
+        }
+
+        return attributes;
+    }
+
+    ///<summary>
+    /// Adds a member of an application vertex that is copied through unchanged, e.g.,
+    /// AddRaw(attributes, vertices, &SkinnedVertex::BoneIndices, "BONEINDICES",
+    /// DXGI_FORMAT_R8G8B8A8_UINT).
+    ///</summary>
+    template<typename VertexT, typename MemberT>
+    static void AddRaw(SourceAttributes& attributes, const std::vector<VertexT>& vertices,
+        MemberT VertexT::* member, const char* semanticName, DXGI_FORMAT format, uint32 semanticIndex = 0)
+    {
+        RawAttribute raw;
+        raw.SemanticName = semanticName;
+        raw.SemanticIndex = semanticIndex;
+        raw.Format = format;
+        raw.ByteSize = sizeof(MemberT);
+        raw.Data = vertices.empty() ? nullptr : &(vertices[0].*member);
+        raw.Stride = sizeof(VertexT);
+        attributes.Raw.push_back(raw);
+    }
+
+    ///<summary>
+    /// Packs the attributes.  If report is not null every vertex is decoded again
+    /// and the largest error of each attribute is measured.
+    ///</summary>
+    static PackedVertices Compress(const SourceAttributes& attributes,
+        const Encoding& encoding = Encoding(), Report* report = nullptr);
+
+    static PackedVertices Compress(const GeometryGenerator::MeshData& meshData,
+        const Encoding& encoding = Encoding(), Report* report = nullptr);
+
+    ///<summary>
+    /// Decodes one vertex on the CPU the same way the vertex shader would.
+    ///</summary>
+    static DecodedVertex Decode(const PackedVertices& packed, size_t index);
+
+    ///<summary>
+    /// Octahedral mapping of a unit vector to [-1, 1]^2 and back.
+    ///</summary>
+    static DirectX::XMFLOAT2 OctEncode(const DirectX::XMFLOAT3& n);
+    static DirectX::XMFLOAT3 OctDecode(const DirectX::XMFLOAT2& e);
+};